@@ -0,0 +1,629 @@
+#include "BlockCompress.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t c_bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    inline int RefinePasses(FCompressQuality quality)
+    {
+        switch (quality)
+        {
+            case FCompressQuality::FCompressQuality_FAST: return 0;
+            case FCompressQuality::FCompressQuality_NORMAL: return 1;
+            default: return 4;
+        }
+    }
+
+    inline float Clamp255(float v)
+    {
+        return std::clamp(v, 0.f, 255.f);
+    }
+
+    // LSB first into a zeroed block, the bit order every BC format uses
+    struct FBitWriter
+    {
+        uint8_t* out;
+        uint32_t position{};
+
+        void Write(uint32_t value, uint32_t bits)
+        {
+            for (uint32_t b = 0; b < bits; ++b, ++position)
+            {
+                if ((value >> b) & 1u)
+                {
+                    out[position >> 3] |= static_cast<uint8_t>(1u << (position & 7u));
+                }
+            }
+        }
+    };
+
+    // Endpoints along the principal axis of 'count' channel points, the extremes of the projections.
+    // The bounding box diagonal instead at FAST, inset a little as the palette never hits the corners exactly.
+    template<size_t N>
+    void FindEndpoints(const float (&points)[16][N], FCompressQuality quality, float (&lo)[N], float (&hi)[N])
+    {
+        float minP[N], maxP[N], mean[N]{};
+        for (size_t c = 0; c < N; ++c)
+        {
+            minP[c] = 255.f;
+            maxP[c] = 0.f;
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            for (size_t c = 0; c < N; ++c)
+            {
+                minP[c] = std::min(minP[c], points[i][c]);
+                maxP[c] = std::max(maxP[c], points[i][c]);
+                mean[c] += points[i][c] / 16.f;
+            }
+        }
+
+        if (quality == FCompressQuality::FCompressQuality_FAST)
+        {
+            for (size_t c = 0; c < N; ++c)
+            {
+                const float inset = (maxP[c] - minP[c]) / 16.f;
+                lo[c] = minP[c] + inset;
+                hi[c] = maxP[c] - inset;
+            }
+            return;
+        }
+
+        float covariance[N][N]{};
+        for (int i = 0; i < 16; ++i)
+        {
+            for (size_t a = 0; a < N; ++a)
+            {
+                for (size_t b = 0; b < N; ++b)
+                {
+                    covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+                }
+            }
+        }
+
+        // Power iteration, starting along the bounding box diagonal
+        float axis[N];
+        for (size_t c = 0; c < N; ++c) axis[c] = maxP[c] - minP[c];
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[N]{};
+            float length = 0.f;
+            for (size_t a = 0; a < N; ++a)
+            {
+                for (size_t b = 0; b < N; ++b) next[a] += covariance[a][b] * axis[b];
+                length = std::max(length, std::fabs(next[a]));
+            }
+            if (length < 1e-8f) break;
+            for (size_t c = 0; c < N; ++c) axis[c] = next[c] / length;
+        }
+
+        float axisLength = 0.f;
+        for (size_t c = 0; c < N; ++c) axisLength += axis[c] * axis[c];
+        if (axisLength < 1e-8f)
+        {
+            for (size_t c = 0; c < N; ++c) lo[c] = hi[c] = mean[c];
+            return;
+        }
+
+        float minT = 0.f, maxT = 0.f;
+        for (int i = 0; i < 16; ++i)
+        {
+            float t = 0.f;
+            for (size_t c = 0; c < N; ++c) t += (points[i][c] - mean[c]) * axis[c];
+            t /= axisLength;
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        for (size_t c = 0; c < N; ++c)
+        {
+            lo[c] = Clamp255(mean[c] + axis[c] * minT);
+            hi[c] = Clamp255(mean[c] + axis[c] * maxT);
+        }
+    }
+
+    // Least squares endpoints for fixed indices, weights[i] is the share of endpoint 0 in texel i's palette entry
+    template<size_t N>
+    bool SolveEndpoints(const float (&points)[16][N], const float (&weights)[16], float (&e0)[N], float (&e1)[N])
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        float ap[N]{}, bp[N]{};
+        for (int i = 0; i < 16; ++i)
+        {
+            const float a = weights[i];
+            const float b = 1.f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (size_t c = 0; c < N; ++c)
+            {
+                ap[c] += a * points[i][c];
+                bp[c] += b * points[i][c];
+            }
+        }
+
+        const float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f)
+        {
+            return false;
+        }
+        for (size_t c = 0; c < N; ++c)
+        {
+            e0[c] = Clamp255((ap[c] * bb - bp[c] * ab) / det);
+            e1[c] = Clamp255((bp[c] * aa - ap[c] * ab) / det);
+        }
+        return true;
+    }
+
+    // ---- BC1 ----
+
+    struct FBC1Block
+    {
+        uint16_t color0;
+        uint16_t color1;
+        uint8_t indices[16];
+        float error;
+    };
+
+    inline uint16_t To565(const float (&c)[3])
+    {
+        const uint32_t r = static_cast<uint32_t>(Clamp255(c[0]) * 31.f / 255.f + 0.5f);
+        const uint32_t g = static_cast<uint32_t>(Clamp255(c[1]) * 63.f / 255.f + 0.5f);
+        const uint32_t b = static_cast<uint32_t>(Clamp255(c[2]) * 31.f / 255.f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    inline void From565(uint16_t v, float (&out)[3])
+    {
+        const uint32_t r = v >> 11;
+        const uint32_t g = (v >> 5) & 63u;
+        const uint32_t b = v & 31u;
+        out[0] = static_cast<float>((r << 3) | (r >> 2));
+        out[1] = static_cast<float>((g << 2) | (g >> 4));
+        out[2] = static_cast<float>((b << 3) | (b >> 2));
+    }
+
+    // Four color mode only, color0 > color1, so the block decodes the same as the color half of BC3
+    FBC1Block FitBC1(const float (&points)[16][3], const float (&e0)[3], const float (&e1)[3])
+    {
+        FBC1Block block{};
+        block.color0 = To565(e0);
+        block.color1 = To565(e1);
+        if (block.color0 < block.color1)
+        {
+            std::swap(block.color0, block.color1);
+        }
+
+        float palette[4][3];
+        From565(block.color0, palette[0]);
+        From565(block.color1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+            palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+        }
+        // Equal endpoints are three color mode, where only index 0 is safe
+        const int entries = block.color0 == block.color1 ? 1 : 4;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float bestError = 1e30f;
+            for (int p = 0; p < entries; ++p)
+            {
+                float error = 0.f;
+                for (int c = 0; c < 3; ++c)
+                {
+                    const float d = points[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    block.indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            block.error += bestError;
+        }
+        return block;
+    }
+
+    void EncodeColorBlock(const float (&points)[16][3], FCompressQuality quality, uint8_t out[8])
+    {
+        static constexpr float c_share[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+        float lo[3], hi[3];
+        FindEndpoints(points, quality, lo, hi);
+        FBC1Block best = FitBC1(points, hi, lo);
+
+        for (int pass = 0; pass < RefinePasses(quality) and best.error > 0.f; ++pass)
+        {
+            float weights[16];
+            for (int i = 0; i < 16; ++i) weights[i] = c_share[best.indices[i]];
+
+            float e0[3], e1[3];
+            if (not SolveEndpoints(points, weights, e0, e1)) break;
+
+            const FBC1Block candidate = FitBC1(points, e0, e1);
+            if (candidate.error >= best.error) break;
+            best = candidate;
+        }
+
+        out[0] = static_cast<uint8_t>(best.color0);
+        out[1] = static_cast<uint8_t>(best.color0 >> 8);
+        out[2] = static_cast<uint8_t>(best.color1);
+        out[3] = static_cast<uint8_t>(best.color1 >> 8);
+        uint32_t indexBits = 0;
+        for (int i = 0; i < 16; ++i) indexBits |= static_cast<uint32_t>(best.indices[i]) << (2 * i);
+        memcpy(out + 4, &indexBits, sizeof(indexBits));
+    }
+
+    // ---- BC4 ----
+
+    struct FBC4Block
+    {
+        uint8_t alpha0;
+        uint8_t alpha1;
+        uint8_t indices[16];
+        float error;
+    };
+
+    // Eight value mode, alpha0 > alpha1
+    FBC4Block FitBC4(const float (&values)[16][1], float e0, float e1)
+    {
+        FBC4Block block{};
+        block.alpha0 = static_cast<uint8_t>(Clamp255(std::max(e0, e1)) + 0.5f);
+        block.alpha1 = static_cast<uint8_t>(Clamp255(std::min(e0, e1)) + 0.5f);
+
+        float palette[8];
+        palette[0] = block.alpha0;
+        palette[1] = block.alpha1;
+        for (int p = 2; p < 8; ++p)
+        {
+            palette[p] = (static_cast<float>(8 - p) * block.alpha0 + static_cast<float>(p - 1) * block.alpha1) / 7.f;
+        }
+        // Equal endpoints would select the six value mode, index 0 decodes right in both
+        const int entries = block.alpha0 == block.alpha1 ? 1 : 8;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            float bestError = 1e30f;
+            for (int p = 0; p < entries; ++p)
+            {
+                const float d = values[i][0] - palette[p];
+                if (d * d < bestError)
+                {
+                    bestError = d * d;
+                    block.indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            block.error += bestError;
+        }
+        return block;
+    }
+
+    void EncodeChannelBlock(const float (&values)[16][1], FCompressQuality quality, uint8_t out[8])
+    {
+        float lo = 255.f, hi = 0.f;
+        for (int i = 0; i < 16; ++i)
+        {
+            lo = std::min(lo, values[i][0]);
+            hi = std::max(hi, values[i][0]);
+        }
+        FBC4Block best = FitBC4(values, hi, lo);
+
+        for (int pass = 0; pass < RefinePasses(quality) and best.error > 0.f; ++pass)
+        {
+            float weights[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                const uint8_t index = best.indices[i];
+                weights[i] = index == 0 ? 1.f : index == 1 ? 0.f : static_cast<float>(8 - index) / 7.f;
+            }
+
+            float e0[1], e1[1];
+            if (not SolveEndpoints(values, weights, e0, e1)) break;
+
+            const FBC4Block candidate = FitBC4(values, e0[0], e1[0]);
+            if (candidate.error >= best.error) break;
+            best = candidate;
+        }
+
+        memset(out, 0, 8);
+        out[0] = best.alpha0;
+        out[1] = best.alpha1;
+        FBitWriter writer{ out, 16 };
+        for (int i = 0; i < 16; ++i) writer.Write(best.indices[i], 3);
+    }
+
+    // ---- BC7 mode 6 ----
+
+    struct FBC7Block
+    {
+        uint32_t endpoint0[4];  // 7 bits
+        uint32_t endpoint1[4];
+        uint32_t pbit0;
+        uint32_t pbit1;
+        uint8_t indices[16];
+        float error;
+    };
+
+    inline uint32_t Quantize7(float value, uint32_t pbit)
+    {
+        const float q = (value - static_cast<float>(pbit)) / 2.f + 0.5f;
+        return static_cast<uint32_t>(std::clamp(q, 0.f, 127.f));
+    }
+
+    FBC7Block FitBC7(const float (&points)[16][4], const float (&e0)[4], const float (&e1)[4], uint32_t pbit0, uint32_t pbit1)
+    {
+        FBC7Block block{};
+        block.pbit0 = pbit0;
+        block.pbit1 = pbit1;
+
+        uint32_t v0[4], v1[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            block.endpoint0[c] = Quantize7(e0[c], pbit0);
+            block.endpoint1[c] = Quantize7(e1[c], pbit1);
+            v0[c] = (block.endpoint0[c] << 1) | pbit0;
+            v1[c] = (block.endpoint1[c] << 1) | pbit1;
+        }
+
+        float palette[16][4];
+        for (int p = 0; p < 16; ++p)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                palette[p][c] = static_cast<float>(((64u - c_bc7Weights[p]) * v0[c] + c_bc7Weights[p] * v1[c] + 32u) >> 6);
+            }
+        }
+
+        // The palette lies on a line: project onto it and only compare the entries around the projection
+        float axis[4];
+        float axisLength = 0.f;
+        for (int c = 0; c < 4; ++c)
+        {
+            axis[c] = palette[15][c] - palette[0][c];
+            axisLength += axis[c] * axis[c];
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int guess = 0;
+            if (axisLength > 0.f)
+            {
+                float t = 0.f;
+                for (int c = 0; c < 4; ++c) t += (points[i][c] - palette[0][c]) * axis[c];
+                const float weight = std::clamp(t / axisLength, 0.f, 1.f) * 64.f;
+                while (guess < 15 and static_cast<float>(c_bc7Weights[guess + 1]) <= weight) ++guess;
+            }
+
+            float bestError = 1e30f;
+            for (int p = std::max(guess - 1, 0); p <= std::min(guess + 2, 15); ++p)
+            {
+                float error = 0.f;
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float d = points[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    block.indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            block.error += bestError;
+        }
+        return block;
+    }
+
+    // The p-bit whose quantization lands closest to the endpoint
+    uint32_t BestPbit(const float (&e)[4])
+    {
+        float error[2]{};
+        for (uint32_t p = 0; p < 2; ++p)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                const float d = e[c] - static_cast<float>((Quantize7(e[c], p) << 1) | p);
+                error[p] += d * d;
+            }
+        }
+        return error[1] < error[0] ? 1u : 0u;
+    }
+
+    FBC7Block FitBC7Pbits(const float (&points)[16][4], const float (&e0)[4], const float (&e1)[4], FCompressQuality quality)
+    {
+        if (quality != FCompressQuality::FCompressQuality_HIGH)
+        {
+            return FitBC7(points, e0, e1, BestPbit(e0), BestPbit(e1));
+        }
+
+        FBC7Block best = FitBC7(points, e0, e1, 0, 0);
+        for (uint32_t combination = 1; combination < 4; ++combination)
+        {
+            const FBC7Block candidate = FitBC7(points, e0, e1, combination & 1u, combination >> 1);
+            if (candidate.error < best.error) best = candidate;
+        }
+        return best;
+    }
+
+    void WriteBC7Mode6(FBC7Block block, uint8_t out[16])
+    {
+        // The anchor index drops its top bit, so texel 0 has to use the lower half of the palette
+        if (block.indices[0] >= 8)
+        {
+            std::swap(block.endpoint0, block.endpoint1);
+            std::swap(block.pbit0, block.pbit1);
+            for (uint8_t& index : block.indices) index = static_cast<uint8_t>(15 - index);
+        }
+
+        memset(out, 0, 16);
+        FBitWriter writer{ out };
+        writer.Write(1u << 6, 7);
+        for (int c = 0; c < 4; ++c)
+        {
+            writer.Write(block.endpoint0[c], 7);
+            writer.Write(block.endpoint1[c], 7);
+        }
+        writer.Write(block.pbit0, 1);
+        writer.Write(block.pbit1, 1);
+        writer.Write(block.indices[0], 3);
+        for (int i = 1; i < 16; ++i) writer.Write(block.indices[i], 4);
+    }
+
+    void LoadBlock(const FImage& image, uint32_t blockX, uint32_t blockY, uint8_t (&rgba)[64])
+    {
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            const uint32_t sy = std::min(blockY * 4u + y, image.height - 1u);
+            const uint8_t* row = image.texels.data() + static_cast<size_t>(sy) * image.rowPitch;
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                const uint32_t sx = std::min(blockX * 4u + x, image.width - 1u);
+                memcpy(rgba + (y * 4u + x) * 4u, row + sx * 4u, 4);
+            }
+        }
+    }
+
+    void EncodeBlock(FPixelFormat format, const uint8_t (&rgba)[64], const FCompressOptions& options, uint8_t* out)
+    {
+        switch (format)
+        {
+            case FPixelFormat::FPixelFormat_BC1: EncodeBC1(rgba, options.quality, out); break;
+            case FPixelFormat::FPixelFormat_BC3: EncodeBC3(rgba, options.quality, out); break;
+            case FPixelFormat::FPixelFormat_BC4: EncodeBC4(rgba, options.channels[0], options.quality, out); break;
+            case FPixelFormat::FPixelFormat_BC5: EncodeBC5(rgba, options.channels[0], options.channels[1], options.quality, out); break;
+            case FPixelFormat::FPixelFormat_BC7: EncodeBC7(rgba, options.quality, out); break;
+            default: throw std::invalid_argument("Not a block compressed format");
+        }
+    }
+}
+
+const char* CompressQualityToString(FCompressQuality quality)
+{
+    switch (quality)
+    {
+        case FCompressQuality::FCompressQuality_FAST: return "Fast";
+        case FCompressQuality::FCompressQuality_NORMAL: return "Normal";
+        case FCompressQuality::FCompressQuality_HIGH: return "High";
+        default: return "Unknown";
+    }
+}
+
+void EncodeBC1(const uint8_t rgba[64], FCompressQuality quality, uint8_t out[8])
+{
+    float points[16][3];
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 3; ++c) points[i][c] = rgba[i * 4 + c];
+    }
+    EncodeColorBlock(points, quality, out);
+}
+
+void EncodeBC3(const uint8_t rgba[64], FCompressQuality quality, uint8_t out[16])
+{
+    EncodeBC4(rgba, 3, quality, out);
+    EncodeBC1(rgba, quality, out + 8);
+}
+
+void EncodeBC4(const uint8_t rgba[64], uint32_t channel, FCompressQuality quality, uint8_t out[8])
+{
+    float values[16][1];
+    for (int i = 0; i < 16; ++i) values[i][0] = rgba[i * 4 + static_cast<int>(channel & 3u)];
+    EncodeChannelBlock(values, quality, out);
+}
+
+void EncodeBC5(const uint8_t rgba[64], uint32_t channel0, uint32_t channel1, FCompressQuality quality, uint8_t out[16])
+{
+    EncodeBC4(rgba, channel0, quality, out);
+    EncodeBC4(rgba, channel1, quality, out + 8);
+}
+
+void EncodeBC7(const uint8_t rgba[64], FCompressQuality quality, uint8_t out[16])
+{
+    float points[16][4];
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 4; ++c) points[i][c] = rgba[i * 4 + c];
+    }
+
+    float lo[4], hi[4];
+    FindEndpoints(points, quality, lo, hi);
+    FBC7Block best = FitBC7Pbits(points, lo, hi, quality);
+
+    for (int pass = 0; pass < RefinePasses(quality) and best.error > 0.f; ++pass)
+    {
+        float weights[16];
+        for (int i = 0; i < 16; ++i) weights[i] = static_cast<float>(64u - c_bc7Weights[best.indices[i]]) / 64.f;
+
+        float e0[4], e1[4];
+        if (not SolveEndpoints(points, weights, e0, e1)) break;
+
+        const FBC7Block candidate = FitBC7Pbits(points, e0, e1, quality);
+        if (candidate.error >= best.error) break;
+        best = candidate;
+    }
+
+    WriteBC7Mode6(best, out);
+}
+
+FCompressStats CompressTexture(FThreadPool& pool, const FTextureData& source, FPixelFormat format,
+    const FCompressOptions& options, FTextureData& out)
+{
+    if (source.format != FPixelFormat::FPixelFormat_RGBA8 or not IsBlockCompressed(format))
+    {
+        throw std::invalid_argument("Block compression goes from RGBA8 to a BC format");
+    }
+
+    struct FBlockRow
+    {
+        uint32_t level;
+        uint32_t blockY;
+    };
+
+    FCompressStats stats;
+    const uint32_t alignment = std::max(options.rowPitchAlignment, 1u);
+    const uint32_t blockSize = FormatElementSize(format);
+
+    out.format = format;
+    out.levels.resize(source.levels.size());
+    std::vector<FBlockRow> rows;
+    for (uint32_t level = 0; level < source.levels.size(); ++level)
+    {
+        const FImage& src = source.levels[level];
+        FImage& dst = out.levels[level];
+        dst.width = src.width;
+        dst.height = src.height;
+        dst.rowPitch = (FormatRowSize(format, src.width) + alignment - 1u) / alignment * alignment;
+        dst.texels.assign(static_cast<size_t>(dst.rowPitch) * FormatRowCount(format, src.height), 0);
+
+        for (uint32_t blockY = 0; blockY < FormatRowCount(format, src.height); ++blockY)
+        {
+            rows.push_back({ level, blockY });
+        }
+        stats.pixels += static_cast<uint64_t>(src.width) * src.height;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.ParallelFor(rows.size(), [&](size_t i) {
+        const FImage& src = source.levels[rows[i].level];
+        FImage& dst = out.levels[rows[i].level];
+        uint8_t* dstRow = dst.texels.data() + static_cast<size_t>(rows[i].blockY) * dst.rowPitch;
+
+        uint8_t rgba[64];
+        for (uint32_t blockX = 0; blockX < (src.width + 3u) / 4u; ++blockX)
+        {
+            LoadBlock(src, blockX, rows[i].blockY, rgba);
+            EncodeBlock(format, rgba, options, dstRow + blockX * blockSize);
+        }
+    });
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.megapixelsPerSecond = stats.seconds > 0.0 ? static_cast<double>(stats.pixels) / 1e6 / stats.seconds : 0.0;
+    return stats;
+}
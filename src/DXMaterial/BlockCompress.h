@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ImageDecoder.h"
+#include "ThreadPool.h"
+
+enum class FCompressQuality : uint32_t {
+    FCompressQuality_FAST = 0,      // bounding box endpoints, no refinement
+    FCompressQuality_NORMAL = 1,    // principal axis endpoints, one least squares refinement
+    FCompressQuality_HIGH = 2,      // more refinement passes, every BC7 p-bit combination
+    FCompressQuality_MAX = 3
+};
+
+struct FCompressOptions
+{
+    FCompressQuality quality{ FCompressQuality::FCompressQuality_NORMAL };
+    uint32_t channels[2]{ 0u, 1u };     // source channels of BC5, BC4 takes the first
+    uint32_t rowPitchAlignment{ 256u }; // between block rows
+};
+
+struct FCompressStats
+{
+    uint64_t pixels{};
+    double seconds{};
+    double megapixelsPerSecond{};
+};
+
+const char* CompressQualityToString(FCompressQuality quality);
+
+// One 4x4 block each, 'rgba' holds the 16 texels in row order
+void EncodeBC1(const uint8_t rgba[64], FCompressQuality quality, uint8_t out[8]);
+void EncodeBC3(const uint8_t rgba[64], FCompressQuality quality, uint8_t out[16]);
+void EncodeBC4(const uint8_t rgba[64], uint32_t channel, FCompressQuality quality, uint8_t out[8]);
+void EncodeBC5(const uint8_t rgba[64], uint32_t channel0, uint32_t channel1, FCompressQuality quality, uint8_t out[16]);
+// Mode 6 only: one subset, 7 bit RGBA endpoints with a p-bit each and 4 bit indices
+void EncodeBC7(const uint8_t rgba[64], FCompressQuality quality, uint8_t out[16]);
+
+// Encodes every level of an RGBA8 texture to 'format', the block rows of all levels are spread over the pool.
+// Edge blocks of levels that are no multiple of 4 repeat the last row and column. Pure C++, runs headless.
+FCompressStats CompressTexture(FThreadPool& pool, const FTextureData& source, FPixelFormat format,
+    const FCompressOptions& options, FTextureData& out);
@@ -0,0 +1,140 @@
+#include "FrustumCull.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define F_FRUSTUM_CULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t c_groupSize = 4;
+
+    inline size_t PaddedCount(size_t count)
+    {
+        return (count + c_groupSize - 1) / c_groupSize * c_groupSize;
+    }
+}
+
+FFrustum MakeFrustum(const float m[4][4])
+{
+    // Row vectors: clip = v * M, so each clip component is a column of M
+    auto column = [&](int c, float out[4]) {
+        for (int r = 0; r < 4; ++r) out[r] = m[r][c];
+    };
+
+    float x[4], y[4], z[4], w[4];
+    column(0, x);
+    column(1, y);
+    column(2, z);
+    column(3, w);
+
+    FFrustum frustum;
+    for (int i = 0; i < 4; ++i)
+    {
+        frustum.planes[0][i] = w[i] + x[i];  // left
+        frustum.planes[1][i] = w[i] - x[i];  // right
+        frustum.planes[2][i] = w[i] + y[i];  // bottom
+        frustum.planes[3][i] = w[i] - y[i];  // top
+        frustum.planes[4][i] = z[i];         // near
+        frustum.planes[5][i] = w[i] - z[i];  // far
+    }
+
+    for (float* plane : frustum.planes)
+    {
+        const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.f)
+        {
+            for (int i = 0; i < 4; ++i) plane[i] /= length;
+        }
+    }
+    return frustum;
+}
+
+void FCullBoxes::Resize(size_t count)
+{
+    m_count = count;
+    const size_t padded = PaddedCount(count);
+    // Padding lanes hold empty boxes at the origin, their result is never read
+    m_centerX.assign(padded, 0.f);
+    m_centerY.assign(padded, 0.f);
+    m_centerZ.assign(padded, 0.f);
+    m_extentX.assign(padded, 0.f);
+    m_extentY.assign(padded, 0.f);
+    m_extentZ.assign(padded, 0.f);
+}
+
+void FCullBoxes::Set(size_t index, const float center[3], const float extent[3])
+{
+    m_centerX[index] = center[0];
+    m_centerY[index] = center[1];
+    m_centerZ[index] = center[2];
+    m_extentX[index] = extent[0];
+    m_extentY[index] = extent[1];
+    m_extentZ[index] = extent[2];
+}
+
+size_t FCullBoxes::Cull(const FFrustum& frustum, uint8_t* visible) const
+{
+    size_t visibleCount = 0;
+
+#if F_FRUSTUM_CULL_SSE
+    // Four boxes per iteration: a box is outside when centre distance + projected extent < 0 for any plane
+    __m128 planeA[6], planeB[6], planeC[6], planeD[6], absA[6], absB[6], absC[6];
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    for (int p = 0; p < 6; ++p)
+    {
+        planeA[p] = _mm_set1_ps(frustum.planes[p][0]);
+        planeB[p] = _mm_set1_ps(frustum.planes[p][1]);
+        planeC[p] = _mm_set1_ps(frustum.planes[p][2]);
+        planeD[p] = _mm_set1_ps(frustum.planes[p][3]);
+        absA[p] = _mm_andnot_ps(signMask, planeA[p]);
+        absB[p] = _mm_andnot_ps(signMask, planeB[p]);
+        absC[p] = _mm_andnot_ps(signMask, planeC[p]);
+    }
+
+    for (size_t group = 0; group < m_count; group += c_groupSize)
+    {
+        const __m128 cx = _mm_loadu_ps(m_centerX.data() + group);
+        const __m128 cy = _mm_loadu_ps(m_centerY.data() + group);
+        const __m128 cz = _mm_loadu_ps(m_centerZ.data() + group);
+        const __m128 ex = _mm_loadu_ps(m_extentX.data() + group);
+        const __m128 ey = _mm_loadu_ps(m_extentY.data() + group);
+        const __m128 ez = _mm_loadu_ps(m_extentZ.data() + group);
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeA[p], cx), _mm_mul_ps(planeB[p], cy)), _mm_add_ps(_mm_mul_ps(planeC[p], cz), planeD[p]));
+            const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absA[p], ex), _mm_mul_ps(absB[p], ey)), _mm_mul_ps(absC[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        const int mask = _mm_movemask_ps(outside);
+        const size_t lanes = m_count - group < c_groupSize ? m_count - group : c_groupSize;
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            const uint8_t inside = (mask >> lane) & 1 ? 0u : 1u;
+            visible[group + lane] = inside;
+            visibleCount += inside;
+        }
+    }
+#else
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        uint8_t inside = 1u;
+        for (int p = 0; p < 6 and inside; ++p)
+        {
+            const float* plane = frustum.planes[p];
+            const float distance = plane[0] * m_centerX[i] + plane[1] * m_centerY[i] + plane[2] * m_centerZ[i] + plane[3];
+            const float radius = std::abs(plane[0]) * m_extentX[i] + std::abs(plane[1]) * m_extentY[i] + std::abs(plane[2]) * m_extentZ[i];
+            inside = distance + radius >= 0.f;
+        }
+        visible[i] = inside;
+        visibleCount += inside;
+    }
+#endif
+
+    return visibleCount;
+}
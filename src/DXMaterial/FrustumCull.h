@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Six normalized planes (a, b, c, d), a point p is inside when a*x + b*y + c*z + d >= 0 for all of them
+struct FFrustum
+{
+    float planes[6][4];
+};
+
+// Planes of a row vector view * projection matrix (DirectXMath convention, clip z in [0, w])
+FFrustum MakeFrustum(const float viewProjection[4][4]);
+
+// World space AABBs as structure of arrays, padded so the SIMD path can read whole groups of four
+class FCullBoxes
+{
+public:
+    void Resize(size_t count);
+    inline size_t Size() const { return m_count; }
+    void Set(size_t index, const float center[3], const float extent[3]);
+
+    // visible[i] is set to 1 for boxes intersecting the frustum and 0 otherwise, returns the visible count
+    size_t Cull(const FFrustum& frustum, uint8_t* visible) const;
+
+private:
+    size_t m_count{};
+    std::vector<float> m_centerX, m_centerY, m_centerZ;
+    std::vector<float> m_extentX, m_extentY, m_extentZ;
+};
@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include <stdexcept>
+
+#include "GeometryPool.h"
+
+namespace
+{
+    inline UINT64 AlignUp(UINT64 value, UINT64 alignment)
+    {
+        return (value + alignment - 1u) / alignment * alignment;
+    }
+
+    // Small meshes are the common case, a page has room for a lot of them
+    constexpr uint32_t c_maxAllocationsPerPage = 64u * 1024u;
+}
+
+_Use_decl_annotations_
+FGeometryPool::FGeometryPool(ID3D12Device* device, UINT64 pageSize) : m_device(device), m_pageSize(AlignUp(pageSize, c_alignment))
+{
+    if (not device)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+    if (m_pageSize / c_alignment > UINT32_MAX)
+    {
+        throw std::out_of_range("Geometry pool page size is too large");
+    }
+}
+
+FGeometryPool::FPage& FGeometryPool::CreatePage(UINT64 size)
+{
+    auto page = std::make_unique<FPage>();
+
+    const D3D12_HEAP_PROPERTIES defaultHeapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    const D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    if (FAILED(m_device->CreateCommittedResource(
+        &defaultHeapProp,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&page->buffer)))) throw std::runtime_error("Failed to create geometry pool page");
+
+    page->buffer->SetName(std::format(L"FGeometryPool::page_{}", m_pages.size()).c_str());
+    page->allocator.Reset(static_cast<uint32_t>(size / c_alignment), c_maxAllocationsPerPage);
+
+    m_pages.push_back(std::move(page));
+    return *m_pages.back();
+}
+
+_Use_decl_annotations_
+FGeometryAllocation FGeometryPool::Allocate(UINT64 size)
+{
+    const UINT64 alignedSize = AlignUp(std::max<UINT64>(size, 1u), c_alignment);
+    if (alignedSize / c_alignment > UINT32_MAX)
+    {
+        throw std::out_of_range("Geometry allocation is too large");
+    }
+    const uint32_t units = static_cast<uint32_t>(alignedSize / c_alignment);
+
+    std::scoped_lock lock(m_mutex);
+
+    FGeometryAllocation result{};
+    for (UINT pageIndex = 0; pageIndex < static_cast<UINT>(m_pages.size()) and not result.IsValid(); ++pageIndex)
+    {
+        const FOffsetAllocation allocation = m_pages[pageIndex]->allocator.Allocate(units);
+        if (allocation.IsValid())
+        {
+            result.page = pageIndex;
+            result.allocation = allocation;
+        }
+    }
+    if (not result.IsValid())
+    {
+        FPage& page = CreatePage(std::max(alignedSize, m_pageSize));
+        result.page = static_cast<UINT>(m_pages.size()) - 1u;
+        result.allocation = page.allocator.Allocate(units);
+    }
+
+    const FPage& page = *m_pages[result.page];
+    result.buffer = page.buffer.Get();
+    result.offset = static_cast<UINT64>(result.allocation.offset) * c_alignment;
+    result.size = size;
+    result.gpuAddress = page.buffer->GetGPUVirtualAddress() + result.offset;
+    return result;
+}
+
+_Use_decl_annotations_
+void FGeometryPool::Free(FGeometryAllocation& allocation)
+{
+    if (not allocation.IsValid())
+    {
+        return;
+    }
+
+    std::scoped_lock lock(m_mutex);
+    m_pages[allocation.page]->allocator.Free(allocation.allocation);
+    allocation = {};
+}
+
+UINT64 FGeometryPool::GetCapacity() const
+{
+    std::scoped_lock lock(m_mutex);
+
+    UINT64 capacity{};
+    for (const std::unique_ptr<FPage>& page : m_pages)
+    {
+        capacity += static_cast<UINT64>(page->allocator.GetSize()) * c_alignment;
+    }
+    return capacity;
+}
+
+UINT64 FGeometryPool::GetFreeBytes() const
+{
+    std::scoped_lock lock(m_mutex);
+
+    UINT64 freeBytes{};
+    for (const std::unique_ptr<FPage>& page : m_pages)
+    {
+        freeBytes += static_cast<UINT64>(page->allocator.GetFreeStorage()) * c_alignment;
+    }
+    return freeBytes;
+}
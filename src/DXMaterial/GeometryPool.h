@@ -0,0 +1,53 @@
+#pragma once
+
+#include "OffsetAllocator.h"
+
+// A vertex or index range inside one of the pool's buffers
+struct FGeometryAllocation
+{
+    UINT page{ UINT_MAX };
+    FOffsetAllocation allocation;
+    ID3D12Resource* buffer{};
+    UINT64 offset{};    // bytes into 'buffer'
+    UINT64 size{};
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress{};
+
+    inline bool IsValid() const { return page != UINT_MAX; }
+};
+
+// Suballocates vertex and index data of every mesh from a few large default heap buffers instead of
+// one committed resource each. Pages are created on demand, a request larger than a page gets a page
+// of its own. Allocate and Free are thread safe. Pages stay in COMMON, FUploadRing copies into them on the
+// copy queue and the direct queue promotes them to vertex and index buffer reads implicitly.
+class FGeometryPool
+{
+public:
+    static constexpr UINT64 c_defaultPageSize = 64ull << 20;
+    // Allocation unit, covers the vertex stride and index format alignment
+    static constexpr UINT64 c_alignment = 16u;
+
+    FGeometryPool(_In_ ID3D12Device* device, _In_ UINT64 pageSize = c_defaultPageSize);
+    FGeometryPool(const FGeometryPool&) = delete;
+    FGeometryPool& operator=(const FGeometryPool&) = delete;
+
+    FGeometryAllocation Allocate(_In_ UINT64 size);
+    void Free(_Inout_ FGeometryAllocation& allocation);
+
+    UINT64 GetCapacity() const;
+    UINT64 GetFreeBytes() const;
+
+private:
+    struct FPage
+    {
+        ComPtr<ID3D12Resource> buffer;
+        FOffsetAllocator allocator;
+    };
+
+    ID3D12Device* m_device;
+    UINT64 m_pageSize;
+    mutable std::mutex m_mutex;
+    // unique_ptr so a growing vector never moves a page another thread is reading
+    std::vector<std::unique_ptr<FPage>> m_pages;
+
+    FPage& CreatePage(UINT64 size);
+};
@@ -1,5 +1,13 @@
 #pragma once
 
+#include "ThreadPool.h"
+#include "GeometryPool.h"
+#include "UploadRing.h"
+#include "TextureCache.h"
+#include "ImageDecoder.h"
+#include "Mipmap.h"
+#include "BlockCompress.h"
+
 class IApp
 {
 public:
@@ -21,6 +29,10 @@ public:
     inline ComPtr<ID3D12DescriptorHeap>& GetModelSrvHeap() { return im_modelSrvHeap; }
     inline ComPtr<ID3D12DescriptorHeap>& GetImguiSrvHeap() { return im_imGuiSrvHeap; }
     inline UINT GetModelSrvDescriptorSize() const { return im_modelSrvDescriptorSize; }
+    inline FThreadPool& GetWorkerPool() { return *im_workerPool; }
+    inline FGeometryPool& GetGeometryPool() { return *im_geometryPool; }
+    inline FUploadRing& GetUploadRing() { return *im_uploadRing; }
+    inline FTextureCache& GetTextureCache() { return *im_textureCache; }
 
     void modelSrvAlloc(D3D12_CPU_DESCRIPTOR_HANDLE* out_cpu_desc_handle, D3D12_GPU_DESCRIPTOR_HANDLE* out_gpu_desc_handle, int allocAmount = 1);
     void modelSrvFree(D3D12_CPU_DESCRIPTOR_HANDLE cpu_desc_handle, D3D12_GPU_DESCRIPTOR_HANDLE gpu_desc_handle);
@@ -34,7 +46,31 @@ public:
 
     static const UINT FrameCount = 2;
     const INT c_maxObjects = 100;
+    // Instance transforms one frame can draw, shared by all meshes
+    const INT c_maxInstances = 16384;
     INT m_remainingMeshSlots = c_maxObjects;
+    // Upper bound of upload heap memory while loading, read when the device is created
+    UINT64 m_uploadRingSize = FUploadRing::c_defaultSize;
+    // Decoder for texture files, both produce the same RGBA8 texels
+    FImageBackend m_imageBackend = FImageBackend::FImageBackend_WIC;
+    // Downsampling filter of the mip chains built at load
+    FMipFilter m_mipFilter = FMipFilter::FMipFilter_BOX;
+    // Block compress textures after their mips are built, BC7 / BC5 / BC4 picked by how the shader reads them
+    bool m_compressTextures{ true };
+    // Fast trades quality for import time and stores color as BC1 / BC3 instead of BC7
+    FCompressQuality m_compressQuality = FCompressQuality::FCompressQuality_NORMAL;
+    // Uniform textures become material constants instead of a texture, descriptor and sample.
+    // Tolerance is the largest spread of 8 bit values in a channel that still counts as uniform.
+    bool m_foldConstantTextures{ true };
+    UINT m_constantTextureTolerance{ 2 };
+    // Separate AO, roughness and metalness maps of one size merge into one ORM texture the shader samples once
+    bool m_packOrmTextures{ true };
+    // Imported textures are written to cache/textures in their final layout and mapped instead of decoded on later runs
+    bool m_cookTextures{ true };
+    // Cooked textures load with their mip tail only and stream finer levels by screen size, the least recently
+    // needed ones are evicted while the textures take more than the budget. Read when a texture is created.
+    bool m_streamTextures{ true };
+    UINT m_textureBudgetMB{ 512 };
 
     protected:
         static IApp* s_instance;
@@ -49,4 +85,9 @@ public:
 
         ComPtr<ID3D12DescriptorHeap> im_fallbackTexSrvHeap;
         UINT im_fallbackSrvDescriptorSize{};
+
+        std::unique_ptr<FThreadPool> im_workerPool;
+        std::unique_ptr<FGeometryPool> im_geometryPool;
+        std::unique_ptr<FUploadRing> im_uploadRing;
+        std::unique_ptr<FTextureCache> im_textureCache;
 };
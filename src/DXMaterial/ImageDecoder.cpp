@@ -0,0 +1,226 @@
+#include "ImageDecoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+
+const char* ImageBackendToString(FImageBackend backend)
+{
+    switch (backend)
+    {
+        case FImageBackend::FImageBackend_WIC: return "WIC";
+        case FImageBackend::FImageBackend_STB: return "stb_image";
+        default: return "Unknown";
+    }
+}
+
+const char* PixelFormatToString(FPixelFormat format)
+{
+    switch (format)
+    {
+        case FPixelFormat::FPixelFormat_RGBA8: return "RGBA8";
+        case FPixelFormat::FPixelFormat_R8: return "R8";
+        case FPixelFormat::FPixelFormat_RG8: return "RG8";
+        case FPixelFormat::FPixelFormat_BC1: return "BC1";
+        case FPixelFormat::FPixelFormat_BC3: return "BC3";
+        case FPixelFormat::FPixelFormat_BC4: return "BC4";
+        case FPixelFormat::FPixelFormat_BC5: return "BC5";
+        case FPixelFormat::FPixelFormat_BC7: return "BC7";
+        default: return "Unknown";
+    }
+}
+
+bool DecodeImage(IImageDecoder& decoder, FImage& out, uint32_t rowPitchAlignment)
+{
+    out = FImage{};
+    const uint64_t width = decoder.GetWidth();
+    const uint64_t height = decoder.GetHeight();
+    if (width == 0 or height == 0 or rowPitchAlignment == 0)
+    {
+        return false;
+    }
+
+    const uint64_t rowPitch = (width * 4u + rowPitchAlignment - 1u) / rowPitchAlignment * rowPitchAlignment;
+    if (rowPitch > UINT32_MAX)
+    {
+        return false;
+    }
+
+    out.texels.resize(static_cast<size_t>(rowPitch * height));
+    if (not decoder.ReadRows(out.texels.data(), 0, static_cast<uint32_t>(height), static_cast<uint32_t>(rowPitch)))
+    {
+        out.texels.clear();
+        return false;
+    }
+
+    out.width = static_cast<uint32_t>(width);
+    out.height = static_cast<uint32_t>(height);
+    out.rowPitch = static_cast<uint32_t>(rowPitch);
+    return true;
+}
+
+bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& out)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (not file)
+    {
+        return false;
+    }
+
+    const std::streamoff size = file.tellg();
+    if (size < 0)
+    {
+        return false;
+    }
+
+    out.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(out.data()), size));
+}
+
+void DecodeImagesParallel(FThreadPool& pool, size_t count, uint32_t maxInFlight,
+    const std::function<bool(size_t index, FTextureData& out)>& decode,
+    const std::function<void(size_t index, FTextureData& texture)>& consume)
+{
+    struct FDecoded
+    {
+        size_t index;
+        FTextureData texture;
+    };
+
+    std::mutex mutex;
+    std::condition_variable slotFreed;
+    std::deque<FDecoded> decoded;
+    uint32_t inFlight = 0;      // decoding, queued or being consumed
+    bool consuming = false;     // 'decoded' is never left non empty without a consumer
+    bool aborted = false;       // 'consume' threw, nothing else gets decoded
+    maxInFlight = std::max(maxInFlight, 1u);
+
+    pool.ParallelFor(count, [&](size_t index) {
+        {
+            std::unique_lock lock(mutex);
+            slotFreed.wait(lock, [&]() { return inFlight < maxInFlight or aborted; });
+            if (aborted)
+            {
+                return;
+            }
+            inFlight++;
+        }
+
+        FTextureData texture;
+        bool succeeded = false;
+        try
+        {
+            succeeded = decode(index, texture);
+        }
+        catch (...)
+        {
+            std::scoped_lock lock(mutex);
+            inFlight--;
+            slotFreed.notify_one();
+            throw;
+        }
+
+        std::unique_lock lock(mutex);
+        if (not succeeded or aborted)
+        {
+            inFlight--;
+            slotFreed.notify_one();
+            return;
+        }
+
+        decoded.push_back({ index, std::move(texture) });
+        if (consuming)
+        {
+            return;
+        }
+
+        // This thread hands over everything finished meanwhile, including what other workers queue
+        consuming = true;
+        while (not decoded.empty())
+        {
+            FDecoded next = std::move(decoded.front());
+            decoded.pop_front();
+            lock.unlock();
+
+            try
+            {
+                consume(next.index, next.texture);
+            }
+            catch (...)
+            {
+                lock.lock();
+                inFlight -= 1u + static_cast<uint32_t>(decoded.size());
+                decoded.clear();
+                consuming = false;
+                aborted = true;
+                slotFreed.notify_all();
+                throw;
+            }
+
+            // Texels go before the slot, so memory never exceeds maxInFlight textures
+            next.texture = FTextureData{};
+            lock.lock();
+            inFlight--;
+            slotFreed.notify_one();
+        }
+        consuming = false;
+    });
+}
+
+FDecodeThroughput MeasureDecodeThroughput(const FImageDecoderFactory& createDecoder,
+    std::span<const std::vector<uint8_t>> encodedImages, uint32_t iterations)
+{
+    FDecodeThroughput result;
+    FImage image;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        for (const std::vector<uint8_t>& encoded : encodedImages)
+        {
+            result.images++;
+            std::unique_ptr<IImageDecoder> decoder = createDecoder();
+            if (not decoder or not decoder->OpenMemory(encoded) or not DecodeImage(*decoder, image))
+            {
+                result.failures++;
+                continue;
+            }
+            result.pixels += static_cast<uint64_t>(image.width) * image.height;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.megapixelsPerSecond = result.seconds > 0.0 ? static_cast<double>(result.pixels) / 1e6 / result.seconds : 0.0;
+    return result;
+}
+
+FDecodeThroughput MeasureDecodeThroughput(FThreadPool& pool, uint32_t maxInFlight, const FImageDecoderFactory& createDecoder,
+    std::span<const std::vector<uint8_t>> encodedImages, uint32_t iterations)
+{
+    FDecodeThroughput result;
+    const size_t count = encodedImages.size() * iterations;
+    std::atomic<uint64_t> failures{};
+
+    const auto start = std::chrono::steady_clock::now();
+    DecodeImagesParallel(pool, count, maxInFlight,
+        [&](size_t index, FTextureData& out) {
+            std::unique_ptr<IImageDecoder> decoder = createDecoder();
+            out.levels.resize(1);
+            if (not decoder or not decoder->OpenMemory(encodedImages[index % encodedImages.size()]) or not DecodeImage(*decoder, out.levels[0]))
+            {
+                failures++;
+                return false;
+            }
+            return true;
+        },
+        [&](size_t, FTextureData& texture) {
+            result.pixels += static_cast<uint64_t>(texture.levels[0].width) * texture.levels[0].height;
+        });
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.images = count;
+    result.failures = failures;
+    result.megapixelsPerSecond = result.seconds > 0.0 ? static_cast<double>(result.pixels) / 1e6 / result.seconds : 0.0;
+    return result;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "ThreadPool.h"
+
+enum class FImageBackend : uint32_t {
+    FImageBackend_WIC = 0,      // Windows Imaging Component, every codec installed on the machine
+    FImageBackend_STB = 1,      // portable PNG / JPEG / TGA
+    FImageBackend_MAX = 2
+};
+
+// Decodes one image to RGBA8, 4 bytes per texel in R, G, B, A order regardless of the source layout.
+// Open reads the header, ReadRows produces the texels. A decoder is used by one thread at a time,
+// memory handed to OpenMemory has to stay valid until the last ReadRows.
+class IImageDecoder
+{
+public:
+    virtual ~IImageDecoder() = default;
+
+    virtual bool OpenMemory(std::span<const uint8_t> data) = 0;
+    virtual bool OpenFile(const std::filesystem::path& path) = 0;
+
+    virtual uint32_t GetWidth() const = 0;
+    virtual uint32_t GetHeight() const = 0;
+
+    // Rows [firstRow, firstRow + rowCount) to 'dst', consecutive rows dstRowPitch bytes apart
+    virtual bool ReadRows(uint8_t* dst, uint32_t firstRow, uint32_t rowCount, uint32_t dstRowPitch) = 0;
+};
+
+using FImageDecoderFactory = std::function<std::unique_ptr<IImageDecoder>()>;
+
+const char* ImageBackendToString(FImageBackend backend);
+
+// Decoded texels with every row starting at a multiple of the requested alignment,
+// 256 matches D3D12_TEXTURE_DATA_PITCH_ALIGNMENT. RGBA8 unless an FTextureData says otherwise.
+struct FImage
+{
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t rowPitch{};
+    std::vector<uint8_t> texels;
+};
+
+// Read only texels of one image, owned by an FImage or by a mapped file
+struct FImageView
+{
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t rowPitch{};
+    const uint8_t* texels{};
+};
+
+bool DecodeImage(IImageDecoder& decoder, FImage& out, uint32_t rowPitchAlignment = 256u);
+
+// Layout of the texels of an FImage. Block compressed images hold rows of 4x4 blocks: rowPitch is the
+// distance between block rows and the texel data is (height + 3) / 4 block rows long.
+enum class FPixelFormat : uint32_t {
+    FPixelFormat_RGBA8 = 0,
+    FPixelFormat_R8 = 1,        // one channel
+    FPixelFormat_RG8 = 2,       // two channels
+    FPixelFormat_BC1 = 3,       // RGB, 1 bit alpha unused
+    FPixelFormat_BC3 = 4,       // RGB + interpolated alpha
+    FPixelFormat_BC4 = 5,       // one channel
+    FPixelFormat_BC5 = 6,       // two channels
+    FPixelFormat_BC7 = 7,       // RGBA
+    FPixelFormat_MAX = 8
+};
+
+// How the stored channels map to the RGBA a shader reads, missing channels read 0 and alpha 1
+enum class FChannelSwizzle : uint32_t {
+    FChannelSwizzle_RGBA = 0,   // as stored
+    FChannelSwizzle_RRR1 = 1,   // one gray channel replicated, opaque
+    FChannelSwizzle_RRRG = 2,   // gray in the first channel, alpha in the second
+    FChannelSwizzle_MAX = 3
+};
+
+const char* PixelFormatToString(FPixelFormat format);
+
+inline bool IsBlockCompressed(FPixelFormat format)
+{
+    return format >= FPixelFormat::FPixelFormat_BC1 and format < FPixelFormat::FPixelFormat_MAX;
+}
+
+// Bytes per texel, or per 4x4 block for compressed formats
+inline uint32_t FormatElementSize(FPixelFormat format)
+{
+    switch (format)
+    {
+        case FPixelFormat::FPixelFormat_R8: return 1u;
+        case FPixelFormat::FPixelFormat_RG8: return 2u;
+        case FPixelFormat::FPixelFormat_BC1:
+        case FPixelFormat::FPixelFormat_BC4: return 8u;
+        case FPixelFormat::FPixelFormat_BC3:
+        case FPixelFormat::FPixelFormat_BC5:
+        case FPixelFormat::FPixelFormat_BC7: return 16u;
+        default: return 4u;
+    }
+}
+
+// Bytes one row (block row) of a 'width' texel wide image takes, without padding
+inline uint32_t FormatRowSize(FPixelFormat format, uint32_t width)
+{
+    return IsBlockCompressed(format) ? (width + 3u) / 4u * FormatElementSize(format) : width * FormatElementSize(format);
+}
+
+inline uint32_t FormatRowCount(FPixelFormat format, uint32_t height)
+{
+    return IsBlockCompressed(format) ? (height + 3u) / 4u : height;
+}
+
+// Every mip level of a texture on the CPU, levels[0] is the most detailed one
+struct FTextureData
+{
+    FPixelFormat format{ FPixelFormat::FPixelFormat_RGBA8 };
+    FChannelSwizzle swizzle{ FChannelSwizzle::FChannelSwizzle_RGBA };
+    // Every texel the shader reads is within the import tolerance, levels holds a single 1x1 RGBA8 texel
+    bool isConstant{};
+    std::vector<FImage> levels;
+};
+
+bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& out);
+
+// Decodes 'count' textures on the pool and hands each one to 'consume' as soon as it is done, in completion
+// order. At most maxInFlight decoded textures are alive at any time: a worker waits for one of them to be
+// consumed before it starts decoding the next. 'consume' runs on one thread at a time, textures 'decode'
+// fails on are skipped. The first exception is rethrown once every started decode finished.
+void DecodeImagesParallel(FThreadPool& pool, size_t count, uint32_t maxInFlight,
+    const std::function<bool(size_t index, FTextureData& out)>& decode,
+    const std::function<void(size_t index, FTextureData& texture)>& consume);
+
+struct FDecodeThroughput
+{
+    uint64_t images{};
+    uint64_t failures{};
+    uint64_t pixels{};
+    double seconds{};
+    double megapixelsPerSecond{};
+};
+
+// Decodes every image 'iterations' times on the calling thread, no GPU or window involved. The encoded
+// bytes are in memory up front so file IO stays out of the measurement.
+FDecodeThroughput MeasureDecodeThroughput(const FImageDecoderFactory& createDecoder,
+    std::span<const std::vector<uint8_t>> encodedImages, uint32_t iterations = 1u);
+// The same spread over the pool through DecodeImagesParallel, the consumer only drops the texels
+FDecodeThroughput MeasureDecodeThroughput(FThreadPool& pool, uint32_t maxInFlight, const FImageDecoderFactory& createDecoder,
+    std::span<const std::vector<uint8_t>> encodedImages, uint32_t iterations = 1u);
@@ -4,120 +4,637 @@
 #include "DXSampleHelper.h"
 
 #include "IApp.h"
+#include "WicImageDecoder.h"
+#include "StbImageDecoder.h"
 
 
 Material::Material(IWICImagingFactory2* wicFactory) : m_isOnCPU{}, m_isOnGPU{} {
     m_wicFactory = wicFactory;
 }
 
-HRESULT Material::LoadTexture(ID3D12Device* device, IWICBitmapDecoder* decoder, INT tType)
+HRESULT Material::LoadTexture(ID3D12Device* device, const FTextureRequest& request)
 {
-    if (tType >= static_cast<INT>(FTextureType::FTextureType_MAX) or not device or not decoder)
+    if (request.textureType >= FTextureType::FTextureType_MAX or not device or (request.source.IsEmpty() and not request.isPacked))
         return E_FAIL;
 
-    FTexture& tex = m_textures.emplace_back(FTexture());
-    tex.textureType = static_cast<FTextureType>(tType);
-    tex.format = FormatTOtype(tex.textureType);
+    const FTextureType textureType = request.textureType;
 
-    ComPtr<IWICBitmapFrameDecode> frame;
-    if (FAILED(decoder->GetFrame(0, &frame))) {
-        g_FError("Failed to get frame from decoder\n");
+    // Only the first material referencing the image decodes it, the rest share its resource
+    FTextureCache& cache = IApp::GetInstance()->GetTextureCache();
+    const UINT slot = cache.Acquire(request.key, [&](FCachedTexture& out) {
+        const std::string name = TextureName(request, m_name);
+        auto cook = std::make_shared<FTextureCook>();
+        if (OpenCookedTexture(request, *cook))
+        {
+            return SUCCEEDED(CreateTexture(device, std::move(cook), textureType, name, out));
+        }
+        FTextureData texture;
+        if (not DecodeTexture(m_wicFactory, request, name, texture))
+        {
+            return false;
+        }
+        // The decode cooked the texture, streaming maps the fresh file instead of creating every level
+        if (IApp::GetInstance()->m_streamTextures and OpenCookedTexture(request, *cook))
+        {
+            return SUCCEEDED(CreateTexture(device, std::move(cook), textureType, name, out));
+        }
+        return SUCCEEDED(CreateTexture(device, texture, textureType, name, out));
+    });
+    if (slot == FTextureCache::c_invalidSlot)
+    {
         return E_FAIL;
     }
 
-    if (FAILED(frame->GetSize(&tex.width, &tex.height))) {
-        g_FError("Failed to get texture dimensions\n");
-        return E_FAIL;
+    const FCachedTexture cached = cache.Get(slot);
+    if (cached.isConstant)
+    {
+        FoldConstantTexture(textureType, cached.constantValue);
+        cache.Release(slot);
+        return S_OK;
     }
 
-    const UINT bpp = 4;
-    const UINT alignment = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
-    UINT rowPitch = (static_cast<UINT64>(tex.width) * bpp + alignment - 1) & ~(alignment - 1); // round up to the next multiple of alignment
-    UINT uploadSize = rowPitch * tex.height;
-    tex.RowPitch = rowPitch;
+    FTexture& tex = m_textures.emplace_back(FTexture());
+    tex.textureType = textureType;
+    tex.format = cached.format;
+    tex.width = cached.width;
+    tex.height = cached.height;
+    tex.defaultBuffer = cached.resource;
+    tex.cacheSlot = slot;
 
-    ComPtr<IWICFormatConverter> converter;
-    if (FAILED(m_wicFactory->CreateFormatConverter(&converter))) {
-        g_FError("Failed to create format converter\n");
-        return E_FAIL;
+    m_isOnCPU = true;
+
+    m_textureFlags |= ( 1u << static_cast<UINT>(textureType));
+
+    return S_OK;
+}
+
+uint64_t Material::TextureKey(const FTextureRequest& request)
+{
+    const auto sourceKey = [](const FImageSource& source, FTextureType tType) -> uint64_t {
+        if (source.IsEmpty()) return 0;
+        const DXGI_FORMAT format = FormatTOtype(tType);
+        return source.embeddedData.empty() ? FTextureCache::KeyFromFile(source.path, format) : FTextureCache::KeyFromMemory(source.contentHash, format);
+    };
+
+    uint64_t key = FHash::Value(request.textureType);
+    if (request.isPacked)
+    {
+        for (size_t c = 0; c < request.packedSources.size(); ++c)
+        {
+            key = FHash::Value(sourceKey(request.packedSources[c], c_ormChannelTypes[c]), key);
+        }
     }
-    
-    if (FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.f, WICBitmapPaletteTypeCustom))) {
-        g_FError("Failed to initialize format converter\n");
+    else key = FHash::Value(sourceKey(request.source, request.textureType), key);
+
+    // Layout, mips, folding and encoding follow the type and the import settings, an image loaded under others is a different texture
+    const IApp* appInfo = IApp::GetInstance();
+    const FCompressQuality quality = appInfo->m_compressTextures ? appInfo->m_compressQuality : FCompressQuality::FCompressQuality_MAX;
+    const UINT tolerance = appInfo->m_foldConstantTextures ? appInfo->m_constantTextureTolerance : UINT_MAX;
+    key = FHash::Value(appInfo->m_mipFilter, key);
+    key = FHash::Value(quality, key);
+    return FHash::Value(tolerance, key);
+}
+
+void Material::KeyRequest(FTextureRequest& request)
+{
+    request.key = TextureKey(request);
+    request.cookPath = CookPath(request, request.cookKey);
+}
+
+std::string Material::TextureName(const FTextureRequest& request, const std::string& materialName)
+{
+    if (request.isPacked)
+    {
+        return FString::format("%s::ORM", materialName);
+    }
+    return request.source.embeddedData.empty() ? request.source.path.filename().generic_string()
+        : FString::format("%s::%s", materialName, TextureTypeToString(request.textureType));
+}
+
+std::unique_ptr<IImageDecoder> Material::CreateImageDecoder(FImageBackend backend, IWICImagingFactory2* wicFactory)
+{
+    switch (backend)
+    {
+        case FImageBackend::FImageBackend_STB: return std::make_unique<FStbImageDecoder>();
+        case FImageBackend::FImageBackend_WIC:
+        default: return std::make_unique<FWicImageDecoder>(wicFactory);
+    }
+}
+
+bool Material::ReadImageSize(IWICImagingFactory2* wicFactory, const FImageSource& source, UINT& outWidth, UINT& outHeight)
+{
+    std::unique_ptr<IImageDecoder> decoder = CreateImageDecoder(IApp::GetInstance()->m_imageBackend, wicFactory);
+    if (not (source.embeddedData.empty() ? decoder->OpenFile(source.path) : decoder->OpenMemory(source.embeddedData)))
+    {
+        return false;
+    }
+    outWidth = decoder->GetWidth();
+    outHeight = decoder->GetHeight();
+    return true;
+}
+
+bool Material::DecodeSource(IWICImagingFactory2* wicFactory, const FImageSource& source, const std::string& name, FImage& out)
+{
+    const FImageBackend backend = IApp::GetInstance()->m_imageBackend;
+    std::unique_ptr<IImageDecoder> decoder = CreateImageDecoder(backend, wicFactory);
+    const bool opened = source.embeddedData.empty() ? decoder->OpenFile(source.path) : decoder->OpenMemory(source.embeddedData);
+    if (not opened or not DecodeImage(*decoder, out, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT))
+    {
+        g_FError("Failed to decode '%s' with %s\n", name, ImageBackendToString(backend));
+        return false;
+    }
+    return true;
+}
+
+bool Material::PackOrm(IWICImagingFactory2* wicFactory, const FTextureRequest& request, const std::string& name, FImage& out)
+{
+    std::array<FImage, 3> maps;
+    out = FImage{};
+    for (size_t c = 0; c < maps.size(); ++c)
+    {
+        if (request.packedSources[c].IsEmpty()) continue;
+        if (not DecodeSource(wicFactory, request.packedSources[c], FString::format("%s.%s", name, TextureTypeToString(c_ormChannelTypes[c])), maps[c]))
+        {
+            return false;
+        }
+        if (out.width == 0)
+        {
+            out.width = maps[c].width;
+            out.height = maps[c].height;
+        }
+        else if (maps[c].width != out.width or maps[c].height != out.height)
+        {
+            g_FError("'%s' packs maps of different sizes\n", name);
+            return false;
+        }
+    }
+    if (out.width == 0)
+    {
+        return false;
+    }
+
+    out.rowPitch = (out.width * 4u + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1u) / D3D12_TEXTURE_DATA_PITCH_ALIGNMENT * D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+    out.texels.assign(static_cast<size_t>(out.rowPitch) * out.height, 0xFF);
+    for (size_t c = 0; c < maps.size(); ++c)
+    {
+        if (maps[c].texels.empty()) continue;
+        for (UINT y = 0; y < out.height; ++y)
+        {
+            const uint8_t* src = maps[c].texels.data() + static_cast<size_t>(y) * maps[c].rowPitch + c_ormSourceChannels[c];
+            uint8_t* dst = out.texels.data() + static_cast<size_t>(y) * out.rowPitch + c;
+            for (UINT x = 0; x < out.width; ++x)
+            {
+                dst[4u * x] = src[4u * x];
+            }
+        }
+    }
+    return true;
+}
+
+bool Material::DecodeTexture(IWICImagingFactory2* wicFactory, const FTextureRequest& request, const std::string& name,
+    FTextureData& out, FCompressStats* outCompressStats)
+{
+    IApp* appInfo = IApp::GetInstance();
+    const FTextureType tType = request.textureType;
+
+    FImage image;
+    if (not (request.isPacked ? PackOrm(wicFactory, request, name, image) : DecodeSource(wicFactory, request.source, name, image)))
+    {
+        return false;
+    }
+
+    out.format = FPixelFormat::FPixelFormat_RGBA8;
+    out.swizzle = FChannelSwizzle::FChannelSwizzle_RGBA;
+    out.isConstant = false;
+
+    // A uniform image keeps its midpoint only, no mips or compression needed
+    const FChannelUsage usage = AnalyzeChannels(image);
+    if (appInfo->m_foldConstantTextures and IsConstantTOtype(tType, usage, appInfo->m_constantTextureTolerance))
+    {
+        FImage texel;
+        texel.width = 1;
+        texel.height = 1;
+        texel.rowPitch = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+        texel.texels.assign(texel.rowPitch, 0);
+        for (UINT c = 0; c < 4; ++c)
+        {
+            texel.texels[c] = static_cast<uint8_t>((usage.minValue[c] + usage.maxValue[c] + 1u) / 2u);
+        }
+        out.isConstant = true;
+        out.levels.assign(1, std::move(texel));
+        CookTexture(request, name, out);
+        return true;
+    }
+
+    // Color is averaged in linear space, data maps as stored
+    FMipOptions mipOptions{};
+    mipOptions.filter = appInfo->m_mipFilter;
+    mipOptions.srgb = FormatTOtype(tType) == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    mipOptions.rowPitchAlignment = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+    GenerateMips(std::move(image), mipOptions, out.levels);
+
+    // D3D12 needs whole blocks at level 0
+    const FImage& top = out.levels[0];
+    const bool compress = appInfo->m_compressTextures and top.width % 4u == 0 and top.height % 4u == 0;
+    if (appInfo->m_compressTextures and not compress)
+    {
+        g_FWarn("'%s' is %ux%u, no multiple of 4, kept uncompressed\n", name, top.width, top.height);
+    }
+    ConvertTexture(tType, usage, compress, appInfo->m_compressQuality, out, outCompressStats);
+    CookTexture(request, name, out);
+    return true;
+}
+
+void Material::CookTexture(const FTextureRequest& request, const std::string& name, const FTextureData& texture)
+{
+    if (not IApp::GetInstance()->m_cookTextures)
+    {
+        return;
+    }
+    if (not FTextureCook::Write(request.cookPath, request.cookKey, texture))
+    {
+        g_FWarn("Failed to cook '%s' to '%s'\n", name, request.cookPath.generic_string());
+    }
+}
+
+std::filesystem::path Material::CookPath(const FTextureRequest& request, uint64_t& outCookKey)
+{
+    // The identity names the file, the key decides whether it is current
+    uint64_t identity = FHash::Value(request.textureType);
+    uint64_t key = FHash::Value(FTextureCook::c_version);
+    const auto addSource = [&](const FImageSource& source, FTextureType tType) {
+        if (source.IsEmpty())
+        {
+            identity = FHash::Value(uint64_t{}, identity);
+        }
+        else if (source.embeddedData.empty())
+        {
+            identity = FHash::String(source.path.generic_string(), identity);
+            key = FHash::Value(FTextureCache::KeyFromFile(source.path, FormatTOtype(tType)), key);
+        }
+        // By content, the address of embedded data changes from run to run
+        else identity = FHash::Value(source.contentHash, identity);
+    };
+    if (request.isPacked)
+    {
+        for (size_t c = 0; c < request.packedSources.size(); ++c) addSource(request.packedSources[c], c_ormChannelTypes[c]);
+    }
+    else addSource(request.source, request.textureType);
+
+    const IApp* appInfo = IApp::GetInstance();
+    const FCompressQuality quality = appInfo->m_compressTextures ? appInfo->m_compressQuality : FCompressQuality::FCompressQuality_MAX;
+    const UINT tolerance = appInfo->m_foldConstantTextures ? appInfo->m_constantTextureTolerance : UINT_MAX;
+    key = FHash::Value(appInfo->m_mipFilter, key);
+    key = FHash::Value(quality, key);
+    key = FHash::Value(tolerance, key);
+    outCookKey = FHash::Value(identity, key);
+
+    const std::string stem = request.isPacked ? "orm" : (request.source.embeddedData.empty() ? request.source.path.stem().string() : "embedded");
+    return FTextureCook::GetCookPath(stem, identity);
+}
+
+bool Material::OpenCookedTexture(const FTextureRequest& request, FTextureCook& out)
+{
+    if (not IApp::GetInstance()->m_cookTextures)
+    {
+        return false;
+    }
+    return out.Open(request.cookPath, request.cookKey);
+}
+
+void Material::ConvertTexture(FTextureType tType, const FChannelUsage& usage, bool compress, FCompressQuality quality,
+    FTextureData& texture, FCompressStats* outStats)
+{
+    if (texture.format != FPixelFormat::FPixelFormat_RGBA8 or texture.levels.empty())
+    {
+        return;
+    }
+
+    const FTextureLayout layout = LayoutTOtype(tType, usage);
+
+    FTextureData converted;
+    if (compress)
+    {
+        FCompressOptions options{};
+        options.quality = quality;
+        options.channels[0] = layout.channels[0];
+        options.channels[1] = layout.channels[1];
+        options.rowPitchAlignment = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+
+        FPixelFormat format = FPixelFormat::FPixelFormat_BC7;
+        if (layout.channelCount == 1) format = FPixelFormat::FPixelFormat_BC4;
+        else if (layout.channelCount == 2) format = FPixelFormat::FPixelFormat_BC5;
+        else if (quality == FCompressQuality::FCompressQuality_FAST) format = usage.opaque ? FPixelFormat::FPixelFormat_BC1 : FPixelFormat::FPixelFormat_BC3;
+
+        const FCompressStats stats = CompressTexture(IApp::GetInstance()->GetWorkerPool(), texture, format, options, converted);
+        if (outStats)
+        {
+            *outStats = stats;
+        }
+    }
+    else if (layout.channelCount < 4)
+    {
+        PackChannels(texture, layout.channels, layout.channelCount, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT, converted);
+    }
+    else
+    {
+        return;
+    }
+
+    converted.swizzle = layout.swizzle;
+    texture = std::move(converted);
+}
+
+Material::FTextureLayout Material::LayoutTOtype(FTextureType tType, const FChannelUsage& usage)
+{
+    FTextureLayout layout{};
+    switch (tType)
+    {
+        // The shader rebuilds Z from X and Y
+        case FTextureType::FTextureType_NORMALS:
+        case FTextureType::FTextureType_NORMAL_CAMERA:
+            layout.channelCount = 2;
+            return layout;
+
+        // Grayscale maps, read from red
+        case FTextureType::FTextureType_HEIGHT:
+        case FTextureType::FTextureType_DISPLACEMENT:
+        case FTextureType::FTextureType_METALNESS:
+        case FTextureType::FTextureType_AMBIENT_OCCLUSION:
+        case FTextureType::FTextureType_SHININESS:
+        case FTextureType::FTextureType_OPACITY:
+            layout.channelCount = 1;
+            layout.swizzle = FChannelSwizzle::FChannelSwizzle_RRR1;
+            return layout;
+
+        // Read from green like the roughness of packed maps, the swizzle hands it to every channel
+        case FTextureType::FTextureType_DIFFUSE_ROUGHNESS:
+            layout.channelCount = 1;
+            layout.channels[0] = 1;
+            layout.swizzle = FChannelSwizzle::FChannelSwizzle_RRR1;
+            return layout;
+
+        default:
+            break;
+    }
+
+    // Other types go by content, DXGI has no one or two channel sRGB formats
+    if (FormatTOtype(tType) == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB or not usage.grayscale)
+    {
+        return layout;
+    }
+    if (usage.opaque)
+    {
+        layout.channelCount = 1;
+        layout.swizzle = FChannelSwizzle::FChannelSwizzle_RRR1;
+    }
+    else
+    {
+        layout.channelCount = 2;
+        layout.channels[1] = 3;
+        layout.swizzle = FChannelSwizzle::FChannelSwizzle_RRRG;
+    }
+    return layout;
+}
+
+bool Material::IsConstantTOtype(FTextureType tType, const FChannelUsage& usage, UINT tolerance)
+{
+    const auto uniform = [&](UINT c) { return static_cast<UINT>(usage.maxValue[c] - usage.minValue[c]) <= tolerance; };
+    // The shader falls back to an AO of 1 and the vertex normal, there is no constant for anything else
+    const auto unoccluded = [&](UINT c) { return usage.minValue[c] + tolerance >= 0xFFu; };
+    const auto flat = [&](UINT c) { return std::abs(static_cast<INT>(usage.minValue[c] + usage.maxValue[c]) - 0xFF) <= static_cast<INT>(tolerance); };
+
+    switch (tType)
+    {
+        case FTextureType::FTextureType_BASE_COLOR:
+            return uniform(0) and uniform(1) and uniform(2) and uniform(3);
+        case FTextureType::FTextureType_METALNESS:
+            return uniform(0);
+        case FTextureType::FTextureType_DIFFUSE_ROUGHNESS:
+            return uniform(1);
+        case FTextureType::FTextureType_AMBIENT_OCCLUSION:
+            return uniform(0) and unoccluded(0);
+        case FTextureType::FTextureType_GLTF_METALLIC_ROUGHNESS:
+            return uniform(0) and uniform(1) and uniform(2) and unoccluded(0);
+        case FTextureType::FTextureType_NORMALS:
+            return uniform(0) and uniform(1) and flat(0) and flat(1);
+        default:
+            return false;
+    }
+}
+
+DXGI_FORMAT Material::PixelFormatTOdxgi(FPixelFormat format, bool srgb)
+{
+    switch (format)
+    {
+        case FPixelFormat::FPixelFormat_R8: return DXGI_FORMAT_R8_UNORM;
+        case FPixelFormat::FPixelFormat_RG8: return DXGI_FORMAT_R8G8_UNORM;
+        case FPixelFormat::FPixelFormat_BC1: return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+        case FPixelFormat::FPixelFormat_BC3: return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+        case FPixelFormat::FPixelFormat_BC4: return DXGI_FORMAT_BC4_UNORM;
+        case FPixelFormat::FPixelFormat_BC5: return DXGI_FORMAT_BC5_UNORM;
+        case FPixelFormat::FPixelFormat_BC7: return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+        case FPixelFormat::FPixelFormat_RGBA8:
+        default: return srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+UINT Material::SwizzleTOmapping(FChannelSwizzle swizzle)
+{
+    switch (swizzle)
+    {
+        case FChannelSwizzle::FChannelSwizzle_RRR1:
+            return D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(
+                D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+                D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+                D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+                D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1);
+        case FChannelSwizzle::FChannelSwizzle_RRRG:
+            return D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(
+                D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+                D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+                D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+                D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_1);
+        case FChannelSwizzle::FChannelSwizzle_RGBA:
+        default:
+            return D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    }
+}
+
+HRESULT Material::CreateTexture(ID3D12Device* device, const FTextureData& texture, FTextureType tType, const std::string& name, FCachedTexture& out)
+{
+    std::vector<FImageView> levels;
+    levels.reserve(texture.levels.size());
+    for (const FImage& image : texture.levels)
+    {
+        levels.push_back({ image.width, image.height, image.rowPitch, image.texels.data() });
+    }
+    return CreateTexture(device, texture.format, texture.swizzle, texture.isConstant, levels, 0u, tType, name, out);
+}
+
+HRESULT Material::CreateTexture(ID3D12Device* device, std::shared_ptr<const FTextureCook> cook, FTextureType tType, const std::string& name, FCachedTexture& out)
+{
+    std::vector<FImageView> levels(cook->GetMipLevels());
+    for (UINT level = 0; level < levels.size(); ++level)
+    {
+        levels[level] = cook->GetLevel(level);
+    }
+    const FPixelFormat format = cook->GetFormat();
+
+    // Only the levels of at most c_streamTailSize to begin with
+    UINT tailLevel{};
+    if (IApp::GetInstance()->m_streamTextures and not cook->IsConstant())
+    {
+        while (tailLevel + 1u < levels.size() and std::max(levels[tailLevel].width, levels[tailLevel].height) > FTextureCache::c_streamTailSize)
+        {
+            tailLevel++;
+        }
+        tailLevel = FTextureCache::ClampTopLevel(levels[0].width, levels[0].height, IsBlockCompressed(format) ? 4u : 1u, tailLevel);
+    }
+
+    const HRESULT hr = CreateTexture(device, format, cook->GetSwizzle(), cook->IsConstant(), levels, tailLevel, tType, name, out);
+    if (FAILED(hr) or tailLevel == 0)
+    {
+        return hr;
+    }
+
+    out.tailLevel = tailLevel;
+    out.createLevels = [device, cook = std::move(cook), levels = std::move(levels), dxgiFormat = out.format, format, name](
+        UINT topLevel, ComPtr<ID3D12Resource2>& resource) {
+        return CreateLevels(device, dxgiFormat, format, std::span<const FImageView>(levels).subspan(topLevel), name, resource);
+    };
+    return hr;
+}
+
+HRESULT Material::CreateTexture(ID3D12Device* device, FPixelFormat format, FChannelSwizzle swizzle, bool isConstant,
+    std::span<const FImageView> levels, UINT topLevel, FTextureType tType, const std::string& name, FCachedTexture& out)
+{
+    if (levels.empty() or levels[0].width == 0 or levels[0].height == 0) {
+        g_FError("Texture has no texels\n");
         return E_FAIL;
     }
 
-    D3D12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
-    D3D12_HEAP_PROPERTIES uploadHeapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    // Nothing to upload, sRGB color is stored linear like the shader would have sampled it
+    if (isConstant)
+    {
+        const uint8_t* texel = levels[0].texels;
+        const bool srgb = FormatTOtype(tType) == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        float value[4];
+        for (UINT c = 0; c < 4; ++c)
+        {
+            const float v = texel[c] / 255.f;
+            value[c] = srgb and c < 3 ? (v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f)) : v;
+        }
+        out.isConstant = true;
+        out.constantValue = DirectX::XMFLOAT4(value[0], value[1], value[2], value[3]);
+        out.width = 1;
+        out.height = 1;
+        return S_OK;
+    }
+
+    out.format = PixelFormatTOdxgi(format, FormatTOtype(tType) == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+    out.componentMapping = SwizzleTOmapping(swizzle);
+    out.width = levels[0].width;
+    out.height = levels[0].height;
+    out.levelCount = static_cast<UINT>(levels.size());
+    out.topLevel = topLevel;
+    out.mipLevels = out.levelCount - topLevel;
+    out.blockSize = IsBlockCompressed(format) ? 4u : 1u;
+
+    return CreateLevels(device, out.format, format, levels.subspan(topLevel), name, out.resource);
+}
+
+HRESULT Material::CreateLevels(ID3D12Device* device, DXGI_FORMAT dxgiFormat, FPixelFormat format, std::span<const FImageView> levels,
+    const std::string& name, ComPtr<ID3D12Resource2>& out)
+{
+    D3D12_RESOURCE_DESC texDesc{};
+    texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    texDesc.Width = levels[0].width;
+    texDesc.Height = levels[0].height;
+    texDesc.DepthOrArraySize = 1;
+    texDesc.MipLevels = static_cast<UINT16>(levels.size());
+    texDesc.Format = dxgiFormat;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.SampleDesc.Quality = 0;
+    texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    D3D12_HEAP_PROPERTIES defaultHeapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
 
     if (FAILED(device->CreateCommittedResource(
-        &uploadHeapProp,
+        &defaultHeapProp,
         D3D12_HEAP_FLAG_NONE,
-        &uploadBufferDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
+        &texDesc,
+        D3D12_RESOURCE_STATE_COMMON,
         nullptr,
-        IID_PPV_ARGS(&tex.uploadBuffer))))
+        IID_PPV_ARGS(&out))))
     {
-        g_FError("Failed to create upload buffer\n");
+        g_FError("Failed to create default resource heap\n");
         return E_FAIL;
     }
 
+    out->SetName(FString::wformat("FTextureCache::%s", name).c_str());
 
-    void* pMappedData = nullptr;
-    if (FAILED(tex.uploadBuffer->Map(0, nullptr, &pMappedData))) 
+    // One subresource per level, the ring lays each out with its own placed footprint
+    FUploadRing& uploadRing = IApp::GetInstance()->GetUploadRing();
+    for (UINT level = 0; level < levels.size(); ++level)
     {
-        g_FError("Failed to map upload buffer\n");
-        return E_FAIL;
-    }
-    
-    if (FAILED(converter->CopyPixels(nullptr, rowPitch, uploadSize, reinterpret_cast<BYTE*>(pMappedData))))
-    {
-        tex.uploadBuffer->Unmap(0, nullptr);
-        g_FError("Failed to copy pixels\n");
-        return E_FAIL; 
-    }
-
-    tex.uploadBuffer->Unmap(0, nullptr);
-
-    if (tex.uploadBuffer and tex.width > 0 and tex.height > 0)
-    {
-        D3D12_RESOURCE_DESC texDesc{};
-        texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        texDesc.Width = tex.width;
-        texDesc.Height = tex.height;
-        texDesc.DepthOrArraySize = 1;
-        texDesc.MipLevels = 1;
-        texDesc.Format = tex.format;
-        texDesc.SampleDesc.Count = 1;
-        texDesc.SampleDesc.Quality = 0;
-        texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-        texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-        D3D12_HEAP_PROPERTIES defaultHeapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-
-        if (FAILED(device->CreateCommittedResource(
-            &defaultHeapProp,
-            D3D12_HEAP_FLAG_NONE,
-            &texDesc,
-            D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(&tex.defaultBuffer))))
+        const FImageView& image = levels[level];
+        const bool copied = uploadRing.CopyTexture(out.Get(), level,
+            [&image, format](uint8_t* dst, UINT firstRow, UINT rowCount, UINT dstRowPitch) {
+                // Rows are block rows for compressed formats, the footprint counts them the same way
+                const size_t rowSize = FormatRowSize(format, image.width);
+                const uint8_t* src = image.texels + static_cast<size_t>(firstRow) * image.rowPitch;
+                // Levels laid out with the footprint's pitch, as cooked ones are, go in one copy
+                if (dstRowPitch == image.rowPitch)
+                {
+                    memcpy(dst, src, static_cast<size_t>(rowCount - 1u) * dstRowPitch + rowSize);
+                    return true;
+                }
+                for (UINT row = 0; row < rowCount; ++row)
+                {
+                    memcpy(dst + static_cast<size_t>(row) * dstRowPitch, src + static_cast<size_t>(row) * image.rowPitch, rowSize);
+                }
+                return true;
+            });
+        if (not copied)
         {
-            g_FError("Failed to create default resource heap\n");
+            out.Reset();
+            g_FError("Failed to copy pixels\n");
             return E_FAIL;
         }
-
-        tex.defaultBuffer->SetName(FString::wformat("%s::%s::defaultBuffer", m_name, TextureTypeToString(tex.textureType)).c_str());
-        tex.uploadBuffer->SetName(FString::wformat("%s::%s::uploadBuffer", m_name, TextureTypeToString(tex.textureType)).c_str());
     }
 
-    m_isOnCPU = true;
-
-    m_textureFlags |= ( 1u << static_cast<UINT>(tType));
-
     return S_OK;
 }
 
+void Material::FoldConstantTexture(FTextureType tType, const DirectX::XMFLOAT4& value)
+{
+    switch (tType)
+    {
+        case FTextureType::FTextureType_BASE_COLOR:
+            m_baseColor.x *= value.x;
+            m_baseColor.y *= value.y;
+            m_baseColor.z *= value.z;
+            m_baseColor.w *= value.w;
+            break;
+        case FTextureType::FTextureType_METALNESS:
+            m_metallic *= value.x;
+            break;
+        case FTextureType::FTextureType_DIFFUSE_ROUGHNESS:
+            m_roughness *= value.y;
+            break;
+        case FTextureType::FTextureType_GLTF_METALLIC_ROUGHNESS:
+            m_roughness *= value.y;
+            m_metallic *= value.z;
+            break;
+        // Fully unoccluded AO and flat normals match what the shader does without them
+        default:
+            break;
+    }
+    g_FDebug("'%s' folded a uniform %s texture into its constants\n", m_name, TextureTypeToString(tType));
+}
+
 void Material::Bind(ID3D12GraphicsCommandList* cmdList) const
 {
     if (not m_isOnGPU) return;
@@ -126,9 +643,39 @@ void Material::Bind(ID3D12GraphicsCommandList* cmdList) const
     return;
 }
 
-void Material::UploadGPU(ID3D12Device* device, ID3D12CommandQueue* cmdQueue, ID3D12GraphicsCommandList* cmdList)
+void Material::RequestDetail(FLOAT screenSize) const
 {
-    if (not device or not cmdQueue or not cmdList) {
+    if (not m_isOnGPU) return;
+
+    FTextureCache& cache = IApp::GetInstance()->GetTextureCache();
+    for (const FTexture& tex : m_textures)
+    {
+        cache.RequestDetail(tex.cacheSlot, screenSize);
+    }
+}
+
+void Material::RefreshViews(ID3D12Device* device)
+{
+    if (not m_isOnGPU) return;
+
+    FTextureCache& cache = IApp::GetInstance()->GetTextureCache();
+    for (FTexture& tex : m_textures)
+    {
+        const UINT viewVersion = cache.GetViewVersion(tex.cacheSlot);
+        if (viewVersion == tex.viewVersion)
+        {
+            continue;
+        }
+        // Lets go of the replaced resource, the last reference to it
+        tex.defaultBuffer = cache.Get(tex.cacheSlot).resource;
+        tex.viewVersion = viewVersion;
+        device->CopyDescriptorsSimple(1, tex.cpuHandle, cache.GetSrv(tex.cacheSlot), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    }
+}
+
+void Material::UploadGPU(ID3D12Device* device)
+{
+    if (not device) {
         g_FError("At least one of the parameters are invalid\n");
         return;
     }
@@ -136,7 +683,7 @@ void Material::UploadGPU(ID3D12Device* device, ID3D12CommandQueue* cmdQueue, ID3
     
     bool invalidTexture = false;
     std::for_each(m_textures.begin(), m_textures.end(), [&invalidTexture](FTexture& tex) {
-        if (not tex.defaultBuffer or not tex.uploadBuffer) {
+        if (not tex.defaultBuffer) {
             invalidTexture = true;
             return;
         }
@@ -159,59 +706,18 @@ void Material::UploadGPU(ID3D12Device* device, ID3D12CommandQueue* cmdQueue, ID3
         device->CopyDescriptorsSimple(1, slotHandle, appInfo->im_fallbackTextureCpuHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     }
 
-    std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
-
-    for (FTexture& tex : m_textures)
-    {
-        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-            tex.defaultBuffer.Get(),
-            D3D12_RESOURCE_STATE_COMMON,
-            D3D12_RESOURCE_STATE_COPY_DEST
-        ));
-    }
-
-    cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
-    barriers.clear();
+    FTextureCache& cache = appInfo->GetTextureCache();
 
+    // The texels were copied on the upload ring's queue, the texture decays to COMMON there and is
+    // promoted to a shader resource on first use, so only the views are left to create
     for (FTexture& tex : m_textures)
     {
-        D3D12_TEXTURE_COPY_LOCATION srcLoc{};
-        srcLoc.pResource = tex.uploadBuffer.Get();
-        srcLoc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-        srcLoc.PlacedFootprint.Offset = 0;
-        srcLoc.PlacedFootprint.Footprint.Format = tex.format;
-        srcLoc.PlacedFootprint.Footprint.Width = tex.width;
-        srcLoc.PlacedFootprint.Footprint.Height = tex.height;
-        srcLoc.PlacedFootprint.Footprint.Depth = 1;
-        srcLoc.PlacedFootprint.Footprint.RowPitch = tex.RowPitch;
-
-        D3D12_TEXTURE_COPY_LOCATION dstLoc{};
-        dstLoc.pResource = tex.defaultBuffer.Get();
-        dstLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-        dstLoc.SubresourceIndex = 0;
-
-        cmdList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
-
-        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-            tex.defaultBuffer.Get(),
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
-        ));
-        
         tex.cpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(baseCpuHandle, static_cast<INT>(tex.textureType), appInfo->GetModelSrvDescriptorSize());
         tex.gpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(baseGpuHandle, static_cast<INT>(tex.textureType), appInfo->GetModelSrvDescriptorSize());
 
-        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Texture2D.MipLevels = 1;
-        srvDesc.Format = tex.format;
-        device->CreateShaderResourceView(tex.defaultBuffer.Get(), &srvDesc, tex.cpuHandle);
-    }
-
-    if (not barriers.empty())
-    {
-        cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+        // The view was created once by the texture cache, every material referencing the image copies it
+        tex.viewVersion = cache.GetViewVersion(tex.cacheSlot);
+        device->CopyDescriptorsSimple(1, tex.cpuHandle, cache.GetSrv(tex.cacheSlot), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     }
 
     m_isOnGPU = true;
@@ -226,11 +732,21 @@ void Material::UnloadGPU()
         g_FError("GPU resource is already empty");
         return;
     }
+    ReleaseTextures();
+}
 
+void Material::ReleaseTextures()
+{
     for (FTexture& texture : m_textures)
     {
-        IApp::GetInstance()->modelSrvFree(texture.cpuHandle, texture.gpuHandle);
+        if (m_isOnGPU)
+        {
+            IApp::GetInstance()->modelSrvFree(texture.cpuHandle, texture.gpuHandle);
+        }
         texture.defaultBuffer.Reset();
+        // The image itself goes away with its last material
+        IApp::GetInstance()->GetTextureCache().Release(texture.cacheSlot);
+        texture.cacheSlot = FTextureCache::c_invalidSlot;
     }
 
     m_isOnGPU = false;
@@ -244,11 +760,7 @@ void Material::ResetUploadHeaps()
         return;
     }
 
-    for (FTexture& texture : m_textures)
-    {
-        texture.uploadBuffer.Reset();
-    }
-
+    // Texels go through the app's upload ring, there are no staging resources of our own left to release
     m_isOnCPU = false;
 }
 
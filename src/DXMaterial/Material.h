@@ -1,5 +1,14 @@
 #pragma once
 
+#include <array>
+#include <span>
+#include "TextureCache.h"
+#include "ImageDecoder.h"
+#include "Mipmap.h"
+#include "BlockCompress.h"
+#include "TextureChannels.h"
+#include "TextureCook.h"
+
 enum class FTextureType : UINT {
     FTextureType_NONE = 0,
     FTextureType_DIFFUSE = 1,
@@ -43,6 +52,35 @@ struct FTexture {
     UINT width{};
     UINT height{};
     UINT RowPitch{};
+    // Slot in the app's FTextureCache, the resource and view are shared with every other user of the image
+    UINT cacheSlot{ FTextureCache::c_invalidSlot };
+    // FCachedTexture::viewVersion of the view in the material's table
+    UINT viewVersion{};
+};
+
+// Where one image comes from, a resolved file path or the bytes of an embedded image
+struct FImageSource
+{
+    std::filesystem::path path;
+    std::span<const uint8_t> embeddedData;
+    uint64_t contentHash{};     // FTextureCache::HashMemory of embeddedData, Model::PlanTextures hashes each image once
+
+    inline bool IsEmpty() const { return path.empty() and embeddedData.empty(); }
+};
+
+// One texture a material samples: a single image, or a GLTF_METALLIC_ROUGHNESS map packed at import from
+// separate AO, roughness and metalness maps in the order of Material::c_ormChannelTypes
+struct FTextureRequest
+{
+    FTextureType textureType = FTextureType::FTextureType_NONE;
+    FImageSource source;
+    std::array<FImageSource, 3> packedSources;  // a channel without a source reads 1
+    bool isPacked{};
+
+    // Set once by Material::KeyRequest when the sources are final, loading reads them instead of hashing again
+    uint64_t key{};                     // TextureKey, the texture cache entry
+    uint64_t cookKey{};                 // tells whether the cook at cookPath is current
+    std::filesystem::path cookPath;
 };
 
 class Material
@@ -63,14 +101,61 @@ public:
     
     Material(IWICImagingFactory2* wicFactory);
     
-    HRESULT LoadTexture(ID3D12Device* device, IWICBitmapDecoder* decoder, INT tType);
+    // Channels of a packed ORM map, matching the GLTF_METALLIC_ROUGHNESS reads of the shader: R = AO, G = roughness, B = metalness
+    static constexpr FTextureType c_ormChannelTypes[3] = {
+        FTextureType::FTextureType_AMBIENT_OCCLUSION, FTextureType::FTextureType_DIFFUSE_ROUGHNESS, FTextureType::FTextureType_METALNESS };
+    // Channel of each separate map the shader reads
+    static constexpr UINT c_ormSourceChannels[3] = { 0, 1, 0 };
+
+    // Decoded with its mip chain through the shared texture cache
+    HRESULT LoadTexture(ID3D12Device* device, const FTextureRequest& request);
+
+    static uint64_t TextureKey(const FTextureRequest& request);
+    // Fills the request's key, cookKey and cookPath
+    static void KeyRequest(FTextureRequest& request);
+    static std::string TextureName(const FTextureRequest& request, const std::string& materialName);
+    static std::unique_ptr<IImageDecoder> CreateImageDecoder(FImageBackend backend, IWICImagingFactory2* wicFactory);
+    // Reads the header only
+    static bool ReadImageSize(IWICImagingFactory2* wicFactory, const FImageSource& source, UINT& outWidth, UINT& outHeight);
+    // Decodes with the app's image backend, builds the mip chain with the app's filter and block compresses it when enabled
+    static bool DecodeTexture(IWICImagingFactory2* wicFactory, const FTextureRequest& request, const std::string& name,
+        FTextureData& out, FCompressStats* outCompressStats = nullptr);
+    // Converts an RGBA8 texture in place to the narrowest layout holding what the shader reads from the texture type:
+    // one or two channels for data maps and grayscale images, block compressed when 'compress' is set.
+    // Compressing needs a level 0 size that is a multiple of 4, D3D12 wants whole blocks there.
+    // 'usage' is the AnalyzeChannels result of level 0.
+    static void ConvertTexture(FTextureType tType, const FChannelUsage& usage, bool compress, FCompressQuality quality,
+        FTextureData& texture, FCompressStats* outStats = nullptr);
+    // Creates the texture with every level of 'texture' and stages the texels in the upload ring
+    static HRESULT CreateTexture(ID3D12Device* device, const FTextureData& texture, FTextureType tType, const std::string& name, FCachedTexture& out);
+    // The same straight from the mapped file, no decode involved. With texture streaming on only the mip tail is created,
+    // the mapping stays open with the cache entry and the finer levels are staged from it when needed.
+    static HRESULT CreateTexture(ID3D12Device* device, std::shared_ptr<const FTextureCook> cook, FTextureType tType, const std::string& name, FCachedTexture& out);
+
+    // Cooked textures live in cache/textures. The key covers the source files' size and write time, the content hash
+    // of embedded images and the import settings, a stale cook fails to open and is replaced by the next decode.
+    static std::filesystem::path CookPath(const FTextureRequest& request, uint64_t& outCookKey);
+    // Opens the cook at the request's cookPath, see KeyRequest
+    static bool OpenCookedTexture(const FTextureRequest& request, FTextureCook& out);
+
+    // Scales the constants by a uniform texture the way the shader would have, the texture itself is never bound
+    void FoldConstantTexture(FTextureType tType, const DirectX::XMFLOAT4& value);
 
-    void UploadGPU(ID3D12Device* device, ID3D12CommandQueue* cmdQueue, ID3D12GraphicsCommandList* cmdList);
+    // Creates the views, the texels were already copied through the upload ring by LoadTexture
+    void UploadGPU(ID3D12Device* device);
     void UnloadGPU();
+    // Drops the texture cache references LoadTexture took, the views too when UploadGPU ran. Unlike UnloadGPU
+    // it also covers a material that never became resident.
+    void ReleaseTextures();
     void ResetUploadHeaps();
 
     void Bind(ID3D12GraphicsCommandList* cmdList) const;
 
+    // Streaming: every texture of the material spans about 'screenSize' pixels on screen this frame
+    void RequestDetail(FLOAT screenSize) const;
+    // Copies the views streaming replaced since the last call into the material's table
+    void RefreshViews(ID3D12Device* device);
+
     inline bool HasTextureType(FTextureType tType) {
         for (FTexture& tex : m_textures) {
             if (tex.textureType == tType)
@@ -91,6 +176,30 @@ public:
 private:
     IWICImagingFactory2* m_wicFactory;
 
+    // Channels a texture keeps, 'channels' are the sources of one and two channel layouts
+    struct FTextureLayout
+    {
+        UINT channelCount{ 4 };
+        UINT channels[2]{ 0, 1 };
+        FChannelSwizzle swizzle{ FChannelSwizzle::FChannelSwizzle_RGBA };
+    };
+
+    static void CookTexture(const FTextureRequest& request, const std::string& name, const FTextureData& texture);
+    static bool DecodeSource(IWICImagingFactory2* wicFactory, const FImageSource& source, const std::string& name, FImage& out);
+    // The separate maps have to share their size, Model checks the headers before it packs
+    static bool PackOrm(IWICImagingFactory2* wicFactory, const FTextureRequest& request, const std::string& name, FImage& out);
+    static FTextureLayout LayoutTOtype(FTextureType tType, const FChannelUsage& usage);
+    // Every channel the shader reads spreads at most 'tolerance' and FoldConstantTexture can stand in for the texture
+    static bool IsConstantTOtype(FTextureType tType, const FChannelUsage& usage, UINT tolerance);
+    // Creates levels [topLevel, levels.size()), 'out' still describes the whole chain
+    static HRESULT CreateTexture(ID3D12Device* device, FPixelFormat format, FChannelSwizzle swizzle, bool isConstant,
+        std::span<const FImageView> levels, UINT topLevel, FTextureType tType, const std::string& name, FCachedTexture& out);
+    // A committed resource in COMMON with one subresource per level of 'levels', the texels staged in the upload ring
+    static HRESULT CreateLevels(ID3D12Device* device, DXGI_FORMAT dxgiFormat, FPixelFormat format, std::span<const FImageView> levels,
+        const std::string& name, ComPtr<ID3D12Resource2>& out);
+    static DXGI_FORMAT PixelFormatTOdxgi(FPixelFormat format, bool srgb);
+    static UINT SwizzleTOmapping(FChannelSwizzle swizzle);
+
     static inline DXGI_FORMAT FormatTOtype(FTextureType tType)
     {
         switch (tType)
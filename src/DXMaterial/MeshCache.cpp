@@ -0,0 +1,393 @@
+#include "stdafx.h"
+#include "MeshCache.h"
+
+#include <fstream>
+#include <unordered_map>
+
+#include "Logger.h"
+
+namespace
+{
+    constexpr uint64_t c_sectionAlignment = 16u;
+
+    inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1u) & ~(alignment - 1u);
+    }
+
+    class FBlobWriter
+    {
+    public:
+        std::vector<uint8_t> bytes;
+
+        uint64_t Reserve(uint64_t size)
+        {
+            const uint64_t offset = AlignUp(bytes.size(), c_sectionAlignment);
+            bytes.resize(static_cast<size_t>(offset + size));
+            return offset;
+        }
+        uint64_t Append(const void* data, uint64_t size)
+        {
+            const uint64_t offset = Reserve(size);
+            if (size > 0) memcpy(bytes.data() + offset, data, static_cast<size_t>(size));
+            return offset;
+        }
+        template<typename T>
+        T* At(uint64_t offset) { return reinterpret_cast<T*>(bytes.data() + offset); }
+    };
+}
+
+FMeshCache::~FMeshCache()
+{
+    Close();
+}
+
+std::filesystem::path FMeshCache::GetCachePath(const std::filesystem::path& sourcePath)
+{
+    std::error_code ec;
+    std::filesystem::path absolutePath = std::filesystem::weakly_canonical(sourcePath, ec);
+    if (ec) absolutePath = sourcePath;
+
+    const uint64_t pathHash = FHash::String(absolutePath.generic_string());
+    return std::filesystem::current_path() / "cache" / std::format("{}.{:016x}.fmesh", sourcePath.stem().string(), pathHash);
+}
+
+uint64_t FMeshCache::ComputeSourceKey(const std::filesystem::path& sourcePath, UINT importFlags)
+{
+    std::error_code ec;
+    std::filesystem::path absolutePath = std::filesystem::weakly_canonical(sourcePath, ec);
+    if (ec) absolutePath = sourcePath;
+
+    const uint64_t fileSize = std::filesystem::file_size(sourcePath, ec);
+    const int64_t writeTime = ec ? 0 : static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, ec).time_since_epoch().count());
+
+    uint64_t key = FHash::Value(c_version);
+    key = FHash::Value(static_cast<uint32_t>(sizeof(Vertex)), key);
+    key = FHash::Value(importFlags, key);
+    key = FHash::String(absolutePath.generic_string(), key);
+    key = FHash::Value(fileSize, key);
+    key = FHash::Value(writeTime, key);
+    return key;
+}
+
+bool FMeshCache::Write(const std::filesystem::path& cachePath, uint64_t sourceKey, const std::vector<FMeshData>& meshes,
+    const std::vector<FMeshInstanceData>& instances, const FNodeTransformCache& nodes)
+{
+    FBlobWriter writer;
+    writer.Reserve(sizeof(FMeshCacheHeader));
+
+    UINT textureCount{};
+    for (const FMeshData& mesh : meshes) textureCount += static_cast<UINT>(mesh.textures.size());
+
+    const uint64_t meshTableOffset = writer.Reserve(sizeof(FMeshCacheMesh) * meshes.size());
+    const uint64_t textureTableOffset = writer.Reserve(sizeof(FMeshCacheTexture) * textureCount);
+    const uint64_t instanceTableOffset = writer.Append(instances.data(), sizeof(FMeshInstanceData) * instances.size());
+    const uint64_t nodeTableOffset = writer.Reserve(sizeof(FMeshCacheNode) * nodes.Size());
+    for (size_t i = 0; i < nodes.Size(); ++i)
+    {
+        const std::string& name = nodes.GetName(i);
+        FMeshCacheNode record{};
+        record.parent = nodes.GetParent(i);
+        record.nameLength = static_cast<uint32_t>(name.size());
+        record.nameOffset = writer.Append(name.data(), name.size());
+        record.local = nodes.GetLocalTransform(i);
+        *writer.At<FMeshCacheNode>(nodeTableOffset + sizeof(FMeshCacheNode) * i) = record;
+    }
+
+    // Several materials usually reference the same embedded image, store it once
+    std::unordered_map<const uint8_t*, uint64_t> embeddedOffsets;
+
+    UINT textureIndex{};
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); ++meshIndex)
+    {
+        const FMeshData& mesh = meshes[meshIndex];
+
+        FMeshCacheMesh record{};
+        record.vertexOffset = writer.Append(mesh.vertices.data(), mesh.vertices.size_bytes());
+        record.indexOffset = writer.Append(mesh.indices.data(), mesh.indices.size_bytes());
+        record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        record.meshletOffset = writer.Append(mesh.meshlets.data(), mesh.meshlets.size_bytes());
+        record.meshletVertexOffset = writer.Append(mesh.meshletVertices.data(), mesh.meshletVertices.size_bytes());
+        record.meshletTriangleOffset = writer.Append(mesh.meshletTriangles.data(), mesh.meshletTriangles.size_bytes());
+        record.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+        record.meshletVertexCount = static_cast<uint32_t>(mesh.meshletVertices.size());
+        record.meshletTriangleByteCount = static_cast<uint32_t>(mesh.meshletTriangles.size());
+        record.lodOffset = writer.Append(mesh.lods.data(), mesh.lods.size_bytes());
+        record.lodCount = static_cast<uint32_t>(mesh.lods.size());
+        record.nameOffset = writer.Append(mesh.name.data(), mesh.name.size());
+        record.nameLength = static_cast<uint32_t>(mesh.name.size());
+        record.materialNameOffset = writer.Append(mesh.materialName.data(), mesh.materialName.size());
+        record.materialNameLength = static_cast<uint32_t>(mesh.materialName.size());
+        record.baseColor = mesh.baseColor;
+        record.metallic = mesh.metallic;
+        record.roughness = mesh.roughness;
+        record.opacity = mesh.opacity;
+        record.boundsMin = mesh.boundsMin;
+        record.boundsMax = mesh.boundsMax;
+        record.boundsCenter = mesh.boundsCenter;
+        record.boundsRadius = mesh.boundsRadius;
+        record.firstTexture = textureIndex;
+        record.textureCount = static_cast<uint32_t>(mesh.textures.size());
+
+        for (const FTextureSource& source : mesh.textures)
+        {
+            FMeshCacheTexture texture{};
+            texture.textureType = static_cast<uint32_t>(source.textureType);
+            texture.isEmbedded = source.embeddedData.empty() ? 0u : 1u;
+
+            if (texture.isEmbedded)
+            {
+                auto it = embeddedOffsets.find(source.embeddedData.data());
+                if (it == embeddedOffsets.end())
+                {
+                    it = embeddedOffsets.emplace(source.embeddedData.data(), writer.Append(source.embeddedData.data(), source.embeddedData.size())).first;
+                }
+                texture.dataOffset = it->second;
+                texture.dataSize = source.embeddedData.size();
+            }
+            else
+            {
+                texture.dataOffset = writer.Append(source.path.data(), source.path.size());
+                texture.dataSize = source.path.size();
+            }
+
+            *writer.At<FMeshCacheTexture>(textureTableOffset + sizeof(FMeshCacheTexture) * textureIndex) = texture;
+            textureIndex++;
+        }
+
+        *writer.At<FMeshCacheMesh>(meshTableOffset + sizeof(FMeshCacheMesh) * meshIndex) = record;
+    }
+
+    writer.Reserve(0u);
+
+    FMeshCacheHeader& header = *writer.At<FMeshCacheHeader>(0u);
+    header.magic = c_magic;
+    header.version = c_version;
+    header.sourceKey = sourceKey;
+    header.fileSize = writer.bytes.size();
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.textureCount = textureCount;
+    header.vertexStride = sizeof(Vertex);
+    header.indexStride = sizeof(UINT);
+    header.meshTableOffset = meshTableOffset;
+    header.textureTableOffset = textureTableOffset;
+    header.instanceTableOffset = instanceTableOffset;
+    header.instanceCount = static_cast<uint32_t>(instances.size());
+    header.nodeTableOffset = nodeTableOffset;
+    header.nodeCount = static_cast<uint32_t>(nodes.Size());
+
+    std::error_code ec;
+    std::filesystem::create_directories(cachePath.parent_path(), ec);
+
+    // Write next to the target and swap in, a crash mid write must not leave a valid looking file
+    std::filesystem::path tempPath = cachePath;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (not file) return false;
+        file.write(reinterpret_cast<const char*>(writer.bytes.data()), static_cast<std::streamsize>(writer.bytes.size()));
+        if (not file) return false;
+    }
+
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool FMeshCache::Open(const std::filesystem::path& cachePath, uint64_t sourceKey)
+{
+    Close();
+
+    m_file = CreateFileW(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (not GetFileSizeEx(m_file, &fileSize) or static_cast<uint64_t>(fileSize.QuadPart) < sizeof(FMeshCacheHeader))
+    {
+        Close();
+        return false;
+    }
+    m_size = static_cast<uint64_t>(fileSize.QuadPart);
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (not m_mapping)
+    {
+        Close();
+        return false;
+    }
+
+    m_view = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (not m_view or not Validate(sourceKey))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void FMeshCache::Close()
+{
+    if (m_view) UnmapViewOfFile(m_view);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+
+    m_view = nullptr;
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+    m_size = 0u;
+}
+
+bool FMeshCache::IsInRange(uint64_t offset, uint64_t size) const
+{
+    return offset <= m_size and size <= m_size - offset;
+}
+
+bool FMeshCache::Validate(uint64_t sourceKey) const
+{
+    const FMeshCacheHeader& header = *At<FMeshCacheHeader>(0u);
+
+    if (header.magic != c_magic or header.version != c_version or header.sourceKey != sourceKey)
+    {
+        return false;
+    }
+    if (header.fileSize != m_size or header.vertexStride != sizeof(Vertex) or header.indexStride != sizeof(UINT))
+    {
+        g_FWarn("Mesh cache has an unexpected layout, ignoring it\n");
+        return false;
+    }
+    if (not IsInRange(header.meshTableOffset, sizeof(FMeshCacheMesh) * static_cast<uint64_t>(header.meshCount)) or
+        not IsInRange(header.textureTableOffset, sizeof(FMeshCacheTexture) * static_cast<uint64_t>(header.textureCount)) or
+        not IsInRange(header.instanceTableOffset, sizeof(FMeshInstanceData) * static_cast<uint64_t>(header.instanceCount)) or
+        not IsInRange(header.nodeTableOffset, sizeof(FMeshCacheNode) * static_cast<uint64_t>(header.nodeCount)))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.instanceCount; ++i)
+    {
+        const FMeshInstanceData& instance = *At<FMeshInstanceData>(header.instanceTableOffset + sizeof(FMeshInstanceData) * i);
+        if (instance.meshIndex >= header.meshCount or instance.nodeIndex >= header.nodeCount)
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header.nodeCount; ++i)
+    {
+        const FMeshCacheNode& node = *At<FMeshCacheNode>(header.nodeTableOffset + sizeof(FMeshCacheNode) * i);
+        if ((node.parent != FNodeTransformCache::c_invalidIndex and node.parent >= i) or not IsInRange(node.nameOffset, node.nameLength))
+        {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.meshCount; ++i)
+    {
+        const FMeshCacheMesh& mesh = *At<FMeshCacheMesh>(header.meshTableOffset + sizeof(FMeshCacheMesh) * i);
+        if (not IsInRange(mesh.vertexOffset, sizeof(Vertex) * static_cast<uint64_t>(mesh.vertexCount)) or
+            not IsInRange(mesh.indexOffset, sizeof(UINT) * static_cast<uint64_t>(mesh.indexCount)) or
+            not IsInRange(mesh.meshletOffset, sizeof(FMeshlet) * static_cast<uint64_t>(mesh.meshletCount)) or
+            not IsInRange(mesh.meshletVertexOffset, sizeof(uint32_t) * static_cast<uint64_t>(mesh.meshletVertexCount)) or
+            not IsInRange(mesh.meshletTriangleOffset, mesh.meshletTriangleByteCount) or
+            not IsInRange(mesh.lodOffset, sizeof(FMeshLod) * static_cast<uint64_t>(mesh.lodCount)) or
+            not IsInRange(mesh.nameOffset, mesh.nameLength) or
+            not IsInRange(mesh.materialNameOffset, mesh.materialNameLength) or
+            static_cast<uint64_t>(mesh.firstTexture) + mesh.textureCount > header.textureCount)
+        {
+            return false;
+        }
+        for (uint32_t l = 0; l < mesh.lodCount; ++l)
+        {
+            const FMeshLod& lod = *At<FMeshLod>(mesh.lodOffset + sizeof(FMeshLod) * l);
+            if (static_cast<uint64_t>(lod.indexOffset) + lod.indexCount > mesh.indexCount)
+            {
+                return false;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < header.textureCount; ++i)
+    {
+        const FMeshCacheTexture& texture = *At<FMeshCacheTexture>(header.textureTableOffset + sizeof(FMeshCacheTexture) * i);
+        if (not IsInRange(texture.dataOffset, texture.dataSize) or texture.textureType >= static_cast<uint32_t>(FTextureType::FTextureType_MAX))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FMeshCache::GetMeshes(std::vector<FMeshData>& outMeshes) const
+{
+    if (not m_view) return;
+
+    const FMeshCacheHeader& header = *At<FMeshCacheHeader>(0u);
+    outMeshes.resize(header.meshCount);
+
+    for (uint32_t i = 0; i < header.meshCount; ++i)
+    {
+        const FMeshCacheMesh& record = *At<FMeshCacheMesh>(header.meshTableOffset + sizeof(FMeshCacheMesh) * i);
+        FMeshData& mesh = outMeshes[i];
+
+        mesh.name.assign(At<char>(record.nameOffset), record.nameLength);
+        mesh.materialName.assign(At<char>(record.materialNameOffset), record.materialNameLength);
+        mesh.baseColor = record.baseColor;
+        mesh.metallic = record.metallic;
+        mesh.roughness = record.roughness;
+        mesh.opacity = record.opacity;
+        mesh.boundsMin = record.boundsMin;
+        mesh.boundsMax = record.boundsMax;
+        mesh.boundsCenter = record.boundsCenter;
+        mesh.boundsRadius = record.boundsRadius;
+        mesh.vertices = std::span<const Vertex>(At<Vertex>(record.vertexOffset), record.vertexCount);
+        mesh.indices = std::span<const UINT>(At<UINT>(record.indexOffset), record.indexCount);
+        mesh.meshlets = std::span<const FMeshlet>(At<FMeshlet>(record.meshletOffset), record.meshletCount);
+        mesh.meshletVertices = std::span<const uint32_t>(At<uint32_t>(record.meshletVertexOffset), record.meshletVertexCount);
+        mesh.meshletTriangles = std::span<const uint8_t>(At<uint8_t>(record.meshletTriangleOffset), record.meshletTriangleByteCount);
+        mesh.lods = std::span<const FMeshLod>(At<FMeshLod>(record.lodOffset), record.lodCount);
+
+        mesh.textures.clear();
+        for (uint32_t t = 0; t < record.textureCount; ++t)
+        {
+            const FMeshCacheTexture& texture = *At<FMeshCacheTexture>(header.textureTableOffset + sizeof(FMeshCacheTexture) * (record.firstTexture + t));
+
+            FTextureSource& source = mesh.textures.emplace_back();
+            source.textureType = static_cast<FTextureType>(texture.textureType);
+            if (texture.isEmbedded)
+            {
+                source.embeddedData = std::span<const uint8_t>(At<uint8_t>(texture.dataOffset), static_cast<size_t>(texture.dataSize));
+            }
+            else
+            {
+                source.path.assign(At<char>(texture.dataOffset), static_cast<size_t>(texture.dataSize));
+            }
+        }
+    }
+}
+
+void FMeshCache::GetInstances(std::vector<FMeshInstanceData>& outInstances) const
+{
+    if (not m_view) return;
+
+    const FMeshCacheHeader& header = *At<FMeshCacheHeader>(0u);
+    const FMeshInstanceData* instances = At<FMeshInstanceData>(header.instanceTableOffset);
+    outInstances.assign(instances, instances + header.instanceCount);
+}
+
+void FMeshCache::GetNodes(FNodeTransformCache& outNodes) const
+{
+    outNodes.Clear();
+    if (not m_view) return;
+
+    const FMeshCacheHeader& header = *At<FMeshCacheHeader>(0u);
+    for (uint32_t i = 0; i < header.nodeCount; ++i)
+    {
+        const FMeshCacheNode& node = *At<FMeshCacheNode>(header.nodeTableOffset + sizeof(FMeshCacheNode) * i);
+        outNodes.AddNode(node.parent, node.local, std::string(At<char>(node.nameOffset), node.nameLength));
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "MeshData.h"
+#include "NodeTransform.h"
+
+// On disk layout of a cooked mesh file. Every section is 16 byte aligned so vertex and
+// index arrays can be copied from the mapped view straight into the upload buffers.
+struct FMeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceKey;
+    uint64_t fileSize;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t vertexStride;
+    uint32_t indexStride;
+    uint64_t meshTableOffset;
+    uint64_t textureTableOffset;
+    uint64_t instanceTableOffset;
+    uint32_t instanceCount;
+    uint32_t nodeCount;
+    uint64_t nodeTableOffset;
+};
+
+struct FMeshCacheMesh
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint64_t meshletOffset;
+    uint64_t meshletVertexOffset;
+    uint64_t meshletTriangleOffset;
+    uint32_t meshletCount;
+    uint32_t meshletVertexCount;
+    uint32_t meshletTriangleByteCount;
+    uint32_t lodCount;
+    uint64_t lodOffset;
+    uint64_t nameOffset;
+    uint64_t materialNameOffset;
+    uint32_t nameLength;
+    uint32_t materialNameLength;
+
+    DirectX::XMFLOAT4 baseColor;
+    FLOAT metallic;
+    FLOAT roughness;
+    FLOAT opacity;
+    DirectX::XMFLOAT3 boundsMin;
+    DirectX::XMFLOAT3 boundsMax;
+    DirectX::XMFLOAT3 boundsCenter;
+    FLOAT boundsRadius;
+};
+
+struct FMeshCacheTexture
+{
+    uint32_t textureType;
+    uint32_t isEmbedded;  // data is the image file itself, otherwise the relative path
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+// Node hierarchy in the preorder of FNodeTransformCache, parents first
+struct FMeshCacheNode
+{
+    uint32_t parent;
+    uint32_t nameLength;
+    uint64_t nameOffset;
+    aiMatrix4x4 local;
+};
+
+class FMeshCache
+{
+public:
+    static constexpr uint32_t c_magic = 0x48534D46; // "FMSH"
+    static constexpr uint32_t c_version = 7;
+
+    FMeshCache() = default;
+    ~FMeshCache();
+    FMeshCache(const FMeshCache&) = delete;
+    FMeshCache& operator=(const FMeshCache&) = delete;
+
+    static std::filesystem::path GetCachePath(const std::filesystem::path& sourcePath);
+    // Changes whenever the source file, the import flags or the cache layout change
+    static uint64_t ComputeSourceKey(const std::filesystem::path& sourcePath, UINT importFlags);
+
+    static bool Write(const std::filesystem::path& cachePath, uint64_t sourceKey, const std::vector<FMeshData>& meshes,
+        const std::vector<FMeshInstanceData>& instances, const FNodeTransformCache& nodes);
+
+    // Maps the file and validates it against sourceKey. The spans handed out by GetMeshes stay valid until Close.
+    bool Open(const std::filesystem::path& cachePath, uint64_t sourceKey);
+    void Close();
+    void GetMeshes(std::vector<FMeshData>& outMeshes) const;
+    void GetInstances(std::vector<FMeshInstanceData>& outInstances) const;
+    // Rebuilds the hierarchy the instances refer to, with the local transforms of the import
+    void GetNodes(FNodeTransformCache& outNodes) const;
+
+private:
+    bool Validate(uint64_t sourceKey) const;
+    bool IsInRange(uint64_t offset, uint64_t size) const;
+
+    template<typename T>
+    inline const T* At(uint64_t offset) const { return reinterpret_cast<const T*>(m_view + offset); }
+
+    HANDLE m_file{ INVALID_HANDLE_VALUE };
+    HANDLE m_mapping{};
+    const uint8_t* m_view{};
+    uint64_t m_size{};
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <span>
+#include "Material.h"
+#include "Meshlet.h"
+#include "Simplify.h"
+
+struct FTextureSource
+{
+    FTextureType textureType = FTextureType::FTextureType_NONE;
+    std::string path;                       // Relative to the model file, empty for embedded textures
+    std::span<const uint8_t> embeddedData;  // Compressed image bytes (png, jpg, ...) of an embedded texture
+};
+
+// CPU side result of importing one mesh, either from Assimp or from a mapped mesh cache.
+// The spans point into the *Storage members after an import and into the mapped cache file on a hit.
+struct FMeshData
+{
+    std::string name;
+    std::string materialName;
+
+    // Object space bounds
+    DirectX::XMFLOAT3 boundsMin{};
+    DirectX::XMFLOAT3 boundsMax{};
+    DirectX::XMFLOAT3 boundsCenter{};
+    FLOAT boundsRadius{};
+
+    DirectX::XMFLOAT4 baseColor{ 1.f, 0.f, 1.f, 1.f };
+    FLOAT metallic{};
+    FLOAT roughness{};
+    FLOAT opacity{ 1.f };
+
+    std::span<const Vertex> vertices;
+    std::span<const UINT> indices;          // every LOD, back to back
+    std::span<const FMeshLod> lods;
+    std::span<const FMeshlet> meshlets;
+    std::span<const uint32_t> meshletVertices;
+    std::span<const uint8_t> meshletTriangles;
+    std::vector<FTextureSource> textures;
+
+    std::vector<Vertex> vertexStorage;
+    std::vector<UINT> indexStorage;
+    std::vector<FMeshLod> lodStorage;
+    FMeshletData meshletStorage;
+};
+
+// One node reference to an imported mesh, every node using the same aiMesh shares its FMeshData.
+// The transform is the node's global one in the model's FNodeTransformCache.
+struct FMeshInstanceData
+{
+    uint32_t meshIndex;
+    uint32_t nodeIndex;
+};
@@ -0,0 +1,419 @@
+#include "MeshOptimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t c_invalid = UINT32_MAX;
+
+    // Forsyth scoring, cache of 32 with the three most recent entries scored flat
+    constexpr int c_forsythCacheSize = 32;
+    constexpr int c_maxValenceScore = 64;
+    constexpr float c_lastTriangleScore = 0.75f;
+    constexpr float c_cacheDecayPower = 1.5f;
+    constexpr float c_valenceBoostScale = 2.f;
+    constexpr float c_valenceBoostPower = 0.5f;
+
+    struct FForsythTables
+    {
+        float cache[c_forsythCacheSize];
+        float valence[c_maxValenceScore];
+
+        FForsythTables()
+        {
+            for (int i = 0; i < c_forsythCacheSize; ++i)
+            {
+                if (i < 3)
+                {
+                    cache[i] = c_lastTriangleScore;
+                }
+                else
+                {
+                    const float scaler = 1.f - static_cast<float>(i - 3) / static_cast<float>(c_forsythCacheSize - 3);
+                    cache[i] = std::pow(scaler, c_cacheDecayPower);
+                }
+            }
+            for (int i = 0; i < c_maxValenceScore; ++i)
+            {
+                valence[i] = i == 0 ? 0.f : c_valenceBoostScale * std::pow(static_cast<float>(i), -c_valenceBoostPower);
+            }
+        }
+    };
+
+    const FForsythTables& GetForsythTables()
+    {
+        static const FForsythTables tables;
+        return tables;
+    }
+
+    inline float VertexScore(const FForsythTables& tables, int cachePosition, uint32_t liveTriangles)
+    {
+        if (liveTriangles == 0)
+        {
+            return -1.f;
+        }
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.f;
+        score += tables.valence[std::min<uint32_t>(liveTriangles, c_maxValenceScore - 1)];
+        return score;
+    }
+
+    // Triangles as a FIFO cache would miss them, 'misses' gets one entry per triangle
+    void SimulateFifo(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, std::vector<uint8_t>& misses)
+    {
+        std::vector<uint32_t> timestamps(vertexCount, 0u);
+        uint32_t time = cacheSize + 1u;
+
+        misses.resize(indexCount / 3);
+        for (size_t triangle = 0; triangle < indexCount / 3; ++triangle)
+        {
+            uint8_t triangleMisses = 0;
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t v = indices[triangle * 3 + corner];
+                if (time - timestamps[v] > cacheSize)
+                {
+                    timestamps[v] = time++;
+                    ++triangleMisses;
+                }
+            }
+            misses[triangle] = triangleMisses;
+        }
+    }
+}
+
+FVertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    FVertexCacheStats stats;
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return stats;
+    }
+
+    std::vector<uint8_t> misses;
+    SimulateFifo(indices, indexCount, vertexCount, cacheSize, misses);
+
+    size_t transformed = 0;
+    for (uint8_t m : misses)
+    {
+        transformed += m;
+    }
+
+    std::vector<uint8_t> referenced(vertexCount, 0u);
+    size_t uniqueVertices = 0;
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        uniqueVertices += referenced[indices[i]] == 0u;
+        referenced[indices[i]] = 1u;
+    }
+
+    stats.acmr = static_cast<float>(transformed) / static_cast<float>(triangleCount);
+    stats.atvr = static_cast<float>(transformed) / static_cast<float>(uniqueVertices);
+    return stats;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    const FForsythTables& tables = GetForsythTables();
+
+    // Triangle adjacency per vertex, the live triangles are kept at the front of each list
+    std::vector<uint32_t> liveTriangles(vertexCount, 0u);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        ++liveTriangles[indices[i]];
+    }
+
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0u);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        vertexScore[v] = VertexScore(tables, -1, liveTriangles[v]);
+    }
+
+    std::vector<uint8_t> emitted(triangleCount, 0u);
+    uint32_t bestTriangle = 0;
+    float bestScore = -1.f;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t* tri = indices + t * 3;
+        const float score = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestTriangle = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<uint32_t> output(triangleCount * 3);
+    uint32_t cache[c_forsythCacheSize + 3];
+    uint32_t newCache[c_forsythCacheSize + 3];
+    int cacheCount = 0;
+    size_t scanPosition = 0;
+
+    for (size_t written = 0; written < triangleCount; ++written)
+    {
+        if (bestTriangle == c_invalid)
+        {
+            // Nothing in the cache touches a live triangle, continue with the next one in input order
+            while (emitted[scanPosition])
+            {
+                ++scanPosition;
+            }
+            bestTriangle = static_cast<uint32_t>(scanPosition);
+        }
+
+        const uint32_t* tri = indices + static_cast<size_t>(bestTriangle) * 3;
+        memcpy(&output[written * 3], tri, 3 * sizeof(uint32_t));
+        emitted[bestTriangle] = 1u;
+
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t v = tri[corner];
+            uint32_t* list = adjacency.data() + adjacencyOffset[v];
+            const uint32_t live = liveTriangles[v];
+            for (uint32_t i = 0; i < live; ++i)
+            {
+                if (list[i] == bestTriangle)
+                {
+                    std::swap(list[i], list[live - 1]);
+                    break;
+                }
+            }
+            --liveTriangles[v];
+        }
+
+        // Most recent first, the three new vertices followed by the old cache without them
+        int newCount = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            if (std::find(newCache, newCache + newCount, tri[corner]) == newCache + newCount)
+            {
+                newCache[newCount++] = tri[corner];
+            }
+        }
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            if (v != tri[0] and v != tri[1] and v != tri[2])
+            {
+                newCache[newCount++] = v;
+            }
+        }
+
+        for (int i = c_forsythCacheSize; i < newCount; ++i)
+        {
+            vertexScore[newCache[i]] = VertexScore(tables, -1, liveTriangles[newCache[i]]);
+        }
+        cacheCount = std::min(newCount, c_forsythCacheSize);
+        memcpy(cache, newCache, static_cast<size_t>(cacheCount) * sizeof(uint32_t));
+
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            vertexScore[cache[i]] = VertexScore(tables, i, liveTriangles[cache[i]]);
+        }
+
+        // Only triangles around cached vertices changed score
+        bestTriangle = c_invalid;
+        bestScore = -1.f;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            const uint32_t* list = adjacency.data() + adjacencyOffset[v];
+            for (uint32_t j = 0; j < liveTriangles[v]; ++j)
+            {
+                const uint32_t t = list[j];
+                const uint32_t* other = indices + static_cast<size_t>(t) * 3;
+                const float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    std::vector<uint8_t> misses;
+    SimulateFifo(indices, indexCount, vertexCount, c_vertexCacheSimSize, misses);
+
+    // Hard boundaries: the cache was cold anyway, a triangle that misses all three vertices
+    std::vector<size_t> hardClusters;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        if (t == 0 or misses[t] == 3)
+        {
+            hardClusters.push_back(t);
+        }
+    }
+    hardClusters.push_back(triangleCount);
+
+    // Soft boundaries: cut a hard cluster wherever restarting the cache costs less than 'threshold'
+    std::vector<size_t> clusters;
+    std::vector<uint32_t> timestamps(vertexCount, 0u);
+    uint32_t time = c_vertexCacheSimSize + 1u;
+    for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+    {
+        const size_t begin = hardClusters[c];
+        const size_t end = hardClusters[c + 1];
+
+        size_t totalMisses = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            totalMisses += misses[t];
+        }
+        const float clusterThreshold = threshold * static_cast<float>(totalMisses) / static_cast<float>(end - begin);
+
+        clusters.push_back(begin);
+        size_t start = begin;
+        size_t runningMisses = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t v = indices[t * 3 + corner];
+                if (time - timestamps[v] > c_vertexCacheSimSize)
+                {
+                    timestamps[v] = time++;
+                    ++runningMisses;
+                }
+            }
+
+            const float acmr = static_cast<float>(runningMisses) / static_cast<float>(t - start + 1);
+            if (t > start and t + 1 < end and acmr <= clusterThreshold)
+            {
+                // Restart with a cold cache, as the cluster will be drawn after an unrelated one
+                clusters.push_back(t + 1);
+                start = t + 1;
+                runningMisses = 0;
+                time += c_vertexCacheSimSize + 1u;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    auto position = [&](uint32_t v) {
+        return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + static_cast<size_t>(v) * positionStride);
+    };
+
+    float meshCentroid[3]{};
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        const float* p = position(indices[i]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            meshCentroid[axis] += p[axis];
+        }
+    }
+    for (float& axis : meshCentroid)
+    {
+        axis /= static_cast<float>(triangleCount * 3);
+    }
+
+    // Clusters facing away from the mesh centre are more likely to occlude the rest, draw them first
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float centroid[3]{};
+        float normal[3]{};
+        float area{};
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const float* a = position(indices[t * 3 + 0]);
+            const float* b = position(indices[t * 3 + 1]);
+            const float* d = position(indices[t * 3 + 2]);
+            const float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float e1[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            const float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+            const float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                centroid[axis] += (a[axis] + b[axis] + d[axis]) * (triangleArea / 3.f);
+                normal[axis] += n[axis];
+            }
+            area += triangleArea;
+        }
+
+        const float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key{};
+        if (area > 0.f and normalLength > 0.f)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                key += (centroid[axis] / area - meshCentroid[axis]) * (normal[axis] / normalLength);
+            }
+        }
+        sortKey[c] = key;
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        order[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (uint32_t c : order)
+    {
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t OptimizeVertexFetch(void* vertices, size_t vertexStride, size_t vertexCount, uint32_t* indices, size_t indexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, c_invalid);
+    std::vector<uint8_t> source(static_cast<const uint8_t*>(vertices), static_cast<const uint8_t*>(vertices) + vertexCount * vertexStride);
+    uint8_t* dst = static_cast<uint8_t*>(vertices);
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const uint32_t v = indices[i];
+        if (remap[v] == c_invalid)
+        {
+            remap[v] = next;
+            memcpy(dst + static_cast<size_t>(next) * vertexStride, source.data() + static_cast<size_t>(v) * vertexStride, vertexStride);
+            ++next;
+        }
+        indices[i] = remap[v];
+    }
+    return next;
+}
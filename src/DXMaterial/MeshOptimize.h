@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Post transform cache efficiency of a triangle list, simulated with a FIFO cache
+//  acmr: transformed vertices per triangle, 0.5 at best, 3 at worst
+//  atvr: transformed vertices per referenced vertex, 1 at best
+struct FVertexCacheStats
+{
+    float acmr{};
+    float atvr{};
+};
+
+constexpr uint32_t c_vertexCacheSimSize = 16;
+
+FVertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = c_vertexCacheSimSize);
+
+// Reorders triangles for post transform cache locality (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Reorders clusters of an already cache optimized list so outward facing ones draw first (Tipsify style).
+// 'threshold' bounds the ACMR loss, 1.05 allows clusters to be cut where that costs at most 5%.
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, float threshold);
+
+// Renumbers vertices in first use order and compacts 'vertices' in place, dropping unreferenced ones.
+// Returns the new vertex count.
+size_t OptimizeVertexFetch(void* vertices, size_t vertexStride, size_t vertexCount, uint32_t* indices, size_t indexCount);
@@ -0,0 +1,72 @@
+#include "MeshSplit.h"
+
+#include <cstring>
+
+void BuildIndexBuffer16(const uint32_t* indices, size_t indexCount, size_t vertexCount, FIndexBuffer16& out)
+{
+    const size_t firstIndex = out.indices.size();
+    out.indices.resize(firstIndex + indexCount);
+
+    if (vertexCount <= c_maxVertices16)
+    {
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            out.indices[firstIndex + i] = static_cast<uint16_t>(indices[i]);
+        }
+        out.ranges.push_back({ static_cast<uint32_t>(firstIndex), static_cast<uint32_t>(indexCount), 0 });
+        return;
+    }
+
+    // Local index of every source vertex in the current range, valid while its stamp matches
+    std::vector<uint32_t> localIndex(vertexCount);
+    std::vector<uint32_t> stamp(vertexCount, UINT32_MAX);
+    uint32_t rangeId = 0;
+
+    FDrawRange range{ static_cast<uint32_t>(firstIndex), 0u, static_cast<int32_t>(out.vertexRemap.size()) };
+    size_t rangeVertices = 0;
+
+    for (size_t triangle = 0; triangle + 2 < indexCount; triangle += 3)
+    {
+        size_t newVertices = 0;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t v = indices[triangle + corner];
+            // A triangle repeating a vertex may count it twice, that only makes the cut a little early
+            newVertices += stamp[v] != rangeId;
+        }
+
+        if (rangeVertices + newVertices > c_maxVertices16)
+        {
+            out.ranges.push_back(range);
+            range = { static_cast<uint32_t>(firstIndex + triangle), 0u, static_cast<int32_t>(out.vertexRemap.size()) };
+            rangeVertices = 0;
+            ++rangeId;
+        }
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t v = indices[triangle + corner];
+            if (stamp[v] != rangeId)
+            {
+                stamp[v] = rangeId;
+                localIndex[v] = static_cast<uint32_t>(rangeVertices++);
+                out.vertexRemap.push_back(v);
+            }
+            out.indices[firstIndex + triangle + corner] = static_cast<uint16_t>(localIndex[v]);
+        }
+        range.indexCount += 3;
+    }
+
+    out.indices.resize(range.indexOffset + range.indexCount);
+    out.ranges.push_back(range);
+}
+
+void RemapVertexBytes(const void* vertices, size_t vertexStride, const std::vector<uint32_t>& remap, void* dst)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(vertices);
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    for (size_t i = 0; i < remap.size(); ++i)
+    {
+        memcpy(out + i * vertexStride, src + static_cast<size_t>(remap[i]) * vertexStride, vertexStride);
+    }
+}
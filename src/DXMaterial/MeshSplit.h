@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vertices a single 16 bit index range can address
+constexpr size_t c_maxVertices16 = 65536;
+
+// One DrawIndexedInstanced call: indices are relative to baseVertex
+struct FDrawRange
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    int32_t baseVertex;
+};
+
+struct FIndexBuffer16
+{
+    std::vector<uint16_t> indices;
+    std::vector<FDrawRange> ranges;
+    // Output vertex -> source vertex, empty when the vertex buffer is used as is
+    std::vector<uint32_t> vertexRemap;
+};
+
+// Narrows a triangle list to 16 bit indices and appends it to 'out', call it once per list sharing
+// the vertex buffer (e.g. per LOD) with the same vertexCount. Meshes with up to c_maxVertices16 vertices
+// keep their vertex buffer and get a single range. Larger ones are cut into consecutive ranges of at
+// most c_maxVertices16 vertices each, vertices shared across a cut are duplicated (see vertexRemap).
+void BuildIndexBuffer16(const uint32_t* indices, size_t indexCount, size_t vertexCount, FIndexBuffer16& out);
+
+// Applies FIndexBuffer16::vertexRemap to a vertex array of any layout
+void RemapVertexBytes(const void* vertices, size_t vertexStride, const std::vector<uint32_t>& remap, void* dst);
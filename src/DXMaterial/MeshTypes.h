@@ -19,10 +19,9 @@ union PaddedFrameConstants
 };
 static_assert(sizeof(PaddedFrameConstants) == D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT * 1);
 
+// Per mesh material constants, the transforms live in the instance buffer
 struct meshConstants
 {
-    DirectX::XMFLOAT4X4 worldMatrix;
-    DirectX::XMFLOAT3X4 normalMatrix;
     DirectX::XMFLOAT4 baseColor;
     FLOAT metallic{};
     FLOAT roughness{};
@@ -39,6 +38,15 @@ union PaddedMeshConstants
 };
 static_assert(sizeof(PaddedMeshConstants) == D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT * 1);
 
+// One element of the per frame instance StructuredBuffer, read in VS.hlsl through SV_InstanceID.
+// Both are XMStoreFloat3x4 of the row vector matrices, the fourth column of an affine transform is implied.
+struct instanceTransform
+{
+    DirectX::XMFLOAT3X4 worldMatrix;
+    DirectX::XMFLOAT3X4 normalMatrix;
+};
+static_assert(sizeof(instanceTransform) == 96);
+
 struct Vertex
 {
     DirectX::XMFLOAT3 position;
@@ -48,6 +56,13 @@ struct Vertex
     DirectX::XMFLOAT2 texCoord;
 };
 
+// Vertex layout a model is uploaded with. Full is the 56 byte Vertex above, Packed is
+// FPackedVertex (VertexPacking.h) and is drawn with the mainVSPacked pipeline.
+enum class FVertexFormat : UINT {
+    FVertexFormat_FULL = 0,
+    FVertexFormat_PACKED = 1
+};
+
 struct DrawContext {
     ID3D12GraphicsCommandList* cmdList;
     CD3DX12_GPU_DESCRIPTOR_HANDLE srvGPUHandle;
@@ -55,4 +70,9 @@ struct DrawContext {
     UINT bufferIndex;
     D3D12_GPU_VIRTUAL_ADDRESS meshConstantsGpuVirtualAddr;
     PaddedMeshConstants* meshConstantsCpuAddr;
+    D3D12_GPU_VIRTUAL_ADDRESS instanceBufferGpuVirtualAddr;
+    instanceTransform* instanceBufferCpuAddr;
+    DirectX::XMFLOAT4X4 viewMatrix;
+    DirectX::XMFLOAT4X4 projectionMatrix;
+    FLOAT viewportHeight;
 };
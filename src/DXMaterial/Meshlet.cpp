@@ -0,0 +1,229 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr uint32_t c_unassigned = UINT32_MAX;
+    // Wider cones hardly ever cull, mark them as never culling instead
+    constexpr float c_minConeDot = 0.1f;
+
+    inline float Dot3(const float a[3], const float b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    inline float DistanceSquared(const float a[3], const float b[3])
+    {
+        const float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+        return Dot3(d, d);
+    }
+
+    class FMeshletBounds
+    {
+    public:
+        FMeshletBounds(const float* positions, size_t positionStride) : m_positions(positions), m_stride(positionStride) {}
+
+        void Compute(FMeshlet& meshlet, const uint32_t* vertices, const uint8_t* triangles) const
+        {
+            ComputeSphere(meshlet, vertices);
+            ComputeCone(meshlet, vertices, triangles);
+        }
+
+    private:
+        inline const float* Position(uint32_t v) const
+        {
+            return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(m_positions) + static_cast<size_t>(v) * m_stride);
+        }
+
+        // Ritter: start from the most distant pair of axis extremes and grow over the outliers
+        void ComputeSphere(FMeshlet& meshlet, const uint32_t* vertices) const
+        {
+            uint32_t minimum[3]{}, maximum[3]{};
+            for (uint32_t i = 1; i < meshlet.vertexCount; ++i)
+            {
+                const float* p = Position(vertices[i]);
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    if (p[axis] < Position(vertices[minimum[axis]])[axis]) minimum[axis] = i;
+                    if (p[axis] > Position(vertices[maximum[axis]])[axis]) maximum[axis] = i;
+                }
+            }
+
+            int widest = 0;
+            float widestDistance = -1.f;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float d = DistanceSquared(Position(vertices[minimum[axis]]), Position(vertices[maximum[axis]]));
+                if (d > widestDistance)
+                {
+                    widestDistance = d;
+                    widest = axis;
+                }
+            }
+
+            const float* a = Position(vertices[minimum[widest]]);
+            const float* b = Position(vertices[maximum[widest]]);
+            float center[3] = { (a[0] + b[0]) * 0.5f, (a[1] + b[1]) * 0.5f, (a[2] + b[2]) * 0.5f };
+            float radius = std::sqrt(widestDistance) * 0.5f;
+
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            {
+                const float* p = Position(vertices[i]);
+                const float distance = std::sqrt(DistanceSquared(p, center));
+                if (distance > radius)
+                {
+                    const float grownRadius = (radius + distance) * 0.5f;
+                    const float shift = (grownRadius - radius) / distance;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        center[axis] += (p[axis] - center[axis]) * shift;
+                    }
+                    radius = grownRadius;
+                }
+            }
+
+            std::copy(center, center + 3, meshlet.center);
+            meshlet.radius = radius;
+        }
+
+        void ComputeCone(FMeshlet& meshlet, const uint32_t* vertices, const uint8_t* triangles) const
+        {
+            std::copy(meshlet.center, meshlet.center + 3, meshlet.coneApex);
+            meshlet.coneAxis[0] = 0.f;
+            meshlet.coneAxis[1] = 0.f;
+            meshlet.coneAxis[2] = 1.f;
+            meshlet.coneCutoff = 1.f;
+
+            float normals[c_meshletMaxTriangles][3];
+            float centroids[c_meshletMaxTriangles][3];
+
+            uint32_t normalCount = 0;
+            float axis[3]{};
+            for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+            {
+                const float* p0 = Position(vertices[triangles[t * 3 + 0]]);
+                const float* p1 = Position(vertices[triangles[t * 3 + 1]]);
+                const float* p2 = Position(vertices[triangles[t * 3 + 2]]);
+                const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                float* n = normals[normalCount];
+                // Clockwise front faces in the left handed space the importer converts to
+                n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+                n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+                n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+
+                const float length = std::sqrt(Dot3(n, n));
+                if (length <= 0.f)
+                {
+                    continue;
+                }
+                for (int i = 0; i < 3; ++i)
+                {
+                    n[i] /= length;
+                    axis[i] += n[i];
+                    centroids[normalCount][i] = (p0[i] + p1[i] + p2[i]) / 3.f;
+                }
+                ++normalCount;
+            }
+
+            const float axisLength = std::sqrt(Dot3(axis, axis));
+            if (normalCount == 0 or axisLength <= 0.f)
+            {
+                return;
+            }
+            for (float& a : axis)
+            {
+                a /= axisLength;
+            }
+
+            float minDot = 1.f;
+            for (uint32_t i = 0; i < normalCount; ++i)
+            {
+                minDot = std::min(minDot, Dot3(normals[i], axis));
+            }
+            if (minDot <= c_minConeDot)
+            {
+                return;
+            }
+
+            // Move the apex back along the axis until it sits behind every triangle plane
+            float maxT = 0.f;
+            for (uint32_t i = 0; i < normalCount; ++i)
+            {
+                const float offset[3] = { meshlet.center[0] - centroids[i][0], meshlet.center[1] - centroids[i][1], meshlet.center[2] - centroids[i][2] };
+                maxT = std::max(maxT, Dot3(offset, normals[i]) / Dot3(axis, normals[i]));
+            }
+
+            for (int i = 0; i < 3; ++i)
+            {
+                meshlet.coneApex[i] = meshlet.center[i] - axis[i] * maxT;
+                meshlet.coneAxis[i] = axis[i];
+            }
+            meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+        }
+
+        const float* m_positions;
+        size_t m_stride;
+    };
+}
+
+void BuildMeshlets(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+    FMeshletData& out, size_t maxVertices, size_t maxTriangles)
+{
+    out.meshlets.clear();
+    out.vertices.clear();
+    out.triangles.clear();
+
+    maxVertices = std::clamp<size_t>(maxVertices, 3, 256);
+    maxTriangles = std::clamp<size_t>(maxTriangles, 1, c_meshletMaxTriangles);
+
+    const FMeshletBounds bounds(positions, positionStride);
+    std::vector<uint32_t> localIndex(vertexCount, c_unassigned);
+
+    FMeshlet current{};
+    auto flush = [&]() {
+        if (current.triangleCount == 0)
+        {
+            return;
+        }
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+        {
+            localIndex[out.vertices[current.vertexOffset + i]] = c_unassigned;
+        }
+        bounds.Compute(current, out.vertices.data() + current.vertexOffset, out.triangles.data() + current.triangleOffset);
+        out.meshlets.push_back(current);
+
+        current = {};
+        current.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(out.triangles.size());
+    };
+
+    for (size_t triangle = 0; triangle + 2 < indexCount; triangle += 3)
+    {
+        const uint32_t* tri = indices + triangle;
+
+        const size_t newVertices =
+            (localIndex[tri[0]] == c_unassigned) +
+            (localIndex[tri[1]] == c_unassigned and tri[1] != tri[0]) +
+            (localIndex[tri[2]] == c_unassigned and tri[2] != tri[0] and tri[2] != tri[1]);
+        if (current.vertexCount + newVertices > maxVertices or current.triangleCount + 1 > maxTriangles)
+        {
+            flush();
+        }
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            uint32_t& local = localIndex[tri[corner]];
+            if (local == c_unassigned)
+            {
+                local = current.vertexCount++;
+                out.vertices.push_back(tri[corner]);
+            }
+            out.triangles.push_back(static_cast<uint8_t>(local));
+        }
+        ++current.triangleCount;
+    }
+    flush();
+}
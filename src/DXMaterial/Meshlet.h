@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr size_t c_meshletMaxVertices = 64;
+constexpr size_t c_meshletMaxTriangles = 124;
+
+// A cluster of up to c_meshletMaxTriangles triangles over up to c_meshletMaxVertices vertices.
+// Back facing test: the whole cluster faces away when dot(normalize(coneApex - eye), coneAxis) >= coneCutoff.
+struct FMeshlet
+{
+    uint32_t vertexOffset;      // into FMeshletData::vertices
+    uint32_t triangleOffset;    // into FMeshletData::triangles, three bytes per triangle
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+
+    float center[3];
+    float radius;
+    float coneApex[3];
+    float coneCutoff;           // 1 when the normals spread too far for the cone to cull anything
+    float coneAxis[3];
+    uint32_t PADDING_1;
+};
+static_assert(sizeof(FMeshlet) == 64);
+
+struct FMeshletData
+{
+    std::vector<FMeshlet> meshlets;
+    std::vector<uint32_t> vertices;     // mesh vertex index of each meshlet local vertex
+    std::vector<uint8_t> triangles;     // meshlet local vertex indices
+};
+
+// Splits a triangle list into meshlets in index order. The output only depends on the input,
+// feed it a vertex cache optimized list to get compact clusters.
+void BuildMeshlets(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+    FMeshletData& out, size_t maxVertices = c_meshletMaxVertices, size_t maxTriangles = c_meshletMaxTriangles);
@@ -0,0 +1,292 @@
+#include "Mipmap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define F_MIPMAP_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr float c_pi = 3.14159265358979f;
+    constexpr float c_kaiserWidth = 3.f;    // support radius in destination texels
+    constexpr float c_kaiserAlpha = 4.f;
+    constexpr uint32_t c_srgbEncodeSteps = 65535u;
+
+    // Per destination texel, the source texels and weights it is filtered from
+    struct FFilterTaps
+    {
+        std::vector<uint32_t> offsets;  // destination texel -> first tap, one extra entry at the end
+        std::vector<uint32_t> indices;  // clamped source texel
+        std::vector<float> weights;     // normalized to sum up to 1
+        uint32_t maxTaps{};
+    };
+
+    float BesselI0(float x)
+    {
+        // Power series, converges quickly for the small arguments used here
+        float sum = 1.f;
+        float term = 1.f;
+        const float halfX = 0.5f * x;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (halfX / static_cast<float>(k)) * (halfX / static_cast<float>(k));
+            sum += term;
+            if (term < sum * 1e-7f) break;
+        }
+        return sum;
+    }
+
+    float FilterWeight(FMipFilter filter, float t)
+    {
+        t = std::fabs(t);
+        if (filter == FMipFilter::FMipFilter_BOX)
+        {
+            return t <= 0.5f ? 1.f : 0.f;
+        }
+
+        if (t >= c_kaiserWidth)
+        {
+            return 0.f;
+        }
+        const float sinc = t < 1e-5f ? 1.f : std::sin(c_pi * t) / (c_pi * t);
+        const float ratio = t / c_kaiserWidth;
+        return sinc * BesselI0(c_kaiserAlpha * std::sqrt(1.f - ratio * ratio)) / BesselI0(c_kaiserAlpha);
+    }
+
+    FFilterTaps BuildTaps(uint32_t srcSize, uint32_t dstSize, FMipFilter filter)
+    {
+        const float scale = static_cast<float>(srcSize) / static_cast<float>(dstSize);
+        const float support = (filter == FMipFilter::FMipFilter_BOX ? 0.5f : c_kaiserWidth) * scale;
+
+        FFilterTaps taps;
+        taps.offsets.reserve(dstSize + 1u);
+        for (uint32_t d = 0; d < dstSize; ++d)
+        {
+            taps.offsets.push_back(static_cast<uint32_t>(taps.indices.size()));
+
+            // Texel centers at +0.5, t is the distance in destination texels
+            const float center = (static_cast<float>(d) + 0.5f) * scale;
+            const int64_t first = static_cast<int64_t>(std::floor(center - support));
+            const int64_t last = static_cast<int64_t>(std::ceil(center + support));
+
+            const size_t begin = taps.weights.size();
+            float sum = 0.f;
+            for (int64_t s = first; s <= last; ++s)
+            {
+                const float weight = FilterWeight(filter, (static_cast<float>(s) + 0.5f - center) / scale);
+                if (weight == 0.f) continue;
+
+                taps.indices.push_back(static_cast<uint32_t>(std::clamp<int64_t>(s, 0, static_cast<int64_t>(srcSize) - 1)));
+                taps.weights.push_back(weight);
+                sum += weight;
+            }
+            for (size_t i = begin; i < taps.weights.size(); ++i)
+            {
+                taps.weights[i] /= sum;
+            }
+            taps.maxTaps = std::max(taps.maxTaps, static_cast<uint32_t>(taps.weights.size() - begin));
+        }
+        taps.offsets.push_back(static_cast<uint32_t>(taps.indices.size()));
+        return taps;
+    }
+
+    const std::array<float, 256>& SrgbToLinearTable()
+    {
+        static const std::array<float, 256> table = []() {
+            std::array<float, 256> t{};
+            for (size_t i = 0; i < t.size(); ++i)
+            {
+                const float c = static_cast<float>(i) / 255.f;
+                t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    const std::array<float, 256>& UnormToFloatTable()
+    {
+        static const std::array<float, 256> table = []() {
+            std::array<float, 256> t{};
+            for (size_t i = 0; i < t.size(); ++i)
+            {
+                t[i] = static_cast<float>(i) / 255.f;
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    // Indexed by the linear value quantized to 16 bits, fine enough to round every sRGB byte correctly in practice
+    const std::vector<uint8_t>& LinearToSrgbTable()
+    {
+        static const std::vector<uint8_t> table = []() {
+            std::vector<uint8_t> t(c_srgbEncodeSteps + 1u);
+            for (size_t i = 0; i < t.size(); ++i)
+            {
+                const float l = static_cast<float>(i) / static_cast<float>(c_srgbEncodeSteps);
+                const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+                t[i] = static_cast<uint8_t>(std::lround(std::clamp(c, 0.f, 1.f) * 255.f));
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    void DecodeRow(const uint8_t* src, uint32_t width, bool srgb, float* out)
+    {
+        const std::array<float, 256>& color = srgb ? SrgbToLinearTable() : UnormToFloatTable();
+        const std::array<float, 256>& alpha = UnormToFloatTable();
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            out[4 * x + 0] = color[src[4 * x + 0]];
+            out[4 * x + 1] = color[src[4 * x + 1]];
+            out[4 * x + 2] = color[src[4 * x + 2]];
+            out[4 * x + 3] = alpha[src[4 * x + 3]];
+        }
+    }
+
+    void EncodeRow(const float* src, uint32_t width, bool srgb, uint8_t* out)
+    {
+        const std::vector<uint8_t>& encode = LinearToSrgbTable();
+        const size_t count = static_cast<size_t>(width) * 4u;
+        for (size_t i = 0; i < count; ++i)
+        {
+            // Kaiser lobes over- and undershoot, clamp before quantizing
+            const float v = std::clamp(src[i], 0.f, 1.f);
+            const bool isAlpha = (i & 3u) == 3u;
+            out[i] = srgb and not isAlpha
+                ? encode[static_cast<size_t>(v * static_cast<float>(c_srgbEncodeSteps) + 0.5f)]
+                : static_cast<uint8_t>(v * 255.f + 0.5f);
+        }
+    }
+
+    // out[x] = sum of weight * src[index] over the taps of x, one RGBA texel per SIMD lane group
+    void FilterRow(const float* src, const FFilterTaps& taps, uint32_t dstWidth, float* out)
+    {
+        for (uint32_t x = 0; x < dstWidth; ++x)
+        {
+            const uint32_t begin = taps.offsets[x];
+            const uint32_t end = taps.offsets[x + 1u];
+#if F_MIPMAP_SSE
+            __m128 acc = _mm_setzero_ps();
+            for (uint32_t t = begin; t < end; ++t)
+            {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src + 4u * taps.indices[t]), _mm_set1_ps(taps.weights[t])));
+            }
+            _mm_storeu_ps(out + 4u * x, acc);
+#else
+            float acc[4]{};
+            for (uint32_t t = begin; t < end; ++t)
+            {
+                const float* texel = src + 4u * taps.indices[t];
+                const float weight = taps.weights[t];
+                for (int c = 0; c < 4; ++c) acc[c] += texel[c] * weight;
+            }
+            for (int c = 0; c < 4; ++c) out[4u * x + c] = acc[c];
+#endif
+        }
+    }
+
+    // acc += weight * src over 'count' floats
+    void AccumulateRow(float* acc, const float* src, float weight, size_t count)
+    {
+        size_t i = 0;
+#if F_MIPMAP_SSE
+        const __m128 w = _mm_set1_ps(weight);
+        for (; i + 4u <= count; i += 4u)
+        {
+            _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), w)));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            acc[i] += src[i] * weight;
+        }
+    }
+
+    void Downsample(const FImage& src, const FMipOptions& options, FImage& dst)
+    {
+        dst.width = std::max(src.width / 2u, 1u);
+        dst.height = std::max(src.height / 2u, 1u);
+        const uint32_t alignment = std::max(options.rowPitchAlignment, 1u);
+        dst.rowPitch = (dst.width * 4u + alignment - 1u) / alignment * alignment;
+        dst.texels.assign(static_cast<size_t>(dst.rowPitch) * dst.height, 0);
+
+        const FFilterTaps tapsX = BuildTaps(src.width, dst.width, options.filter);
+        const FFilterTaps tapsY = BuildTaps(src.height, dst.height, options.filter);
+
+        // Horizontally filtered source rows, neighbouring destination rows share most of them.
+        // The rows one destination row needs are contiguous and at most maxTaps, so a ring that size holds them.
+        const size_t filteredSize = static_cast<size_t>(dst.width) * 4u;
+        const uint32_t ringSize = tapsY.maxTaps;
+        std::vector<float> ring(filteredSize * ringSize);
+        std::vector<uint32_t> ringRows(ringSize, UINT32_MAX);
+
+        std::vector<float> srcRow(static_cast<size_t>(src.width) * 4u);
+        std::vector<float> dstRow(filteredSize);
+
+        for (uint32_t y = 0; y < dst.height; ++y)
+        {
+            std::fill(dstRow.begin(), dstRow.end(), 0.f);
+            for (uint32_t t = tapsY.offsets[y]; t < tapsY.offsets[y + 1u]; ++t)
+            {
+                const uint32_t row = tapsY.indices[t];
+                float* filtered = ring.data() + filteredSize * (row % ringSize);
+                if (ringRows[row % ringSize] != row)
+                {
+                    DecodeRow(src.texels.data() + static_cast<size_t>(row) * src.rowPitch, src.width, options.srgb, srcRow.data());
+                    FilterRow(srcRow.data(), tapsX, dst.width, filtered);
+                    ringRows[row % ringSize] = row;
+                }
+                AccumulateRow(dstRow.data(), filtered, tapsY.weights[t], filteredSize);
+            }
+            EncodeRow(dstRow.data(), dst.width, options.srgb, dst.texels.data() + static_cast<size_t>(y) * dst.rowPitch);
+        }
+    }
+}
+
+const char* MipFilterToString(FMipFilter filter)
+{
+    switch (filter)
+    {
+        case FMipFilter::FMipFilter_BOX: return "Box";
+        case FMipFilter::FMipFilter_KAISER: return "Kaiser";
+        default: return "Unknown";
+    }
+}
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1u; size /= 2u)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+void GenerateMips(FImage&& source, const FMipOptions& options, std::vector<FImage>& outLevels)
+{
+    outLevels.clear();
+    if (source.width == 0 or source.height == 0)
+    {
+        return;
+    }
+
+    const uint32_t fullChain = MipLevelCount(source.width, source.height);
+    const uint32_t levelCount = options.maxLevels == 0 ? fullChain : std::min(options.maxLevels, fullChain);
+
+    outLevels.reserve(levelCount);
+    outLevels.push_back(std::move(source));
+    for (uint32_t level = 1; level < levelCount; ++level)
+    {
+        FImage next;
+        Downsample(outLevels.back(), options, next);
+        outLevels.push_back(std::move(next));
+    }
+}
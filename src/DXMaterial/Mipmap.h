@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ImageDecoder.h"
+
+enum class FMipFilter : uint32_t {
+    FMipFilter_BOX = 0,         // 2x2 average, fast
+    FMipFilter_KAISER = 1,      // Kaiser windowed sinc, sharper minification at a wider support
+    FMipFilter_MAX = 2
+};
+
+struct FMipOptions
+{
+    FMipFilter filter{ FMipFilter::FMipFilter_BOX };
+    bool srgb{};                        // RGB is filtered in linear space and stored sRGB encoded, alpha is always linear
+    uint32_t maxLevels{};               // 0 builds the full chain down to 1x1
+    uint32_t rowPitchAlignment{ 256u }; // of the generated levels
+};
+
+const char* MipFilterToString(FMipFilter filter);
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+// Builds the mip chain of an RGBA8 image, outLevels[0] is 'source' itself. Every level halves the previous
+// one (rounded down, at least 1) and is filtered from it separably with clamped edges.
+void GenerateMips(FImage&& source, const FMipOptions& options, std::vector<FImage>& outLevels);
@@ -3,12 +3,51 @@
 
 #include "IApp.h"
 #include "Model.h"
+#include "MeshCache.h"
+#include "MeshOptimize.h"
+#include "Meshlet.h"
+#include "Simplify.h"
+#include "VertexConvert.h"
+#include "VertexPacking.h"
 #include "DXSampleHelper.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/version.h>
 
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+
+static_assert(sizeof(Vertex) == sizeof(FVertexF32));
+static_assert(offsetof(Vertex, normal) == offsetof(FVertexF32, normal));
+static_assert(offsetof(Vertex, tangent) == offsetof(FVertexF32, tangent));
+static_assert(offsetof(Vertex, bitangent) == offsetof(FVertexF32, bitangent));
+static_assert(offsetof(Vertex, texCoord) == offsetof(FVertexF32, texCoord));
+static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "Vertex kernels expect single precision Assimp vectors");
+
+namespace
+{
+    inline uint64_t MicrosecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+const char* FModelLoadState::StageToString(FLoadStage stage)
+{
+    switch (stage)
+    {
+        case FLoadStage::FLoadStage_QUEUED: return "Queued";
+        case FLoadStage::FLoadStage_PARSE: return "Parse";
+        case FLoadStage::FLoadStage_CONVERT: return "Convert";
+        case FLoadStage::FLoadStage_CREATE: return "Create";
+        case FLoadStage::FLoadStage_DONE: return "Done";
+        case FLoadStage::FLoadStage_FAILED: return "Failed";
+        default: return "Unknown";
+    }
+}
+
 Model::Model() : m_device(nullptr), m_wicFactory(nullptr) {}
 
 _Use_decl_annotations_
@@ -28,254 +67,646 @@ bool Model::Load(const std::filesystem::path& path, ID3D12GraphicsCommandList* c
         throw std::runtime_error("At least one of the pointers are invalid");
     }
 
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path.generic_string(),
-        aiProcess_Triangulate |
-        aiProcess_ConvertToLeftHanded |
-        aiProcess_GenSmoothNormals |
-        aiProcess_CalcTangentSpace |
-        aiProcess_JoinIdenticalVertices
-    );
-    if (not scene or scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE or not scene->mRootNode)
+    if (not meshes.empty())
     {
-        g_FError(importer.GetErrorString());
-        throw std::runtime_error("\n");
+        throw std::runtime_error("Model is already loaded, UnloadGPU it first");
     }
 
     m_assetPath = path;
-    ProcessNode(scene->mRootNode, scene, cmdList);
+    m_load = std::make_shared<FModelLoadState>();
+    RunLoad(*m_load);
 
     isOnCPU = true;
     return true;
 }
 
 _Use_decl_annotations_
-void Model::ProcessNode(aiNode* node, const aiScene* scene, ID3D12GraphicsCommandList* cmdList) {
+FModelLoadHandle Model::LoadAsync(const std::filesystem::path& path)
+{
+    if (m_load and m_load->stage != FLoadStage::FLoadStage_DONE and m_load->stage != FLoadStage::FLoadStage_FAILED)
+    {
+        throw std::runtime_error("Model is already loading");
+    }
+    // Mesh slots, geometry and texture references of the previous load would leak
+    if (not meshes.empty())
+    {
+        throw std::runtime_error("Model is already loaded, UnloadGPU it first");
+    }
+
+    m_assetPath = path;
+    m_load = std::make_shared<FModelLoadState>();
+
+    FModelLoadHandle state = m_load;
+    m_load->task = IApp::GetInstance()->GetWorkerPool().Submit([this, state]() {
+        try
+        {
+            RunLoad(*state);
+        }
+        catch (const std::exception& e)
+        {
+            state->error = e.what();
+            state->stage = FLoadStage::FLoadStage_FAILED;
+            g_FError("Loading '%s' failed: %s\n", m_assetPath.generic_string(), state->error);
+        }
+    });
+    return m_load;
+}
+
+_Use_decl_annotations_
+void Model::RunLoad(FModelLoadState& state)
+{
+    const std::filesystem::path& path = m_assetPath;
+
+    const std::filesystem::path cachePath = FMeshCache::GetCachePath(path);
+    const uint64_t sourceKey = FMeshCache::ComputeSourceKey(path, c_importFlags);
+
+    // Both have to outlive mesh creation, the mesh data spans point into them
+    FMeshCache meshCache;
+    std::unique_ptr<Assimp::Importer> importer;
+
+    std::vector<FMeshData> meshData;
+    std::vector<FMeshInstanceData> instanceData;
+
+    state.stage = FLoadStage::FLoadStage_PARSE;
+    auto stageStart = std::chrono::steady_clock::now();
 
-    if (not node or not scene or not node or not cmdList)
+    if (meshCache.Open(cachePath, sourceKey))
     {
-        throw std::runtime_error("At least one of the pointers are invalid");
+        meshCache.GetMeshes(meshData);
+        meshCache.GetInstances(instanceData);
+        meshCache.GetNodes(m_nodeTransforms);
+        state.parseTime += MicrosecondsSince(stageStart);
+        g_FDebug("Loading '%s' from mesh cache '%s'\n", path.generic_string(), cachePath.generic_string());
     }
+    else
+    {
+        importer = std::make_unique<Assimp::Importer>();
+        const aiScene* scene = importer->ReadFile(path.generic_string(), c_importFlags);
+        if (not scene or scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE or not scene->mRootNode)
+        {
+            g_FError(importer->GetErrorString());
+            throw std::runtime_error("\n");
+        }
+        state.parseTime += MicrosecondsSince(stageStart);
+
+        state.stage = FLoadStage::FLoadStage_CONVERT;
+        stageStart = std::chrono::steady_clock::now();
+
+        // Every global transform is resolved once here, meshes sharing a node reuse it
+        m_nodeTransforms.Build(scene->mRootNode);
 
-    for (UINT i = 0; i < node->mNumMeshes; ++i) {
-        aiMesh* pAiMesh = scene->mMeshes[node->mMeshes[i]];
+        std::vector<FMeshWorkItem> workItems;
+        CollectMeshes(scene, m_nodeTransforms, workItems, instanceData);
+        meshData.resize(workItems.size());
+
+        IApp::GetInstance()->GetWorkerPool().ParallelFor(workItems.size(), [&](size_t i) {
+            const FMeshWorkItem& item = workItems[i];
+            ImportMesh(item.pAiMesh, scene, meshData[item.meshIndex]);
+        });
+
+        g_FDebug("'%s': %u unique meshes, %u instances\n", path.generic_string(),
+            static_cast<UINT>(meshData.size()), static_cast<UINT>(instanceData.size()));
+
+        if (not FMeshCache::Write(cachePath, sourceKey, meshData, instanceData, m_nodeTransforms))
+        {
+            g_FWarn("Failed to write mesh cache '%s'\n", cachePath.generic_string());
+        }
+        // The importer goes away with the load, the transforms stay for SetNodeTransform
+        m_nodeTransforms.ReleaseScene();
+        state.convertTime += MicrosecondsSince(stageStart);
+    }
 
+    for (size_t i = 0; i < meshData.size(); ++i)
+    {
         if (IApp::GetInstance()->m_remainingMeshSlots <= 0)
         {
             throw std::out_of_range("No available mesh slot");
         }
-        Mesh& mesh = meshes.emplace_back(Mesh(m_wicFactory));
+        meshes.emplace_back(Mesh(m_wicFactory));
         IApp::GetInstance()->m_remainingMeshSlots--;
-        
-        mesh.name = FString::format("%s::mesh_%s", m_name, pAiMesh->mName.C_Str());
-        mesh.material.m_name = FString::format("%s::material", mesh.name);
-
-        ProcessMesh(pAiMesh, scene, node, mesh);
     }
     if (meshes.size() > IApp::GetInstance()->c_maxObjects)
     {
         throw std::out_of_range("Meshes got out of range");
     }
-    for (UINT i = 0; i < node->mNumChildren; ++i) {
-        ProcessNode(node->mChildren[i], scene, cmdList);
+
+    if (instanceData.size() > IApp::GetInstance()->c_maxInstances)
+    {
+        throw std::out_of_range("Mesh instances got out of range");
+    }
+    m_instances.clear();
+    m_instances.reserve(instanceData.size());
+    for (const FMeshInstanceData& data : instanceData)
+    {
+        MeshInstance& instance = m_instances.emplace_back();
+        instance.meshIndex = data.meshIndex;
+        instance.nodeIndex = data.nodeIndex;
+        if (not DecomposeTransform(m_nodeTransforms.GetGlobalTransform(data.nodeIndex), instance))
+        {
+            throw std::runtime_error("Failed to decompose matrix");
+        }
+        meshes[data.meshIndex].instanceCount++;
+    }
+
+    // 'meshes' and 'm_instances' keep their size from here on, the render thread may start reading them
+    state.meshCount = static_cast<UINT>(meshes.size());
+    state.stage = FLoadStage::FLoadStage_CREATE;
+
+    // Materials only take references to the cached images afterwards, the prefetch ones go once meshes hold theirs
+    FTextureCache& textureCache = IApp::GetInstance()->GetTextureCache();
+    std::vector<UINT> textureSlots;
+    std::vector<std::vector<FTextureRequest>> textureRequests;
+    try
+    {
+        PlanTextures(meshData, textureRequests);
+        PrefetchTextures(meshData, textureRequests, state, textureSlots);
+
+        // Every mesh owns its slot in 'meshes' by now, so buffer creation can run on the workers
+        IApp::GetInstance()->GetWorkerPool().ParallelFor(meshData.size(), [&](size_t i) {
+            CreateMesh(meshData[i], textureRequests[i], meshes[i]);
+
+            // Each mesh goes out in its own batch, so it can be drawn without waiting for the rest
+            IApp::GetInstance()->GetUploadRing().Submit();
+            {
+                std::scoped_lock lock(state.readyMutex);
+                state.readyMeshes.push_back(static_cast<UINT>(i));
+            }
+            state.meshesCreated++;
+        });
+    }
+    catch (...)
+    {
+        for (UINT slot : textureSlots) textureCache.Release(slot);
+        throw;
     }
+    for (UINT slot : textureSlots) textureCache.Release(slot);
 }
 
 _Use_decl_annotations_
-void Model::ProcessMesh(aiMesh* pAiMesh, const aiScene* scene, _In_ aiNode* node, Mesh& outMesh)
+void Model::PlanTextures(const std::vector<FMeshData>& meshData, std::vector<std::vector<FTextureRequest>>& outRequests)
 {
-    if (not m_device or not pAiMesh or not scene)
+    const bool packOrm = IApp::GetInstance()->m_packOrmTextures;
+    // Packing decisions by ORM texture key, materials are shared by many meshes
+    std::unordered_map<uint64_t, bool> packable;
+    // Meshes share embedded images, hashing their bytes is the expensive part of a key
+    std::unordered_map<const uint8_t*, uint64_t> contentHashes;
+
+    outRequests.assign(meshData.size(), {});
+    for (size_t i = 0; i < meshData.size(); ++i)
     {
-        throw std::runtime_error("At least one of the pointers are invalid");
+        std::vector<FTextureRequest>& requests = outRequests[i];
+        FTextureRequest orm{};
+        orm.textureType = FTextureType::FTextureType_GLTF_METALLIC_ROUGHNESS;
+        orm.isPacked = true;
+        UINT ormMaps = 0;
+        bool hasPackedMap = false;
+
+        for (const FTextureSource& source : meshData[i].textures)
+        {
+            FTextureRequest& request = requests.emplace_back();
+            request.textureType = source.textureType;
+            request.source.embeddedData = source.embeddedData;
+            if (source.embeddedData.empty()) request.source.path = m_assetPath.parent_path() / source.path;
+            else
+            {
+                auto [hash, inserted] = contentHashes.try_emplace(source.embeddedData.data());
+                if (inserted) hash->second = FTextureCache::HashMemory(source.embeddedData);
+                request.source.contentHash = hash->second;
+            }
+            Material::KeyRequest(request);
+
+            hasPackedMap = hasPackedMap or source.textureType == FTextureType::FTextureType_GLTF_METALLIC_ROUGHNESS;
+            for (size_t c = 0; c < orm.packedSources.size(); ++c)
+            {
+                if (source.textureType == Material::c_ormChannelTypes[c] and orm.packedSources[c].IsEmpty())
+                {
+                    orm.packedSources[c] = request.source;
+                    ormMaps++;
+                }
+            }
+        }
+
+        // A single map gains nothing, and the shader takes the packed path only without a packed map of the scene's own
+        if (not packOrm or hasPackedMap or ormMaps < 2)
+        {
+            continue;
+        }
+
+        Material::KeyRequest(orm);
+        auto [it, inserted] = packable.try_emplace(orm.key, true);
+        if (inserted)
+        {
+            UINT width{}, height{};
+            for (const FImageSource& source : orm.packedSources)
+            {
+                UINT mapWidth{}, mapHeight{};
+                if (source.IsEmpty()) continue;
+                if (not Material::ReadImageSize(m_wicFactory, source, mapWidth, mapHeight) or (width != 0 and (mapWidth != width or mapHeight != height)))
+                {
+                    it->second = false;
+                    break;
+                }
+                width = mapWidth;
+                height = mapHeight;
+            }
+            if (not it->second)
+            {
+                g_FDebug("'%s' keeps separate AO / roughness / metalness maps, their sizes differ or can't be read\n", meshData[i].materialName);
+            }
+        }
+        if (not it->second)
+        {
+            continue;
+        }
+
+        std::erase_if(requests, [](const FTextureRequest& request) {
+            return std::find(std::begin(Material::c_ormChannelTypes), std::end(Material::c_ormChannelTypes), request.textureType) != std::end(Material::c_ormChannelTypes);
+        });
+        requests.push_back(std::move(orm));
     }
+}
+
+_Use_decl_annotations_
+void Model::PrefetchTextures(const std::vector<FMeshData>& meshData, const std::vector<std::vector<FTextureRequest>>& requests,
+    FModelLoadState& state, std::vector<UINT>& outSlots)
+{
+    struct FPendingTexture
+    {
+        FTextureRequest request;
+        std::string name;
+    };
 
-    std::wstring meshName = std::wstring(outMesh.name.begin(), outMesh.name.end());
+    FTextureCache& textureCache = IApp::GetInstance()->GetTextureCache();
+    std::vector<FPendingTexture> pending;
+    std::unordered_set<uint64_t> seenKeys;
+    outSlots.clear();
 
-    std::vector<Vertex> vertices;
-    std::vector<UINT> indices;
+    for (size_t i = 0; i < meshData.size(); ++i)
+    {
+        for (const FTextureRequest& request : requests[i])
+        {
+            const uint64_t key = request.key;
+            if (not seenKeys.insert(key).second)
+            {
+                continue;
+            }
 
-    aiMatrix4x4 aiGlobalTransform = GetGlobalNodeTransformation(node);
+            // Cached by an earlier load, nothing to decode
+            if (const UINT slot = textureCache.TryAcquire(key); slot != FTextureCache::c_invalidSlot)
+            {
+                outSlots.push_back(slot);
+                continue;
+            }
+            pending.push_back({ request, Material::TextureName(request, meshData[i].materialName) });
+        }
+    }
+    state.textureCount = static_cast<UINT>(seenKeys.size());
+    state.texturesLoaded = static_cast<UINT>(outSlots.size());
+
+    // Cooked textures are mapped and copied into staging as they are, only the rest is decoded
+    std::vector<uint8_t> cooked(pending.size());
+    std::mutex slotMutex;
+    IApp::GetInstance()->GetWorkerPool().ParallelFor(pending.size(), [&](size_t i) {
+        const FPendingTexture& texture = pending[i];
+        const auto start = std::chrono::steady_clock::now();
+        auto cook = std::make_shared<FTextureCook>();
+        if (not Material::OpenCookedTexture(texture.request, *cook))
+        {
+            return;
+        }
 
-    DirectX::XMMATRIX globalMatrix = DirectX::XMMatrixSet(
-        aiGlobalTransform.a1, aiGlobalTransform.b1, aiGlobalTransform.c1, aiGlobalTransform.d1,
-        aiGlobalTransform.a2, aiGlobalTransform.b2, aiGlobalTransform.c2, aiGlobalTransform.d2,
-        aiGlobalTransform.a3, aiGlobalTransform.b3, aiGlobalTransform.c3, aiGlobalTransform.d3,
-        aiGlobalTransform.a4, aiGlobalTransform.b4, aiGlobalTransform.c4, aiGlobalTransform.d4
-    );
+        const UINT slot = textureCache.Acquire(texture.request.key, [&](FCachedTexture& out) {
+            return SUCCEEDED(Material::CreateTexture(m_device, std::move(cook), texture.request.textureType, texture.name, out));
+        });
+        // A cook that fails to create falls through to the decode
+        if (slot != FTextureCache::c_invalidSlot)
+        {
+            std::scoped_lock lock(slotMutex);
+            outSlots.push_back(slot);
+            state.texturesLoaded++;
+            state.texturesCooked++;
+            cooked[i] = 1;
+        }
+        state.uploadTime += MicrosecondsSince(start);
+    });
+    std::vector<FPendingTexture> decodes;
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        if (not cooked[i]) decodes.push_back(std::move(pending[i]));
+    }
+    pending.swap(decodes);
+
+    // Decodes and mip generation run on every worker, each finished texture is uploaded as soon as it is done while the rest keep decoding
+    DecodeImagesParallel(IApp::GetInstance()->GetWorkerPool(), pending.size(), m_maxDecodedTextures,
+        [&](size_t i, FTextureData& out) {
+            const FPendingTexture& texture = pending[i];
+            const auto start = std::chrono::steady_clock::now();
+            FCompressStats compress{};
+            const bool decoded = Material::DecodeTexture(m_wicFactory, texture.request, texture.name, out, &compress);
+            state.textureTime += MicrosecondsSince(start);
+            state.compressTime += static_cast<uint64_t>(compress.seconds * 1e6);
+            state.compressedPixels += compress.pixels;
+            return decoded;
+        },
+        [&](size_t i, FTextureData& data) {
+            const FPendingTexture& texture = pending[i];
+            const auto start = std::chrono::steady_clock::now();
+
+            const UINT slot = textureCache.Acquire(texture.request.key, [&](FCachedTexture& out) {
+                // The decode cooked the texture, streaming maps the fresh file instead of creating every level
+                if (auto cook = std::make_shared<FTextureCook>(); IApp::GetInstance()->m_streamTextures and Material::OpenCookedTexture(texture.request, *cook))
+                {
+                    return SUCCEEDED(Material::CreateTexture(m_device, std::move(cook), texture.request.textureType, texture.name, out));
+                }
+                return SUCCEEDED(Material::CreateTexture(m_device, data, texture.request.textureType, texture.name, out));
+            });
+            // Consumers run one at a time, no lock needed for the slots
+            if (slot != FTextureCache::c_invalidSlot)
+            {
+                outSlots.push_back(slot);
+                state.texturesLoaded++;
+            }
+            state.uploadTime += MicrosecondsSince(start);
+        });
+}
 
-    DirectX::XMVECTOR outScale, outRotQ, outPos;
-    if (not DirectX::XMMatrixDecompose(&outScale, &outRotQ, &outPos, globalMatrix))
+_Use_decl_annotations_
+void Model::UpdateLoad(ID3D12CommandQueue* cmdQueue)
+{
+    if (not cmdQueue)
     {
-        throw std::runtime_error("Failed to decompose matrix");
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+    if (not m_load or m_load->stage == FLoadStage::FLoadStage_DONE)
+    {
+        return;
     }
 
-    DirectX::XMStoreFloat3(&outMesh.m_position, outPos);
-    DirectX::XMStoreFloat4(&outMesh.m_rotationQ, outRotQ);
-    DirectX::XMStoreFloat3(&outMesh.m_scale, outScale);
+    FModelLoadState& state = *m_load;
 
-    for (UINT i = 0; i < pAiMesh->mNumVertices; i++)
+    std::vector<UINT> ready;
     {
-        Vertex v{};
+        std::scoped_lock lock(state.readyMutex);
+        ready.swap(state.readyMeshes);
+    }
 
-        v.position = DirectX::XMFLOAT3 {
-            pAiMesh->mVertices[i].x,
-            pAiMesh->mVertices[i].y,
-            pAiMesh->mVertices[i].z
-        };
+    if (not ready.empty())
+    {
+        const auto start = std::chrono::steady_clock::now();
 
-        v.normal = pAiMesh->HasNormals() ? DirectX::XMFLOAT3 {
-            pAiMesh->mNormals[i].x,
-            pAiMesh->mNormals[i].y,
-            pAiMesh->mNormals[i].z
+        // Everything submitted so far includes the copies of these meshes, wait on the GPU not here
+        IApp::GetInstance()->GetUploadRing().QueueWait(cmdQueue);
+        for (UINT meshIndex : ready)
+        {
+            MakeResident(meshes[meshIndex]);
         }
-        :   DirectX::XMFLOAT3 {0.f, 0.f, 0.f};
+        state.meshesResident += static_cast<UINT>(ready.size());
+        state.uploadTime += MicrosecondsSince(start);
+    }
 
-        v.texCoord = pAiMesh->mTextureCoords[0] ? DirectX::XMFLOAT2 {
-            pAiMesh->mTextureCoords[0][i].x,
-            pAiMesh->mTextureCoords[0][i].y
-        }
-        :   DirectX::XMFLOAT2{ 0.f, 0.f };
+    if (state.stage == FLoadStage::FLoadStage_CREATE and state.meshesResident == state.meshCount and state.meshesCreated == state.meshCount)
+    {
+        WaitLoad();
+        state.stage = FLoadStage::FLoadStage_DONE;
+        isOnGPU = true;
 
-        v.tangent = pAiMesh->HasTangentsAndBitangents() ? DirectX::XMFLOAT3{
-            pAiMesh->mTangents[i].x,
-            pAiMesh->mTangents[i].y,
-            pAiMesh->mTangents[i].z
+        g_FDebug("'%s' loaded: parse %.2f ms, convert %.2f ms, texture decode %.2f ms (compress %.2f ms, %.1f MPix/s), upload %.2f ms\n",
+            m_assetPath.generic_string(), state.parseTime / 1000.0, state.convertTime / 1000.0, state.textureTime / 1000.0,
+            state.compressTime / 1000.0, state.GetCompressMegapixelsPerSecond(), state.uploadTime / 1000.0);
+    }
+}
+
+void Model::RefreshTextureViews()
+{
+    if (not AreMeshesPublished())
+    {
+        return;
+    }
+    for (Mesh& mesh : meshes)
+    {
+        if (mesh.isResident)
+        {
+            mesh.material.RefreshViews(m_device);
         }
-        : DirectX::XMFLOAT3{ 1.f, 0.f, 0.f };
+    }
+}
+
+void Model::WaitLoad()
+{
+    if (m_load and m_load->task.valid())
+    {
+        m_load->task.wait();
+    }
+}
+
+_Use_decl_annotations_
+void Model::MakeResident(Mesh& mesh)
+{
+    mesh.material.UploadGPU(m_device);
+    mesh.isResident = true;
+}
 
-        v.bitangent = pAiMesh->HasTangentsAndBitangents() ? DirectX::XMFLOAT3{
-            pAiMesh->mBitangents[i].x,
-            pAiMesh->mBitangents[i].y,
-            pAiMesh->mBitangents[i].z
+_Use_decl_annotations_
+void Model::CollectMeshes(const aiScene* scene, const FNodeTransformCache& nodes, std::vector<FMeshWorkItem>& outItems, std::vector<FMeshInstanceData>& outInstances) {
+
+    if (not scene)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    // scene->mMeshes index -> imported mesh index, each aiMesh is imported once no matter how many nodes use it
+    std::vector<uint32_t> meshIndices(scene->mNumMeshes, UINT32_MAX);
+
+    // The cache is in preorder, so meshes keep the order of the former recursive walk
+    for (size_t n = 0; n < nodes.Size(); ++n) {
+        const aiNode* node = nodes.GetNode(n);
+        if (node->mNumMeshes == 0) {
+            continue;
         }
-        : DirectX::XMFLOAT3{ 0.f, 1.f, 0.f };
 
-        {
-            using namespace DirectX;
-            XMVECTOR T = XMLoadFloat3(&v.tangent);
-            XMVECTOR B = XMLoadFloat3(&v.bitangent);
-            XMVECTOR N = XMLoadFloat3(&v.normal);
-            XMVECTOR det = XMVector3Dot(N, XMVector3Cross(T, B));
-            if (XMVectorGetX(XMVectorLess(det, XMVectorZero())) > 0) // Check left handedness
-            {
-                v.bitangent.x = -v.bitangent.x;
-                v.bitangent.y = -v.bitangent.y;
-                v.bitangent.z = -v.bitangent.z;
+        for (UINT i = 0; i < node->mNumMeshes; ++i) {
+            const UINT sceneMeshIndex = node->mMeshes[i];
+            if (meshIndices[sceneMeshIndex] == UINT32_MAX) {
+                meshIndices[sceneMeshIndex] = static_cast<uint32_t>(outItems.size());
+                outItems.push_back({ scene->mMeshes[sceneMeshIndex], outItems.size() });
             }
+
+            FMeshInstanceData& instance = outInstances.emplace_back();
+            instance.meshIndex = meshIndices[sceneMeshIndex];
+            instance.nodeIndex = static_cast<uint32_t>(n);
         }
+    }
+}
 
-        vertices.push_back(v);
+_Use_decl_annotations_
+bool Model::DecomposeTransform(const aiMatrix4x4& transform, MeshInstance& outInstance)
+{
+    DirectX::XMMATRIX globalMatrix = DirectX::XMMatrixSet(
+        transform.a1, transform.b1, transform.c1, transform.d1,
+        transform.a2, transform.b2, transform.c2, transform.d2,
+        transform.a3, transform.b3, transform.c3, transform.d3,
+        transform.a4, transform.b4, transform.c4, transform.d4
+    );
+
+    DirectX::XMVECTOR outScale, outRotQ, outPos;
+    if (not DirectX::XMMatrixDecompose(&outScale, &outRotQ, &outPos, globalMatrix))
+    {
+        return false;
     }
+    DirectX::XMStoreFloat3(&outInstance.m_position, outPos);
+    DirectX::XMStoreFloat4(&outInstance.m_rotationQ, outRotQ);
+    DirectX::XMStoreFloat3(&outInstance.m_scale, outScale);
+    return true;
+}
 
-    for (UINT i = 0; i < pAiMesh->mNumFaces; i++)
+_Use_decl_annotations_
+void Model::SetNodeTransform(uint32_t nodeIndex, const aiMatrix4x4& local)
+{
+    m_nodeTransforms.SetLocalTransform(nodeIndex, local);
+}
+
+void Model::UpdateNodeTransforms()
+{
+    if (not m_nodeTransforms.IsDirty())
+    {
+        return;
+    }
+    m_nodeTransforms.Update();
+    for (MeshInstance& instance : m_instances)
     {
-        aiFace face = pAiMesh->mFaces[i];
-        for (UINT j = 0; j < face.mNumIndices; j++)
+        // Typically a node animated down to zero scale, it draws nothing until it grows again
+        if (not DecomposeTransform(m_nodeTransforms.GetGlobalTransform(instance.nodeIndex), instance))
         {
-            indices.push_back(face.mIndices[j]);
+            instance.m_scale = DirectX::XMFLOAT3{};
         }
     }
+}
 
-    g_FDebug("Mesh '%s' load begin with %u vertices, %u indices", outMesh.name, static_cast<UINT>(vertices.size()), static_cast<UINT>(indices.size()));
+_Use_decl_annotations_
+void Model::ImportMesh(aiMesh* pAiMesh, const aiScene* scene, FMeshData& outData)
+{
+    if (not pAiMesh or not scene)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
 
-    outMesh.vertexCount = static_cast<UINT>(vertices.size());
-    outMesh.indexCount = static_cast<UINT>(indices.size());
-    const UINT vbByteSize = outMesh.vertexCount * sizeof(Vertex);
-    const UINT ibByteSize = outMesh.indexCount * sizeof(UINT);
+    outData.name = pAiMesh->mName.C_Str();
 
-    D3D12_RESOURCE_DESC vertexBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(vbByteSize);
-    D3D12_RESOURCE_DESC indexBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
-    D3D12_HEAP_PROPERTIES uploadHeapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    std::vector<Vertex>& vertices = outData.vertexStorage;
+    std::vector<UINT>& indices = outData.indexStorage;
 
-    if (FAILED(m_device->CreateCommittedResource(
-        &uploadHeapProp,
-        D3D12_HEAP_FLAG_NONE,
-        &vertexBufferDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&outMesh.uploadVertexBuffer)))) throw std::runtime_error("Failed to create vertex buffer");
+    vertices.resize(pAiMesh->mNumVertices);
 
-    outMesh.uploadVertexBuffer->SetName(meshName.append(L"defaultVertexBuffer").c_str());
+    FVertexStreams streams{};
+    streams.positions = &pAiMesh->mVertices[0].x;
+    streams.normals = pAiMesh->HasNormals() ? &pAiMesh->mNormals[0].x : nullptr;
+    streams.tangents = pAiMesh->HasTangentsAndBitangents() ? &pAiMesh->mTangents[0].x : nullptr;
+    streams.bitangents = pAiMesh->HasTangentsAndBitangents() ? &pAiMesh->mBitangents[0].x : nullptr;
+    streams.texCoords = pAiMesh->mTextureCoords[0] ? &pAiMesh->mTextureCoords[0][0].x : nullptr;
+    streams.count = pAiMesh->mNumVertices;
+    ConvertVertices(streams, reinterpret_cast<FVertexF32*>(vertices.data()));
 
-    void* mappedVertexBuffer = nullptr;
-    if (FAILED(outMesh.uploadVertexBuffer->Map(0u, nullptr, reinterpret_cast<void**>(&mappedVertexBuffer)))) throw std::runtime_error("Failed to map vertex upload buffer");
+    size_t indexCount{};
+    for (UINT i = 0; i < pAiMesh->mNumFaces; i++)
+    {
+        indexCount += pAiMesh->mFaces[i].mNumIndices;
+    }
+    indices.resize(indexCount);
 
-    memcpy(mappedVertexBuffer, vertices.data(), vbByteSize);
-    outMesh.uploadVertexBuffer->Unmap(0, nullptr);
+    UINT* indexOut = indices.data();
+    for (UINT i = 0; i < pAiMesh->mNumFaces; i++)
+    {
+        const aiFace& face = pAiMesh->mFaces[i];
+        memcpy(indexOut, face.mIndices, face.mNumIndices * sizeof(UINT));
+        indexOut += face.mNumIndices;
+    }
 
-    if (FAILED(m_device->CreateCommittedResource(
-        &uploadHeapProp,
-        D3D12_HEAP_FLAG_NONE,
-        &indexBufferDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&outMesh.uploadIndexBuffer)))) throw std::runtime_error("Failed to create index buffer");
+    // Point and line faces would break the triangle list assumptions of the optimizer
+    if (pAiMesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE and not indices.empty())
+    {
+        const FVertexCacheStats before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
 
-    outMesh.uploadIndexBuffer->SetName(meshName.append(L"defaultIndexBuffer").c_str());
+        OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+        if constexpr (c_overdrawThreshold > 0.f)
+        {
+            OptimizeOverdraw(indices.data(), indices.size(), &vertices[0].position.x, sizeof(Vertex), vertices.size(), c_overdrawThreshold);
+        }
+        vertices.resize(OptimizeVertexFetch(vertices.data(), sizeof(Vertex), vertices.size(), indices.data(), indices.size()));
 
-    void* mappedIndexBuffer = nullptr;
-    if (FAILED(outMesh.uploadIndexBuffer->Map(0u, nullptr, reinterpret_cast<void**>(&mappedIndexBuffer)))) throw std::runtime_error("Failed to map index upload buffer");
-    
-    memcpy(mappedIndexBuffer, indices.data(), ibByteSize);
-    outMesh.uploadIndexBuffer->Unmap(0, nullptr);
+        const FVertexCacheStats after = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+        g_FDebug("Mesh '%s' optimized, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", outData.name, before.acmr, after.acmr, before.atvr, after.atvr);
 
-    D3D12_HEAP_PROPERTIES defaultHeapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+        FMeshletData& meshlets = outData.meshletStorage;
+        BuildMeshlets(indices.data(), indices.size(), &vertices[0].position.x, sizeof(Vertex), vertices.size(), meshlets);
+        outData.meshlets = meshlets.meshlets;
+        outData.meshletVertices = meshlets.vertices;
+        outData.meshletTriangles = meshlets.triangles;
 
-    if (FAILED(m_device->CreateCommittedResource(
-        &defaultHeapProp,
-        D3D12_HEAP_FLAG_NONE,
-        &vertexBufferDesc,
-        D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&outMesh.defaultVertexBuffer)))) throw std::runtime_error("Failed to create index buffer");
+        BuildLodChain(indices, reinterpret_cast<const FVertexF32*>(vertices.data()), vertices.size(), c_lodSettings, outData.lodStorage);
+        for (size_t lod = 1; lod < outData.lodStorage.size(); ++lod)
+        {
+            g_FDebug("Mesh '%s' LOD %u: %u triangles, error %f\n", outData.name, static_cast<UINT>(lod),
+                outData.lodStorage[lod].indexCount / 3u, outData.lodStorage[lod].error);
+        }
+    }
+    else outData.lodStorage = { { 0u, static_cast<uint32_t>(indices.size()), 0.f, 0u } };
+    outData.lods = outData.lodStorage;
 
-    if (FAILED(m_device->CreateCommittedResource(
-        &defaultHeapProp,
-        D3D12_HEAP_FLAG_NONE,
-        &indexBufferDesc,
-        D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&outMesh.defaultIndexBuffer)))) throw std::runtime_error("Failed to create index buffer");
+    if (not vertices.empty())
+    {
+        DirectX::XMVECTOR boundsMin = DirectX::XMLoadFloat3(&vertices[0].position);
+        DirectX::XMVECTOR boundsMax = boundsMin;
+        for (const Vertex& vertex : vertices)
+        {
+            const DirectX::XMVECTOR position = DirectX::XMLoadFloat3(&vertex.position);
+            boundsMin = DirectX::XMVectorMin(boundsMin, position);
+            boundsMax = DirectX::XMVectorMax(boundsMax, position);
+        }
 
-    outMesh.defaultIndexBuffer->SetName(meshName.append(L"defaultIndexBuffer").c_str());
-    outMesh.defaultVertexBuffer->SetName(meshName.append(L"defaultVertexBuffer").c_str());
+        // Sphere around the box centre, sized by the farthest vertex rather than the box corner
+        const DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(boundsMin, boundsMax), .5f);
+        DirectX::XMVECTOR radiusSq = DirectX::XMVectorZero();
+        for (const Vertex& vertex : vertices)
+        {
+            radiusSq = DirectX::XMVectorMax(radiusSq, DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertex.position), center)));
+        }
 
-    outMesh.vertexBufferView.BufferLocation = outMesh.defaultVertexBuffer->GetGPUVirtualAddress();
-    outMesh.vertexBufferView.SizeInBytes = vbByteSize;
-    outMesh.vertexBufferView.StrideInBytes = sizeof(Vertex);
+        DirectX::XMStoreFloat3(&outData.boundsMin, boundsMin);
+        DirectX::XMStoreFloat3(&outData.boundsMax, boundsMax);
+        DirectX::XMStoreFloat3(&outData.boundsCenter, center);
+        outData.boundsRadius = std::sqrt(DirectX::XMVectorGetX(radiusSq));
+    }
 
-    outMesh.indexBufferView.BufferLocation = outMesh.defaultIndexBuffer->GetGPUVirtualAddress();
-    outMesh.indexBufferView.SizeInBytes = ibByteSize;
-    outMesh.indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    outData.vertices = vertices;
+    outData.indices = indices;
 
-    if (pAiMesh->mMaterialIndex >= 0)
+    if (pAiMesh->mMaterialIndex < scene->mNumMaterials)
     {
         aiMaterial* material = scene->mMaterials[pAiMesh->mMaterialIndex];
 
         aiString matName;
         if (material->Get(AI_MATKEY_NAME, matName) == AI_SUCCESS) {
-            const std::string materialName = outMesh.material.m_name;
-            outMesh.material.m_name = FString::format("%s::%s", materialName, std::string(matName.C_Str(), matName.C_Str() + matName.length).c_str());
+            outData.materialName = std::string(matName.C_Str(), matName.C_Str() + matName.length);
         }
 
         aiColor4D baseColor;
         if (material->Get(AI_MATKEY_COLOR_DIFFUSE, baseColor) == AI_SUCCESS) {
-            outMesh.material.m_baseColor = DirectX::XMFLOAT4(baseColor.r, baseColor.g, baseColor.b, baseColor.a);
+            outData.baseColor = DirectX::XMFLOAT4(baseColor.r, baseColor.g, baseColor.b, baseColor.a);
         }
 
         float metallic {};
         if (material->Get(AI_MATKEY_METALLIC_FACTOR, metallic) == AI_SUCCESS) {
-            outMesh.material.m_metallic = metallic;
+            outData.metallic = metallic;
         }
 
         float roughness{};
         if (material->Get(AI_MATKEY_ROUGHNESS_FACTOR, roughness) == AI_SUCCESS) {
-            outMesh.material.m_roughness = roughness;
+            outData.roughness = roughness;
         }
 
         float opacity{};
         if (material->Get(AI_MATKEY_OPACITY, opacity) == AI_SUCCESS) {
-            outMesh.material.m_opacity = opacity;
+            outData.opacity = opacity;
         }
 
         for (UINT type = 0u; type < AI_TEXTURE_TYPE_MAX; ++type) {
@@ -286,44 +717,22 @@ void Model::ProcessMesh(aiMesh* pAiMesh, const aiScene* scene, _In_ aiNode* node
 
                     if (not pathStr.empty())
                     {
-                        const aiTexture* embeddedTex = scene->GetEmbeddedTexture(path.C_Str());
-
-                        ComPtr<IWICBitmapDecoder> decoder;
+                        FTextureSource source{};
+                        source.textureType = static_cast<FTextureType>(type);
 
+                        const aiTexture* embeddedTex = scene->GetEmbeddedTexture(path.C_Str());
                         if (embeddedTex != nullptr)
                         {
-                            if (embeddedTex->mHeight == 0)
-                            {
-                                ComPtr<IWICStream> stream;
-                                if (FAILED(m_wicFactory->CreateStream(&stream)))
-                                {
-                                    g_FError("Failed to create WIC stream\n");
-                                    continue;
-                                }
-                                if (FAILED(stream->InitializeFromMemory(reinterpret_cast<BYTE*>(embeddedTex->pcData), embeddedTex->mWidth)))
-                                {
-                                    g_FError("Failed to initialize stream from memory\n");
-                                    continue;
-                                }
-
-                                if (FAILED(m_wicFactory->CreateDecoderFromStream(stream.Get(), nullptr, WICDecodeMetadataCacheOnDemand, &decoder)))
-                                {
-                                    g_FError("Failed to create WIC decoder\n");
-                                    continue;
-                                }
-                            }
-                        }
-                        else {
-                            std::wstring directory = m_assetPath.parent_path().generic_wstring() + L"/" + std::wstring(pathStr.begin(), pathStr.end());
-
-                            if (FAILED(m_wicFactory->CreateDecoderFromFilename(directory.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)))
+                            if (embeddedTex->mHeight != 0)
                             {
-                                g_FError("Failed to create decoder from file: %s\n", WStringToString(directory).c_str());
+                                g_FWarn("Uncompressed embedded texture '%s' is not supported\n", pathStr);
                                 continue;
                             }
+                            source.embeddedData = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(embeddedTex->pcData), embeddedTex->mWidth);
                         }
+                        else source.path = pathStr;
 
-                        outMesh.material.LoadTexture(m_device, decoder.Get(), static_cast<aiTextureType>(type));
+                        outData.textures.push_back(std::move(source));
                     }
                     else throw std::runtime_error("Failed to get path from aiString");
                 }
@@ -332,68 +741,178 @@ void Model::ProcessMesh(aiMesh* pAiMesh, const aiScene* scene, _In_ aiNode* node
         }
     }
     else g_FWarn("\n\t-- No Material Found");
-
-    g_FDebug("\n\t -- loaded\n");
 }
 
 _Use_decl_annotations_
-void Model::UploadGPU(ID3D12GraphicsCommandList* cmdList, ID3D12CommandQueue* cmdQueue)
+void Model::CreateMesh(const FMeshData& data, const std::vector<FTextureRequest>& textures, Mesh& outMesh)
 {
-    if (not cmdList or not cmdQueue)
+    if (not m_device)
     {
         throw std::runtime_error("At least one of the pointers are invalid");
     }
-    if (not isOnCPU)
+
+    outMesh.name = FString::format("%s::mesh_%s", m_name, data.name);
+    outMesh.material.m_name = FString::format("%s::material", outMesh.name);
+    if (not data.materialName.empty())
     {
-        throw std::runtime_error("Upload heaps are empty");
+        outMesh.material.m_name = FString::format("%s::%s", outMesh.material.m_name, data.materialName);
     }
-    if (isOnGPU)
+
+    outMesh.material.m_baseColor = data.baseColor;
+    outMesh.material.m_metallic = data.metallic;
+    outMesh.material.m_roughness = data.roughness;
+    outMesh.material.m_opacity = data.opacity;
+
+    g_FDebug("Mesh '%s' load begin with %u vertices, %u indices, %u meshlets", outMesh.name,
+        static_cast<UINT>(data.vertices.size()), static_cast<UINT>(data.indices.size()), static_cast<UINT>(data.meshlets.size()));
+
+    outMesh.vertexCount = static_cast<UINT>(data.vertices.size());
+    outMesh.indexCount = static_cast<UINT>(data.indices.size());
+
+    outMesh.boundsMin = data.boundsMin;
+    outMesh.boundsMax = data.boundsMax;
+    outMesh.boundsCenter = data.boundsCenter;
+    outMesh.boundsRadius = data.boundsRadius;
+
+    const void* vertexData = data.vertices.data();
+    UINT vertexStride = sizeof(Vertex);
+    std::vector<FPackedVertex> packedVertices;
+    if (m_vertexFormat == FVertexFormat::FVertexFormat_PACKED)
     {
-        return;
+        const FVertexF32* source = reinterpret_cast<const FVertexF32*>(data.vertices.data());
+        const FPositionQuantization quantization = ComputePositionQuantization(source, data.vertices.size());
+
+        packedVertices.resize(data.vertices.size());
+        PackVertices(source, data.vertices.size(), quantization, packedVertices.data());
+
+        outMesh.positionScale = { quantization.scale[0], quantization.scale[1], quantization.scale[2] };
+        outMesh.positionOffset = { quantization.offset[0], quantization.offset[1], quantization.offset[2] };
+        vertexData = packedVertices.data();
+        vertexStride = sizeof(FPackedVertex);
     }
-    std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
-    barriers.reserve(meshes.size() * 3u);
 
-    for (Mesh& mesh : meshes)
+    const void* indexData = data.indices.data();
+    UINT indexStride = sizeof(UINT);
+    FIndexBuffer16 indexBuffer16;
+    std::vector<uint8_t> splitVertices;
+    std::vector<FMeshLod> lods(data.lods.begin(), data.lods.end());
+    if (lods.empty())
     {
-        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-            mesh.defaultVertexBuffer.Get(),
-            D3D12_RESOURCE_STATE_COMMON,
-            D3D12_RESOURCE_STATE_COPY_DEST
-        ));
-        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-            mesh.defaultIndexBuffer.Get(),
-            D3D12_RESOURCE_STATE_COMMON,
-            D3D12_RESOURCE_STATE_COPY_DEST
-        ));
+        lods.push_back({ 0u, static_cast<uint32_t>(data.indices.size()), 0.f, 0u });
     }
 
-    cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+    outMesh.lods.clear();
+    outMesh.drawRanges.clear();
+    if (m_splitLargeMeshes or data.vertices.size() <= c_maxVertices16)
+    {
+        for (const FMeshLod& lod : lods)
+        {
+            const UINT firstRange = static_cast<UINT>(indexBuffer16.ranges.size());
+            BuildIndexBuffer16(data.indices.data() + lod.indexOffset, lod.indexCount, data.vertices.size(), indexBuffer16);
+            outMesh.lods.push_back({ firstRange, static_cast<UINT>(indexBuffer16.ranges.size()) - firstRange, lod.error });
+        }
+        if (not indexBuffer16.vertexRemap.empty())
+        {
+            splitVertices.resize(indexBuffer16.vertexRemap.size() * vertexStride);
+            RemapVertexBytes(vertexData, vertexStride, indexBuffer16.vertexRemap, splitVertices.data());
+            vertexData = splitVertices.data();
+            outMesh.vertexCount = static_cast<UINT>(indexBuffer16.vertexRemap.size());
+            g_FDebug("Mesh '%s' split into %u ranges for 16 bit indices, %u vertices after the split",
+                outMesh.name, static_cast<UINT>(indexBuffer16.ranges.size()), outMesh.vertexCount);
+        }
 
-    barriers.clear();
+        outMesh.indexCount = static_cast<UINT>(indexBuffer16.indices.size());
+        outMesh.drawRanges = indexBuffer16.ranges;
+        indexData = indexBuffer16.indices.data();
+        indexStride = sizeof(uint16_t);
+    }
+    else
+    {
+        for (const FMeshLod& lod : lods)
+        {
+            outMesh.lods.push_back({ static_cast<UINT>(outMesh.drawRanges.size()), 1u, lod.error });
+            outMesh.drawRanges.push_back({ lod.indexOffset, lod.indexCount, 0 });
+        }
+    }
 
-    for (Mesh& mesh : meshes)
+    outMesh.meshletData.meshlets.assign(data.meshlets.begin(), data.meshlets.end());
+    outMesh.meshletData.vertices.assign(data.meshletVertices.begin(), data.meshletVertices.end());
+    outMesh.meshletData.triangles.assign(data.meshletTriangles.begin(), data.meshletTriangles.end());
+    if (not indexBuffer16.vertexRemap.empty())
     {
-        cmdList->CopyResource(mesh.defaultVertexBuffer.Get(), mesh.uploadVertexBuffer.Get());
-        cmdList->CopyResource(mesh.defaultIndexBuffer.Get(), mesh.uploadIndexBuffer.Get());
+        // Split copies of a vertex are identical, any of them will do for the meshlets
+        std::vector<uint32_t> splitIndex(data.vertices.size());
+        for (size_t i = 0; i < indexBuffer16.vertexRemap.size(); ++i)
+        {
+            splitIndex[indexBuffer16.vertexRemap[i]] = static_cast<uint32_t>(i);
+        }
+        for (uint32_t& v : outMesh.meshletData.vertices)
+        {
+            v = splitIndex[v];
+        }
+    }
+
+    const UINT vbByteSize = outMesh.vertexCount * vertexStride;
+    const UINT ibByteSize = outMesh.indexCount * indexStride;
+
+    FGeometryPool& geometryPool = IApp::GetInstance()->GetGeometryPool();
+    outMesh.vertexAllocation = geometryPool.Allocate(vbByteSize);
+    outMesh.indexAllocation = geometryPool.Allocate(ibByteSize);
+
+    // Staged straight into the shared ring, the copies run on its queue while loading continues
+    const auto uploadStart = std::chrono::steady_clock::now();
+    FUploadRing& uploadRing = IApp::GetInstance()->GetUploadRing();
+    uploadRing.CopyBuffer(outMesh.vertexAllocation.buffer, outMesh.vertexAllocation.offset, vertexData, vbByteSize);
+    uploadRing.CopyBuffer(outMesh.indexAllocation.buffer, outMesh.indexAllocation.offset, indexData, ibByteSize);
+    if (m_load) m_load->uploadTime += MicrosecondsSince(uploadStart);
+
+    outMesh.vertexBufferView.BufferLocation = outMesh.vertexAllocation.gpuAddress;
+    outMesh.vertexBufferView.SizeInBytes = vbByteSize;
+    outMesh.vertexBufferView.StrideInBytes = vertexStride;
 
-        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-            mesh.defaultVertexBuffer.Get(),
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-        ));
-        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-            mesh.defaultIndexBuffer.Get(),
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            D3D12_RESOURCE_STATE_INDEX_BUFFER
-        ));
+    outMesh.indexBufferView.BufferLocation = outMesh.indexAllocation.gpuAddress;
+    outMesh.indexBufferView.SizeInBytes = ibByteSize;
+    outMesh.indexBufferView.Format = indexStride == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+    for (const FTextureRequest& request : textures)
+    {
+        // Decoded by PrefetchTextures already, meshes only take a reference in the texture cache
+        outMesh.material.LoadTexture(m_device, request);
     }
 
-    cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+    g_FDebug("\n\t -- loaded\n");
+}
+
+_Use_decl_annotations_
+void Model::UploadGPU(ID3D12GraphicsCommandList* cmdList, ID3D12CommandQueue* cmdQueue)
+{
+    if (not cmdList or not cmdQueue)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+    if (not isOnCPU)
+    {
+        throw std::runtime_error("Upload heaps are empty");
+    }
+    if (isOnGPU)
+    {
+        return;
+    }
+    // Geometry and texels were staged while loading, the direct queue only has to wait for the copies
+    FUploadRing& uploadRing = IApp::GetInstance()->GetUploadRing();
+    uploadRing.Submit();
+    uploadRing.QueueWait(cmdQueue);
 
     for (Mesh& mesh : meshes)
     {
-        mesh.material.UploadGPU(m_device, cmdQueue, cmdList);
+        MakeResident(mesh);
+    }
+    if (m_load)
+    {
+        std::scoped_lock lock(m_load->readyMutex);
+        m_load->readyMeshes.clear();
+        m_load->meshesResident = m_load->meshCount.load();
+        m_load->stage = FLoadStage::FLoadStage_DONE;
     }
 
     ThrowIfFailed(cmdList->Close());
@@ -410,27 +929,180 @@ void Model::Draw(DrawContext ctx)
     {
         throw std::runtime_error("At least one of the pointers are invalid");
     }
+    if (not AreMeshesPublished())
+    {
+        m_drawnMeshes = m_culledMeshes = m_drawCalls = 0u;
+        return;
+    }
+    UpdateNodeTransforms();
 
     DirectX::XMMATRIX globalRotation = DirectX::XMMatrixRotationRollPitchYaw(m_rotation.x, m_rotation.y, m_rotation.z);
 
-    UINT meshIndex{};
-    for (Mesh& mesh : meshes)
+    // Pixels covered by one world unit at distance one, projection _22 is cot(fovY / 2)
+    const DirectX::XMMATRIX viewInverse = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&ctx.viewMatrix));
+    const DirectX::XMVECTOR cameraPosition = viewInverse.r[3];
+    const FLOAT pixelsPerUnit = ctx.projectionMatrix._22 * ctx.viewportHeight * .5f;
+
+    // Culling pass: every instance box goes to world space and is tested against the frustum before recording
+    m_worldMatrices.resize(m_instances.size());
+    m_meshVisible.resize(m_instances.size());
+    m_cullBoxes.Resize(m_instances.size());
+    UINT pendingInstances{};
+    for (size_t i = 0; i < m_instances.size(); ++i)
     {
-        const DirectX::XMMATRIX scaleMatrix = DirectX::XMMatrixScalingFromVector(DirectX::XMLoadFloat3(&mesh.m_scale));
-        const DirectX::XMMATRIX rotQMatrix  = DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&mesh.m_rotationQ));
-        const DirectX::XMMATRIX posMatrix   = DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat3(&mesh.m_position));
+        const MeshInstance& instance = m_instances[i];
+        const Mesh& mesh = meshes[instance.meshIndex];
+        if (not mesh.isResident)
+        {
+            // Still being created on a worker, none of its fields are safe to read yet
+            const DirectX::XMFLOAT3 empty{};
+            m_cullBoxes.Set(i, &empty.x, &empty.x);
+            pendingInstances++;
+            continue;
+        }
+
+        const DirectX::XMMATRIX scaleMatrix = DirectX::XMMatrixScalingFromVector(DirectX::XMLoadFloat3(&instance.m_scale));
+        const DirectX::XMMATRIX rotQMatrix  = DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&instance.m_rotationQ));
+        const DirectX::XMMATRIX posMatrix   = DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat3(&instance.m_position));
         const DirectX::XMMATRIX worldMatrix = scaleMatrix * rotQMatrix * posMatrix * globalRotation;
+        DirectX::XMStoreFloat4x4(&m_worldMatrices[i], worldMatrix);
+
+        const DirectX::XMVECTOR boundsMin = DirectX::XMLoadFloat3(&mesh.boundsMin);
+        const DirectX::XMVECTOR boundsMax = DirectX::XMLoadFloat3(&mesh.boundsMax);
+        const DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(boundsMin, boundsMax), .5f);
+        const DirectX::XMVECTOR extent = DirectX::XMVectorScale(DirectX::XMVectorSubtract(boundsMax, boundsMin), .5f);
+
+        // Arvo: the world extent is the object extent through the absolute rotation/scale part
+        DirectX::XMVECTOR worldExtent = DirectX::XMVectorMultiply(DirectX::XMVectorAbs(worldMatrix.r[0]), DirectX::XMVectorSplatX(extent));
+        worldExtent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(worldMatrix.r[1]), DirectX::XMVectorSplatY(extent), worldExtent);
+        worldExtent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(worldMatrix.r[2]), DirectX::XMVectorSplatZ(extent), worldExtent);
+
+        DirectX::XMFLOAT3 worldCenter, worldExtent3;
+        DirectX::XMStoreFloat3(&worldCenter, DirectX::XMVector3Transform(center, worldMatrix));
+        DirectX::XMStoreFloat3(&worldExtent3, worldExtent);
+        m_cullBoxes.Set(i, &worldCenter.x, &worldExtent3.x);
+    }
 
-        const UINT slot = ctx.bufferIndex * IApp::GetInstance()->c_maxObjects + meshIndex;
-        auto meshConstantGpuAddrBase = ctx.meshConstantsGpuVirtualAddr + sizeof(PaddedMeshConstants) * slot;
+    DirectX::XMFLOAT4X4 viewProjection;
+    DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMLoadFloat4x4(&ctx.viewMatrix) * DirectX::XMLoadFloat4x4(&ctx.projectionMatrix));
+    m_drawnMeshes = static_cast<UINT>(m_cullBoxes.Cull(MakeFrustum(viewProjection.m), m_meshVisible.data()));
+    if (pendingInstances > 0)
+    {
+        for (size_t i = 0; i < m_instances.size(); ++i)
+        {
+            if (m_meshVisible[i] and not meshes[m_instances[i].meshIndex].isResident)
+            {
+                m_meshVisible[i] = 0;
+                m_drawnMeshes--;
+            }
+        }
+    }
+    m_culledMeshes = static_cast<UINT>(m_instances.size()) - pendingInstances - m_drawnMeshes;
 
-        meshConstants constants{};
-        DirectX::XMStoreFloat4x4(&constants.worldMatrix, worldMatrix);
+    // Bucket the visible instances by mesh and LOD with a counting sort, each bucket becomes one instanced draw
+    m_firstGroup.resize(meshes.size());
+    UINT groupCount{};
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        m_firstGroup[i] = groupCount;
+        if (not meshes[i].isResident)
+        {
+            continue;
+        }
+        groupCount += static_cast<UINT>(meshes[i].lods.size());
+        meshes[i].currentLod = static_cast<UINT>(meshes[i].lods.size()) - 1u;
+    }
+    m_groupCounts.assign(groupCount, 0u);
+    m_groupOffsets.resize(groupCount);
+    m_instanceLods.resize(m_instances.size());
+    m_meshScreenSizes.assign(meshes.size(), 0.f);
+
+    for (size_t i = 0; i < m_instances.size(); ++i)
+    {
+        if (not m_meshVisible[i])
+        {
+            continue;
+        }
+
+        const UINT meshIndex = m_instances[i].meshIndex;
+        Mesh& mesh = meshes[meshIndex];
+        const FLOAT projectedScale = ProjectedScale(mesh, DirectX::XMLoadFloat4x4(&m_worldMatrices[i]), cameraPosition, pixelsPerUnit);
+        const UINT lod = SelectLod(mesh, projectedScale);
+        mesh.currentLod = std::min(mesh.currentLod, lod);
+        m_instanceLods[i] = lod;
+        m_groupCounts[m_firstGroup[meshIndex] + lod]++;
+        m_meshScreenSizes[meshIndex] = std::max(m_meshScreenSizes[meshIndex], 2.f * mesh.boundsRadius * projectedScale);
+    }
+
+    // Texture detail follows the closest visible instance, culled meshes ask for nothing and age toward eviction
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        if (m_meshScreenSizes[i] > 0.f)
+        {
+            meshes[i].material.RequestDetail(m_meshScreenSizes[i]);
+        }
+    }
+
+    UINT instanceOffset{};
+    for (UINT group = 0; group < groupCount; ++group)
+    {
+        m_groupOffsets[group] = instanceOffset;
+        instanceOffset += m_groupCounts[group];
+    }
+
+    m_groupCursors = m_groupOffsets;
+    instanceTransform* frameInstances = ctx.instanceBufferCpuAddr + static_cast<size_t>(ctx.bufferIndex) * IApp::GetInstance()->c_maxInstances;
+    for (size_t i = 0; i < m_instances.size(); ++i)
+    {
+        if (not m_meshVisible[i])
+        {
+            continue;
+        }
+
+        const Mesh& mesh = meshes[m_instances[i].meshIndex];
+        const DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&m_worldMatrices[i]);
+        const DirectX::XMMATRIX dequantizeMatrix =
+            DirectX::XMMatrixScalingFromVector(DirectX::XMLoadFloat3(&mesh.positionScale)) *
+            DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat3(&mesh.positionOffset));
+
+        const UINT group = m_firstGroup[m_instances[i].meshIndex] + m_instanceLods[i];
+        instanceTransform& transform = frameInstances[m_groupCursors[group]++];
+
+        DirectX::XMStoreFloat3x4(&transform.worldMatrix, dequantizeMatrix * worldMatrix);
+        // Normals are not quantized, keep the dequantize scale out of the normal matrix
         DirectX::XMVECTOR det;
         DirectX::XMMATRIX worldInverse = DirectX::XMMatrixInverse(&det, worldMatrix);
         DirectX::XMMATRIX normalMatrix = DirectX::XMMatrixTranspose(worldInverse);
-        DirectX::XMStoreFloat3x4(&constants.normalMatrix, normalMatrix);
-        
+        DirectX::XMStoreFloat3x4(&transform.normalMatrix, normalMatrix);
+    }
+
+    ctx.cmdList->SetGraphicsRootShaderResourceView(4, ctx.instanceBufferGpuVirtualAddr + sizeof(instanceTransform) * ctx.bufferIndex * IApp::GetInstance()->c_maxInstances);
+
+    m_drawCalls = 0u;
+    for (UINT meshIndex = 0; meshIndex < static_cast<UINT>(meshes.size()); ++meshIndex)
+    {
+        Mesh& mesh = meshes[meshIndex];
+        if (not mesh.isResident)
+        {
+            continue;
+        }
+        const UINT firstGroup = m_firstGroup[meshIndex];
+        const UINT lodCount = static_cast<UINT>(mesh.lods.size());
+
+        bool anyVisible = false;
+        for (UINT lod = 0; lod < lodCount and not anyVisible; ++lod)
+        {
+            anyVisible = m_groupCounts[firstGroup + lod] > 0u;
+        }
+        if (not anyVisible)
+        {
+            continue;
+        }
+
+        const UINT slot = ctx.bufferIndex * IApp::GetInstance()->c_maxObjects + meshIndex;
+        auto meshConstantGpuAddrBase = ctx.meshConstantsGpuVirtualAddr + sizeof(PaddedMeshConstants) * slot;
+
+        meshConstants constants{};
         constants.baseColor = mesh.material.m_baseColor;
         constants.metallic = mesh.material.m_metallic;
         constants.roughness = mesh.material.m_roughness;
@@ -445,10 +1117,58 @@ void Model::Draw(DrawContext ctx)
 
         ctx.cmdList->IASetVertexBuffers(0, 1, &mesh.vertexBufferView);
         ctx.cmdList->IASetIndexBuffer(&mesh.indexBufferView);
-        ctx.cmdList->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0, 0);
+        for (UINT lodIndex = 0; lodIndex < lodCount; ++lodIndex)
+        {
+            const UINT instanceCount = m_groupCounts[firstGroup + lodIndex];
+            if (instanceCount == 0u)
+            {
+                continue;
+            }
+
+            ctx.cmdList->SetGraphicsRoot32BitConstant(3, m_groupOffsets[firstGroup + lodIndex], 0);
+
+            const FMeshLodRanges& lod = mesh.lods[lodIndex];
+            for (UINT i = lod.firstRange; i < lod.firstRange + lod.rangeCount; ++i)
+            {
+                const FDrawRange& range = mesh.drawRanges[i];
+                ctx.cmdList->DrawIndexedInstanced(range.indexCount, instanceCount, range.indexOffset, range.baseVertex, 0);
+                m_drawCalls++;
+            }
+        }
+    }
+}
+
+_Use_decl_annotations_
+FLOAT Model::ProjectedScale(const Mesh& mesh, DirectX::FXMMATRIX worldMatrix, DirectX::FXMVECTOR cameraPosition, FLOAT pixelsPerUnit) const
+{
+    // Errors and bounds are in object space, scale them by the largest world axis
+    const FLOAT worldScale = std::max({
+        DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[0])),
+        DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[1])),
+        DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[2])) });
+
+    const DirectX::XMVECTOR center = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&mesh.boundsCenter), worldMatrix);
+    const FLOAT centerDistance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(center, cameraPosition)));
+    const FLOAT distance = std::max(centerDistance - mesh.boundsRadius * worldScale, c_lodMinDistance);
+    return worldScale * pixelsPerUnit / distance;
+}
 
-        meshIndex++;
+_Use_decl_annotations_
+UINT Model::SelectLod(const Mesh& mesh, FLOAT projectedScale) const
+{
+    if (mesh.lods.size() <= 1)
+    {
+        return 0u;
     }
+
+    for (UINT lod = static_cast<UINT>(mesh.lods.size()) - 1u; lod > 0u; --lod)
+    {
+        if (mesh.lods[lod].error * projectedScale <= m_lodPixelError)
+        {
+            return lod;
+        }
+    }
+    return 0u;
 }
 
 void Model::RotateAdd(DirectX::XMFLOAT3 rotation)
@@ -467,8 +1187,6 @@ void Model::ResetUploadHeaps() {
 
     for (Mesh& mesh : meshes)
     {
-        mesh.uploadIndexBuffer.Reset();
-        mesh.uploadVertexBuffer.Reset();
         mesh.material.ResetUploadHeaps();
     }
     isOnCPU = false;
@@ -476,18 +1194,29 @@ void Model::ResetUploadHeaps() {
 
 void Model::UnloadGPU()
 {
-    if (not isOnGPU)
+    // An unfinished or failed load still holds whatever it got to, m_load goes away with it below
+    if (not isOnGPU and not m_load)
     {
         g_FError("GPU resource is already empty");
         return;
     }
+    WaitLoad();
 
     for(Mesh& mesh : meshes)
     {
-        mesh.defaultIndexBuffer.Reset();
-        mesh.defaultVertexBuffer.Reset();
-        mesh.material.UnloadGPU();
+        IApp::GetInstance()->GetGeometryPool().Free(mesh.indexAllocation);
+        IApp::GetInstance()->GetGeometryPool().Free(mesh.vertexAllocation);
+        // Created meshes hold their texture cache references before they are resident
+        mesh.material.ReleaseTextures();
+        mesh.isResident = false;
     }
 
+    // The meshes are of no use without their geometry, the next load starts from an empty model
+    IApp::GetInstance()->m_remainingMeshSlots += static_cast<INT>(meshes.size());
+    meshes.clear();
+    m_instances.clear();
+    m_nodeTransforms.Clear();
+    m_load.reset();
+
     isOnGPU = false;
 }
@@ -1,7 +1,20 @@
 #pragma once
 
+#include <future>
 #include <assimp/scene.h>
+#include <assimp/postprocess.h>
 #include "Material.h"
+#include "MeshData.h"
+#include "MeshSplit.h"
+#include "FrustumCull.h"
+#include "NodeTransform.h"
+
+struct FMeshLodRanges
+{
+    UINT firstRange;
+    UINT rangeCount;
+    FLOAT error;    // object space units
+};
 
 class Mesh
 {
@@ -10,21 +23,101 @@ public:
     std::string name;
 
     Material material;
-    ComPtr<ID3D12Resource> defaultVertexBuffer;
-    ComPtr<ID3D12Resource> defaultIndexBuffer;
-    ComPtr<ID3D12Resource> uploadVertexBuffer;
-    ComPtr<ID3D12Resource> uploadIndexBuffer;
+    // Ranges in the app's FGeometryPool, the buffer views point into them
+    FGeometryAllocation vertexAllocation;
+    FGeometryAllocation indexAllocation;
 
     D3D12_VERTEX_BUFFER_VIEW vertexBufferView{};
     D3D12_INDEX_BUFFER_VIEW indexBufferView{};
     UINT vertexCount{};
     UINT indexCount{};
+    // Sub ranges of the index buffer, more than one when the mesh was split for 16 bit indices
+    std::vector<FDrawRange> drawRanges;
+    // LOD 0 is the imported mesh, each level draws its own run of drawRanges
+    std::vector<FMeshLodRanges> lods;
+    // Finest LOD any instance was drawn with in the last Draw
+    UINT currentLod{};
+    // Object space bounds
+    DirectX::XMFLOAT3 boundsMin{};
+    DirectX::XMFLOAT3 boundsMax{};
+    DirectX::XMFLOAT3 boundsCenter{};
+    FLOAT boundsRadius{};
+    // Clusters over the uploaded vertex buffer, not drawn yet
+    FMeshletData meshletData;
+    // Nodes referencing this mesh
+    UINT instanceCount{};
+    // Set by the render thread once the copies are visible to its queue, Draw skips the mesh until then
+    bool isResident{};
 
+    // Packed positions are stored relative to the mesh AABB, Draw folds this back into the world matrix
+    DirectX::XMFLOAT3 positionScale{1.f, 1.f, 1.f};
+    DirectX::XMFLOAT3 positionOffset{};
+};
+
+// A node placing a shared Mesh, only the transform is per instance. The TRS is the node's global transform
+// decomposed, re-derived whenever the node transforms change.
+struct MeshInstance
+{
+    UINT meshIndex{};
+    UINT nodeIndex{};
     DirectX::XMFLOAT3 m_position{};
     DirectX::XMFLOAT4 m_rotationQ{};
     DirectX::XMFLOAT3 m_scale{};
 };
 
+struct FMeshWorkItem
+{
+    aiMesh* pAiMesh;
+    size_t meshIndex;
+};
+
+enum class FLoadStage : UINT {
+    FLoadStage_QUEUED = 0,
+    FLoadStage_PARSE = 1,
+    FLoadStage_CONVERT = 2,
+    FLoadStage_CREATE = 3,  // textures are decoded, then meshes are created on the workers and become resident one by one
+    FLoadStage_DONE = 4,
+    FLoadStage_FAILED = 5
+};
+
+// Progress of one model load, shared by the loading workers and the render thread
+struct FModelLoadState
+{
+    std::atomic<FLoadStage> stage{ FLoadStage::FLoadStage_QUEUED };
+    std::atomic<UINT> meshCount{};
+    std::atomic<UINT> meshesCreated{};
+    std::atomic<UINT> meshesResident{};
+    std::atomic<UINT> textureCount{};      // unique images the scene references
+    std::atomic<UINT> texturesLoaded{};
+    std::atomic<UINT> texturesCooked{};     // of the loaded ones, mapped from cache/textures without a decode
+    // Microseconds, summed over every thread taking part in the stage
+    std::atomic<uint64_t> parseTime{};
+    std::atomic<uint64_t> convertTime{};
+    std::atomic<uint64_t> textureTime{};
+    std::atomic<uint64_t> uploadTime{};
+    // Part of textureTime spent block compressing, and the texels of every level it covered
+    std::atomic<uint64_t> compressTime{};
+    std::atomic<uint64_t> compressedPixels{};
+    // Written before stage turns FAILED
+    std::string error;
+
+    // Created meshes waiting for Model::UpdateLoad
+    std::mutex readyMutex;
+    std::vector<UINT> readyMeshes;
+    std::future<void> task;
+
+    inline double GetCompressMegapixelsPerSecond() const {
+        const uint64_t time = compressTime.load();
+        return time == 0 ? 0.0 : static_cast<double>(compressedPixels.load()) / static_cast<double>(time);
+    }
+    inline FLOAT GetProgress() const {
+        const UINT count = meshCount.load() + textureCount.load();
+        return count == 0 ? 0.f : static_cast<FLOAT>(meshesResident.load() + texturesLoaded.load()) / static_cast<FLOAT>(count);
+    }
+    static const char* StageToString(FLoadStage stage);
+};
+using FModelLoadHandle = std::shared_ptr<FModelLoadState>;
+
 class Model
 {
 public:
@@ -35,15 +128,53 @@ public:
     DirectX::XMFLOAT3 m_position{};
     DirectX::XMFLOAT3 m_rotation{};
     DirectX::XMFLOAT3 m_scale{1.f, 1.f, 1.f};
+    // Set before Load, the pipeline drawing the model has to match
+    FVertexFormat m_vertexFormat{ FVertexFormat::FVertexFormat_FULL };
+    // Meshes above c_maxVertices16 vertices get split into 16 bit index ranges instead of keeping 32 bit indices
+    bool m_splitLargeMeshes{ true };
+    // Draw picks the coarsest LOD whose error projects to at most this many pixels
+    FLOAT m_lodPixelError{ 1.f };
+    // Decoded images waiting for upload while loading, bounds the memory of the parallel texture decode
+    UINT m_maxDecodedTextures{ 6 };
 
     void RotateAdd(DirectX::XMFLOAT3 rotation);
     void Draw(_In_ DrawContext ctx);
 
     bool Load(_In_ const std::filesystem::path& path, _In_ ID3D12GraphicsCommandList* cmdList);
+    // Imports on the worker pool and returns right away. UpdateLoad has to be called every frame to make the
+    // finished meshes resident, Draw shows whatever is resident so far. The model must not move meanwhile.
+    FModelLoadHandle LoadAsync(_In_ const std::filesystem::path& path);
+    void UpdateLoad(_In_ ID3D12CommandQueue* cmdQueue);
+    // After FTextureCache::UpdateStreaming, points the materials at the textures it replaced
+    void RefreshTextureViews();
+    // Blocks until the workers are done with the model, the meshes they finished stay pending
+    void WaitLoad();
+    inline const FModelLoadHandle& GetLoadState() const { return m_load; }
+    // Before the CREATE stage the workers still resize 'meshes' and 'm_instances', nothing may read them
+    inline bool AreMeshesPublished() const { return not m_load or m_load->stage >= FLoadStage::FLoadStage_CREATE; }
     void UploadGPU(_In_ ID3D12GraphicsCommandList* cmdList, _In_ ID3D12CommandQueue* cmdQueue);
     void UnloadGPU();
     void ResetUploadHeaps();
     inline const std::vector<Mesh>& GetMeshes() { return meshes; };
+    inline const std::vector<MeshInstance>& GetInstances() { return m_instances; };
+    // The scene's node hierarchy, what the instances are placed by. Published like 'meshes'.
+    inline const FNodeTransformCache& GetNodeTransforms() const { return m_nodeTransforms; }
+    // Moves a node and everything below it, the instances follow with the next Draw
+    void SetNodeTransform(_In_ uint32_t nodeIndex, _In_ const aiMatrix4x4& local);
+    // Result of the culling pass of the last Draw, counted in instances
+    inline UINT GetDrawnMeshCount() const { return m_drawnMeshes; }
+    inline UINT GetCulledMeshCount() const { return m_culledMeshes; }
+    inline UINT GetDrawCallCount() const { return m_drawCalls; }
+
+    static constexpr UINT c_importFlags =
+        aiProcess_Triangulate |
+        aiProcess_ConvertToLeftHanded |
+        aiProcess_GenSmoothNormals |
+        aiProcess_CalcTangentSpace |
+        aiProcess_JoinIdenticalVertices;
+    // ACMR loss allowed when reordering triangle clusters against overdraw, 0 keeps the vertex cache order
+    static constexpr float c_overdrawThreshold = 1.05f;
+    static constexpr FLodChainSettings c_lodSettings{};
 
     std::filesystem::path m_assetPath;
     bool isOnGPU{};
@@ -52,17 +183,43 @@ private:
     IWICImagingFactory2* m_wicFactory;
     ID3D12Device* m_device;
     std::vector<Mesh> meshes;
-    void ProcessNode(_In_ aiNode* node, _In_  const aiScene* scene, _In_ ID3D12GraphicsCommandList* cmdList);
-    void ProcessMesh(_In_ aiMesh* pAiMesh, _In_ const aiScene* scene, _In_ aiNode* node, _Out_ Mesh& outMesh);
-
-    inline aiMatrix4x4 GetGlobalNodeTransformation(aiNode* node) {
-        aiMatrix4x4 transform = node->mTransformation;
-        aiNode* parent = node->mParent;
-        while (parent) {
-            transform = parent->mTransformation * transform;
-            parent = parent->mParent;
-        }
-        return transform;
-    }
+    std::vector<MeshInstance> m_instances;
+    FNodeTransformCache m_nodeTransforms;
+    FModelLoadHandle m_load;
+
+    // Draw scratch, kept to avoid per frame allocations
+    std::vector<DirectX::XMFLOAT4X4> m_worldMatrices;
+    std::vector<uint8_t> m_meshVisible;
+    FCullBoxes m_cullBoxes;
+    // Visible instances are bucketed by (mesh, LOD), one instanced draw per bucket
+    std::vector<UINT> m_instanceLods;
+    std::vector<UINT> m_firstGroup;     // per mesh, its LOD 0 bucket
+    std::vector<UINT> m_groupOffsets;   // per bucket, first instanceTransform of the frame
+    std::vector<UINT> m_groupCounts;
+    std::vector<UINT> m_groupCursors;
+    std::vector<FLOAT> m_meshScreenSizes;  // per mesh, bounding sphere diameter in pixels of its closest visible instance
+    UINT m_drawnMeshes{};
+    UINT m_culledMeshes{};
+    UINT m_drawCalls{};
+    void RunLoad(_Inout_ FModelLoadState& state);
+    // Resolves the changed node globals and re-derives the TRS of every instance from them
+    void UpdateNodeTransforms();
+    // Fills the instance TRS, false for a matrix without one (e.g. zero scale)
+    static bool DecomposeTransform(_In_ const aiMatrix4x4& transform, _Inout_ MeshInstance& outInstance);
+    void MakeResident(_Inout_ Mesh& mesh);
+    // Per mesh, the textures its material samples: its sources, with separate AO / roughness / metalness maps packed when they fit
+    void PlanTextures(_In_ const std::vector<FMeshData>& meshData, _Out_ std::vector<std::vector<FTextureRequest>>& outRequests);
+    // Decodes every image the meshes reference on the worker pool into the texture cache, the slots hold them until released
+    void PrefetchTextures(_In_ const std::vector<FMeshData>& meshData, _In_ const std::vector<std::vector<FTextureRequest>>& requests,
+        _Inout_ FModelLoadState& state, _Out_ std::vector<UINT>& outSlots);
+    void CollectMeshes(_In_ const aiScene* scene, _In_ const FNodeTransformCache& nodes, _Inout_ std::vector<FMeshWorkItem>& outItems, _Inout_ std::vector<FMeshInstanceData>& outInstances);
+    void ImportMesh(_In_ aiMesh* pAiMesh, _In_ const aiScene* scene, _Out_ FMeshData& outData);
+    void CreateMesh(_In_ const FMeshData& data, _In_ const std::vector<FTextureRequest>& textures, _Out_ Mesh& outMesh);
+    // Pixels one object space unit of the mesh covers at the point of its bounds closest to the camera
+    FLOAT ProjectedScale(_In_ const Mesh& mesh, _In_ DirectX::FXMMATRIX worldMatrix, _In_ DirectX::FXMVECTOR cameraPosition, _In_ FLOAT pixelsPerUnit) const;
+    UINT SelectLod(_In_ const Mesh& mesh, _In_ FLOAT projectedScale) const;
+
+    // Inside the bounding sphere, keeps the projected error finite
+    static constexpr FLOAT c_lodMinDistance = .01f;
 };
 
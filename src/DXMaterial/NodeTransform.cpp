@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include <stdexcept>
+
+#include "NodeTransform.h"
+
+_Use_decl_annotations_
+void FNodeTransformCache::Build(const aiNode* root)
+{
+    if (not root)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    Clear();
+
+    // Explicit stack, deep CAD hierarchies would otherwise recurse thousands of levels
+    std::vector<std::pair<const aiNode*, uint32_t>> stack;
+    stack.emplace_back(root, c_invalidIndex);
+
+    while (not stack.empty())
+    {
+        const auto [node, parent] = stack.back();
+        stack.pop_back();
+
+        const uint32_t index = Append(node, parent, node->mTransformation, node->mName.C_Str());
+
+        // Reversed so children pop in their scene order
+        for (UINT i = node->mNumChildren; i > 0; --i)
+        {
+            stack.emplace_back(node->mChildren[i - 1], index);
+        }
+    }
+}
+
+_Use_decl_annotations_
+uint32_t FNodeTransformCache::AddNode(uint32_t parent, const aiMatrix4x4& local, std::string name)
+{
+    if (parent != c_invalidIndex and parent >= m_nodes.size())
+    {
+        throw std::out_of_range("Parent node index out of range");
+    }
+    return Append(nullptr, parent, local, std::move(name));
+}
+
+uint32_t FNodeTransformCache::Append(const aiNode* node, uint32_t parent, const aiMatrix4x4& local, std::string name)
+{
+    const uint32_t index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(node);
+    m_names.push_back(std::move(name));
+    m_parents.push_back(parent);
+    m_locals.push_back(local);
+    m_globals.push_back(parent == c_invalidIndex ? local : m_globals[parent] * local);
+    m_dirty.push_back(0u);
+    return index;
+}
+
+void FNodeTransformCache::ReleaseScene()
+{
+    std::fill(m_nodes.begin(), m_nodes.end(), nullptr);
+}
+
+void FNodeTransformCache::Clear()
+{
+    m_nodes.clear();
+    m_names.clear();
+    m_parents.clear();
+    m_locals.clear();
+    m_globals.clear();
+    m_dirty.clear();
+    m_anyDirty = false;
+}
+
+_Use_decl_annotations_
+void FNodeTransformCache::SetLocalTransform(size_t index, const aiMatrix4x4& local)
+{
+    if (index >= m_locals.size())
+    {
+        throw std::out_of_range("Node index out of range");
+    }
+    m_locals[index] = local;
+    m_dirty[index] = 1u;
+    m_anyDirty = true;
+}
+
+void FNodeTransformCache::Update()
+{
+    if (not m_anyDirty)
+    {
+        return;
+    }
+
+    // Parents come first, so a dirty parent has already been resolved when its children are reached
+    for (size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        const uint32_t parent = m_parents[i];
+        if (parent != c_invalidIndex and m_dirty[parent])
+        {
+            m_dirty[i] = 1u;
+        }
+        if (m_dirty[i])
+        {
+            m_globals[i] = parent == c_invalidIndex ? m_locals[i] : m_globals[parent] * m_locals[i];
+        }
+    }
+
+    std::fill(m_dirty.begin(), m_dirty.end(), uint8_t{ 0u });
+    m_anyDirty = false;
+}
+
+_Use_decl_annotations_
+uint32_t FNodeTransformCache::Find(const char* name) const
+{
+    for (size_t i = 0; i < m_names.size(); ++i)
+    {
+        if (m_names[i] == name)
+        {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    return c_invalidIndex;
+}
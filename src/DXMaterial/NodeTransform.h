@@ -0,0 +1,48 @@
+#pragma once
+
+#include <assimp/scene.h>
+
+// Flattened node hierarchy with every node's global transform computed once, top down.
+// Nodes are stored parent first in the same preorder a recursive walk from the root visits them,
+// so a single forward pass over the arrays resolves all globals.
+class FNodeTransformCache
+{
+public:
+    // Parent of the root and result of a failed Find
+    static constexpr uint32_t c_invalidIndex = UINT32_MAX;
+
+    void Build(_In_ const aiNode* root);
+    // Appends a node without a scene behind it, e.g. from the mesh cache. Parents have to be added before their children.
+    uint32_t AddNode(_In_ uint32_t parent, _In_ const aiMatrix4x4& local, _In_ std::string name);
+    // Forgets the aiNode pointers before their scene is freed, the transforms stay usable
+    void ReleaseScene();
+    void Clear();
+
+    // Marks the node and its subtree for the next Update, e.g. when an animation moves it
+    void SetLocalTransform(_In_ size_t index, _In_ const aiMatrix4x4& local);
+    // Recomputes the globals of the nodes touched since the last Build / Update
+    void Update();
+    inline bool IsDirty() const { return m_anyDirty; }
+
+    inline size_t Size() const { return m_nodes.size(); }
+    // nullptr for nodes of AddNode and after ReleaseScene
+    inline const aiNode* GetNode(size_t index) const { return m_nodes[index]; }
+    inline const std::string& GetName(size_t index) const { return m_names[index]; }
+    inline uint32_t GetParent(size_t index) const { return m_parents[index]; }
+    inline const aiMatrix4x4& GetLocalTransform(size_t index) const { return m_locals[index]; }
+    inline const aiMatrix4x4& GetGlobalTransform(size_t index) const { return m_globals[index]; }
+    // Index of the first node with that name, c_invalidIndex when there is none
+    uint32_t Find(_In_ const char* name) const;
+
+private:
+    uint32_t Append(const aiNode* node, uint32_t parent, const aiMatrix4x4& local, std::string name);
+
+    // Only valid while the scene the cache was built from is alive
+    std::vector<const aiNode*> m_nodes;
+    std::vector<std::string> m_names;
+    std::vector<uint32_t> m_parents;
+    std::vector<aiMatrix4x4> m_locals;
+    std::vector<aiMatrix4x4> m_globals;
+    std::vector<uint8_t> m_dirty;
+    bool m_anyDirty{};
+};
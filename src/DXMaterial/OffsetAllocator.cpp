@@ -0,0 +1,294 @@
+#include "OffsetAllocator.h"
+
+#include <bit>
+
+namespace
+{
+    constexpr uint32_t c_mantissaBits = 3;
+    constexpr uint32_t c_mantissaValue = 1u << c_mantissaBits;
+    constexpr uint32_t c_mantissaMask = c_mantissaValue - 1u;
+
+    // Sizes are binned as tiny floats: 5 bit exponent, 3 bit mantissa, denormals below 8.
+    // A block is filed under the class its size rounds down to, a request searches from the class it
+    // rounds up to, so any block found is large enough without looking at its actual size.
+    uint32_t SizeToBinRoundUp(uint32_t size)
+    {
+        if (size < c_mantissaValue)
+        {
+            return size;
+        }
+
+        const uint32_t highestBit = 31u - static_cast<uint32_t>(std::countl_zero(size));
+        const uint32_t mantissaStart = highestBit - c_mantissaBits;
+        const uint32_t exponent = mantissaStart + 1u;
+        uint32_t mantissa = (size >> mantissaStart) & c_mantissaMask;
+
+        // A mantissa carry moves into the exponent, which is the next class up
+        if (size & ((1u << mantissaStart) - 1u))
+        {
+            mantissa++;
+        }
+        return (exponent << c_mantissaBits) + mantissa;
+    }
+
+    uint32_t SizeToBinRoundDown(uint32_t size)
+    {
+        if (size < c_mantissaValue)
+        {
+            return size;
+        }
+
+        const uint32_t highestBit = 31u - static_cast<uint32_t>(std::countl_zero(size));
+        const uint32_t mantissaStart = highestBit - c_mantissaBits;
+        const uint32_t exponent = mantissaStart + 1u;
+        const uint32_t mantissa = (size >> mantissaStart) & c_mantissaMask;
+        return (exponent << c_mantissaBits) | mantissa;
+    }
+
+    uint32_t LowestSetBitAfter(uint32_t mask, uint32_t startBit)
+    {
+        if (startBit >= 32u)
+        {
+            return FOffsetAllocation::c_noSpace;
+        }
+        const uint32_t masked = mask & ~((1u << startBit) - 1u);
+        return masked ? static_cast<uint32_t>(std::countr_zero(masked)) : FOffsetAllocation::c_noSpace;
+    }
+}
+
+FOffsetAllocator::FOffsetAllocator(uint32_t size, uint32_t maxAllocations)
+{
+    Reset(size, maxAllocations);
+}
+
+void FOffsetAllocator::Reset(uint32_t size, uint32_t maxAllocations)
+{
+    // Nothing to hand out, skip the node storage (e.g. a default constructed member reset later)
+    if (size == 0) maxAllocations = 0;
+
+    m_size = size;
+    m_freeStorage = 0;
+    m_usedBinsTop = 0;
+    for (uint8_t& bins : m_usedBins) bins = 0;
+    for (uint32_t& index : m_binIndices) index = c_unused;
+
+    m_nodes.assign(maxAllocations, FNode{});
+    m_freeNodes.resize(maxAllocations);
+    // Popped from the back, so node 0 goes out first
+    for (uint32_t i = 0; i < maxAllocations; ++i)
+    {
+        m_freeNodes[i] = maxAllocations - i - 1u;
+    }
+
+    if (maxAllocations > 0)
+    {
+        InsertNodeIntoBin(size, 0u);
+    }
+}
+
+FOffsetAllocation FOffsetAllocator::Allocate(uint32_t size)
+{
+    if (size == 0)
+    {
+        return {};
+    }
+
+    const uint32_t minBin = SizeToBinRoundUp(size);
+    const uint32_t minTop = minBin >> c_mantissaBits;
+    const uint32_t minLeaf = minBin & c_mantissaMask;
+
+    uint32_t top = minTop;
+    uint32_t leaf = FOffsetAllocation::c_noSpace;
+    if (top < c_topBins and m_usedBinsTop & (1u << top))
+    {
+        leaf = LowestSetBitAfter(m_usedBins[top], minLeaf);
+    }
+    if (leaf == FOffsetAllocation::c_noSpace)
+    {
+        top = LowestSetBitAfter(m_usedBinsTop, minTop + 1u);
+        if (top == FOffsetAllocation::c_noSpace)
+        {
+            return {};
+        }
+        // Any class of a larger top bin fits
+        leaf = static_cast<uint32_t>(std::countr_zero(static_cast<uint32_t>(m_usedBins[top])));
+    }
+
+    const uint32_t bin = (top << c_mantissaBits) | leaf;
+    const uint32_t nodeIndex = m_binIndices[bin];
+    FNode& node = m_nodes[nodeIndex];
+    const uint32_t nodeTotalSize = node.dataSize;
+
+    // A split needs a spare node for the remainder, an exact fit reuses the block's own
+    const uint32_t remainder = nodeTotalSize - size;
+    if (remainder > 0 and m_freeNodes.empty())
+    {
+        return {};
+    }
+
+    // Pop the head of the class list
+    m_binIndices[bin] = node.binListNext;
+    if (node.binListNext != c_unused) m_nodes[node.binListNext].binListPrev = c_unused;
+    if (m_binIndices[bin] == c_unused)
+    {
+        m_usedBins[top] &= static_cast<uint8_t>(~(1u << leaf));
+        if (m_usedBins[top] == 0) m_usedBinsTop &= ~(1u << top);
+    }
+    m_freeStorage -= nodeTotalSize;
+
+    node.dataSize = size;
+    node.used = true;
+    node.binListPrev = c_unused;
+    node.binListNext = c_unused;
+
+    if (remainder > 0)
+    {
+        const uint32_t remainderIndex = InsertNodeIntoBin(remainder, node.dataOffset + size);
+
+        // m_nodes never grows, 'node' is still valid here
+        FNode& remainderNode = m_nodes[remainderIndex];
+        if (node.neighborNext != c_unused) m_nodes[node.neighborNext].neighborPrev = remainderIndex;
+        remainderNode.neighborPrev = nodeIndex;
+        remainderNode.neighborNext = node.neighborNext;
+        node.neighborNext = remainderIndex;
+    }
+
+    return { node.dataOffset, nodeIndex };
+}
+
+void FOffsetAllocator::Free(FOffsetAllocation allocation)
+{
+    if (allocation.metadata == FOffsetAllocation::c_noSpace)
+    {
+        return;
+    }
+
+    const uint32_t nodeIndex = allocation.metadata;
+    FNode& node = m_nodes[nodeIndex];
+
+    uint32_t offset = node.dataOffset;
+    uint32_t size = node.dataSize;
+
+    if (node.neighborPrev != c_unused and not m_nodes[node.neighborPrev].used)
+    {
+        const FNode& prev = m_nodes[node.neighborPrev];
+        offset = prev.dataOffset;
+        size += prev.dataSize;
+
+        const uint32_t prevIndex = node.neighborPrev;
+        node.neighborPrev = prev.neighborPrev;
+        RemoveNodeFromBin(prevIndex);
+    }
+    if (node.neighborNext != c_unused and not m_nodes[node.neighborNext].used)
+    {
+        const FNode& next = m_nodes[node.neighborNext];
+        size += next.dataSize;
+
+        const uint32_t nextIndex = node.neighborNext;
+        node.neighborNext = next.neighborNext;
+        RemoveNodeFromBin(nextIndex);
+    }
+
+    const uint32_t neighborPrev = node.neighborPrev;
+    const uint32_t neighborNext = node.neighborNext;
+
+    // The merged block gets a fresh node, the allocation's node goes back to the pool first so it can be reused
+    node = FNode{};
+    m_freeNodes.push_back(nodeIndex);
+
+    const uint32_t combinedIndex = InsertNodeIntoBin(size, offset);
+    if (neighborNext != c_unused)
+    {
+        m_nodes[combinedIndex].neighborNext = neighborNext;
+        m_nodes[neighborNext].neighborPrev = combinedIndex;
+    }
+    if (neighborPrev != c_unused)
+    {
+        m_nodes[combinedIndex].neighborPrev = neighborPrev;
+        m_nodes[neighborPrev].neighborNext = combinedIndex;
+    }
+}
+
+uint32_t FOffsetAllocator::GetAllocationSize(FOffsetAllocation allocation) const
+{
+    if (allocation.metadata == FOffsetAllocation::c_noSpace)
+    {
+        return 0;
+    }
+    return m_nodes[allocation.metadata].dataSize;
+}
+
+FOffsetAllocatorReport FOffsetAllocator::GetReport() const
+{
+    FOffsetAllocatorReport report{};
+    report.totalFree = m_freeStorage;
+
+    for (uint32_t bin = 0; bin < c_leafBins; ++bin)
+    {
+        for (uint32_t index = m_binIndices[bin]; index != c_unused; index = m_nodes[index].binListNext)
+        {
+            report.freeBlocks++;
+            if (m_nodes[index].dataSize > report.largestFree) report.largestFree = m_nodes[index].dataSize;
+        }
+    }
+    report.usedBlocks = static_cast<uint32_t>(m_nodes.size() - m_freeNodes.size()) - report.freeBlocks;
+    return report;
+}
+
+uint32_t FOffsetAllocator::InsertNodeIntoBin(uint32_t size, uint32_t dataOffset)
+{
+    const uint32_t bin = SizeToBinRoundDown(size);
+    const uint32_t top = bin >> c_mantissaBits;
+    const uint32_t leaf = bin & c_mantissaMask;
+
+    if (m_binIndices[bin] == c_unused)
+    {
+        m_usedBins[top] |= static_cast<uint8_t>(1u << leaf);
+        m_usedBinsTop |= 1u << top;
+    }
+
+    const uint32_t headIndex = m_binIndices[bin];
+    const uint32_t nodeIndex = m_freeNodes.back();
+    m_freeNodes.pop_back();
+
+    FNode& node = m_nodes[nodeIndex];
+    node = FNode{};
+    node.dataOffset = dataOffset;
+    node.dataSize = size;
+    node.binListNext = headIndex;
+    if (headIndex != c_unused) m_nodes[headIndex].binListPrev = nodeIndex;
+    m_binIndices[bin] = nodeIndex;
+
+    m_freeStorage += size;
+    return nodeIndex;
+}
+
+void FOffsetAllocator::RemoveNodeFromBin(uint32_t nodeIndex)
+{
+    FNode& node = m_nodes[nodeIndex];
+
+    if (node.binListPrev != c_unused)
+    {
+        m_nodes[node.binListPrev].binListNext = node.binListNext;
+        if (node.binListNext != c_unused) m_nodes[node.binListNext].binListPrev = node.binListPrev;
+    }
+    else
+    {
+        // Head of its class list
+        const uint32_t bin = SizeToBinRoundDown(node.dataSize);
+        const uint32_t top = bin >> c_mantissaBits;
+        const uint32_t leaf = bin & c_mantissaMask;
+
+        m_binIndices[bin] = node.binListNext;
+        if (node.binListNext != c_unused) m_nodes[node.binListNext].binListPrev = c_unused;
+        if (m_binIndices[bin] == c_unused)
+        {
+            m_usedBins[top] &= static_cast<uint8_t>(~(1u << leaf));
+            if (m_usedBins[top] == 0) m_usedBinsTop &= ~(1u << top);
+        }
+    }
+
+    m_freeStorage -= node.dataSize;
+    node = FNode{};
+    m_freeNodes.push_back(nodeIndex);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Result of FOffsetAllocator::Allocate, 'metadata' is the allocator's node and has to be handed back to Free
+struct FOffsetAllocation
+{
+    static constexpr uint32_t c_noSpace = UINT32_MAX;
+
+    uint32_t offset{ c_noSpace };
+    uint32_t metadata{ c_noSpace };
+
+    inline bool IsValid() const { return offset != c_noSpace; }
+};
+
+struct FOffsetAllocatorReport
+{
+    uint32_t totalFree;
+    uint32_t largestFree;
+    uint32_t freeBlocks;
+    uint32_t usedBlocks;
+};
+
+// Two level segregated fit allocator over a range of abstract units. It only hands out offsets, the caller
+// decides what a unit is (bytes, 16 byte blocks, descriptors) and owns the memory behind them.
+// Free blocks sit in 256 size classes (8 linear steps per power of two) found through two bitmasks, so
+// Allocate and Free are O(1). Free merges the block with free neighbours right away.
+class FOffsetAllocator
+{
+public:
+    static constexpr uint32_t c_topBins = 32;
+    static constexpr uint32_t c_binsPerLeaf = 8;
+    static constexpr uint32_t c_leafBins = c_topBins * c_binsPerLeaf;
+
+    explicit FOffsetAllocator(uint32_t size = 0, uint32_t maxAllocations = 128 * 1024);
+
+    // Drops every allocation, the whole range becomes one free block
+    void Reset(uint32_t size, uint32_t maxAllocations);
+
+    // Fails (IsValid() == false) when no free block fits, or when the block has to be split and all
+    // maxAllocations nodes (used and free blocks alike) are taken. An exact fit needs no extra node.
+    FOffsetAllocation Allocate(uint32_t size);
+    void Free(FOffsetAllocation allocation);
+
+    uint32_t GetAllocationSize(FOffsetAllocation allocation) const;
+    inline uint32_t GetSize() const { return m_size; }
+    inline uint32_t GetFreeStorage() const { return m_freeStorage; }
+    FOffsetAllocatorReport GetReport() const;
+
+private:
+    static constexpr uint32_t c_unused = UINT32_MAX;
+
+    struct FNode
+    {
+        uint32_t dataOffset{};
+        uint32_t dataSize{};
+        uint32_t binListPrev{ c_unused };
+        uint32_t binListNext{ c_unused };
+        uint32_t neighborPrev{ c_unused };
+        uint32_t neighborNext{ c_unused };
+        bool used{};
+    };
+
+    uint32_t InsertNodeIntoBin(uint32_t size, uint32_t dataOffset);
+    void RemoveNodeFromBin(uint32_t nodeIndex);
+
+    uint32_t m_size{};
+    uint32_t m_freeStorage{};
+    uint32_t m_usedBinsTop{};
+    uint8_t m_usedBins[c_topBins]{};
+    uint32_t m_binIndices[c_leafBins]{};
+
+    std::vector<FNode> m_nodes;
+    std::vector<uint32_t> m_freeNodes;
+};
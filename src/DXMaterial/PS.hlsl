@@ -23,20 +23,18 @@ struct FrameConstants
 
 struct MeshConstants
 {
-    float4x4 worldMatrix; // Local -> world transform.
-    float3x3 normalMatrix; // Inverse-transpose of worldMatrix (for normals/TBN; ADD THIS IN C++).
     float4 baseColor; // Albedo tint.
     float metallic; // Metallic factor.
     float roughness; // Roughness factor.
     float opacity; // Opacity.
     uint textureFlags; // Bitfield for textures.
-    // Note: Update sizeof(meshConstants) in C++ to ~144 bytes (add 12 for float3x3).
 };
 
 ConstantBuffer<FrameConstants> frameCB : register(b0); // Per-frame constants.
 ConstantBuffer<MeshConstants> meshCB : register(b1); // Per-mesh constants.
 
 Texture2D textures[28] : register(t0); // Texture array: slot = FTextureType enum value.
+// One and two channel maps (R8 / RG8 / BC4 / BC5) are swizzled by their SRV, gray reads the same from .r, .g and .b.
 SamplerState texSampler : register(s0); // Linear sampler for textures.
 
 // Texture flag constants (match FTextureType enum bits).
@@ -0,0 +1,399 @@
+#include "Simplify.h"
+#include "MeshOptimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    // Symmetric 4x4 plane quadric, 'weight' is the accumulated triangle area
+    struct FQuadric
+    {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+        double weight;
+
+        void AddPlane(double a, double b, double c, double d, double w)
+        {
+            a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+            b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+            c2 += w * c * c; cd += w * c * d;
+            d2 += w * d * d;
+            weight += w;
+        }
+
+        void Add(const FQuadric& other)
+        {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+            weight += other.weight;
+        }
+
+        // Area weighted mean squared distance of p to the accumulated planes
+        double Error(const float p[3]) const
+        {
+            const double x = p[0], y = p[1], z = p[2];
+            const double e =
+                a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+                b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+                c2 * z * z + 2.0 * cd * z +
+                d2;
+            return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct FCollapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float cost;
+        float positionError;
+    };
+
+    inline void Cross(const float a[3], const float b[3], float out[3])
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    inline void TriangleNormal(const float* p0, const float* p1, const float* p2, float out[3])
+    {
+        const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        Cross(e0, e1, out);
+    }
+
+    inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+    {
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    struct FPositionKey
+    {
+        uint32_t bits[3];
+        bool operator==(const FPositionKey& other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+
+    struct FPositionKeyHash
+    {
+        size_t operator()(const FPositionKey& key) const
+        {
+            return (static_cast<size_t>(key.bits[0]) * 73856093u) ^ (static_cast<size_t>(key.bits[1]) * 19349663u) ^ (static_cast<size_t>(key.bits[2]) * 83492791u);
+        }
+    };
+}
+
+size_t SimplifyMesh(const uint32_t* indices, size_t indexCount, const FVertexF32* vertices, size_t vertexCount,
+    size_t targetIndexCount, const FSimplifyOptions& options, uint32_t* outIndices, float* outError)
+{
+    indexCount -= indexCount % 3;
+    std::vector<uint32_t> current(indices, indices + indexCount);
+    if (outError)
+    {
+        *outError = 0.f;
+    }
+    if (indexCount <= targetIndexCount or vertexCount == 0)
+    {
+        std::copy(current.begin(), current.end(), outIndices);
+        return current.size();
+    }
+
+    // Work relative to the mesh extent so the error limit and attribute weights are scale free
+    float minimum[3] = { vertices[0].position[0], vertices[0].position[1], vertices[0].position[2] };
+    float maximum[3] = { minimum[0], minimum[1], minimum[2] };
+    for (size_t v = 1; v < vertexCount; ++v)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minimum[axis] = std::min(minimum[axis], vertices[v].position[axis]);
+            maximum[axis] = std::max(maximum[axis], vertices[v].position[axis]);
+        }
+    }
+    const float extent = std::max({ maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2], 1e-20f });
+
+    std::vector<float> positions(vertexCount * 3);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            positions[v * 3 + axis] = (vertices[v].position[axis] - minimum[axis]) / extent;
+        }
+    }
+
+    // Vertices sharing a position are split by an attribute seam, treat them as one point for the topology
+    std::vector<uint32_t> positionId(vertexCount);
+    std::vector<uint32_t> positionUses;
+    {
+        std::unordered_map<FPositionKey, uint32_t, FPositionKeyHash> ids;
+        ids.reserve(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            FPositionKey key;
+            memcpy(key.bits, vertices[v].position, sizeof(key.bits));
+            const auto [it, inserted] = ids.try_emplace(key, static_cast<uint32_t>(positionUses.size()));
+            if (inserted)
+            {
+                positionUses.push_back(0u);
+            }
+            positionId[v] = it->second;
+            ++positionUses[it->second];
+        }
+    }
+
+    std::vector<uint8_t> locked(vertexCount, 0u);
+    {
+        std::unordered_set<uint64_t> edges;
+        edges.reserve(indexCount);
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            for (size_t e = 0; e < 3; ++e)
+            {
+                edges.insert(EdgeKey(positionId[current[i + e]], positionId[current[i + (e + 1) % 3]]));
+            }
+        }
+
+        std::vector<uint8_t> lockedPosition(positionUses.size(), 0u);
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            for (size_t e = 0; e < 3; ++e)
+            {
+                const uint32_t a = positionId[current[i + e]];
+                const uint32_t b = positionId[current[i + (e + 1) % 3]];
+                if (not edges.contains(EdgeKey(b, a)))
+                {
+                    lockedPosition[a] = 1u;
+                    lockedPosition[b] = 1u;
+                }
+            }
+        }
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            locked[v] = lockedPosition[positionId[v]] or positionUses[positionId[v]] > 1u;
+        }
+    }
+
+    std::vector<FQuadric> quadrics(vertexCount, FQuadric{});
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const float* p0 = &positions[current[i + 0] * 3u];
+        const float* p1 = &positions[current[i + 1] * 3u];
+        const float* p2 = &positions[current[i + 2] * 3u];
+        float n[3];
+        TriangleNormal(p0, p1, p2, n);
+        const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length <= 0.f)
+        {
+            continue;
+        }
+        const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+        const double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        const double area = length * 0.5;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            quadrics[current[i + corner]].AddPlane(a, b, c, d, area);
+        }
+    }
+
+    const float maxCost = options.maxError * options.maxError;
+    float maxPositionError = 0.f;
+
+    std::vector<FCollapse> candidates;
+    std::vector<uint32_t> collapseTo(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+
+    while (current.size() > targetIndexCount)
+    {
+        const size_t triangleCount = current.size() / 3;
+
+        candidates.clear();
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            for (size_t e = 0; e < 3; ++e)
+            {
+                const uint32_t a = current[i + e];
+                const uint32_t b = current[i + (e + 1) % 3];
+                for (int direction = 0; direction < 2; ++direction)
+                {
+                    const uint32_t from = direction ? b : a;
+                    const uint32_t to = direction ? a : b;
+                    if (locked[from])
+                    {
+                        continue;
+                    }
+
+                    const FVertexF32& vf = vertices[from];
+                    const FVertexF32& vt = vertices[to];
+                    const float positionError = static_cast<float>(quadrics[from].Error(&positions[to * 3u]));
+                    const float normalDot = vf.normal[0] * vt.normal[0] + vf.normal[1] * vt.normal[1] + vf.normal[2] * vt.normal[2];
+                    const float du = vf.texCoord[0] - vt.texCoord[0];
+                    const float dv = vf.texCoord[1] - vt.texCoord[1];
+                    const float cost = positionError + options.normalWeight * (1.f - normalDot) + options.texCoordWeight * (du * du + dv * dv);
+                    if (cost <= maxCost)
+                    {
+                        candidates.push_back({ from, to, cost, positionError });
+                    }
+                }
+            }
+        }
+        if (candidates.empty())
+        {
+            break;
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const FCollapse& l, const FCollapse& r) {
+            if (l.cost != r.cost) return l.cost < r.cost;
+            if (l.from != r.from) return l.from < r.from;
+            return l.to < r.to;
+        });
+
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0u);
+        for (uint32_t v : current)
+        {
+            ++adjacencyOffset[v + 1];
+        }
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        adjacency.resize(current.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i = 0; i < current.size(); ++i)
+            {
+                adjacency[fill[current[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            collapseTo[v] = static_cast<uint32_t>(v);
+        }
+        std::fill(touched.begin(), touched.end(), uint8_t{ 0u });
+
+        // Each collapse removes about two triangles, leave the rest for the next pass so costs stay fresh
+        const size_t collapseBudget = std::max<size_t>((triangleCount - targetIndexCount / 3) / 2, 1);
+        size_t collapses = 0;
+
+        for (const FCollapse& candidate : candidates)
+        {
+            if (collapses >= collapseBudget)
+            {
+                break;
+            }
+            if (touched[candidate.from] or touched[candidate.to])
+            {
+                continue;
+            }
+
+            // Reject collapses that would fold a triangle over
+            bool flips = false;
+            const float* target = &positions[candidate.to * 3u];
+            for (uint32_t k = adjacencyOffset[candidate.from]; k < adjacencyOffset[candidate.from + 1] and not flips; ++k)
+            {
+                const uint32_t* tri = &current[adjacency[k] * 3u];
+                if (tri[0] == candidate.to or tri[1] == candidate.to or tri[2] == candidate.to)
+                {
+                    continue;
+                }
+
+                const float* before[3];
+                const float* after[3];
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    before[corner] = &positions[tri[corner] * 3u];
+                    after[corner] = tri[corner] == candidate.from ? target : before[corner];
+                }
+                float n0[3], n1[3];
+                TriangleNormal(before[0], before[1], before[2], n0);
+                TriangleNormal(after[0], after[1], after[2], n1);
+                flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.f;
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            collapseTo[candidate.from] = candidate.to;
+            quadrics[candidate.to].Add(quadrics[candidate.from]);
+            maxPositionError = std::max(maxPositionError, candidate.positionError);
+
+            // The one ring changed shape, its flip checks are stale until the next pass
+            for (uint32_t k = adjacencyOffset[candidate.from]; k < adjacencyOffset[candidate.from + 1]; ++k)
+            {
+                const uint32_t* tri = &current[adjacency[k] * 3u];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1u;
+            }
+            touched[candidate.to] = 1u;
+            ++collapses;
+        }
+        if (collapses == 0)
+        {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            const uint32_t a = collapseTo[current[i + 0]];
+            const uint32_t b = collapseTo[current[i + 1]];
+            const uint32_t c = collapseTo[current[i + 2]];
+            if (a != b and b != c and a != c)
+            {
+                current[write++] = a;
+                current[write++] = b;
+                current[write++] = c;
+            }
+        }
+        current.resize(write);
+    }
+
+    std::copy(current.begin(), current.end(), outIndices);
+    if (outError)
+    {
+        *outError = std::sqrt(maxPositionError) * extent;
+    }
+    return current.size();
+}
+
+void BuildLodChain(std::vector<uint32_t>& indices, const FVertexF32* vertices, size_t vertexCount,
+    const FLodChainSettings& settings, std::vector<FMeshLod>& outLods)
+{
+    const size_t sourceCount = indices.size() - indices.size() % 3;
+    outLods.clear();
+    outLods.push_back({ 0u, static_cast<uint32_t>(sourceCount), 0.f, 0u });
+
+    // Every level starts from the source so errors do not compound
+    const std::vector<uint32_t> source(indices.begin(), indices.begin() + static_cast<ptrdiff_t>(sourceCount));
+    std::vector<uint32_t> simplified(sourceCount);
+
+    float ratio = 1.f;
+    for (size_t level = 1; level < settings.maxLods; ++level)
+    {
+        ratio *= settings.reduction;
+        const size_t target = static_cast<size_t>(static_cast<float>(sourceCount / 3) * ratio) * 3;
+        if (target < 3)
+        {
+            break;
+        }
+
+        float error = 0.f;
+        const size_t count = SimplifyMesh(source.data(), sourceCount, vertices, vertexCount, target, settings.simplify, simplified.data(), &error);
+
+        const FMeshLod& previous = outLods.back();
+        if (count == 0 or static_cast<float>(count) > static_cast<float>(previous.indexCount) * 0.9f)
+        {
+            break;
+        }
+
+        OptimizeVertexCache(simplified.data(), count, vertexCount);
+
+        outLods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(count), std::max(error, previous.error), 0u });
+        indices.insert(indices.end(), simplified.begin(), simplified.begin() + static_cast<ptrdiff_t>(count));
+    }
+}
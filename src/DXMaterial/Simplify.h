@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include "VertexConvert.h"
+
+// One level of detail inside a shared index buffer, error is in object space units
+struct FMeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;
+    uint32_t PADDING_1;
+};
+
+struct FSimplifyOptions
+{
+    // Penalties added to the squared position error, which is measured relative to the mesh extent
+    float normalWeight{ 0.01f };    // per unit of (1 - cos) between the collapsed vertex normals
+    float texCoordWeight{ 0.01f };  // per squared UV distance
+    float maxError{ 0.05f };        // fraction of the mesh extent
+};
+
+// Quadric error edge collapse onto existing vertices, so every result indexes the original vertex array.
+// Vertices on open borders and attribute seams stay in place. Returns the index count written to
+// outIndices (room for indexCount) and the largest geometric error in object space units.
+size_t SimplifyMesh(const uint32_t* indices, size_t indexCount, const FVertexF32* vertices, size_t vertexCount,
+    size_t targetIndexCount, const FSimplifyOptions& options, uint32_t* outIndices, float* outError);
+
+struct FLodChainSettings
+{
+    size_t maxLods{ 4 };        // including the source level
+    float reduction{ 0.5f };    // triangle ratio between consecutive levels
+    FSimplifyOptions simplify;
+};
+
+// Appends simplified copies of indices[0, indexCount) to 'indices', each vertex cache optimized.
+// outLods[0] is the source level, the chain stops early once a level barely reduces anything.
+void BuildLodChain(std::vector<uint32_t>& indices, const FVertexF32* vertices, size_t vertexCount,
+    const FLodChainSettings& settings, std::vector<FMeshLod>& outLods);
@@ -0,0 +1,111 @@
+#include "StbImageDecoder.h"
+
+#include <climits>
+#include <cstring>
+
+// Files are read through ReadFileBytes, stb only ever sees memory
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_STDIO
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_TGA
+
+// Third party code, kept out of the warnings-as-errors build
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#pragma GCC diagnostic ignored "-Wextra"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+#include <stb_image.h>
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+FStbImageDecoder::~FStbImageDecoder()
+{
+    Close();
+}
+
+void FStbImageDecoder::Close()
+{
+    if (m_texels)
+    {
+        stbi_image_free(m_texels);
+        m_texels = nullptr;
+    }
+    m_encoded = {};
+    m_width = 0;
+    m_height = 0;
+}
+
+bool FStbImageDecoder::OpenMemory(std::span<const uint8_t> data)
+{
+    Close();
+    if (data.empty() or data.size() > static_cast<size_t>(INT_MAX))
+    {
+        return false;
+    }
+
+    int width{};
+    int height{};
+    int channels{};
+    if (not stbi_info_from_memory(data.data(), static_cast<int>(data.size()), &width, &height, &channels) or width <= 0 or height <= 0)
+    {
+        return false;
+    }
+
+    m_encoded = data;
+    m_width = static_cast<uint32_t>(width);
+    m_height = static_cast<uint32_t>(height);
+    return true;
+}
+
+bool FStbImageDecoder::OpenFile(const std::filesystem::path& path)
+{
+    Close();
+    if (not ReadFileBytes(path, m_fileData))
+    {
+        return false;
+    }
+    return OpenMemory(m_fileData);
+}
+
+bool FStbImageDecoder::ReadRows(uint8_t* dst, uint32_t firstRow, uint32_t rowCount, uint32_t dstRowPitch)
+{
+    const size_t rowSize = static_cast<size_t>(m_width) * 4u;
+    if (not dst or m_encoded.empty() or firstRow + rowCount > m_height or dstRowPitch < rowSize)
+    {
+        return false;
+    }
+
+    if (not m_texels)
+    {
+        int width{};
+        int height{};
+        int channels{};
+        // Expands grey, grey alpha and RGB to RGBA with an opaque alpha, the same as the WIC converter
+        m_texels = stbi_load_from_memory(m_encoded.data(), static_cast<int>(m_encoded.size()), &width, &height, &channels, 4);
+        if (not m_texels)
+        {
+            return false;
+        }
+        if (static_cast<uint32_t>(width) != m_width or static_cast<uint32_t>(height) != m_height)
+        {
+            stbi_image_free(m_texels);
+            m_texels = nullptr;
+            return false;
+        }
+    }
+
+    for (uint32_t row = 0; row < rowCount; ++row)
+    {
+        memcpy(dst + static_cast<size_t>(row) * dstRowPitch, m_texels + static_cast<size_t>(firstRow + row) * rowSize, rowSize);
+    }
+    return true;
+}
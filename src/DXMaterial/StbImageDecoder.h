@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ImageDecoder.h"
+
+// Portable backend on top of stb_image, PNG / JPEG / TGA only. The whole image is decoded on the first
+// ReadRows and kept until the decoder goes away, later calls only copy rows out of it.
+class FStbImageDecoder final : public IImageDecoder
+{
+public:
+    FStbImageDecoder() = default;
+    ~FStbImageDecoder() override;
+    FStbImageDecoder(const FStbImageDecoder&) = delete;
+    FStbImageDecoder& operator=(const FStbImageDecoder&) = delete;
+
+    bool OpenMemory(std::span<const uint8_t> data) override;
+    bool OpenFile(const std::filesystem::path& path) override;
+
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+
+    bool ReadRows(uint8_t* dst, uint32_t firstRow, uint32_t rowCount, uint32_t dstRowPitch) override;
+
+private:
+    void Close();
+
+    std::vector<uint8_t> m_fileData;    // owns the encoded bytes for OpenFile
+    std::span<const uint8_t> m_encoded;
+    uint8_t* m_texels{};
+    uint32_t m_width{};
+    uint32_t m_height{};
+};
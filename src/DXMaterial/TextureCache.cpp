@@ -0,0 +1,438 @@
+#include "stdafx.h"
+#include <cmath>
+#include <stdexcept>
+
+#include "TextureCache.h"
+#include "DXSampleHelper.h"
+#include "IApp.h"
+
+_Use_decl_annotations_
+FTextureCache::FTextureCache(ID3D12Device* device) : m_device(device)
+{
+    if (not device)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc{};
+    desc.NumDescriptors = c_maxTextures;
+    desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    ThrowIfFailed(m_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_srvHeap)));
+    m_srvHeap->SetName(L"FTextureCache::m_srvHeap");
+    m_srvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    m_entries.resize(c_maxTextures);
+    m_freeSlots.reserve(c_maxTextures);
+    // Popped from the back, so slot 0 goes out first
+    for (UINT i = 0; i < c_maxTextures; ++i)
+    {
+        m_freeSlots.push_back(c_maxTextures - i - 1u);
+    }
+}
+
+_Use_decl_annotations_
+uint64_t FTextureCache::KeyFromFile(const std::filesystem::path& path, DXGI_FORMAT format)
+{
+    std::error_code ec;
+    std::filesystem::path absolutePath = std::filesystem::weakly_canonical(path, ec);
+    if (ec) absolutePath = path;
+
+    const uint64_t fileSize = std::filesystem::file_size(path, ec);
+    const int64_t writeTime = ec ? 0 : static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+
+    uint64_t key = FHash::Value(format);
+    key = FHash::String(absolutePath.generic_string(), key);
+    key = FHash::Value(fileSize, key);
+    key = FHash::Value(writeTime, key);
+    return key;
+}
+
+_Use_decl_annotations_
+uint64_t FTextureCache::HashMemory(std::span<const uint8_t> data)
+{
+    return FHash::Value(data.size(), FHash::Bytes(data.data(), data.size()));
+}
+
+_Use_decl_annotations_
+uint64_t FTextureCache::KeyFromMemory(uint64_t contentHash, DXGI_FORMAT format)
+{
+    return FHash::Value(contentHash, FHash::Value(format));
+}
+
+_Use_decl_annotations_
+UINT FTextureCache::Acquire(uint64_t key, const FTextureLoader& load)
+{
+    std::unique_lock lock(m_mutex);
+
+    if (auto it = m_slots.find(key); it != m_slots.end())
+    {
+        return AcquireExisting(lock, it->second);
+    }
+
+    if (m_freeSlots.empty())
+    {
+        throw std::out_of_range("No available texture cache slot");
+    }
+
+    const UINT slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    m_slots[key] = slot;
+
+    FEntry& entry = m_entries[slot];
+    entry = FEntry{};
+    entry.key = key;
+    entry.refCount = 1u;
+    entry.loading = true;
+    m_misses++;
+
+    // Nobody reads the texture before 'loading' clears, so it is filled without the lock
+    lock.unlock();
+    bool loaded = false;
+    try
+    {
+        loaded = load(entry.texture) and (entry.texture.resource or entry.texture.isConstant);
+    }
+    catch (...)
+    {
+        lock.lock();
+        entry.loading = false;
+        entry.failed = true;
+        m_slots.erase(key);
+        m_loaded.notify_all();
+        ReleaseLocked(slot);
+        throw;
+    }
+
+    if (loaded and entry.texture.resource)
+    {
+        CreateSrv(slot);
+        entry.texture.residentBytes = LevelBytes(entry.texture, entry.texture.topLevel);
+    }
+    lock.lock();
+
+    entry.loading = false;
+    entry.failed = not loaded;
+    m_loaded.notify_all();
+    if (not loaded)
+    {
+        m_slots.erase(key);
+        ReleaseLocked(slot);
+        return c_invalidSlot;
+    }
+    entry.requestedLevel = entry.texture.tailLevel;
+    m_residentBytes += entry.texture.residentBytes;
+    return slot;
+}
+
+_Use_decl_annotations_
+UINT FTextureCache::TryAcquire(uint64_t key)
+{
+    std::unique_lock lock(m_mutex);
+    auto it = m_slots.find(key);
+    return it == m_slots.end() ? c_invalidSlot : AcquireExisting(lock, it->second);
+}
+
+UINT FTextureCache::AcquireExisting(std::unique_lock<std::mutex>& lock, UINT slot)
+{
+    FEntry& entry = m_entries[slot];
+    entry.refCount++;
+    m_loaded.wait(lock, [&entry]() { return not entry.loading; });
+
+    if (entry.failed)
+    {
+        ReleaseLocked(slot);
+        return c_invalidSlot;
+    }
+    m_hits++;
+    return slot;
+}
+
+_Use_decl_annotations_
+void FTextureCache::Release(UINT slot)
+{
+    if (slot == c_invalidSlot)
+    {
+        return;
+    }
+
+    std::scoped_lock lock(m_mutex);
+    ReleaseLocked(slot);
+}
+
+void FTextureCache::ReleaseLocked(UINT slot)
+{
+    FEntry& entry = m_entries[slot];
+    if (entry.refCount == 0)
+    {
+        throw std::runtime_error("Texture cache slot released more often than acquired");
+    }
+    if (--entry.refCount > 0)
+    {
+        return;
+    }
+
+    // A failed entry is out of the map already, its key may belong to a newer load by now
+    if (not entry.failed)
+    {
+        m_slots.erase(entry.key);
+    }
+    m_residentBytes -= entry.texture.residentBytes;
+    entry.texture = {};
+    m_freeSlots.push_back(slot);
+}
+
+_Use_decl_annotations_
+FCachedTexture FTextureCache::Get(UINT slot) const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_entries.at(slot).texture;
+}
+
+_Use_decl_annotations_
+D3D12_CPU_DESCRIPTOR_HANDLE FTextureCache::GetSrv(UINT slot) const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), static_cast<INT>(slot), m_srvDescriptorSize);
+}
+
+_Use_decl_annotations_
+UINT FTextureCache::GetViewVersion(UINT slot) const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_entries.at(slot).texture.viewVersion;
+}
+
+void FTextureCache::CreateSrv(UINT slot)
+{
+    const FCachedTexture& texture = m_entries[slot].texture;
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+    srvDesc.Shader4ComponentMapping = texture.componentMapping;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = texture.mipLevels;
+    srvDesc.Format = texture.format;
+    m_device->CreateShaderResourceView(texture.resource.Get(), &srvDesc, GetSrv(slot));
+}
+
+_Use_decl_annotations_
+UINT FTextureCache::ClampTopLevel(UINT width, UINT height, UINT blockSize, UINT level)
+{
+    // D3D12 wants whole blocks in level 0 of a block compressed resource, the smaller levels may be partial
+    while (level > 0 and (std::max(width >> level, 1u) % blockSize != 0 or std::max(height >> level, 1u) % blockSize != 0))
+    {
+        level--;
+    }
+    return level;
+}
+
+UINT64 FTextureCache::LevelBytes(const FCachedTexture& texture, UINT topLevel) const
+{
+    D3D12_RESOURCE_DESC desc{};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = std::max(texture.width >> topLevel, 1u);
+    desc.Height = std::max(texture.height >> topLevel, 1u);
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = static_cast<UINT16>(texture.levelCount - topLevel);
+    desc.Format = texture.format;
+    desc.SampleDesc.Count = 1;
+    desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    return m_device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
+_Use_decl_annotations_
+void FTextureCache::RequestDetail(UINT slot, FLOAT screenSize)
+{
+    std::scoped_lock lock(m_mutex);
+    FEntry& entry = m_entries.at(slot);
+    const FCachedTexture& texture = entry.texture;
+    if (entry.loading or not texture.createLevels)
+    {
+        return;
+    }
+
+    // One texel per pixel: every level finer than that would be minified away by the sampler
+    const FLOAT size = static_cast<FLOAT>(std::max(texture.width, texture.height));
+    const FLOAT level = screenSize > 1.f ? std::floor(std::log2(size / screenSize)) : static_cast<FLOAT>(texture.tailLevel);
+    const UINT wanted = ClampTopLevel(texture.width, texture.height, texture.blockSize,
+        static_cast<UINT>(std::clamp(level, 0.f, static_cast<FLOAT>(texture.tailLevel))));
+
+    if (entry.lastNeeded != m_frame)
+    {
+        entry.lastNeeded = m_frame;
+        entry.requestedLevel = wanted;
+    }
+    entry.requestedLevel = std::min(entry.requestedLevel, wanted);
+}
+
+UINT FTextureCache::KeepLevel(const FEntry& entry) const
+{
+    return entry.lastNeeded == m_frame ? entry.requestedLevel : entry.texture.tailLevel;
+}
+
+_Use_decl_annotations_
+void FTextureCache::UpdateStreaming(ID3D12CommandQueue* queue, UINT64 budget)
+{
+    if (not queue)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    struct FStreamChange
+    {
+        UINT slot;
+        UINT topLevel;
+        UINT64 bytes;
+        ComPtr<ID3D12Resource2> resource;
+    };
+    std::vector<FStreamChange> changes;
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        std::vector<UINT> streamed;
+        for (const auto& [key, slot] : m_slots)
+        {
+            const FEntry& entry = m_entries[slot];
+            if (not entry.loading and entry.texture.createLevels)
+            {
+                streamed.push_back(slot);
+            }
+        }
+
+        // Least recently needed first, each drops to what it still needs until the budget holds again
+        std::sort(streamed.begin(), streamed.end(), [this](UINT a, UINT b) { return m_entries[a].lastNeeded < m_entries[b].lastNeeded; });
+        UINT64 resident = m_residentBytes;
+        size_t evictCursor = 0;
+        const auto evict = [&](UINT64 growth) {
+            while (resident + growth > budget and evictCursor < streamed.size())
+            {
+                const UINT slot = streamed[evictCursor++];
+                const FEntry& entry = m_entries[slot];
+                const UINT keepLevel = KeepLevel(entry);
+                if (keepLevel <= entry.texture.topLevel)
+                {
+                    continue;
+                }
+                const UINT64 bytes = LevelBytes(entry.texture, keepLevel);
+                resident -= entry.texture.residentBytes - bytes;
+                changes.push_back({ slot, keepLevel, bytes });
+            }
+            return resident + growth <= budget;
+        };
+        evict(0u);
+
+        // Largest detail deficit first, as much as fits into the budget and the staging of one update
+        std::vector<UINT> upgrades;
+        for (UINT slot : streamed)
+        {
+            const FEntry& entry = m_entries[slot];
+            if (KeepLevel(entry) < entry.texture.topLevel)
+            {
+                upgrades.push_back(slot);
+            }
+        }
+        std::sort(upgrades.begin(), upgrades.end(), [this](UINT a, UINT b) {
+            return m_entries[a].texture.topLevel - m_entries[a].requestedLevel > m_entries[b].texture.topLevel - m_entries[b].requestedLevel;
+        });
+
+        UINT64 staged{};
+        for (UINT slot : upgrades)
+        {
+            const FEntry& entry = m_entries[slot];
+            const UINT64 bytes = LevelBytes(entry.texture, entry.requestedLevel);
+            if (staged > 0 and staged + bytes > c_maxStreamBytesPerUpdate)
+            {
+                break;
+            }
+            if (not evict(bytes - entry.texture.residentBytes))
+            {
+                break;
+            }
+            resident += bytes - entry.texture.residentBytes;
+            staged += bytes;
+            changes.push_back({ slot, entry.requestedLevel, bytes });
+        }
+
+        // Held for the recreation below, it runs without the lock
+        for (const FStreamChange& change : changes)
+        {
+            m_entries[change.slot].refCount++;
+        }
+        m_frame++;
+    }
+
+    if (changes.empty())
+    {
+        return;
+    }
+
+    for (FStreamChange& change : changes)
+    {
+        // Only the render thread changes the resource of an entry, reading the loader without the lock is fine
+        const FCachedTexture& texture = m_entries[change.slot].texture;
+        if (FAILED(texture.createLevels(change.topLevel, change.resource)))
+        {
+            g_FWarn("Failed to stream level %u of a cached texture\n", change.topLevel);
+            change.resource.Reset();
+        }
+    }
+
+    FUploadRing& uploadRing = IApp::GetInstance()->GetUploadRing();
+    uploadRing.Submit();
+    uploadRing.QueueWait(queue);
+
+    std::scoped_lock lock(m_mutex);
+    for (const FStreamChange& change : changes)
+    {
+        FEntry& entry = m_entries[change.slot];
+        if (change.resource)
+        {
+            FCachedTexture& texture = entry.texture;
+            if (change.topLevel > texture.topLevel)
+            {
+                m_evictions++;
+            }
+            else
+            {
+                m_streamedBytes += change.bytes;
+            }
+            m_residentBytes += change.bytes - texture.residentBytes;
+            texture.resource = change.resource;
+            texture.topLevel = change.topLevel;
+            texture.mipLevels = texture.levelCount - change.topLevel;
+            texture.residentBytes = change.bytes;
+            texture.viewVersion++;
+            CreateSrv(change.slot);
+        }
+        ReleaseLocked(change.slot);
+    }
+}
+
+FTextureStreamStats FTextureCache::GetStreamStats() const
+{
+    std::scoped_lock lock(m_mutex);
+    FTextureStreamStats stats;
+    stats.residentBytes = m_residentBytes;
+    stats.streamedBytes = m_streamedBytes;
+    stats.evictions = m_evictions;
+    for (const auto& [key, slot] : m_slots)
+    {
+        const FEntry& entry = m_entries[slot];
+        if (entry.loading or not entry.texture.createLevels)
+        {
+            continue;
+        }
+        stats.streamedTextures++;
+        if (KeepLevel(entry) < entry.texture.topLevel)
+        {
+            stats.pendingTextures++;
+        }
+    }
+    return stats;
+}
+
+UINT FTextureCache::GetTextureCount() const
+{
+    std::scoped_lock lock(m_mutex);
+    return static_cast<UINT>(m_slots.size());
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <span>
+#include <unordered_map>
+
+// A decoded and uploaded image, shared by every material referencing the same source
+struct FCachedTexture
+{
+    ComPtr<ID3D12Resource2> resource;
+    DXGI_FORMAT format{ DXGI_FORMAT_UNKNOWN };
+    UINT width{};
+    UINT height{};
+    UINT mipLevels{ 1 };
+    // SRV swizzle of one and two channel formats, see FChannelSwizzle
+    UINT componentMapping{ D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING };
+    // Uniform image without resource or view, users fold 'constantValue' (linear RGBA) into their constants
+    bool isConstant{};
+    DirectX::XMFLOAT4 constantValue{};
+
+    // A streamed texture holds levels [topLevel, levelCount) only, 'resource' and 'mipLevels' cover just those
+    // while 'width' and 'height' stay the size of level 0. Textures without createLevels are fully resident.
+    UINT levelCount{ 1 };
+    UINT topLevel{};
+    UINT tailLevel{};       // least detailed top level, what streaming starts from and evicts back to
+    UINT blockSize{ 1 };    // level 0 of a resource has to be a multiple of it, 4 for block compressed formats
+    UINT64 residentBytes{};
+    // Creates a resource holding levels [topLevel, levelCount) and stages their texels in the upload ring
+    std::function<HRESULT(UINT topLevel, ComPtr<ID3D12Resource2>& out)> createLevels;
+    // Bumped whenever streaming replaced the resource and its SRV, users copy the view again
+    UINT viewVersion{};
+};
+
+struct FTextureStreamStats
+{
+    UINT64 residentBytes{};     // every cached texture, streamed or not
+    UINT streamedTextures{};
+    UINT pendingTextures{};     // need more detail than is resident
+    UINT64 streamedBytes{};     // staged by streaming since the start
+    UINT64 evictions{};
+};
+
+// Deduplicates texture decode and upload across materials. Entries are keyed by the source (the resolved
+// file path with its size and write time, or the content of embedded data) and the target format, and reference counted:
+// the resource and its SRV go away with the last Release. Thread safe, a request for an image another
+// thread is still decoding waits for that decode instead of starting a second one.
+//
+// Streamed textures start with their mip tail resident. The render thread asks for detail per frame with
+// RequestDetail and UpdateStreaming recreates the resources with the needed levels, dropping the least
+// recently needed ones back toward their tail while the budget is exceeded.
+class FTextureCache
+{
+public:
+    static constexpr UINT c_maxTextures = 1024;
+    static constexpr UINT c_invalidSlot = UINT_MAX;
+    // Streamed textures keep their levels of at most this size resident
+    static constexpr UINT c_streamTailSize = 64;
+    // Staged by one UpdateStreaming, a single larger level still goes through
+    static constexpr UINT64 c_maxStreamBytesPerUpdate = 16ull << 20;
+
+    // Fills 'out' on a miss, runs without the cache lock held
+    using FTextureLoader = std::function<bool(FCachedTexture& out)>;
+
+    FTextureCache(_In_ ID3D12Device* device);
+    FTextureCache(const FTextureCache&) = delete;
+    FTextureCache& operator=(const FTextureCache&) = delete;
+
+    // Size and write time stand in for the content of a file
+    static uint64_t KeyFromFile(_In_ const std::filesystem::path& path, _In_ DXGI_FORMAT format);
+    // Every byte of embedded data, the one pass over it a load makes
+    static uint64_t HashMemory(_In_ std::span<const uint8_t> data);
+    static uint64_t KeyFromMemory(_In_ uint64_t contentHash, _In_ DXGI_FORMAT format);
+
+    // Returns the slot holding the texture, c_invalidSlot if loading it failed. Every valid slot needs a Release.
+    UINT Acquire(_In_ uint64_t key, _In_ const FTextureLoader& load);
+    // Acquire without loading, c_invalidSlot when the key is not cached
+    UINT TryAcquire(_In_ uint64_t key);
+    void Release(_In_ UINT slot);
+
+    // Valid between Acquire and the matching Release. A copy, streaming may replace the resource any frame.
+    FCachedTexture Get(_In_ UINT slot) const;
+    // In a CPU only heap, copy it into a shader visible table
+    D3D12_CPU_DESCRIPTOR_HANDLE GetSrv(_In_ UINT slot) const;
+    UINT GetViewVersion(_In_ UINT slot) const;
+
+    // Most detailed level at or above 'level' a resource can start with, see FCachedTexture::blockSize
+    static UINT ClampTopLevel(_In_ UINT width, _In_ UINT height, _In_ UINT blockSize, _In_ UINT level);
+
+    // The texture spans about 'screenSize' pixels across on screen this frame, the finest request of a frame wins
+    void RequestDetail(_In_ UINT slot, _In_ FLOAT screenSize);
+    // Applies the requests of the frame: stages the levels they need and evicts least recently needed levels
+    // while more than 'budget' bytes are resident. 'queue' waits for the copies on the GPU. Replaced resources
+    // and views are released right away, so call it between frames once the GPU finished the previous one.
+    void UpdateStreaming(_In_ ID3D12CommandQueue* queue, _In_ UINT64 budget);
+    FTextureStreamStats GetStreamStats() const;
+
+    UINT GetTextureCount() const;
+    inline UINT64 GetHits() const { return m_hits; }
+    inline UINT64 GetMisses() const { return m_misses; }
+
+private:
+    struct FEntry
+    {
+        FCachedTexture texture;
+        uint64_t key{};
+        UINT refCount{};
+        bool loading{};
+        bool failed{};
+        // Streaming, the finest level requested in frame 'lastNeeded'
+        UINT requestedLevel{};
+        UINT64 lastNeeded{};
+    };
+
+    // Expect m_mutex to be held
+    UINT AcquireExisting(std::unique_lock<std::mutex>& lock, UINT slot);
+    void ReleaseLocked(UINT slot);
+    // Level the entry has to keep resident: what the current frame asked for, the tail when nothing did
+    UINT KeepLevel(const FEntry& entry) const;
+    UINT64 LevelBytes(const FCachedTexture& texture, UINT topLevel) const;
+    void CreateSrv(UINT slot);
+
+    ID3D12Device* m_device;
+    ComPtr<ID3D12DescriptorHeap> m_srvHeap;
+    UINT m_srvDescriptorSize{};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_loaded;
+    // Fixed size, an entry never moves while a slot to it is handed out
+    std::vector<FEntry> m_entries;
+    std::vector<UINT> m_freeSlots;
+    std::unordered_map<uint64_t, UINT> m_slots;
+    std::atomic<UINT64> m_hits{};
+    std::atomic<UINT64> m_misses{};
+
+    // Counts UpdateStreaming calls, requests carry the current one
+    UINT64 m_frame{ 1 };
+    UINT64 m_residentBytes{};
+    UINT64 m_streamedBytes{};
+    UINT64 m_evictions{};
+};
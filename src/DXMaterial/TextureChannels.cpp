@@ -0,0 +1,64 @@
+#include "TextureChannels.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+FChannelUsage AnalyzeChannels(const FImage& image)
+{
+    FChannelUsage usage;
+    usage.grayscale = true;
+    usage.opaque = true;
+    std::fill(std::begin(usage.minValue), std::end(usage.minValue), static_cast<uint8_t>(0xFF));
+
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        const uint8_t* row = image.texels.data() + static_cast<size_t>(y) * image.rowPitch;
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            const uint8_t* texel = row + 4u * x;
+            for (uint32_t c = 0; c < 4u; ++c)
+            {
+                usage.minValue[c] = std::min(usage.minValue[c], texel[c]);
+                usage.maxValue[c] = std::max(usage.maxValue[c], texel[c]);
+            }
+            usage.grayscale = usage.grayscale and texel[0] == texel[1] and texel[1] == texel[2];
+        }
+    }
+    usage.opaque = usage.minValue[3] == 0xFF;
+    return usage;
+}
+
+void PackChannels(const FTextureData& source, const uint32_t channels[2], uint32_t channelCount,
+    uint32_t rowPitchAlignment, FTextureData& out)
+{
+    if (source.format != FPixelFormat::FPixelFormat_RGBA8 or channelCount == 0 or channelCount > 2u)
+    {
+        throw std::invalid_argument("Channel packing goes from RGBA8 to one or two channels");
+    }
+
+    const uint32_t alignment = std::max(rowPitchAlignment, 1u);
+    out.format = channelCount == 1u ? FPixelFormat::FPixelFormat_R8 : FPixelFormat::FPixelFormat_RG8;
+    out.levels.resize(source.levels.size());
+    for (size_t level = 0; level < source.levels.size(); ++level)
+    {
+        const FImage& src = source.levels[level];
+        FImage& dst = out.levels[level];
+        dst.width = src.width;
+        dst.height = src.height;
+        dst.rowPitch = (FormatRowSize(out.format, src.width) + alignment - 1u) / alignment * alignment;
+        dst.texels.assign(static_cast<size_t>(dst.rowPitch) * src.height, 0);
+
+        for (uint32_t y = 0; y < src.height; ++y)
+        {
+            const uint8_t* srcRow = src.texels.data() + static_cast<size_t>(y) * src.rowPitch;
+            uint8_t* dstRow = dst.texels.data() + static_cast<size_t>(y) * dst.rowPitch;
+            for (uint32_t x = 0; x < src.width; ++x)
+            {
+                for (uint32_t c = 0; c < channelCount; ++c)
+                {
+                    dstRow[x * channelCount + c] = srcRow[4u * x + (channels[c] & 3u)];
+                }
+            }
+        }
+    }
+}
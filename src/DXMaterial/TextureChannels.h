@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ImageDecoder.h"
+
+// What the texels of an RGBA8 image hold, gathered in one pass at import
+struct FChannelUsage
+{
+    bool grayscale{};       // red, green and blue are equal in every texel
+    bool opaque{};          // alpha is 255 in every texel
+    uint8_t minValue[4]{};
+    uint8_t maxValue[4]{};
+};
+
+FChannelUsage AnalyzeChannels(const FImage& image);
+
+// Copies the first 'channelCount' (1 or 2) source channels in 'channels' of every level of an RGBA8 texture
+// into an R8 or RG8 one, rows aligned to rowPitchAlignment. Pure C++, runs headless.
+void PackChannels(const FTextureData& source, const uint32_t channels[2], uint32_t channelCount,
+    uint32_t rowPitchAlignment, FTextureData& out);
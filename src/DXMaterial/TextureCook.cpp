@@ -0,0 +1,231 @@
+#include "stdafx.h"
+#include "TextureCook.h"
+
+#include <fstream>
+
+#include "Logger.h"
+
+namespace
+{
+    constexpr uint32_t c_maxMipLevels = D3D12_REQ_MIP_LEVELS;
+
+    inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1u) & ~(alignment - 1u);
+    }
+
+    // Levels of a full chain down to 1 x 1
+    inline uint32_t FullMipLevels(uint32_t width, uint32_t height)
+    {
+        uint32_t levels = 1u;
+        for (uint32_t size = std::max(width, height); size > 1u; size >>= 1u) ++levels;
+        return levels;
+    }
+}
+
+FTextureCook::~FTextureCook()
+{
+    Close();
+}
+
+_Use_decl_annotations_
+std::filesystem::path FTextureCook::GetCookPath(const std::string& stem, uint64_t identity)
+{
+    return std::filesystem::current_path() / "cache" / "textures" / std::format("{}.{:016x}.ftex", stem, identity);
+}
+
+_Use_decl_annotations_
+bool FTextureCook::Write(const std::filesystem::path& cookPath, uint64_t cookKey, const FTextureData& texture)
+{
+    if (texture.levels.empty() or texture.levels.size() > c_maxMipLevels)
+    {
+        return false;
+    }
+
+    std::vector<FTextureCookLevel> levels(texture.levels.size());
+    uint64_t offset = AlignUp(sizeof(FTextureCookHeader) + sizeof(FTextureCookLevel) * levels.size(), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        const FImage& image = texture.levels[i];
+        levels[i].offset = offset;
+        levels[i].width = image.width;
+        levels[i].height = image.height;
+        levels[i].rowPitch = image.rowPitch;
+        levels[i].rowCount = FormatRowCount(texture.format, image.height);
+        offset = AlignUp(offset + static_cast<uint64_t>(image.rowPitch) * levels[i].rowCount, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    }
+
+    FTextureCookHeader header{};
+    header.magic = c_magic;
+    header.version = c_version;
+    header.cookKey = cookKey;
+    header.fileSize = offset;
+    header.pixelFormat = static_cast<uint32_t>(texture.format);
+    header.swizzle = static_cast<uint32_t>(texture.swizzle);
+    header.mipLevels = static_cast<uint32_t>(levels.size());
+    header.isConstant = texture.isConstant ? 1u : 0u;
+    header.levelTableOffset = sizeof(FTextureCookHeader);
+
+    std::error_code ec;
+    std::filesystem::create_directories(cookPath.parent_path(), ec);
+
+    // Write next to the target and swap in, a crash mid write must not leave a valid looking file.
+    // Workers cook different textures at once, the temp name is unique per cook path.
+    std::filesystem::path tempPath = cookPath;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (not file) return false;
+
+        const auto padTo = [&file](uint64_t target) {
+            static constexpr char c_zeros[D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT]{};
+            const uint64_t position = static_cast<uint64_t>(file.tellp());
+            if (target > position) file.write(c_zeros, static_cast<std::streamsize>(target - position));
+        };
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(sizeof(FTextureCookLevel) * levels.size()));
+        for (size_t i = 0; i < levels.size(); ++i)
+        {
+            padTo(levels[i].offset);
+            file.write(reinterpret_cast<const char*>(texture.levels[i].texels.data()),
+                static_cast<std::streamsize>(static_cast<uint64_t>(levels[i].rowPitch) * levels[i].rowCount));
+        }
+        padTo(header.fileSize);
+        if (not file) return false;
+    }
+
+    std::filesystem::rename(tempPath, cookPath, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+_Use_decl_annotations_
+bool FTextureCook::Open(const std::filesystem::path& cookPath, uint64_t cookKey)
+{
+    Close();
+
+    m_file = CreateFileW(cookPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (not GetFileSizeEx(m_file, &fileSize) or static_cast<uint64_t>(fileSize.QuadPart) < sizeof(FTextureCookHeader))
+    {
+        Close();
+        return false;
+    }
+    m_size = static_cast<uint64_t>(fileSize.QuadPart);
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (not m_mapping)
+    {
+        Close();
+        return false;
+    }
+
+    m_view = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (not m_view or not Validate(cookKey))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void FTextureCook::Close()
+{
+    if (m_view) UnmapViewOfFile(m_view);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+
+    m_view = nullptr;
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+    m_size = 0u;
+}
+
+FPixelFormat FTextureCook::GetFormat() const
+{
+    return static_cast<FPixelFormat>(GetHeader().pixelFormat);
+}
+
+FChannelSwizzle FTextureCook::GetSwizzle() const
+{
+    return static_cast<FChannelSwizzle>(GetHeader().swizzle);
+}
+
+bool FTextureCook::IsConstant() const
+{
+    return GetHeader().isConstant != 0u;
+}
+
+UINT FTextureCook::GetMipLevels() const
+{
+    return GetHeader().mipLevels;
+}
+
+_Use_decl_annotations_
+FImageView FTextureCook::GetLevel(UINT level) const
+{
+    if (not m_view or level >= GetHeader().mipLevels)
+    {
+        throw std::out_of_range("Cooked texture level out of range");
+    }
+    const FTextureCookLevel& record = *At<FTextureCookLevel>(GetHeader().levelTableOffset + sizeof(FTextureCookLevel) * level);
+    return FImageView{ record.width, record.height, record.rowPitch, At<uint8_t>(record.offset) };
+}
+
+bool FTextureCook::IsInRange(uint64_t offset, uint64_t size) const
+{
+    return offset <= m_size and size <= m_size - offset;
+}
+
+bool FTextureCook::Validate(uint64_t cookKey) const
+{
+    const FTextureCookHeader& header = GetHeader();
+
+    if (header.magic != c_magic or header.version != c_version or header.cookKey != cookKey)
+    {
+        return false;
+    }
+    if (header.fileSize != m_size or header.pixelFormat >= static_cast<uint32_t>(FPixelFormat::FPixelFormat_MAX) or
+        header.swizzle >= static_cast<uint32_t>(FChannelSwizzle::FChannelSwizzle_MAX) or
+        header.mipLevels == 0 or header.mipLevels > c_maxMipLevels or
+        not IsInRange(header.levelTableOffset, sizeof(FTextureCookLevel) * static_cast<uint64_t>(header.mipLevels)))
+    {
+        g_FWarn("Cooked texture has an unexpected layout, ignoring it\n");
+        return false;
+    }
+
+    // Level 0 decides the rest: every level halves the last one down to 1 x 1, rows padded the way the decode and
+    // the mip generation pad them. Streaming and the upload copy each level by the footprint D3D12 derives from level 0.
+    const FPixelFormat format = static_cast<FPixelFormat>(header.pixelFormat);
+    const FTextureCookLevel& top = *At<FTextureCookLevel>(header.levelTableOffset);
+    if (top.width == 0 or top.height == 0 or header.mipLevels > FullMipLevels(top.width, top.height))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.mipLevels; ++i)
+    {
+        const FTextureCookLevel& level = *At<FTextureCookLevel>(header.levelTableOffset + sizeof(FTextureCookLevel) * i);
+        const uint32_t width = std::max(top.width >> i, 1u);
+        const uint32_t height = std::max(top.height >> i, 1u);
+        if (level.width != width or level.height != height or
+            level.rowPitch != AlignUp(FormatRowSize(format, width), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) or
+            level.rowCount != FormatRowCount(format, height) or
+            level.offset % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT != 0 or
+            not IsInRange(level.offset, static_cast<uint64_t>(level.rowPitch) * level.rowCount))
+        {
+            g_FWarn("Cooked texture level %u does not follow the mip chain of level 0, ignoring it\n", i);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ImageDecoder.h"
+
+// On disk layout of a cooked texture. Every level is in its final format with rows rowPitch apart and
+// starts at a D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT offset, the placed footprint layout of the upload
+// heap, so a load maps the file and copies each level into staging as is.
+struct FTextureCookHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t cookKey;
+    uint64_t fileSize;
+    uint32_t pixelFormat;   // FPixelFormat
+    uint32_t swizzle;       // FChannelSwizzle
+    uint32_t mipLevels;
+    uint32_t isConstant;
+    uint64_t levelTableOffset;
+};
+
+struct FTextureCookLevel
+{
+    uint64_t offset;
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowPitch;
+    uint32_t rowCount;
+};
+
+class FTextureCook
+{
+public:
+    static constexpr uint32_t c_magic = 0x58455446; // "FTEX"
+    static constexpr uint32_t c_version = 1;
+
+    FTextureCook() = default;
+    ~FTextureCook();
+    FTextureCook(const FTextureCook&) = delete;
+    FTextureCook& operator=(const FTextureCook&) = delete;
+
+    // 'identity' tells cooked textures apart, the cook key inside tells whether the file is still current
+    static std::filesystem::path GetCookPath(_In_ const std::string& stem, _In_ uint64_t identity);
+
+    static bool Write(_In_ const std::filesystem::path& cookPath, _In_ uint64_t cookKey, _In_ const FTextureData& texture);
+
+    // Maps the file and validates it against cookKey. The views handed out by GetLevel stay valid until Close.
+    bool Open(_In_ const std::filesystem::path& cookPath, _In_ uint64_t cookKey);
+    void Close();
+
+    FPixelFormat GetFormat() const;
+    FChannelSwizzle GetSwizzle() const;
+    bool IsConstant() const;
+    UINT GetMipLevels() const;
+    FImageView GetLevel(_In_ UINT level) const;
+
+private:
+    bool Validate(uint64_t cookKey) const;
+    bool IsInRange(uint64_t offset, uint64_t size) const;
+
+    template<typename T>
+    inline const T* At(uint64_t offset) const { return reinterpret_cast<const T*>(m_view + offset); }
+    inline const FTextureCookHeader& GetHeader() const { return *At<FTextureCookHeader>(0u); }
+
+    HANDLE m_file{ INVALID_HANDLE_VALUE };
+    HANDLE m_mapping{};
+    const uint8_t* m_view{};
+    uint64_t m_size{};
+};
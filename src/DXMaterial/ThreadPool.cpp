@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+FThreadPool::FThreadPool(uint32_t threadCount, std::function<void()> onThreadStart, std::function<void()> onThreadExit)
+    : m_onThreadStart(std::move(onThreadStart)), m_onThreadExit(std::move(onThreadExit))
+{
+    if (threadCount == 0)
+    {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = std::max(1u, hardwareThreads > 1u ? hardwareThreads - 1u : 1u);
+    }
+
+    m_workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        m_workers.emplace_back(&FThreadPool::WorkerMain, this);
+    }
+}
+
+FThreadPool::~FThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+
+    for (std::thread& worker : m_workers)
+    {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void FThreadPool::Enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_cv.notify_one();
+}
+
+void FThreadPool::WorkerMain()
+{
+    if (m_onThreadStart) m_onThreadStart();
+
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]() { return m_stopping or not m_tasks.empty(); });
+            if (m_stopping and m_tasks.empty()) break;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+
+    if (m_onThreadExit) m_onThreadExit();
+}
+
+void FThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+    if (count == 0) return;
+
+    // Shared with the helper tasks, which may start after this call returned
+    // when all workers were busy; they then find no work left and exit.
+    struct Job
+    {
+        std::function<void(size_t)> fn;
+        size_t count{};
+        std::atomic<size_t> next{};
+        std::atomic<size_t> done{};
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    auto job = std::make_shared<Job>();
+    job->fn = fn;
+    job->count = count;
+
+    auto runItems = [](Job& j)
+    {
+        for (size_t i = j.next.fetch_add(1); i < j.count; i = j.next.fetch_add(1))
+        {
+            try
+            {
+                j.fn(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(j.mutex);
+                if (not j.error) j.error = std::current_exception();
+            }
+
+            if (j.done.fetch_add(1) + 1 == j.count)
+            {
+                std::lock_guard<std::mutex> lock(j.mutex);
+                j.cv.notify_all();
+            }
+        }
+    };
+
+    const size_t helperCount = std::min(count - 1, m_workers.size());
+    for (size_t i = 0; i < helperCount; ++i)
+    {
+        Enqueue([job, runItems]() { runItems(*job); });
+    }
+
+    runItems(*job);
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cv.wait(lock, [&job]() { return job->done.load() == job->count; });
+
+    if (job->error) std::rethrow_exception(job->error);
+}
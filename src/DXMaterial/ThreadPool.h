@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed size worker pool. Platform independent on purpose so the import and
+// cook stages built on top of it can run headless.
+class FThreadPool
+{
+public:
+    // threadCount == 0 picks hardware_concurrency() - 1 (at least one worker).
+    // The hooks run on every worker right after start / right before exit,
+    // e.g. to initialize COM on Windows.
+    explicit FThreadPool(uint32_t threadCount = 0,
+        std::function<void()> onThreadStart = nullptr,
+        std::function<void()> onThreadExit = nullptr);
+    ~FThreadPool();
+
+    FThreadPool(const FThreadPool&) = delete;
+    FThreadPool& operator=(const FThreadPool&) = delete;
+
+    template<typename F>
+    auto Submit(F&& fn) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+        std::future<Result> future = task->get_future();
+        Enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    // Runs fn(i) for every i in [0, count). The calling thread takes part in the
+    // work, so it is safe to call from inside a worker. The first exception
+    // thrown by fn is rethrown on the calling thread after all items finished.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    inline uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+private:
+    void Enqueue(std::function<void()> task);
+    void WorkerMain();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping{};
+
+    std::function<void()> m_onThreadStart;
+    std::function<void()> m_onThreadExit;
+};
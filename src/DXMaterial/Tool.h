@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
+#include <cstddef>
 
 class FString {
 public:
@@ -41,4 +43,30 @@ private:
     }
 };
 
+class FHash {
+public:
+    static constexpr uint64_t c_seed = 14695981039346656037ull;
+
+    // FNV-1a, chainable through 'hash'
+    static inline uint64_t Bytes(const void* data, size_t size, uint64_t hash = c_seed)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
 
+    template<typename T>
+    static inline uint64_t Value(const T& value, uint64_t hash = c_seed)
+    {
+        return Bytes(&value, sizeof(T), hash);
+    }
+
+    static inline uint64_t String(const std::string& str, uint64_t hash = c_seed)
+    {
+        return Bytes(str.data(), str.size(), hash);
+    }
+};
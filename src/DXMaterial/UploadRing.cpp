@@ -0,0 +1,321 @@
+#include "stdafx.h"
+#include <stdexcept>
+
+#include "UploadRing.h"
+#include "DXSampleHelper.h"
+
+namespace
+{
+    inline UINT64 AlignUp(UINT64 value, UINT64 alignment)
+    {
+        return (value + alignment - 1u) / alignment * alignment;
+    }
+
+    inline UINT BlockHeight(DXGI_FORMAT format)
+    {
+        const bool isBlockCompressed =
+            (format >= DXGI_FORMAT_BC1_TYPELESS and format <= DXGI_FORMAT_BC5_SNORM) or
+            (format >= DXGI_FORMAT_BC6H_TYPELESS and format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+        return isBlockCompressed ? 4u : 1u;
+    }
+}
+
+_Use_decl_annotations_
+FUploadRing::FUploadRing(ID3D12Device* device, UINT64 size) : m_device(device), m_size(AlignUp(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT))
+{
+    if (not device)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    const D3D12_HEAP_PROPERTIES uploadHeapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    const D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_size);
+    ThrowIfFailed(m_device->CreateCommittedResource(
+        &uploadHeapProp,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_buffer)));
+    m_buffer->SetName(L"FUploadRing::m_buffer");
+
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(m_buffer->Map(0, &readRange, reinterpret_cast<void**>(&m_cpuBase)));
+
+    D3D12_COMMAND_QUEUE_DESC queueDesc{};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue)));
+    m_queue->SetName(L"FUploadRing::m_queue");
+
+    ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_allocator)));
+    ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, m_allocator.Get(), nullptr, IID_PPV_ARGS(&m_cmdList)));
+    ThrowIfFailed(m_cmdList->Close());
+    m_cmdList->SetName(L"FUploadRing::m_cmdList");
+
+    ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+    m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (not m_fenceEvent)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+}
+
+FUploadRing::~FUploadRing()
+{
+    if (m_queue and m_fence)
+    {
+        Flush();
+    }
+    if (m_buffer and m_cpuBase)
+    {
+        m_buffer->Unmap(0, nullptr);
+    }
+    if (m_fenceEvent)
+    {
+        CloseHandle(m_fenceEvent);
+    }
+}
+
+FUploadRing::FAllocation FUploadRing::Allocate(std::unique_lock<std::mutex>& lock, UINT64 size, UINT64 alignment)
+{
+    if (size > m_size)
+    {
+        throw std::out_of_range("Upload is larger than the staging ring");
+    }
+
+    for (;;)
+    {
+        // Empty ring, start over at the front so a full size request fits
+        if (m_used == 0)
+        {
+            m_head = 0;
+        }
+
+        UINT64 offset = AlignUp(m_head, alignment);
+        UINT64 padding = offset - m_head;
+        if (offset + size > m_size)
+        {
+            // Skip the tail end, it is reclaimed together with this batch
+            offset = 0;
+            padding = m_size - m_head;
+        }
+
+        if (m_used + padding + size <= m_size)
+        {
+            m_head = offset + size == m_size ? 0 : offset + size;
+            m_used += padding + size;
+            m_pendingBytes += padding + size;
+            m_openAllocations++;
+            return { m_cpuBase + offset, offset };
+        }
+
+        // Full: reclaim the oldest batch, or submit the pending copies first when nothing else is in flight
+        if (m_inFlight.empty())
+        {
+            SubmitLocked(lock);
+        }
+        RetireOldest(true);
+    }
+}
+
+void FUploadRing::FinishAllocation()
+{
+    m_openAllocations--;
+    m_allocationFinished.notify_all();
+}
+
+void FUploadRing::BeginRecording()
+{
+    if (m_recording)
+    {
+        return;
+    }
+
+    // Pick up allocators of batches that finished meanwhile without waiting for anything
+    while (not m_inFlight.empty() and RetireOldest(false)) {}
+
+    if (m_freeAllocators.empty())
+    {
+        ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_allocator)));
+    }
+    else
+    {
+        m_allocator = std::move(m_freeAllocators.back());
+        m_freeAllocators.pop_back();
+    }
+
+    ThrowIfFailed(m_allocator->Reset());
+    ThrowIfFailed(m_cmdList->Reset(m_allocator.Get(), nullptr));
+    m_recording = true;
+}
+
+void FUploadRing::SubmitLocked(std::unique_lock<std::mutex>& lock)
+{
+    // Bytes handed out before this point belong to this batch, their copies have to be in it
+    m_allocationFinished.wait(lock, [this]() { return m_openAllocations == 0; });
+
+    if (not m_recording and m_pendingBytes == 0)
+    {
+        return;
+    }
+
+    // Bytes without a recorded copy (a failed row writer) still retire in order with a fence of their own
+    if (m_recording)
+    {
+        ThrowIfFailed(m_cmdList->Close());
+        ID3D12CommandList* ppCommandLists[] = { m_cmdList.Get() };
+        m_queue->ExecuteCommandLists(1, ppCommandLists);
+    }
+
+    m_fenceValue++;
+    ThrowIfFailed(m_queue->Signal(m_fence.Get(), m_fenceValue));
+
+    m_inFlight.push_back({ m_fenceValue, m_pendingBytes, std::move(m_allocator) });
+    m_pendingBytes = 0;
+    m_recording = false;
+}
+
+bool FUploadRing::RetireOldest(bool wait)
+{
+    if (m_inFlight.empty())
+    {
+        return false;
+    }
+
+    FSubmission& oldest = m_inFlight.front();
+    if (m_fence->GetCompletedValue() < oldest.fenceValue)
+    {
+        if (not wait)
+        {
+            return false;
+        }
+        ThrowIfFailed(m_fence->SetEventOnCompletion(oldest.fenceValue, m_fenceEvent));
+        WaitForSingleObjectEx(m_fenceEvent, INFINITE, false);
+    }
+
+    m_used -= oldest.bytes;
+    if (oldest.allocator)
+    {
+        m_freeAllocators.push_back(std::move(oldest.allocator));
+    }
+    m_inFlight.pop_front();
+    return true;
+}
+
+_Use_decl_annotations_
+void FUploadRing::CopyBuffer(ID3D12Resource* dst, UINT64 dstOffset, const void* data, UINT64 size)
+{
+    if (not dst or (size > 0 and not data))
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (UINT64 copied = 0; copied < size;)
+    {
+        const UINT64 chunk = std::min(size - copied, m_size);
+
+        std::unique_lock lock(m_mutex);
+        const FAllocation allocation = Allocate(lock, chunk, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        // The copy into mapped memory runs unlocked, other threads keep staging meanwhile
+        lock.unlock();
+        memcpy(allocation.cpuAddress, src + copied, static_cast<size_t>(chunk));
+        lock.lock();
+
+        BeginRecording();
+        m_cmdList->CopyBufferRegion(dst, dstOffset + copied, m_buffer.Get(), allocation.offset, chunk);
+        FinishAllocation();
+
+        copied += chunk;
+    }
+}
+
+_Use_decl_annotations_
+bool FUploadRing::CopyTexture(ID3D12Resource* dst, UINT subresource, const FRowWriter& writeRows)
+{
+    if (not dst)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    const D3D12_RESOURCE_DESC desc = dst->GetDesc();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout{};
+    UINT rowCount{};
+    UINT64 rowSize{};
+    m_device->GetCopyableFootprints(&desc, subresource, 1, 0, &layout, &rowCount, &rowSize, nullptr);
+
+    const UINT rowPitch = layout.Footprint.RowPitch;
+    const UINT blockHeight = BlockHeight(layout.Footprint.Format);
+    const UINT rowsPerBand = static_cast<UINT>(std::min<UINT64>(rowCount, m_size / rowPitch));
+    if (rowsPerBand == 0)
+    {
+        throw std::out_of_range("Texture row is larger than the staging ring");
+    }
+
+    bool succeeded = true;
+    for (UINT firstRow = 0; firstRow < rowCount; firstRow += rowsPerBand)
+    {
+        const UINT bandRows = std::min(rowsPerBand, rowCount - firstRow);
+
+        std::unique_lock lock(m_mutex);
+        const FAllocation allocation = Allocate(lock, static_cast<UINT64>(bandRows) * rowPitch, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        // Decoding straight into the ring is the slow part, keep it outside the lock
+        lock.unlock();
+        const bool written = writeRows(allocation.cpuAddress, firstRow, bandRows, rowPitch);
+        lock.lock();
+
+        if (written)
+        {
+            D3D12_TEXTURE_COPY_LOCATION srcLoc{};
+            srcLoc.pResource = m_buffer.Get();
+            srcLoc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+            srcLoc.PlacedFootprint.Offset = allocation.offset;
+            srcLoc.PlacedFootprint.Footprint = layout.Footprint;
+            srcLoc.PlacedFootprint.Footprint.Height = std::min(bandRows * blockHeight, layout.Footprint.Height - firstRow * blockHeight);
+
+            D3D12_TEXTURE_COPY_LOCATION dstLoc{};
+            dstLoc.pResource = dst;
+            dstLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            dstLoc.SubresourceIndex = subresource;
+
+            BeginRecording();
+            m_cmdList->CopyTextureRegion(&dstLoc, 0, firstRow * blockHeight, 0, &srcLoc, nullptr);
+        }
+        FinishAllocation();
+
+        if (not written)
+        {
+            succeeded = false;
+            break;
+        }
+    }
+    return succeeded;
+}
+
+void FUploadRing::Submit()
+{
+    std::unique_lock lock(m_mutex);
+    SubmitLocked(lock);
+}
+
+_Use_decl_annotations_
+void FUploadRing::QueueWait(ID3D12CommandQueue* queue)
+{
+    if (not queue)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+
+    std::scoped_lock lock(m_mutex);
+    ThrowIfFailed(queue->Wait(m_fence.Get(), m_fenceValue));
+}
+
+void FUploadRing::Flush()
+{
+    std::unique_lock lock(m_mutex);
+    SubmitLocked(lock);
+    while (RetireOldest(true)) {}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+
+// Staging memory for every GPU upload: one persistently mapped upload heap buffer used as a ring, copied
+// from on a dedicated copy queue. Space is handed out in submission order and reclaimed once the fence
+// value of the batch it was submitted with completes, so upload memory never exceeds the ring size.
+// Copies larger than the ring are split into ring sized pieces (buffers) or bands of rows (textures).
+//
+// Destinations have to be in D3D12_RESOURCE_STATE_COMMON. Copy queue accesses decay back to COMMON when
+// the batch completes, from where buffers and textures are implicitly promoted on the direct queue.
+class FUploadRing
+{
+public:
+    static constexpr UINT64 c_defaultSize = 64ull << 20;
+
+    // Writes rowCount rows starting at firstRow (block rows for compressed formats), rows are dstRowPitch apart
+    using FRowWriter = std::function<bool(uint8_t* dst, UINT firstRow, UINT rowCount, UINT dstRowPitch)>;
+
+    FUploadRing(_In_ ID3D12Device* device, _In_ UINT64 size = c_defaultSize);
+    ~FUploadRing();
+    FUploadRing(const FUploadRing&) = delete;
+    FUploadRing& operator=(const FUploadRing&) = delete;
+
+    // Thread safe. Block while the ring is full until the GPU retires older copies.
+    void CopyBuffer(_In_ ID3D12Resource* dst, _In_ UINT64 dstOffset, _In_ const void* data, _In_ UINT64 size);
+    bool CopyTexture(_In_ ID3D12Resource* dst, _In_ UINT subresource, _In_ const FRowWriter& writeRows);
+
+    // Executes the copies recorded so far on the copy queue
+    void Submit();
+    // GPU side wait of 'queue' for every submitted copy, the CPU does not block
+    void QueueWait(_In_ ID3D12CommandQueue* queue);
+    // Submit and block until the GPU finished every copy
+    void Flush();
+
+    inline UINT64 GetSize() const { return m_size; }
+
+private:
+    struct FAllocation
+    {
+        uint8_t* cpuAddress;
+        UINT64 offset;
+    };
+
+    struct FSubmission
+    {
+        UINT64 fenceValue;
+        UINT64 bytes;
+        ComPtr<ID3D12CommandAllocator> allocator;
+    };
+
+    // The ones taking a lock expect m_mutex to be held by it
+    FAllocation Allocate(std::unique_lock<std::mutex>& lock, UINT64 size, UINT64 alignment);
+    void FinishAllocation();
+    void BeginRecording();
+    void SubmitLocked(std::unique_lock<std::mutex>& lock);
+    bool RetireOldest(bool wait);
+
+    ID3D12Device* m_device;
+    UINT64 m_size;
+
+    ComPtr<ID3D12Resource> m_buffer;
+    uint8_t* m_cpuBase{};
+
+    ComPtr<ID3D12CommandQueue> m_queue;
+    ComPtr<ID3D12GraphicsCommandList> m_cmdList;
+    ComPtr<ID3D12CommandAllocator> m_allocator;
+    std::vector<ComPtr<ID3D12CommandAllocator>> m_freeAllocators;
+    ComPtr<ID3D12Fence> m_fence;
+    UINT64 m_fenceValue{};
+    HANDLE m_fenceEvent{};
+
+    std::mutex m_mutex;
+    std::condition_variable m_allocationFinished;
+    std::deque<FSubmission> m_inFlight;
+    UINT64 m_head{};            // next free byte
+    UINT64 m_used{};            // in flight + pending, including wrap padding
+    UINT64 m_pendingBytes{};    // allocated since the last submission
+    UINT m_openAllocations{};   // handed out but copy not recorded yet, a submission has to wait for them
+    bool m_recording{};
+};
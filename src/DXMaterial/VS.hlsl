@@ -11,6 +11,15 @@ struct VSInput
     float2 texcoord : TEXCOORD0; // UV coordinates.
 };
 
+// FPackedVertex, 20 bytes (see VertexPacking.h).
+struct VSInputPacked
+{
+    float4 position : POSITION; // R16G16B16A16_UNORM: xyz in the mesh AABB (worldMatrix dequantizes), w = bitangent sign (0: +1, 1: -1).
+    float2 normal : NORMAL; // R16G16_SNORM octahedral.
+    float2 tangent : TANGENT; // R16G16_SNORM octahedral.
+    float2 texcoord : TEXCOORD0; // R16G16_FLOAT.
+};
+
 struct PSInput
 {
     float4 position : SV_POSITION; // Clip-space position (for rasterization).
@@ -30,29 +39,42 @@ struct FrameConstants
     uint _padding1;
 };
 
-struct MeshConstants
+// instanceTransform in MeshTypes.h, both matrices are XMStoreFloat3x4 rows.
+struct InstanceTransform
+{
+    float4 worldRows[3]; // Local -> world, rows of the column vector form (fourth row is 0, 0, 0, 1).
+    float4 normalRows[3]; // Inverse-transpose of world, laid out like the former float3x3 constant.
+};
+
+struct DrawConstants
 {
-    float4x4 worldMatrix; // Local -> world transform.
-    float3x3 normalMatrix; // Inverse-transpose of worldMatrix (for normals/TBN; ADD THIS IN C++).
-    float4 baseColor; // Albedo tint.
-    float metallic; // Metallic factor.
-    float roughness; // Roughness factor.
-    float opacity; // Opacity.
-    uint textureFlags; // Bitfield for textures.
-    // Note: Update sizeof(meshConstants) in C++ to ~144 bytes (add 12 for float3x3).
+    uint instanceOffset; // First InstanceTransform of the draw, SV_InstanceID starts at 0 for every draw.
 };
 
 ConstantBuffer<FrameConstants> frameCB : register(b0); // Per-frame constants.
-ConstantBuffer<MeshConstants> meshCB : register(b1); // Per-mesh constants.
+ConstantBuffer<DrawConstants> drawCB : register(b2); // Per-draw root constant.
+StructuredBuffer<InstanceTransform> instances : register(t0, space1); // Per-frame instance transforms.
+
+float3 OctDecode(float2 e)
+{
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += (1.0f - 2.0f * step(0.0f, n.xy)) * t; // -t where n.xy >= 0, +t elsewhere
+    return normalize(n);
+}
 
-PSInput mainVS(VSInput input)
+PSInput TransformVertex(VSInput input, uint instanceID)
 {
     PSInput output;
 
+    InstanceTransform instance = instances[drawCB.instanceOffset + instanceID];
+    float4x4 worldMatrix = float4x4(instance.worldRows[0], instance.worldRows[1], instance.worldRows[2], float4(0.0f, 0.0f, 0.0f, 1.0f));
+    float3x3 normalMatrix = transpose(float3x3(instance.normalRows[0].xyz, instance.normalRows[1].xyz, instance.normalRows[2].xyz));
+
     // === POSITION TRANSFORM ===
     // Local -> world.
     float4 localPos = float4(input.position, 1.0f);
-    float4 worldPos = mul(meshCB.worldMatrix, localPos); // FIXED: matrix * vec
+    float4 worldPos = mul(worldMatrix, localPos); // FIXED: matrix * vec
     output.worldPos = worldPos.xyz;
 
     // World -> view -> clip (NDC).
@@ -62,7 +84,7 @@ PSInput mainVS(VSInput input)
     // === NORMAL TRANSFORM ===
     // Use inverse-transpose matrix for scale/shear invariance.
     float3 localNormal = input.normal;
-    float3 worldNormal = normalize(mul(meshCB.normalMatrix, localNormal)); // FIXED
+    float3 worldNormal = normalize(mul(normalMatrix, localNormal)); // FIXED
     output.normal = worldNormal;
 
     // === UV PASSTHROUGH ===
@@ -71,9 +93,9 @@ PSInput mainVS(VSInput input)
     // === TBN MATRIX FOR NORMAL MAPPING ===
     // Transform tangent and bitangent using same normal matrix.
     float3 localTangent = input.tangent;
-    float3 T = normalize(mul(meshCB.normalMatrix, localTangent)); // FIXED
+    float3 T = normalize(mul(normalMatrix, localTangent)); // FIXED
     float3 localBitangent = input.bitangent;
-    float3 B = normalize(mul(meshCB.normalMatrix, localBitangent)); // FIXED
+    float3 B = normalize(mul(normalMatrix, localBitangent)); // FIXED
     float3 N = worldNormal;
 
     // Gram-Schmidt orthogonalization (ensures T/B perp to N; recomputes B for consistency).
@@ -86,3 +108,19 @@ PSInput mainVS(VSInput input)
 
     return output;
 }
+
+PSInput mainVS(VSInput input, uint instanceID : SV_InstanceID)
+{
+    return TransformVertex(input, instanceID);
+}
+
+PSInput mainVSPacked(VSInputPacked packed, uint instanceID : SV_InstanceID)
+{
+    VSInput input;
+    input.position = packed.position.xyz;
+    input.normal = OctDecode(packed.normal);
+    input.tangent = OctDecode(packed.tangent);
+    input.bitangent = cross(input.normal, input.tangent) * (1.0f - 2.0f * packed.position.w);
+    input.texcoord = packed.texcoord;
+    return TransformVertex(input, instanceID);
+}
@@ -0,0 +1,286 @@
+#include "VertexConvert.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define F_VERTEX_CONVERT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define F_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define F_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace
+{
+    constexpr float c_zero3[4] = { 0.f, 0.f, 0.f, 0.f };
+    constexpr float c_tangent3[4] = { 1.f, 0.f, 0.f, 0.f };
+    constexpr float c_bitangent3[4] = { 0.f, 1.f, 0.f, 0.f };
+
+    // Attribute presence is a template parameter so the per vertex loops carry no branches
+    template<bool HasNormals, bool HasTangents, bool HasTexCoords>
+    void ConvertScalar(const FVertexStreams& s, FVertexF32* dst, size_t begin)
+    {
+        for (size_t i = begin; i < s.count; ++i)
+        {
+            const float* p = s.positions + i * 3u;
+            const float* n = HasNormals ? s.normals + i * 3u : c_zero3;
+            const float* t = HasTangents ? s.tangents + i * 3u : c_tangent3;
+            const float* b = HasTangents ? s.bitangents + i * 3u : c_bitangent3;
+
+            FVertexF32& v = dst[i];
+            memcpy(v.position, p, sizeof(v.position));
+            memcpy(v.normal, n, sizeof(v.normal));
+            memcpy(v.tangent, t, sizeof(v.tangent));
+
+            const float cx = t[1] * b[2] - t[2] * b[1];
+            const float cy = t[2] * b[0] - t[0] * b[2];
+            const float cz = t[0] * b[1] - t[1] * b[0];
+            const float sign = (n[0] * cx + n[1] * cy + n[2] * cz) < 0.f ? -1.f : 1.f;
+            v.bitangent[0] = b[0] * sign;
+            v.bitangent[1] = b[1] * sign;
+            v.bitangent[2] = b[2] * sign;
+
+            if constexpr (HasTexCoords)
+            {
+                v.texCoord[0] = s.texCoords[i * 3u];
+                v.texCoord[1] = s.texCoords[i * 3u + 1u];
+            }
+            else
+            {
+                v.texCoord[0] = 0.f;
+                v.texCoord[1] = 0.f;
+            }
+        }
+    }
+
+#if F_VERTEX_CONVERT_X86
+    // Three registers holding x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 to x, y, z of four vertices
+    inline void TransposeAoS3(const float* src, __m128& x, __m128& y, __m128& z)
+    {
+        const __m128 a0 = _mm_loadu_ps(src);
+        const __m128 a1 = _mm_loadu_ps(src + 4);
+        const __m128 a2 = _mm_loadu_ps(src + 8);
+        const __m128 t = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+        const __m128 u = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+        x = _mm_shuffle_ps(a0, t, _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm_shuffle_ps(u, t, _MM_SHUFFLE(3, 1, 2, 0));
+        z = _mm_shuffle_ps(u, a2, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+    // Writes one interleaved vertex with overlapping 4 wide stores in ascending order, each store
+    // spills one float into the next field which the following store overwrites. Source pointers
+    // must have one readable float past the attribute (the next vertex or a padded constant).
+    inline void StoreVertexSSE(float* out, const float* p, const float* n, const float* t, const float* b, __m128 bitangentSign, const float* uv)
+    {
+        _mm_storeu_ps(out + 0, _mm_loadu_ps(p));
+        _mm_storeu_ps(out + 3, _mm_loadu_ps(n));
+        _mm_storeu_ps(out + 6, _mm_loadu_ps(t));
+        _mm_storeu_ps(out + 9, _mm_xor_ps(_mm_loadu_ps(b), bitangentSign));
+        _mm_storel_pi(reinterpret_cast<__m64*>(out + 12), uv ? _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(uv)) : _mm_setzero_ps());
+    }
+
+    inline __m128 LeftHandedMask(__m128 nx, __m128 ny, __m128 nz, __m128 tx, __m128 ty, __m128 tz, __m128 bx, __m128 by, __m128 bz)
+    {
+        const __m128 cx = _mm_sub_ps(_mm_mul_ps(ty, bz), _mm_mul_ps(tz, by));
+        const __m128 cy = _mm_sub_ps(_mm_mul_ps(tz, bx), _mm_mul_ps(tx, bz));
+        const __m128 cz = _mm_sub_ps(_mm_mul_ps(tx, by), _mm_mul_ps(ty, bx));
+        const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_mul_ps(nz, cz));
+        return _mm_cmplt_ps(det, _mm_setzero_ps());
+    }
+
+    template<bool HasNormals, bool HasTangents, bool HasTexCoords>
+    void ConvertSSE2(const FVertexStreams& s, FVertexF32* dst)
+    {
+        const __m128 signBit = _mm_set1_ps(-0.f);
+        float* out = reinterpret_cast<float*>(dst);
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.f);
+
+        size_t i = 0;
+        // Strictly less: the per vertex loads of the last vertex read one float of the next one
+        for (; i + 4u < s.count; i += 4u)
+        {
+            __m128 nx = zero, ny = zero, nz = zero;
+            __m128 tx = one, ty = zero, tz = zero;
+            __m128 bx = zero, by = one, bz = zero;
+            if constexpr (HasNormals) TransposeAoS3(s.normals + i * 3u, nx, ny, nz);
+            if constexpr (HasTangents)
+            {
+                TransposeAoS3(s.tangents + i * 3u, tx, ty, tz);
+                TransposeAoS3(s.bitangents + i * 3u, bx, by, bz);
+            }
+            const __m128 flip = _mm_and_ps(LeftHandedMask(nx, ny, nz, tx, ty, tz, bx, by, bz), signBit);
+
+            for (size_t k = 0; k < 4u; ++k)
+            {
+                const size_t v = i + k;
+                __m128 laneSign{};
+                switch (k)
+                {
+                    case 0: laneSign = _mm_shuffle_ps(flip, flip, _MM_SHUFFLE(0, 0, 0, 0)); break;
+                    case 1: laneSign = _mm_shuffle_ps(flip, flip, _MM_SHUFFLE(1, 1, 1, 1)); break;
+                    case 2: laneSign = _mm_shuffle_ps(flip, flip, _MM_SHUFFLE(2, 2, 2, 2)); break;
+                    default: laneSign = _mm_shuffle_ps(flip, flip, _MM_SHUFFLE(3, 3, 3, 3)); break;
+                }
+                StoreVertexSSE(out + v * 14u,
+                    s.positions + v * 3u,
+                    HasNormals ? s.normals + v * 3u : c_zero3,
+                    HasTangents ? s.tangents + v * 3u : c_tangent3,
+                    HasTangents ? s.bitangents + v * 3u : c_bitangent3,
+                    laneSign,
+                    HasTexCoords ? s.texCoords + v * 3u : nullptr);
+            }
+        }
+
+        ConvertScalar<HasNormals, HasTangents, HasTexCoords>(s, dst, i);
+    }
+
+    template<bool HasNormals, bool HasTangents, bool HasTexCoords>
+    F_TARGET_AVX2 void ConvertAVX2(const FVertexStreams& s, FVertexF32* dst)
+    {
+        const __m256i stride3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        float* out = reinterpret_cast<float*>(dst);
+
+        size_t i = 0;
+        for (; i + 8u < s.count; i += 8u)
+        {
+            __m256 nx = _mm256_setzero_ps(), ny = _mm256_setzero_ps(), nz = _mm256_setzero_ps();
+            __m256 tx = _mm256_set1_ps(1.f), ty = _mm256_setzero_ps(), tz = _mm256_setzero_ps();
+            __m256 bx = _mm256_setzero_ps(), by = _mm256_set1_ps(1.f), bz = _mm256_setzero_ps();
+            if constexpr (HasNormals)
+            {
+                const float* n = s.normals + i * 3u;
+                nx = _mm256_i32gather_ps(n, stride3, 4);
+                ny = _mm256_i32gather_ps(n + 1, stride3, 4);
+                nz = _mm256_i32gather_ps(n + 2, stride3, 4);
+            }
+            if constexpr (HasTangents)
+            {
+                const float* t = s.tangents + i * 3u;
+                const float* b = s.bitangents + i * 3u;
+                tx = _mm256_i32gather_ps(t, stride3, 4);
+                ty = _mm256_i32gather_ps(t + 1, stride3, 4);
+                tz = _mm256_i32gather_ps(t + 2, stride3, 4);
+                bx = _mm256_i32gather_ps(b, stride3, 4);
+                by = _mm256_i32gather_ps(b + 1, stride3, 4);
+                bz = _mm256_i32gather_ps(b + 2, stride3, 4);
+            }
+
+            const __m256 cx = _mm256_fmsub_ps(ty, bz, _mm256_mul_ps(tz, by));
+            const __m256 cy = _mm256_fmsub_ps(tz, bx, _mm256_mul_ps(tx, bz));
+            const __m256 cz = _mm256_fmsub_ps(tx, by, _mm256_mul_ps(ty, bx));
+            const __m256 det = _mm256_fmadd_ps(nz, cz, _mm256_fmadd_ps(ny, cy, _mm256_mul_ps(nx, cx)));
+            const int flipBits = _mm256_movemask_ps(_mm256_cmp_ps(det, _mm256_setzero_ps(), _CMP_LT_OQ));
+
+            for (size_t k = 0; k < 8u; ++k)
+            {
+                const size_t v = i + k;
+                const __m128 laneSign = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0u - ((static_cast<unsigned>(flipBits) >> k) & 1u)) & static_cast<int>(0x80000000u)));
+                StoreVertexSSE(out + v * 14u,
+                    s.positions + v * 3u,
+                    HasNormals ? s.normals + v * 3u : c_zero3,
+                    HasTangents ? s.tangents + v * 3u : c_tangent3,
+                    HasTangents ? s.bitangents + v * 3u : c_bitangent3,
+                    laneSign,
+                    HasTexCoords ? s.texCoords + v * 3u : nullptr);
+            }
+        }
+
+        ConvertScalar<HasNormals, HasTangents, HasTexCoords>(s, dst, i);
+    }
+
+    bool CpuHasAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4]{};
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        if (not osxsave or not fma) return false;
+        if ((_xgetbv(0) & 0x6) != 0x6) return false; // OS saves XMM and YMM state
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+
+    using FConvertFn = void(*)(const FVertexStreams&, FVertexF32*);
+
+    // Index: normals | tangents << 1 | texcoords << 2
+    template<bool N, bool T, bool U>
+    void ScalarEntry(const FVertexStreams& s, FVertexF32* dst) { ConvertScalar<N, T, U>(s, dst, 0u); }
+
+    constexpr FConvertFn c_scalarTable[8] = {
+        &ScalarEntry<false, false, false>, &ScalarEntry<true, false, false>, &ScalarEntry<false, true, false>, &ScalarEntry<true, true, false>,
+        &ScalarEntry<false, false, true>,  &ScalarEntry<true, false, true>,  &ScalarEntry<false, true, true>,  &ScalarEntry<true, true, true>,
+    };
+
+#if F_VERTEX_CONVERT_X86
+    constexpr FConvertFn c_sse2Table[8] = {
+        &ConvertSSE2<false, false, false>, &ConvertSSE2<true, false, false>, &ConvertSSE2<false, true, false>, &ConvertSSE2<true, true, false>,
+        &ConvertSSE2<false, false, true>,  &ConvertSSE2<true, false, true>,  &ConvertSSE2<false, true, true>,  &ConvertSSE2<true, true, true>,
+    };
+    constexpr FConvertFn c_avx2Table[8] = {
+        &ConvertAVX2<false, false, false>, &ConvertAVX2<true, false, false>, &ConvertAVX2<false, true, false>, &ConvertAVX2<true, true, false>,
+        &ConvertAVX2<false, false, true>,  &ConvertAVX2<true, false, true>,  &ConvertAVX2<false, true, true>,  &ConvertAVX2<true, true, true>,
+    };
+#endif
+}
+
+FVertexKernel GetBestVertexKernel()
+{
+#if F_VERTEX_CONVERT_X86
+    static const FVertexKernel s_kernel = CpuHasAVX2() ? FVertexKernel::AVX2 : FVertexKernel::SSE2;
+    return s_kernel;
+#else
+    return FVertexKernel::Scalar;
+#endif
+}
+
+const char* VertexKernelToString(FVertexKernel kernel)
+{
+    switch (kernel)
+    {
+        case FVertexKernel::SSE2: return "SSE2";
+        case FVertexKernel::AVX2: return "AVX2";
+        default: return "Scalar";
+    }
+}
+
+void ConvertVertices(const FVertexStreams& streams, FVertexF32* dst)
+{
+    ConvertVertices(streams, dst, GetBestVertexKernel());
+}
+
+void ConvertVertices(const FVertexStreams& streams, FVertexF32* dst, FVertexKernel kernel)
+{
+    if (not streams.positions or not dst or streams.count == 0) return;
+
+    const bool hasTangents = streams.tangents and streams.bitangents;
+    const size_t variant = (streams.normals ? 1u : 0u) | (hasTangents ? 2u : 0u) | (streams.texCoords ? 4u : 0u);
+
+#if F_VERTEX_CONVERT_X86
+    if (kernel == FVertexKernel::AVX2 and GetBestVertexKernel() == FVertexKernel::AVX2)
+    {
+        c_avx2Table[variant](streams, dst);
+        return;
+    }
+    if (kernel != FVertexKernel::Scalar)
+    {
+        c_sse2Table[variant](streams, dst);
+        return;
+    }
+#endif
+    c_scalarTable[variant](streams, dst);
+}
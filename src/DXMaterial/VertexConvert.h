@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Interleaved layout written by the conversion kernels, binary compatible with Vertex in MeshTypes.h
+struct FVertexF32
+{
+    float position[3];
+    float normal[3];
+    float tangent[3];
+    float bitangent[3];
+    float texCoord[2];
+};
+static_assert(sizeof(FVertexF32) == 56);
+
+// Separate attribute arrays as Assimp stores them: three floats per element (aiVector3D),
+// texture coordinates use the first two. Missing attributes are nullptr.
+struct FVertexStreams
+{
+    const float* positions{};
+    const float* normals{};
+    const float* tangents{};    // tangents and bitangents are either both present or both missing
+    const float* bitangents{};
+    const float* texCoords{};
+    size_t count{};
+};
+
+enum class FVertexKernel : uint8_t
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Converts 'streams' into 'dst' (room for streams.count vertices). Missing normals become zero,
+// missing tangent frames (1,0,0)/(0,1,0), missing UVs zero. The bitangent is flipped where the
+// frame is left handed, i.e. dot(N, cross(T, B)) < 0.
+void ConvertVertices(const FVertexStreams& streams, FVertexF32* dst);
+void ConvertVertices(const FVertexStreams& streams, FVertexF32* dst, FVertexKernel kernel);
+
+// Widest kernel the running CPU supports
+FVertexKernel GetBestVertexKernel();
+const char* VertexKernelToString(FVertexKernel kernel);
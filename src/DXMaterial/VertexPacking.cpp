@@ -0,0 +1,312 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr float c_snormScale = 32767.f;
+    constexpr float c_unormScale = 65535.f;
+    constexpr float c_radToDeg = 57.2957795f;
+
+    inline float Dot3(const float a[3], const float b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    inline void Cross3(const float a[3], const float b[3], float out[3])
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    inline float SignNotZero(float v)
+    {
+        return v >= 0.f ? 1.f : -1.f;
+    }
+
+    inline int16_t ToSnorm16(float v)
+    {
+        return static_cast<int16_t>(std::lround(std::clamp(v, -1.f, 1.f) * c_snormScale));
+    }
+
+    inline float FromSnorm16(int16_t v)
+    {
+        return std::max(static_cast<float>(v) / c_snormScale, -1.f);
+    }
+
+    // Angle between two directions, zero length inputs count as exact
+    float AngleBetween(const float a[3], const float b[3])
+    {
+        const float lengths = std::sqrt(Dot3(a, a) * Dot3(b, b));
+        if (lengths <= 0.f)
+        {
+            return 0.f;
+        }
+        return std::acos(std::clamp(Dot3(a, b) / lengths, -1.f, 1.f)) * c_radToDeg;
+    }
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFFu)
+    {
+        // Inf stays Inf, NaN keeps a mantissa bit
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+    }
+
+    const int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 31)
+    {
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+
+    if (halfExponent <= 0)
+    {
+        if (halfExponent < -10)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+
+        // Denormal, round to nearest even
+        mantissa |= 0x800000u;
+        const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1u);
+        const uint32_t halfway = 1u << (shift - 1u);
+        if (rest > halfway or (rest == halfway and (half & 1u)))
+        {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1FFFu;
+    if (rest > 0x1000u or (rest == 0x1000u and (half & 1u)))
+    {
+        ++half; // a carry into the exponent is still the correctly rounded value
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+float HalfToFloat(uint16_t value)
+{
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    uint32_t bits;
+    if (exponent == 0u)
+    {
+        if (mantissa == 0u)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // Denormal, normalize it
+            int32_t e = -1;
+            do
+            {
+                ++e;
+                mantissa <<= 1;
+            } while ((mantissa & 0x400u) == 0u);
+            bits = sign | (static_cast<uint32_t>(127 - 15 - e) << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    }
+    else if (exponent == 0x1Fu)
+    {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 127u - 15u) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+void OctEncode(const float n[3], int16_t out[2])
+{
+    const float l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    if (l1 <= 0.f)
+    {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
+
+    float x = n[0] / l1;
+    float y = n[1] / l1;
+    if (n[2] < 0.f)
+    {
+        const float fx = (1.f - std::abs(y)) * SignNotZero(x);
+        const float fy = (1.f - std::abs(x)) * SignNotZero(y);
+        x = fx;
+        y = fy;
+    }
+
+    // Rounding each axis on its own can land a few degrees off on the fold, try the four
+    // neighbouring grid points and keep the one that decodes closest to n
+    const float gx = std::floor(std::clamp(x, -1.f, 1.f) * c_snormScale);
+    const float gy = std::floor(std::clamp(y, -1.f, 1.f) * c_snormScale);
+
+    float bestDot = -2.f;
+    for (int i = 0; i < 4; ++i)
+    {
+        const int16_t candidate[2] = {
+            static_cast<int16_t>(std::clamp(gx + static_cast<float>(i & 1), -c_snormScale, c_snormScale)),
+            static_cast<int16_t>(std::clamp(gy + static_cast<float>(i >> 1), -c_snormScale, c_snormScale)) };
+
+        float decoded[3];
+        OctDecode(candidate, decoded);
+        const float d = Dot3(decoded, n);
+        if (d > bestDot)
+        {
+            bestDot = d;
+            out[0] = candidate[0];
+            out[1] = candidate[1];
+        }
+    }
+}
+
+void OctDecode(const int16_t in[2], float out[3])
+{
+    float x = FromSnorm16(in[0]);
+    float y = FromSnorm16(in[1]);
+    const float z = 1.f - std::abs(x) - std::abs(y);
+    if (z < 0.f)
+    {
+        const float t = -z;
+        x += x >= 0.f ? -t : t;
+        y += y >= 0.f ? -t : t;
+    }
+
+    const float length = std::sqrt(x * x + y * y + z * z);
+    out[0] = x / length;
+    out[1] = y / length;
+    out[2] = z / length;
+}
+
+FPositionQuantization ComputePositionQuantization(const FVertexF32* vertices, size_t count)
+{
+    FPositionQuantization quantization;
+    if (count == 0)
+    {
+        return quantization;
+    }
+
+    float minimum[3], maximum[3];
+    memcpy(minimum, vertices[0].position, sizeof(minimum));
+    memcpy(maximum, vertices[0].position, sizeof(maximum));
+    for (size_t i = 1; i < count; ++i)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minimum[axis] = std::min(minimum[axis], vertices[i].position[axis]);
+            maximum[axis] = std::max(maximum[axis], vertices[i].position[axis]);
+        }
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float extent = maximum[axis] - minimum[axis];
+        quantization.scale[axis] = extent > 0.f ? extent : 1.f; // flat axis, everything quantizes to 0
+        quantization.offset[axis] = minimum[axis];
+    }
+    return quantization;
+}
+
+void PackVertices(const FVertexF32* src, size_t count, const FPositionQuantization& quantization, FPackedVertex* dst)
+{
+    float inverseScale[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        inverseScale[axis] = c_unormScale / quantization.scale[axis];
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const FVertexF32& v = src[i];
+        FPackedVertex& p = dst[i];
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float q = (v.position[axis] - quantization.offset[axis]) * inverseScale[axis];
+            p.position[axis] = static_cast<uint16_t>(std::lround(std::clamp(q, 0.f, c_unormScale)));
+        }
+
+        float nxt[3];
+        Cross3(v.normal, v.tangent, nxt);
+        p.position[3] = Dot3(nxt, v.bitangent) < 0.f ? 65535u : 0u;
+
+        OctEncode(v.normal, p.normal);
+        OctEncode(v.tangent, p.tangent);
+        p.texCoord[0] = FloatToHalf(v.texCoord[0]);
+        p.texCoord[1] = FloatToHalf(v.texCoord[1]);
+    }
+}
+
+void UnpackVertex(const FPackedVertex& src, const FPositionQuantization& quantization, FVertexF32& dst)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        dst.position[axis] = static_cast<float>(src.position[axis]) / c_unormScale * quantization.scale[axis] + quantization.offset[axis];
+    }
+
+    OctDecode(src.normal, dst.normal);
+    OctDecode(src.tangent, dst.tangent);
+
+    const float sign = src.position[3] ? -1.f : 1.f;
+    Cross3(dst.normal, dst.tangent, dst.bitangent);
+    for (float& b : dst.bitangent)
+    {
+        b *= sign;
+    }
+
+    dst.texCoord[0] = HalfToFloat(src.texCoord[0]);
+    dst.texCoord[1] = HalfToFloat(src.texCoord[1]);
+}
+
+FPackingError MeasurePackingError(const FVertexF32* src, const FPackedVertex* packed, size_t count, const FPositionQuantization& quantization)
+{
+    FPackingError error;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const FVertexF32& v = src[i];
+        FVertexF32 decoded;
+        UnpackVertex(packed[i], quantization, decoded);
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            error.maxPositionError = std::max(error.maxPositionError, std::abs(decoded.position[axis] - v.position[axis]));
+        }
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            error.maxTexCoordError = std::max(error.maxTexCoordError, std::abs(decoded.texCoord[axis] - v.texCoord[axis]));
+        }
+        error.maxNormalAngle = std::max(error.maxNormalAngle, AngleBetween(decoded.normal, v.normal));
+        error.maxTangentAngle = std::max(error.maxTangentAngle, AngleBetween(decoded.tangent, v.tangent));
+
+        float nxt[3];
+        Cross3(v.normal, v.tangent, nxt);
+        const float d = Dot3(nxt, v.bitangent);
+        if (d != 0.f and SignNotZero(d) != SignNotZero(Dot3(nxt, decoded.bitangent)) and Dot3(decoded.bitangent, decoded.bitangent) > 0.f)
+        {
+            ++error.bitangentSignErrors;
+        }
+    }
+    return error;
+}
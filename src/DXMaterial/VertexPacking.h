@@ -0,0 +1,47 @@
+#pragma once
+
+#include "VertexConvert.h"
+
+// 20 byte vertex used by FVertexFormat::Packed
+//  position  R16G16B16A16_UNORM  xyz quantized against the mesh AABB, w = bitangent sign (0: +1, 1: -1)
+//  normal    R16G16_SNORM        octahedral
+//  tangent   R16G16_SNORM        octahedral
+//  texCoord  R16G16_FLOAT
+struct FPackedVertex
+{
+    uint16_t position[4];
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t texCoord[2];
+};
+static_assert(sizeof(FPackedVertex) == 20);
+
+// position = quantized / 65535 * scale + offset
+struct FPositionQuantization
+{
+    float scale[3]{ 1.f, 1.f, 1.f };
+    float offset[3]{};
+};
+
+struct FPackingError
+{
+    float maxPositionError{};      // object space units
+    float maxNormalAngle{};        // degrees
+    float maxTangentAngle{};       // degrees
+    float maxTexCoordError{};
+    size_t bitangentSignErrors{};
+};
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+void OctEncode(const float n[3], int16_t out[2]);
+void OctDecode(const int16_t in[2], float out[3]);
+
+FPositionQuantization ComputePositionQuantization(const FVertexF32* vertices, size_t count);
+void PackVertices(const FVertexF32* src, size_t count, const FPositionQuantization& quantization, FPackedVertex* dst);
+// Bitangent is rebuilt as sign * cross(normal, tangent), like the vertex shader does
+void UnpackVertex(const FPackedVertex& src, const FPositionQuantization& quantization, FVertexF32& dst);
+
+// Worst case round trip error of 'packed' against 'src'
+FPackingError MeasurePackingError(const FVertexF32* src, const FPackedVertex* packed, size_t count, const FPositionQuantization& quantization);
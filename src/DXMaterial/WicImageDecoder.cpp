@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include <stdexcept>
+
+#include "WicImageDecoder.h"
+#include "DXSampleHelper.h"
+
+_Use_decl_annotations_
+FWicImageDecoder::FWicImageDecoder(IWICImagingFactory2* wicFactory) : m_wicFactory(wicFactory)
+{
+    if (not wicFactory)
+    {
+        throw std::runtime_error("At least one of the pointers are invalid");
+    }
+}
+
+_Use_decl_annotations_
+bool FWicImageDecoder::OpenMemory(std::span<const uint8_t> data)
+{
+    if (data.empty() or data.size() > MAXDWORD)
+    {
+        return false;
+    }
+
+    if (FAILED(m_wicFactory->CreateStream(&m_stream)))
+    {
+        g_FError("Failed to create WIC stream\n");
+        return false;
+    }
+    if (FAILED(m_stream->InitializeFromMemory(const_cast<BYTE*>(data.data()), static_cast<DWORD>(data.size()))))
+    {
+        g_FError("Failed to initialize stream from memory\n");
+        return false;
+    }
+
+    ComPtr<IWICBitmapDecoder> decoder;
+    if (FAILED(m_wicFactory->CreateDecoderFromStream(m_stream.Get(), nullptr, WICDecodeMetadataCacheOnDemand, &decoder)))
+    {
+        g_FError("Failed to create WIC decoder\n");
+        return false;
+    }
+    return OpenDecoder(decoder.Get());
+}
+
+_Use_decl_annotations_
+bool FWicImageDecoder::OpenFile(const std::filesystem::path& path)
+{
+    ComPtr<IWICBitmapDecoder> decoder;
+    if (FAILED(m_wicFactory->CreateDecoderFromFilename(path.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)))
+    {
+        g_FError("Failed to create decoder from file: %s\n", path.generic_string());
+        return false;
+    }
+    return OpenDecoder(decoder.Get());
+}
+
+_Use_decl_annotations_
+bool FWicImageDecoder::OpenDecoder(IWICBitmapDecoder* decoder)
+{
+    m_width = 0;
+    m_height = 0;
+
+    ComPtr<IWICBitmapFrameDecode> frame;
+    if (FAILED(decoder->GetFrame(0, &frame))) {
+        g_FError("Failed to get frame from decoder\n");
+        return false;
+    }
+
+    UINT width{};
+    UINT height{};
+    if (FAILED(frame->GetSize(&width, &height))) {
+        g_FError("Failed to get texture dimensions\n");
+        return false;
+    }
+
+    if (FAILED(m_wicFactory->CreateFormatConverter(&m_converter))) {
+        g_FError("Failed to create format converter\n");
+        return false;
+    }
+
+    if (FAILED(m_converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.f, WICBitmapPaletteTypeCustom))) {
+        g_FError("Failed to initialize format converter\n");
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    return true;
+}
+
+_Use_decl_annotations_
+bool FWicImageDecoder::ReadRows(uint8_t* dst, uint32_t firstRow, uint32_t rowCount, uint32_t dstRowPitch)
+{
+    if (not dst or not m_converter or firstRow + rowCount > m_height)
+    {
+        return false;
+    }
+
+    const WICRect rect{ 0, static_cast<INT>(firstRow), static_cast<INT>(m_width), static_cast<INT>(rowCount) };
+    return SUCCEEDED(m_converter->CopyPixels(&rect, dstRowPitch, dstRowPitch * rowCount, dst));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ImageDecoder.h"
+
+// Windows Imaging Component backend, decodes rows on demand through a format converter to 32bpp RGBA
+class FWicImageDecoder final : public IImageDecoder
+{
+public:
+    FWicImageDecoder(_In_ IWICImagingFactory2* wicFactory);
+
+    bool OpenMemory(_In_ std::span<const uint8_t> data) override;
+    bool OpenFile(_In_ const std::filesystem::path& path) override;
+
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+
+    bool ReadRows(_Out_ uint8_t* dst, _In_ uint32_t firstRow, _In_ uint32_t rowCount, _In_ uint32_t dstRowPitch) override;
+
+private:
+    bool OpenDecoder(_In_ IWICBitmapDecoder* decoder);
+
+    IWICImagingFactory2* m_wicFactory;
+    ComPtr<IWICStream> m_stream;
+    ComPtr<IWICFormatConverter> m_converter;
+    UINT m_width{};
+    UINT m_height{};
+};
@@ -21,6 +21,8 @@ app::app(UINT width, UINT height, std::wstring title, HINSTANCE hInstance, int n
     m_meshConstantsGpuVirtualAddr{},
     m_frameConstantsCpuAddr(nullptr),
     m_meshConstantsCpuAddr(nullptr),
+    m_instanceBufferGpuVirtualAddr{},
+    m_instanceBufferCpuAddr(nullptr),
     m_frameIndex{},
     m_fenceEvent(nullptr),
     m_fenceGeneration{},
@@ -58,6 +60,12 @@ app::app(UINT width, UINT height, std::wstring title, HINSTANCE hInstance, int n
     ThrowIfFailed(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED));
     ThrowIfFailed(CoCreateInstance(CLSID_WICImagingFactory2, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_wicFactory)));
 
+    // Workers decode through WIC, so every one of them needs its own COM apartment
+    im_workerPool = std::make_unique<FThreadPool>(0u,
+        []() { CoInitializeEx(nullptr, COINIT_MULTITHREADED); },
+        []() { CoUninitialize(); }
+    );
+
     m_keyboard = std::make_unique<DirectX::Keyboard>();
     m_mouse = std::make_unique<DirectX::Mouse>();
     m_mouse->SetWindow(plat.GetHWND());
@@ -67,10 +75,15 @@ app::~app() {
 }
 void app::OnDestroy()
 {
+    // A load still running on the workers uses the device, the upload ring and the geometry pool
+    m_model.WaitLoad();
+
     if (m_frameConstantsGpuResource) m_frameConstantsGpuResource->Unmap(0, nullptr);
     if (m_meshConstantsGpuResource) m_meshConstantsGpuResource->Unmap(0, nullptr);
     if (m_frameConstantsCpuAddr) m_frameConstantsCpuAddr = nullptr;
     if (m_meshConstantsCpuAddr) m_meshConstantsCpuAddr = nullptr;
+    if (m_instanceBufferGpuResource) m_instanceBufferGpuResource->Unmap(0, nullptr);
+    if (m_instanceBufferCpuAddr) m_instanceBufferCpuAddr = nullptr;
         
     ImGui_ImplDX12_Shutdown();
     ImGui::DestroyContext();
@@ -85,6 +98,7 @@ void app::OnDestroy()
     for (UINT i = 0; i < FrameCount; i++) m_commandAllocators[i].Reset();
     
     m_pipeline.Reset();
+    m_packedPipeline.Reset();
     m_rootSignature.Reset();
 
     if (m_fallbackTexture.uploadBuffer) m_fallbackTexture.uploadBuffer.Reset();
@@ -92,9 +106,13 @@ void app::OnDestroy()
     
     m_frameConstantsGpuResource.Reset();
     m_meshConstantsGpuResource.Reset();
+    m_instanceBufferGpuResource.Reset();
 
 
     m_model.UnloadGPU();
+    im_textureCache.reset();
+    im_uploadRing.reset();
+    im_geometryPool.reset();
 
     im_modelSrvHeap.Reset();
     im_imGuiSrvHeap.Reset();
@@ -108,6 +126,7 @@ void app::OnDestroy()
     
     m_swapchain.Reset();
 
+    im_workerPool.reset();
     m_wicFactory.Reset();
     m_device.Reset();
 
@@ -219,6 +238,10 @@ void app::OnUpdate() {
     ImGui_ImplDX12_NewFrame();
     ImGui::NewFrame();
 
+    m_model.UpdateLoad(m_commandQueue.Get());
+    // The previous frame is done on the GPU, MoveToNextFrame waited for it, so replaced textures can go right away
+    im_textureCache->UpdateStreaming(m_commandQueue.Get(), static_cast<UINT64>(m_textureBudgetMB) << 20);
+    m_model.RefreshTextureViews();
     m_model.RotateAdd({ 0.f, 5.f * static_cast<FLOAT>(m_timer.GetElapsedSeconds()), 0.f });
 
     app::UpdateKeyBindings();
@@ -286,6 +309,10 @@ void app::LoadPipeline() {
         }
         ThrowIfFailed(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_12_2, IID_PPV_ARGS(&m_device)));
         m_device->SetName(L"app::m_device");
+
+        im_geometryPool = std::make_unique<FGeometryPool>(m_device.Get());
+        im_uploadRing = std::make_unique<FUploadRing>(m_device.Get(), m_uploadRingSize);
+        im_textureCache = std::make_unique<FTextureCache>(m_device.Get());
     }
 
     // Describe and create the command queue.
@@ -536,10 +563,13 @@ void app::LoadAssets() {
         CD3DX12_DESCRIPTOR_RANGE1 srvRange[1]{};
         srvRange[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, static_cast<INT>(FTextureType::FTextureType_MAX), 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
 
-        CD3DX12_ROOT_PARAMETER1 rp[3]{};
+        CD3DX12_ROOT_PARAMETER1 rp[5]{};
         rp[0].InitAsConstantBufferView(0, 0);
         rp[1].InitAsConstantBufferView(1, 0);
         rp[2].InitAsDescriptorTable(1, &srvRange[0], D3D12_SHADER_VISIBILITY_PIXEL);
+        // First instanceTransform of the draw, SV_InstanceID does not include StartInstanceLocation
+        rp[3].InitAsConstants(1, 2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+        rp[4].InitAsShaderResourceView(0, 1, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
 
         D3D12_STATIC_SAMPLER_DESC sampler{};
         sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
@@ -614,11 +644,33 @@ void app::LoadAssets() {
 
             m_meshConstantsGpuVirtualAddr = m_meshConstantsGpuResource->GetGPUVirtualAddress();
         }
+
+        // Per instance, one StructuredBuffer range of c_maxInstances per frame
+        {
+            const D3D12_HEAP_PROPERTIES uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+            const size_t bufferSize = static_cast<size_t>(FrameCount) * c_maxInstances * sizeof(instanceTransform);
+
+            const D3D12_RESOURCE_DESC heapDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+            ThrowIfFailed(m_device->CreateCommittedResource(
+                &uploadHeapProperties,
+                D3D12_HEAP_FLAG_NONE,
+                &heapDesc,
+                D3D12_RESOURCE_STATE_GENERIC_READ,
+                nullptr,
+                IID_PPV_ARGS(m_instanceBufferGpuResource.ReleaseAndGetAddressOf()))
+            );
+            m_instanceBufferGpuResource->SetName(L"app::m_instanceBufferGpuResource");
+            CD3DX12_RANGE readRange(0, 0);
+            ThrowIfFailed(m_instanceBufferGpuResource->Map(0, &readRange, reinterpret_cast<void**>(&m_instanceBufferCpuAddr)));
+
+            m_instanceBufferGpuVirtualAddr = m_instanceBufferGpuResource->GetGPUVirtualAddress();
+        }
     }
 
     // Create the pipeline state, which includes compiling and loading shaders.
     {
         ComPtr<IDxcBlob> vertexShader;
+        ComPtr<IDxcBlob> packedVertexShader;
         ComPtr<IDxcBlob> pixelShader;
         ComPtr<IDxcOperationResult> opResult;
         HRESULT hr{};
@@ -648,7 +700,8 @@ void app::LoadAssets() {
             ThrowIfFailed(m_dxcUtils->LoadFile((m_assetsPath + L"VS.hlsl").c_str(), nullptr, &vertexSource));
             ThrowIfFailed(m_dxcUtils->LoadFile((m_assetsPath + L"PS.hlsl").c_str(), nullptr, &pixelSource));
 
-            // Vertex Shader
+            // Vertex Shader, one entry point per FVertexFormat
+            auto compileVertexShader = [&](LPCWSTR entryPoint, ComPtr<IDxcBlob>& outShader)
             {
                 DxcBuffer vertexBuffer{};
                 vertexBuffer.Encoding = DXC_CP_ACP;
@@ -656,7 +709,7 @@ void app::LoadAssets() {
                 vertexBuffer.Size = vertexSource->GetBufferSize();
 
                 LPCWSTR args[] = {
-                    L"-E", L"mainVS",
+                    L"-E", entryPoint,
                     L"-T", L"vs_6_0",
                     L"-Zi",
                     L"-Od"
@@ -674,8 +727,10 @@ void app::LoadAssets() {
                 compileResult->GetStatus(&hr);
                 ThrowIfFailed(hr);
 
-                ThrowIfFailed(compileResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&vertexShader), nullptr));
-            }
+                ThrowIfFailed(compileResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&outShader), nullptr));
+            };
+            compileVertexShader(L"mainVS", vertexShader);
+            compileVertexShader(L"mainVSPacked", packedVertexShader);
 
             // Pixel Shader
             {
@@ -708,6 +763,8 @@ void app::LoadAssets() {
 
             hr = m_dxcValidator->Validate(vertexShader.Get(), DxcValidatorFlags_Default, &opResult);
             validateOpResult(m_dxcLibrary.Get(), hr, opResult.Get());
+            hr = m_dxcValidator->Validate(packedVertexShader.Get(), DxcValidatorFlags_Default, &opResult);
+            validateOpResult(m_dxcLibrary.Get(), hr, opResult.Get());
             hr = m_dxcValidator->Validate(pixelShader.Get(), DxcValidatorFlags_Default, &opResult);
             validateOpResult(m_dxcLibrary.Get(), hr, opResult.Get());
         }
@@ -720,6 +777,14 @@ void app::LoadAssets() {
             {"TEXCOORD",  0, DXGI_FORMAT_R32G32_FLOAT,    0, 48, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
         };
 
+        // FPackedVertex
+        D3D12_INPUT_ELEMENT_DESC packedInputElements[] = {
+            {"POSITION",  0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"NORMAL",    0, DXGI_FORMAT_R16G16_SNORM,       0, 8,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"TANGENT",   0, DXGI_FORMAT_R16G16_SNORM,       0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"TEXCOORD",  0, DXGI_FORMAT_R16G16_FLOAT,       0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        };
+
         // Create the pipeline state objects, which includes compiling and loading
         // shaders.
         {
@@ -754,29 +819,31 @@ void app::LoadAssets() {
             desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
             ThrowIfFailed(m_device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&m_pipeline)));
             m_pipeline->SetName(L"app::m_pipeline");
+
+            desc.InputLayout = { packedInputElements, _countof(packedInputElements) };
+            desc.VS = CD3DX12_SHADER_BYTECODE(packedVertexShader->GetBufferPointer(), packedVertexShader->GetBufferSize());
+            ThrowIfFailed(m_device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&m_packedPipeline)));
+            m_packedPipeline->SetName(L"app::m_packedPipeline");
         }
     }
 
     m_model = Model("Ramen Bowl", m_device.Get(), m_wicFactory.Get());
     m_model.m_rotation = { 0.f, 0.f, 0.f };
     m_model.m_scale = { 10.f, 10.f, 10.f };
-    {
-        ThrowIfFailed(m_commandList->Reset(m_commandAllocators[0].Get(), nullptr));
+    m_model.m_vertexFormat = FVertexFormat::FVertexFormat_PACKED;
 
-        m_model.Load(GetAssetFullPath(L"res/lowpoly_ramen_bowl.glb"), m_commandList.Get());
+    // Imported on the workers, OnUpdate makes the meshes resident as they finish
+    m_model.LoadAsync(GetAssetFullPath(L"res/lowpoly_ramen_bowl.glb"));
 
-        m_model.UploadGPU(m_commandList.Get(), m_commandQueue.Get());
-        WaitForGPU();
-    }
-
-    m_model.ResetUploadHeaps();
     m_fallbackTexture.uploadBuffer.Reset();
 }
 void app::PopulateCommandList()
 {
     ThrowIfFailed(m_commandAllocators[m_frameIndex]->Reset());
 
-    ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), m_pipeline.Get()));
+    ID3D12PipelineState* pipeline = m_model.m_vertexFormat == FVertexFormat::FVertexFormat_PACKED ? m_packedPipeline.Get() : m_pipeline.Get();
+
+    ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), pipeline));
 
     ID3D12DescriptorHeap* ppModelHeap[] = { im_modelSrvHeap.Get() };
     m_commandList->SetDescriptorHeaps(1, ppModelHeap);
@@ -784,7 +851,7 @@ void app::PopulateCommandList()
     m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
     m_commandList->RSSetViewports(1, &m_viewport);
     m_commandList->RSSetScissorRects(1, &m_scissorRect);
-    m_commandList->SetPipelineState(m_pipeline.Get());
+    m_commandList->SetPipelineState(pipeline);
 
     {
         CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTarget[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
@@ -816,19 +883,54 @@ void app::PopulateCommandList()
     m_commandList->SetGraphicsRootConstantBufferView(0, frameConstantGpuAddrBase);
 
     CD3DX12_GPU_DESCRIPTOR_HANDLE srvGPUHandle(im_modelSrvHeap->GetGPUDescriptorHandleForHeapStart());
-    m_model.Draw({ m_commandList.Get(), srvGPUHandle, im_modelSrvDescriptorSize, bufferIndex, m_meshConstantsGpuVirtualAddr, m_meshConstantsCpuAddr });
+    m_model.Draw({ m_commandList.Get(), srvGPUHandle, im_modelSrvDescriptorSize, bufferIndex, m_meshConstantsGpuVirtualAddr, m_meshConstantsCpuAddr,
+        m_instanceBufferGpuVirtualAddr, m_instanceBufferCpuAddr, frameCB.viewMatrix, frameCB.projectionMatrix, m_viewport.Height });
 
     ID3D12DescriptorHeap* ppImGuiHeap[] = { im_imGuiSrvHeap.Get() };
     m_commandList->SetDescriptorHeaps(1, ppImGuiHeap);
 
     ImGui::Begin("Model");
     {
+        ImGui::Text("Drawn: %u -- Culled: %u -- Draw calls: %u", m_model.GetDrawnMeshCount(), m_model.GetCulledMeshCount(), m_model.GetDrawCallCount());
+        ImGui::SliderFloat("LOD pixel error", &m_model.m_lodPixelError, .25f, 16.f);
+
+        if (const FModelLoadHandle& load = m_model.GetLoadState())
+        {
+            const FLoadStage stage = load->stage;
+            ImGui::Text("Load: %s -- Meshes: %u/%u resident -- Textures: %u/%u (%u cooked)", FModelLoadState::StageToString(stage),
+                load->meshesResident.load(), load->meshCount.load(), load->texturesLoaded.load(), load->textureCount.load(), load->texturesCooked.load());
+            if (stage != FLoadStage::FLoadStage_DONE)
+            {
+                ImGui::ProgressBar(load->GetProgress());
+            }
+            ImGui::Text("Parse: %.2f ms -- Convert: %.2f ms -- Texture decode: %.2f ms -- Upload: %.2f ms",
+                load->parseTime / 1000.0, load->convertTime / 1000.0, load->textureTime / 1000.0, load->uploadTime / 1000.0);
+            ImGui::Text("Block compress: %.2f ms -- %.1f MPix/s (%s)", load->compressTime / 1000.0,
+                load->GetCompressMegapixelsPerSecond(), m_compressTextures ? CompressQualityToString(m_compressQuality) : "Off");
+        }
+
+        ImGui::Text("Texture cache: %u images -- Hits: %u -- Misses: %u", im_textureCache->GetTextureCount(),
+            static_cast<UINT>(im_textureCache->GetHits()), static_cast<UINT>(im_textureCache->GetMisses()));
+
+        const FTextureStreamStats streamStats = im_textureCache->GetStreamStats();
+        ImGui::Text("Texture memory: %.1f / %u MB -- Streamed: %u textures, %u waiting for detail", streamStats.residentBytes / (1024.0 * 1024.0),
+            m_textureBudgetMB, streamStats.streamedTextures, streamStats.pendingTextures);
+        ImGui::Text("Streamed in: %.1f MB -- Evictions: %u", streamStats.streamedBytes / (1024.0 * 1024.0), static_cast<UINT>(streamStats.evictions));
+        const UINT minBudgetMB = 16u;
+        const UINT maxBudgetMB = 4096u;
+        ImGui::SliderScalar("Texture budget (MB)", ImGuiDataType_U32, &m_textureBudgetMB, &minBudgetMB, &maxBudgetMB);
+
         const std::vector<Mesh>& meshes = m_model.GetMeshes();
-        for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++)
+        for (size_t meshIndex = 0; meshIndex < meshes.size() and m_model.AreMeshesPublished(); meshIndex++)
         {
             const Mesh& mesh = meshes[meshIndex];
+            if (not mesh.isResident)
+            {
+                continue;
+            }
 
-            ImGui::LabelText(mesh.name.c_str(), "Vertices: %u -- Indices: %u", mesh.vertexCount, mesh.indexCount);
+            ImGui::LabelText(mesh.name.c_str(), "Vertices: %u -- Indices: %u -- Instances: %u -- LOD: %u/%u", mesh.vertexCount, mesh.indexCount,
+                mesh.instanceCount, mesh.currentLod, static_cast<UINT>(mesh.lods.size()) - 1u);
         }
     }
     ImGui::End();
@@ -42,6 +42,7 @@ private:
     ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
     ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
     ComPtr<ID3D12PipelineState> m_pipeline;
+    ComPtr<ID3D12PipelineState> m_packedPipeline;
     ComPtr<ID3D12GraphicsCommandList10> m_commandList;
 
     FTexture m_fallbackTexture;
@@ -57,6 +58,10 @@ private:
     D3D12_GPU_VIRTUAL_ADDRESS m_meshConstantsGpuVirtualAddr;
     PaddedMeshConstants* m_meshConstantsCpuAddr;
 
+    ComPtr<ID3D12Resource2> m_instanceBufferGpuResource;
+    D3D12_GPU_VIRTUAL_ADDRESS m_instanceBufferGpuVirtualAddr;
+    instanceTransform* m_instanceBufferCpuAddr;
+
     UINT m_frameIndex;
     HANDLE m_fenceEvent;
     ComPtr<ID3D12Fence1> m_fence;
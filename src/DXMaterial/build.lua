@@ -40,6 +40,11 @@ links {
 
 pchheader "stdafx.h"
 pchsource "stdafx.cpp"
+
+-- Platform independent sources, kept free of stdafx.h / Windows headers
+filter "files:ThreadPool.cpp or VertexConvert.cpp or VertexPacking.cpp or MeshSplit.cpp or MeshOptimize.cpp or Meshlet.cpp or Simplify.cpp or FrustumCull.cpp or OffsetAllocator.cpp or ImageDecoder.cpp or StbImageDecoder.cpp or Mipmap.cpp or BlockCompress.cpp or TextureChannels.cpp"
+    flags { "NoPCH" }
+filter {}
     
 filter "configurations:*"
     linkoptions { 
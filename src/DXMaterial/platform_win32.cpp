@@ -205,6 +205,10 @@ void platform::PlatMessageDispatch(MSG& msg)
 
 void platform::PlatformConsoleWrite(FlogLevel level, const std::string_view& message)
 {
+    // Loader workers log concurrently; keep color switch and write together
+    static std::mutex s_consoleMutex;
+    std::lock_guard<std::mutex> lock(s_consoleMutex);
+
     HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
     if (hConsole == INVALID_HANDLE_VALUE)
     {
@@ -23,6 +23,8 @@
 #include <cstdio>
 #include <memory>
 #include <algorithm>
+#include <mutex>
+#include <atomic>
 
 #include <MeshTypes.h>
 #include <ComTypes.h>
@@ -0,0 +1,436 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#include "DXMaterial/BlockCompress.h"
+
+namespace
+{
+    constexpr FCompressQuality c_qualities[] = { FCompressQuality::FCompressQuality_FAST, FCompressQuality::FCompressQuality_NORMAL, FCompressQuality::FCompressQuality_HIGH };
+
+    // Decoders written from the format specification, independent of the encoder's palettes
+
+    struct FBitReader
+    {
+        const uint8_t* data;
+        uint32_t position{};
+
+        uint32_t Read(uint32_t bits)
+        {
+            uint32_t value = 0;
+            for (uint32_t b = 0; b < bits; ++b, ++position)
+            {
+                value |= static_cast<uint32_t>((data[position >> 3] >> (position & 7u)) & 1u) << b;
+            }
+            return value;
+        }
+    };
+
+    // One channel, 16 values in row order
+    void DecodeBC4(const uint8_t block[8], uint8_t out[16])
+    {
+        const float a0 = block[0];
+        const float a1 = block[1];
+        float palette[8] = { a0, a1 };
+        if (block[0] > block[1])
+        {
+            for (int p = 2; p < 8; ++p) palette[p] = (static_cast<float>(8 - p) * a0 + static_cast<float>(p - 1) * a1) / 7.f;
+        }
+        else
+        {
+            for (int p = 2; p < 6; ++p) palette[p] = (static_cast<float>(6 - p) * a0 + static_cast<float>(p - 1) * a1) / 5.f;
+            palette[6] = 0.f;
+            palette[7] = 255.f;
+        }
+
+        FBitReader reader{ block, 16 };
+        for (int i = 0; i < 16; ++i)
+        {
+            out[i] = static_cast<uint8_t>(palette[reader.Read(3)] + .5f);
+        }
+    }
+
+    // Mode 6 only, the one the encoder writes. False for any other mode.
+    bool DecodeBC7(const uint8_t block[16], uint8_t out[64])
+    {
+        constexpr uint32_t c_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        FBitReader reader{ block };
+        if (reader.Read(7) != 1u << 6)
+        {
+            return false;
+        }
+
+        uint32_t endpoints[2][4];
+        for (int c = 0; c < 4; ++c)
+        {
+            endpoints[0][c] = reader.Read(7);
+            endpoints[1][c] = reader.Read(7);
+        }
+        const uint32_t pbits[2] = { reader.Read(1), reader.Read(1) };
+        for (int e = 0; e < 2; ++e)
+        {
+            for (uint32_t& value : endpoints[e]) value = (value << 1) | pbits[e];
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const uint32_t w = c_weights[reader.Read(i == 0 ? 3u : 4u)];
+            for (int c = 0; c < 4; ++c)
+            {
+                out[i * 4 + c] = static_cast<uint8_t>(((64u - w) * endpoints[0][c] + w * endpoints[1][c] + 32u) >> 6);
+            }
+        }
+        return true;
+    }
+
+    // Smooth gradients with some noise and a few hard edges, like a real albedo or mask
+    FImage MakeTestImage(uint32_t width, uint32_t height, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::normal_distribution<float> noise(0.f, 3.f);
+
+        FImage image;
+        image.width = width;
+        image.height = height;
+        image.rowPitch = (width * 4u + 255u) / 256u * 256u;
+        image.texels.assign(static_cast<size_t>(image.rowPitch) * height, 0);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const float u = static_cast<float>(x) / static_cast<float>(width);
+                const float v = static_cast<float>(y) / static_cast<float>(height);
+                const float edge = ((x / 24u + y / 16u) & 1u) ? 40.f : 0.f;
+                const float rgba[4] = {
+                    200.f * u + 30.f + edge,
+                    60.f + 120.f * v,
+                    128.f + 100.f * std::sin(6.f * u + 4.f * v),
+                    255.f * v,
+                };
+                uint8_t* texel = image.texels.data() + static_cast<size_t>(y) * image.rowPitch + x * 4u;
+                for (int c = 0; c < 4; ++c)
+                {
+                    texel[c] = static_cast<uint8_t>(std::clamp(rgba[c] + noise(rng), 0.f, 255.f) + .5f);
+                }
+            }
+        }
+        return image;
+    }
+
+    void RandomBlock(std::mt19937& rng, uint8_t rgba[64])
+    {
+        // Random ranges per channel, from flat to the whole 0..255
+        uint8_t lo[4], hi[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            const uint32_t a = rng() & 255u, b = rng() & 255u;
+            lo[c] = static_cast<uint8_t>(std::min(a, b));
+            hi[c] = static_cast<uint8_t>(rng() % 4u == 0u ? lo[c] : std::max(a, b));
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                rgba[i * 4 + c] = static_cast<uint8_t>(lo[c] + rng() % (hi[c] - lo[c] + 1u));
+            }
+        }
+    }
+
+    double Psnr(double squaredError, uint64_t samples)
+    {
+        return squaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 * static_cast<double>(samples) / squaredError) : 99.0;
+    }
+
+    // Decodes every block of 'compressed' and compares with the source, edge blocks against the repeated last row and column
+    double CompressedPsnr(const FImage& source, const FImage& compressed, FPixelFormat format, const uint32_t* channels, uint32_t channelCount)
+    {
+        double squaredError = 0.0;
+        for (uint32_t by = 0; by < (source.height + 3u) / 4u; ++by)
+        {
+            for (uint32_t bx = 0; bx < (source.width + 3u) / 4u; ++bx)
+            {
+                const uint8_t* block = compressed.texels.data() + static_cast<size_t>(by) * compressed.rowPitch + bx * FormatElementSize(format);
+                uint8_t decoded[64]{};
+                if (format == FPixelFormat::FPixelFormat_BC7)
+                {
+                    F_CHECK(DecodeBC7(block, decoded));
+                }
+                else
+                {
+                    for (uint32_t c = 0; c < channelCount; ++c)
+                    {
+                        uint8_t values[16];
+                        DecodeBC4(block + c * 8u, values);
+                        for (int i = 0; i < 16; ++i) decoded[i * 4 + static_cast<int>(c)] = values[i];
+                    }
+                }
+
+                for (uint32_t i = 0; i < 16u; ++i)
+                {
+                    const uint32_t sx = std::min(bx * 4u + i % 4u, source.width - 1u);
+                    const uint32_t sy = std::min(by * 4u + i / 4u, source.height - 1u);
+                    const uint8_t* texel = source.texels.data() + static_cast<size_t>(sy) * source.rowPitch + sx * 4u;
+                    for (uint32_t c = 0; c < channelCount; ++c)
+                    {
+                        const double d = static_cast<double>(decoded[i * 4u + c]) - texel[channels[c]];
+                        squaredError += d * d;
+                    }
+                }
+            }
+        }
+        const uint64_t samples = static_cast<uint64_t>((source.width + 3u) / 4u) * ((source.height + 3u) / 4u) * 16u * channelCount;
+        return Psnr(squaredError, samples);
+    }
+}
+
+F_TEST_CASE(BC4DecodeBackError)
+{
+    std::mt19937 rng(21u);
+    for (int n = 0; n < 20000; ++n)
+    {
+        uint8_t rgba[64];
+        RandomBlock(rng, rgba);
+        const uint32_t channel = static_cast<uint32_t>(n & 3);
+
+        uint8_t lo = 255, hi = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            lo = std::min(lo, rgba[i * 4 + static_cast<int>(channel)]);
+            hi = std::max(hi, rgba[i * 4 + static_cast<int>(channel)]);
+        }
+
+        for (FCompressQuality quality : c_qualities)
+        {
+            uint8_t block[8], decoded[16];
+            EncodeBC4(rgba, channel, quality, block);
+            DecodeBC4(block, decoded);
+
+            // Exact min / max endpoints put every value within half a palette step of an entry, refinement only
+            // keeps endpoints that lower the squared error. Plus rounding of the decoded palette.
+            double squaredError = 0.0;
+            for (int i = 0; i < 16; ++i)
+            {
+                const double d = static_cast<double>(decoded[i]) - rgba[i * 4 + static_cast<int>(channel)];
+                squaredError += d * d;
+            }
+            F_CHECK_LE(std::sqrt(squaredError / 16.0), (hi - lo) / 14.0 + 1.0);
+            if (lo == hi)
+            {
+                F_CHECK(squaredError == 0.0);
+            }
+        }
+    }
+
+    // Two levels only hit the endpoints exactly
+    uint8_t rgba[64]{};
+    for (int i = 0; i < 16; ++i) rgba[i * 4] = (i % 3) ? 10u : 200u;
+    uint8_t block[8], decoded[16];
+    EncodeBC4(rgba, 0u, FCompressQuality::FCompressQuality_FAST, block);
+    DecodeBC4(block, decoded);
+    for (int i = 0; i < 16; ++i) F_CHECK(decoded[i] == rgba[i * 4]);
+}
+
+F_TEST_CASE(BC5DecodeBackError)
+{
+    std::mt19937 rng(22u);
+    for (int n = 0; n < 20000; ++n)
+    {
+        uint8_t rgba[64];
+        RandomBlock(rng, rgba);
+        // Normal maps pass R and G, any pair of channels is stored the same way
+        const uint32_t channels[2] = { static_cast<uint32_t>(n & 3), static_cast<uint32_t>((n + 1 + (n >> 2)) & 3) };
+
+        for (FCompressQuality quality : c_qualities)
+        {
+            uint8_t block[16];
+            EncodeBC5(rgba, channels[0], channels[1], quality, block);
+            for (int half = 0; half < 2; ++half)
+            {
+                uint8_t lo = 255, hi = 0;
+                for (int i = 0; i < 16; ++i)
+                {
+                    lo = std::min(lo, rgba[i * 4 + static_cast<int>(channels[half])]);
+                    hi = std::max(hi, rgba[i * 4 + static_cast<int>(channels[half])]);
+                }
+
+                uint8_t decoded[16];
+                DecodeBC4(block + half * 8, decoded);
+                double squaredError = 0.0;
+                for (int i = 0; i < 16; ++i)
+                {
+                    const double d = static_cast<double>(decoded[i]) - rgba[i * 4 + static_cast<int>(channels[half])];
+                    squaredError += d * d;
+                }
+                F_CHECK_LE(std::sqrt(squaredError / 16.0), (hi - lo) / 14.0 + 1.0);
+            }
+        }
+    }
+}
+
+F_TEST_CASE(BC7DecodeBackError)
+{
+    std::mt19937 rng(23u);
+
+    // A constant block is within one step of the 7 bit endpoints plus their shared p-bit
+    for (int n = 0; n < 5000; ++n)
+    {
+        uint8_t rgba[64];
+        const uint32_t color = rng();
+        for (int i = 0; i < 64; ++i) rgba[i] = static_cast<uint8_t>(color >> ((i & 3) * 8));
+
+        for (FCompressQuality quality : c_qualities)
+        {
+            uint8_t block[16], decoded[64];
+            EncodeBC7(rgba, quality, block);
+            F_CHECK(DecodeBC7(block, decoded));
+            for (int i = 0; i < 64; ++i)
+            {
+                F_CHECK_LE(std::abs(decoded[i] - rgba[i]), 1);
+            }
+        }
+    }
+
+    // Random blocks: every quality decodes, higher ones never do worse over the set
+    double squaredError[3]{};
+    for (int n = 0; n < 20000; ++n)
+    {
+        uint8_t rgba[64];
+        RandomBlock(rng, rgba);
+        for (size_t q = 0; q < std::size(c_qualities); ++q)
+        {
+            uint8_t block[16], decoded[64];
+            EncodeBC7(rgba, c_qualities[q], block);
+            F_CHECK(DecodeBC7(block, decoded));
+            for (int i = 0; i < 64; ++i)
+            {
+                const double d = static_cast<double>(decoded[i]) - rgba[i];
+                squaredError[q] += d * d;
+            }
+        }
+    }
+    const uint64_t samples = 20000u * 64u;
+    std::printf("    random blocks: fast %.2f dB, normal %.2f dB, high %.2f dB\n",
+        Psnr(squaredError[0], samples), Psnr(squaredError[1], samples), Psnr(squaredError[2], samples));
+    F_CHECK(squaredError[1] <= squaredError[0]);
+    F_CHECK(squaredError[2] <= squaredError[1]);
+
+    // A two color block, the line between both colors holds every texel
+    uint8_t rgba[64];
+    const uint8_t colors[2][4] = { { 250, 20, 64, 255 }, { 10, 200, 90, 0 } };
+    for (int i = 0; i < 16; ++i) std::memcpy(rgba + i * 4, colors[(i * 7) % 5 < 2], 4);
+    for (FCompressQuality quality : { FCompressQuality::FCompressQuality_NORMAL, FCompressQuality::FCompressQuality_HIGH })
+    {
+        uint8_t block[16], decoded[64];
+        EncodeBC7(rgba, quality, block);
+        F_CHECK(DecodeBC7(block, decoded));
+        for (int i = 0; i < 64; ++i)
+        {
+            F_CHECK_LE(std::abs(decoded[i] - rgba[i]), 2);
+        }
+    }
+}
+
+F_TEST_CASE(CompressTextureLayout)
+{
+    // Sizes no multiple of 4, the edge blocks repeat the last row and column
+    FTextureData source;
+    source.levels.push_back(MakeTestImage(37u, 21u, 1u));
+    source.levels.push_back(MakeTestImage(18u, 10u, 2u));
+    source.levels.push_back(MakeTestImage(1u, 1u, 3u));
+
+    FThreadPool pool(4u), single(1u);
+    FCompressOptions options;
+    options.channels[0] = 2u;
+    options.channels[1] = 3u;
+
+    for (FPixelFormat format : { FPixelFormat::FPixelFormat_BC4, FPixelFormat::FPixelFormat_BC5, FPixelFormat::FPixelFormat_BC7 })
+    {
+        FTextureData out, reference;
+        const FCompressStats stats = CompressTexture(pool, source, format, options, out);
+        F_CHECK(out.format == format);
+        F_CHECK(out.levels.size() == source.levels.size());
+        F_CHECK(stats.pixels == 37u * 21u + 18u * 10u + 1u);
+
+        // The split over the pool does not change a single byte
+        CompressTexture(single, source, format, options, reference);
+
+        for (size_t level = 0; level < source.levels.size(); ++level)
+        {
+            const FImage& src = source.levels[level];
+            const FImage& dst = out.levels[level];
+            F_CHECK(dst.width == src.width and dst.height == src.height);
+            F_CHECK(dst.rowPitch % 256u == 0u and dst.rowPitch >= FormatRowSize(format, src.width));
+            F_CHECK(dst.texels.size() == static_cast<size_t>(dst.rowPitch) * FormatRowCount(format, src.height));
+            F_CHECK(dst.texels == reference.levels[level].texels);
+
+            // Every block sits where its 4x4 texels encode to on their own
+            for (uint32_t by = 0; by < FormatRowCount(format, src.height); ++by)
+            {
+                for (uint32_t bx = 0; bx < (src.width + 3u) / 4u; ++bx)
+                {
+                    uint8_t rgba[64];
+                    for (uint32_t i = 0; i < 16u; ++i)
+                    {
+                        const uint32_t sx = std::min(bx * 4u + i % 4u, src.width - 1u);
+                        const uint32_t sy = std::min(by * 4u + i / 4u, src.height - 1u);
+                        std::memcpy(rgba + i * 4u, src.texels.data() + static_cast<size_t>(sy) * src.rowPitch + sx * 4u, 4);
+                    }
+
+                    uint8_t expected[16];
+                    switch (format)
+                    {
+                        case FPixelFormat::FPixelFormat_BC4: EncodeBC4(rgba, options.channels[0], options.quality, expected); break;
+                        case FPixelFormat::FPixelFormat_BC5: EncodeBC5(rgba, options.channels[0], options.channels[1], options.quality, expected); break;
+                        default: EncodeBC7(rgba, options.quality, expected); break;
+                    }
+                    const uint8_t* block = dst.texels.data() + static_cast<size_t>(by) * dst.rowPitch + bx * FormatElementSize(format);
+                    F_CHECK(std::memcmp(block, expected, FormatElementSize(format)) == 0);
+                }
+            }
+        }
+    }
+
+    FTextureData out;
+    bool thrown = false;
+    try
+    {
+        CompressTexture(pool, source, FPixelFormat::FPixelFormat_RGBA8, options, out);
+    }
+    catch (const std::invalid_argument&)
+    {
+        thrown = true;
+    }
+    F_CHECK(thrown);
+}
+
+F_TEST_CASE(CompressThroughput)
+{
+    FTextureData source;
+    source.levels.push_back(MakeTestImage(512u, 512u, 4u));
+    FThreadPool pool;
+
+    for (FPixelFormat format : { FPixelFormat::FPixelFormat_BC4, FPixelFormat::FPixelFormat_BC5, FPixelFormat::FPixelFormat_BC7 })
+    {
+        for (FCompressQuality quality : c_qualities)
+        {
+            FCompressOptions options;
+            options.quality = quality;
+            FTextureData out;
+            const FCompressStats stats = CompressTexture(pool, source, format, options, out);
+            const uint32_t channels[2] = { 0u, 1u };
+            const uint32_t rgbaChannels[4] = { 0u, 1u, 2u, 3u };
+            const bool bc7 = format == FPixelFormat::FPixelFormat_BC7;
+            const double psnr = CompressedPsnr(source.levels[0], out.levels[0], format, bc7 ? rgbaChannels : channels,
+                bc7 ? 4u : format == FPixelFormat::FPixelFormat_BC5 ? 2u : 1u);
+            std::printf("    %s %-6s %7.1f MPix/s  %.2f dB\n", PixelFormatToString(format), CompressQualityToString(quality), stats.megapixelsPerSecond, psnr);
+            F_CHECK(stats.pixels == 512u * 512u and stats.megapixelsPerSecond > 0.0);
+            // A few dB below what the encoders reach on this image
+            F_CHECK(psnr >= (bc7 ? 36.0 : 48.0));
+        }
+    }
+}
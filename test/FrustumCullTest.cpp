@@ -0,0 +1,170 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <random>
+
+#include "DXMaterial/FrustumCull.h"
+
+namespace
+{
+    constexpr float c_near = 1.f;
+    constexpr float c_far = 100.f;
+
+    // Camera at 'eye' looking down +z with a 90 degree field of view, row vectors like XMMatrixPerspectiveFovLH
+    void MakeViewProjection(const float eye[3], float out[4][4])
+    {
+        const float view[4][4] = { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f }, { -eye[0], -eye[1], -eye[2], 1.f } };
+        const float range = c_far / (c_far - c_near);
+        const float projection[4][4] = { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, range, 1.f }, { 0.f, 0.f, -c_near * range, 0.f } };
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                out[r][c] = 0.f;
+                for (int k = 0; k < 4; ++k) out[r][c] += view[r][k] * projection[k][c];
+            }
+        }
+    }
+
+    struct FTestBox
+    {
+        float center[3];
+        float extent[3];
+        uint8_t visible;
+    };
+
+    // Outside when all eight corners are behind one plane, with the signed distance of the corner closest to passing
+    bool ReferenceOutside(const FFrustum& frustum, const FTestBox& box, float& outMargin)
+    {
+        bool outside = false;
+        outMargin = INFINITY;
+        for (const float* plane : frustum.planes)
+        {
+            float nearest = -INFINITY;
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                float distance = plane[3];
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    const float sign = (corner >> axis) & 1 ? 1.f : -1.f;
+                    distance += plane[axis] * (box.center[axis] + sign * box.extent[axis]);
+                }
+                nearest = std::max(nearest, distance);
+            }
+            outside = outside or nearest < 0.f;
+            outMargin = std::min(outMargin, std::abs(nearest));
+        }
+        return outside;
+    }
+}
+
+F_TEST_CASE(FrustumPlanes)
+{
+    const float eye[3] = { 0.f, 0.f, 0.f };
+    float viewProjection[4][4];
+    MakeViewProjection(eye, viewProjection);
+    const FFrustum frustum = MakeFrustum(viewProjection);
+
+    // Unit normals, so the plane equation is a distance: a point on the axis at z sits z / sqrt(2) from the sides
+    const float point[3] = { 0.f, 0.f, 10.f };
+    const float expected[6] = { 10.f / std::sqrt(2.f), 10.f / std::sqrt(2.f), 10.f / std::sqrt(2.f), 10.f / std::sqrt(2.f), 10.f - c_near, c_far - 10.f };
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = frustum.planes[p];
+        F_CHECK_LE(std::abs(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2] - 1.f), 1e-5f);
+        F_CHECK_LE(std::abs(plane[0] * point[0] + plane[1] * point[1] + plane[2] * point[2] + plane[3] - expected[p]), 1e-3f);
+    }
+}
+
+F_TEST_CASE(FrustumCullClassifiesBoxes)
+{
+    // Nine boxes, so the last group of four is partial
+    const FTestBox boxes[] = {
+        { { 0.f, 0.f, 10.f }, { 1.f, 1.f, 1.f }, 1u },       // inside
+        { { 0.f, 0.f, -5.f }, { 1.f, 1.f, 1.f }, 0u },       // behind the camera
+        { { 0.f, 0.f, 150.f }, { 1.f, 1.f, 1.f }, 0u },      // past the far plane
+        { { -30.f, 0.f, 10.f }, { 1.f, 1.f, 1.f }, 0u },     // left
+        { { 0.f, 30.f, 10.f }, { 1.f, 1.f, 1.f }, 0u },      // above
+        { { -10.f, 0.f, 10.f }, { 1.f, 1.f, 1.f }, 1u },     // across the left plane
+        { { 0.f, 0.f, 1.f }, { 0.5f, 0.5f, 0.5f }, 1u },     // across the near plane
+        { { 0.f, 0.f, 100.f }, { 2.f, 2.f, 2.f }, 1u },      // across the far plane
+        { { 0.f, 0.f, 50.f }, { 1000.f, 1000.f, 1000.f }, 1u }, // holding the whole frustum
+    };
+    constexpr size_t c_count = std::size(boxes);
+
+    // The same scene seen from the origin and from a moved camera
+    for (float offset : { 0.f, 25.f })
+    {
+        const float eye[3] = { offset, -offset, offset };
+        float viewProjection[4][4];
+        MakeViewProjection(eye, viewProjection);
+        const FFrustum frustum = MakeFrustum(viewProjection);
+
+        FCullBoxes cull;
+        cull.Resize(c_count);
+        size_t expectedVisible = 0;
+        for (size_t i = 0; i < c_count; ++i)
+        {
+            const float center[3] = { boxes[i].center[0] + eye[0], boxes[i].center[1] + eye[1], boxes[i].center[2] + eye[2] };
+            cull.Set(i, center, boxes[i].extent);
+            expectedVisible += boxes[i].visible;
+        }
+        F_CHECK(cull.Size() == c_count);
+
+        uint8_t visible[c_count + 1];
+        visible[c_count] = 0xCDu;
+        F_CHECK(cull.Cull(frustum, visible) == expectedVisible);
+        for (size_t i = 0; i < c_count; ++i)
+        {
+            F_CHECK(visible[i] == boxes[i].visible);
+        }
+        // Padding lanes are never written
+        F_CHECK(visible[c_count] == 0xCDu);
+    }
+}
+
+F_TEST_CASE(FrustumCullMatchesReference)
+{
+    const float eye[3] = { 3.f, -2.f, 1.f };
+    float viewProjection[4][4];
+    MakeViewProjection(eye, viewProjection);
+    const FFrustum frustum = MakeFrustum(viewProjection);
+
+    std::mt19937 rng(9u);
+    std::uniform_real_distribution<float> position(-120.f, 120.f);
+    std::uniform_real_distribution<float> size(0.f, 8.f);
+    constexpr size_t c_count = 4099;
+    std::vector<FTestBox> boxes(c_count);
+    FCullBoxes cull;
+    cull.Resize(c_count);
+    for (size_t i = 0; i < c_count; ++i)
+    {
+        FTestBox& box = boxes[i];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            box.center[axis] = position(rng);
+            box.extent[axis] = size(rng);
+        }
+        cull.Set(i, box.center, box.extent);
+    }
+
+    std::vector<uint8_t> visible(c_count);
+    const size_t visibleCount = cull.Cull(frustum, visible.data());
+    size_t counted = 0, mismatches = 0, compared = 0;
+    for (size_t i = 0; i < c_count; ++i)
+    {
+        counted += visible[i];
+        float margin;
+        const bool outside = ReferenceOutside(frustum, boxes[i], margin);
+        // Boxes touching a plane are decided by rounding either way
+        if (margin < 1e-3f) continue;
+        ++compared;
+        mismatches += (visible[i] != 0) == outside;
+    }
+    F_CHECK(counted == visibleCount);
+    F_CHECK(visibleCount > 0u and visibleCount < c_count);
+    F_CHECK(compared > c_count - 10u);
+    F_CHECK(mismatches == 0u);
+}
@@ -0,0 +1,485 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "DXMaterial/ImageDecoder.h"
+#include "DXMaterial/StbImageDecoder.h"
+
+// Real encoded images come from stb_image_write, part of the same vcpkg port as the decoder
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STBI_WRITE_NO_STDIO
+
+// Third party code, kept out of the warnings-as-errors build
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#pragma GCC diagnostic ignored "-Wextra"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+#include <stb_image_write.h>
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace
+{
+    // "Encoded" images are a 16 byte header, the texels are a function of the position and the seed.
+    // Stands in for a codec so the decode plumbing runs without WIC or image files.
+    constexpr uint32_t c_syntheticMagic = 0x304e5953u; // "SYN0"
+
+    std::vector<uint8_t> MakeSyntheticImage(uint32_t width, uint32_t height, uint32_t seed)
+    {
+        const uint32_t header[4] = { c_syntheticMagic, width, height, seed };
+        std::vector<uint8_t> encoded(sizeof(header));
+        std::memcpy(encoded.data(), header, sizeof(header));
+        return encoded;
+    }
+
+    void SyntheticTexel(uint32_t x, uint32_t y, uint32_t seed, uint8_t out[4])
+    {
+        out[0] = static_cast<uint8_t>(x * 7u + seed);
+        out[1] = static_cast<uint8_t>(y * 13u);
+        out[2] = static_cast<uint8_t>(x ^ y);
+        out[3] = static_cast<uint8_t>(255u - seed);
+    }
+
+    class FSyntheticDecoder final : public IImageDecoder
+    {
+    public:
+        bool OpenMemory(std::span<const uint8_t> data) override
+        {
+            uint32_t header[4];
+            if (data.size() != sizeof(header))
+            {
+                return false;
+            }
+            std::memcpy(header, data.data(), sizeof(header));
+            if (header[0] != c_syntheticMagic)
+            {
+                return false;
+            }
+            m_width = header[1];
+            m_height = header[2];
+            m_seed = header[3];
+            return true;
+        }
+        bool OpenFile(const std::filesystem::path&) override { return false; }
+
+        uint32_t GetWidth() const override { return m_width; }
+        uint32_t GetHeight() const override { return m_height; }
+
+        bool ReadRows(uint8_t* dst, uint32_t firstRow, uint32_t rowCount, uint32_t dstRowPitch) override
+        {
+            if (firstRow + rowCount > m_height or dstRowPitch < m_width * 4u)
+            {
+                return false;
+            }
+            for (uint32_t y = 0; y < rowCount; ++y)
+            {
+                for (uint32_t x = 0; x < m_width; ++x)
+                {
+                    SyntheticTexel(x, firstRow + y, m_seed, dst + static_cast<size_t>(y) * dstRowPitch + x * 4u);
+                }
+            }
+            return true;
+        }
+
+    private:
+        uint32_t m_width{};
+        uint32_t m_height{};
+        uint32_t m_seed{};
+    };
+
+    bool MatchesSynthetic(const FImage& image, uint32_t seed)
+    {
+        for (uint32_t y = 0; y < image.height; ++y)
+        {
+            for (uint32_t x = 0; x < image.width; ++x)
+            {
+                uint8_t expected[4];
+                SyntheticTexel(x, y, seed, expected);
+                if (std::memcmp(expected, image.texels.data() + static_cast<size_t>(y) * image.rowPitch + x * 4u, 4) != 0)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    enum class FEncoding
+    {
+        PNG,
+        TGA,
+        TGARLE,
+        JPEG,
+    };
+
+    // Triangle waves, every channel moves but there are no hard edges for JPEG to ring on
+    uint8_t Wave(uint32_t v)
+    {
+        return static_cast<uint8_t>((v & 256u) ? 255u - (v & 255u) : (v & 255u));
+    }
+
+    std::vector<uint8_t> MakePattern(uint32_t width, uint32_t height, uint32_t channels)
+    {
+        std::vector<uint8_t> texels(static_cast<size_t>(width) * height * channels);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const uint8_t rgba[4] = { Wave(x * 3u), Wave(y * 5u + 40u), Wave(x * 2u + y * 2u + 90u), Wave(x + y * 3u + 160u) };
+                uint8_t* texel = texels.data() + (static_cast<size_t>(y) * width + x) * channels;
+                // One and two channel images are grey and grey alpha
+                if (channels <= 2u)
+                {
+                    texel[0] = rgba[0];
+                    if (channels == 2u) texel[1] = rgba[3];
+                }
+                else
+                {
+                    std::memcpy(texel, rgba, channels);
+                }
+            }
+        }
+        return texels;
+    }
+
+    void AppendEncoded(void* context, void* data, int size)
+    {
+        std::vector<uint8_t>& encoded = *static_cast<std::vector<uint8_t>*>(context);
+        encoded.insert(encoded.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+    }
+
+    std::vector<uint8_t> Encode(FEncoding encoding, uint32_t width, uint32_t height, uint32_t channels, const std::vector<uint8_t>& texels)
+    {
+        std::vector<uint8_t> encoded;
+        const int w = static_cast<int>(width);
+        const int h = static_cast<int>(height);
+        const int comp = static_cast<int>(channels);
+        switch (encoding)
+        {
+        case FEncoding::PNG:
+            stbi_write_png_to_func(AppendEncoded, &encoded, w, h, comp, texels.data(), w * comp);
+            break;
+        case FEncoding::TGA:
+        case FEncoding::TGARLE:
+            stbi_write_tga_with_rle = encoding == FEncoding::TGARLE ? 1 : 0;
+            stbi_write_tga_to_func(AppendEncoded, &encoded, w, h, comp, texels.data());
+            break;
+        case FEncoding::JPEG:
+            stbi_write_jpg_to_func(AppendEncoded, &encoded, w, h, comp, texels.data(), 95);
+            break;
+        }
+        return encoded;
+    }
+
+    // Grey replicates into RGB, a missing alpha is opaque
+    void ExpandToRGBA(const uint8_t* texel, uint32_t channels, uint8_t out[4])
+    {
+        if (channels <= 2u)
+        {
+            out[0] = out[1] = out[2] = texel[0];
+            out[3] = channels == 2u ? texel[1] : 255u;
+        }
+        else
+        {
+            std::memcpy(out, texel, 3);
+            out[3] = channels == 4u ? texel[3] : 255u;
+        }
+    }
+
+    struct FDecodeError
+    {
+        uint32_t maxError{};
+        double meanError{};
+    };
+
+    FDecodeError CompareDecoded(const uint8_t* decoded, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t firstRow,
+        const std::vector<uint8_t>& source, uint32_t channels)
+    {
+        FDecodeError error;
+        uint64_t sum{};
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint8_t expected[4];
+                ExpandToRGBA(source.data() + (static_cast<size_t>(firstRow + y) * width + x) * channels, channels, expected);
+                for (uint32_t c = 0; c < 4u; ++c)
+                {
+                    const uint32_t difference = static_cast<uint32_t>(std::abs(decoded[static_cast<size_t>(y) * rowPitch + x * 4u + c] - expected[c]));
+                    error.maxError = std::max(error.maxError, difference);
+                    sum += difference;
+                }
+            }
+        }
+        error.meanError = static_cast<double>(sum) / (static_cast<double>(width) * height * 4.0);
+        return error;
+    }
+
+    // Decodes through DecodeImage, checks the size and the 256 byte row pitch on the way
+    bool DecodeEncoded(const std::vector<uint8_t>& encoded, uint32_t width, uint32_t height, FImage& image)
+    {
+        FStbImageDecoder decoder;
+        if (not decoder.OpenMemory(encoded) or decoder.GetWidth() != width or decoder.GetHeight() != height or not DecodeImage(decoder, image))
+        {
+            return false;
+        }
+        return image.width == width and image.height == height and image.rowPitch % 256u == 0u and image.rowPitch >= width * 4u
+            and image.rowPitch < width * 4u + 256u and image.texels.size() == static_cast<size_t>(image.rowPitch) * height;
+    }
+
+    const uint32_t c_stbSizes[][2] = { { 1u, 1u }, { 13u, 7u }, { 64u, 2u }, { 65u, 3u }, { 100u, 37u } };
+
+    const FImageDecoderFactory c_stbFactory = []() -> std::unique_ptr<IImageDecoder> { return std::make_unique<FStbImageDecoder>(); };
+
+    // A fixed set in every format: odd sizes, a single texel, rows that already are 256 byte aligned, one broken image
+    std::vector<std::vector<uint8_t>> MakeImageSet(uint64_t& outPixels)
+    {
+        const uint32_t sizes[][2] = { { 1u, 1u }, { 13u, 7u }, { 64u, 64u }, { 257u, 3u }, { 512u, 384u }, { 1024u, 1024u } };
+        const FEncoding encodings[] = { FEncoding::PNG, FEncoding::JPEG, FEncoding::TGARLE };
+        std::vector<std::vector<uint8_t>> images;
+        outPixels = 0;
+        for (const auto& size : sizes)
+        {
+            for (FEncoding encoding : encodings)
+            {
+                const uint32_t channels = encoding == FEncoding::JPEG ? 3u : 4u;
+                images.push_back(Encode(encoding, size[0], size[1], channels, MakePattern(size[0], size[1], channels)));
+                outPixels += static_cast<uint64_t>(size[0]) * size[1];
+            }
+        }
+        images.push_back({ 1u, 2u, 3u });
+        return images;
+    }
+}
+
+F_TEST_CASE(DecodeImageRowPitch)
+{
+    FSyntheticDecoder decoder;
+    F_CHECK(decoder.OpenMemory(MakeSyntheticImage(13u, 7u, 5u)));
+
+    FImage image;
+    F_CHECK(DecodeImage(decoder, image));
+    F_CHECK(image.width == 13u and image.height == 7u);
+    F_CHECK(image.rowPitch == 256u);
+    F_CHECK(image.texels.size() == 256u * 7u);
+    F_CHECK(MatchesSynthetic(image, 5u));
+
+    // Exactly one alignment wide stays unpadded, one texel more takes another step
+    F_CHECK(decoder.OpenMemory(MakeSyntheticImage(64u, 2u, 0u)) and DecodeImage(decoder, image) and image.rowPitch == 256u);
+    F_CHECK(decoder.OpenMemory(MakeSyntheticImage(65u, 2u, 0u)) and DecodeImage(decoder, image) and image.rowPitch == 512u);
+    F_CHECK(decoder.OpenMemory(MakeSyntheticImage(65u, 2u, 0u)) and DecodeImage(decoder, image, 4u) and image.rowPitch == 260u);
+    F_CHECK(MatchesSynthetic(image, 0u));
+
+    // Nothing to decode leaves an empty image behind
+    F_CHECK(decoder.OpenMemory(MakeSyntheticImage(0u, 4u, 0u)));
+    F_CHECK(not DecodeImage(decoder, image));
+    F_CHECK(image.texels.empty() and image.width == 0u);
+    F_CHECK(decoder.OpenMemory(MakeSyntheticImage(4u, 4u, 0u)));
+    F_CHECK(not DecodeImage(decoder, image, 0u));
+}
+
+F_TEST_CASE(StbDecodesLosslessExactly)
+{
+    // PNG in every channel layout, TGA with and without run length encoding
+    const FEncoding encodings[] = { FEncoding::PNG, FEncoding::TGA, FEncoding::TGARLE };
+    for (FEncoding encoding : encodings)
+    {
+        for (uint32_t channels = 1u; channels <= 4u; ++channels)
+        {
+            for (const auto& size : c_stbSizes)
+            {
+                const std::vector<uint8_t> source = MakePattern(size[0], size[1], channels);
+                const std::vector<uint8_t> encoded = Encode(encoding, size[0], size[1], channels, source);
+                F_CHECK(not encoded.empty());
+
+                FImage image;
+                F_CHECK(DecodeEncoded(encoded, size[0], size[1], image));
+                if (image.width == size[0] and image.height == size[1])
+                {
+                    F_CHECK(CompareDecoded(image.texels.data(), image.rowPitch, size[0], size[1], 0u, source, channels).maxError == 0u);
+                }
+            }
+        }
+    }
+}
+
+F_TEST_CASE(StbDecodesJpegWithinTolerance)
+{
+    for (uint32_t channels : { 1u, 3u })
+    {
+        for (const auto& size : c_stbSizes)
+        {
+            const std::vector<uint8_t> source = MakePattern(size[0], size[1], channels);
+            FImage image;
+            F_CHECK(DecodeEncoded(Encode(FEncoding::JPEG, size[0], size[1], channels, source), size[0], size[1], image));
+            if (image.width == size[0] and image.height == size[1])
+            {
+                // Quality 95 on smooth content, alpha is always opaque and counts as exact
+                const FDecodeError error = CompareDecoded(image.texels.data(), image.rowPitch, size[0], size[1], 0u, source, channels);
+                F_CHECK_LE(error.maxError, 16u);
+                F_CHECK_LE(error.meanError, 2.0);
+            }
+        }
+    }
+}
+
+F_TEST_CASE(StbReadRowsAndBrokenImages)
+{
+    const std::vector<uint8_t> source = MakePattern(100u, 37u, 4u);
+    const std::vector<uint8_t> encoded = Encode(FEncoding::PNG, 100u, 37u, 4u, source);
+
+    // Rows come out of the one decoded copy in any order, into any pitch that holds them
+    FStbImageDecoder decoder;
+    F_CHECK(decoder.OpenMemory(encoded));
+    constexpr uint32_t c_pitch = 100u * 4u + 12u;
+    std::vector<uint8_t> rows(c_pitch * 5u);
+    F_CHECK(decoder.ReadRows(rows.data(), 30u, 5u, c_pitch));
+    F_CHECK(CompareDecoded(rows.data(), c_pitch, 100u, 5u, 30u, source, 4u).maxError == 0u);
+    F_CHECK(decoder.ReadRows(rows.data(), 0u, 2u, c_pitch));
+    F_CHECK(CompareDecoded(rows.data(), c_pitch, 100u, 2u, 0u, source, 4u).maxError == 0u);
+    F_CHECK(not decoder.ReadRows(rows.data(), 33u, 5u, c_pitch));
+    F_CHECK(not decoder.ReadRows(rows.data(), 0u, 1u, 100u * 4u - 1u));
+    F_CHECK(not decoder.ReadRows(nullptr, 0u, 1u, c_pitch));
+
+    // Nothing, garbage, and a PNG cut off after its header: the last opens but cannot decode
+    F_CHECK(not decoder.OpenMemory({}));
+    F_CHECK(decoder.GetWidth() == 0u and decoder.GetHeight() == 0u);
+    const std::vector<uint8_t> garbage(64u, 0x5au);
+    F_CHECK(not decoder.OpenMemory(garbage));
+    const std::vector<uint8_t> truncated(encoded.begin(), encoded.begin() + static_cast<std::ptrdiff_t>(encoded.size() / 2u));
+    FImage image;
+    F_CHECK(not (decoder.OpenMemory(truncated) and DecodeImage(decoder, image)));
+}
+
+F_TEST_CASE(DecodeThroughputSingleThread)
+{
+    uint64_t pixels;
+    const std::vector<std::vector<uint8_t>> images = MakeImageSet(pixels);
+
+    constexpr uint32_t c_iterations = 3u;
+    const FDecodeThroughput result = MeasureDecodeThroughput(c_stbFactory, images, c_iterations);
+    F_CHECK(result.images == images.size() * c_iterations);
+    F_CHECK(result.failures == c_iterations);
+    F_CHECK(result.pixels == pixels * c_iterations);
+    F_CHECK(result.seconds > 0.0 and result.megapixelsPerSecond > 0.0);
+    std::printf("    1 thread: %.1f MPix/s\n", result.megapixelsPerSecond);
+
+    // A factory that cannot create anything fails every image
+    const FDecodeThroughput none = MeasureDecodeThroughput([]() { return std::unique_ptr<IImageDecoder>(); }, images);
+    F_CHECK(none.failures == images.size() and none.pixels == 0u);
+}
+
+F_TEST_CASE(DecodeThroughputParallel)
+{
+    uint64_t pixels;
+    const std::vector<std::vector<uint8_t>> images = MakeImageSet(pixels);
+    FThreadPool pool(4u);
+
+    constexpr uint32_t c_iterations = 8u;
+    for (uint32_t maxInFlight : { 1u, 3u, 64u })
+    {
+        const FDecodeThroughput result = MeasureDecodeThroughput(pool, maxInFlight, c_stbFactory, images, c_iterations);
+        F_CHECK(result.images == images.size() * c_iterations);
+        F_CHECK(result.failures == c_iterations);
+        F_CHECK(result.pixels == pixels * c_iterations);
+        std::printf("    %u threads, %u in flight: %.1f MPix/s\n", pool.GetThreadCount() + 1u, maxInFlight, result.megapixelsPerSecond);
+    }
+}
+
+F_TEST_CASE(DecodeImagesParallelInFlightBound)
+{
+    FThreadPool pool(4u);
+    constexpr size_t c_count = 200;
+    constexpr uint32_t c_maxInFlight = 3u;
+
+    std::atomic<uint32_t> alive{}, maxAlive{}, consumers{};
+    std::atomic<bool> overlapped{};
+    std::vector<uint32_t> consumed(c_count);
+
+    DecodeImagesParallel(pool, c_count, c_maxInFlight,
+        [&](size_t index, FTextureData& out) {
+            const uint32_t now = ++alive;
+            uint32_t seen = maxAlive;
+            while (now > seen and not maxAlive.compare_exchange_weak(seen, now)) {}
+
+            // Every seventh one fails and is never consumed
+            if (index % 7u == 3u)
+            {
+                --alive;
+                return false;
+            }
+            FSyntheticDecoder decoder;
+            out.levels.resize(1);
+            return decoder.OpenMemory(MakeSyntheticImage(16u + static_cast<uint32_t>(index % 5u), 9u, static_cast<uint32_t>(index)))
+                and DecodeImage(decoder, out.levels[0]);
+        },
+        [&](size_t index, FTextureData& texture) {
+            if (++consumers > 1u) overlapped = true;
+            consumed[index]++;
+            if (not MatchesSynthetic(texture.levels[0], static_cast<uint32_t>(index))) consumed[index] += 100u;
+            --consumers;
+            --alive;
+        });
+
+    F_CHECK(not overlapped);
+    F_CHECK_LE(maxAlive.load(), c_maxInFlight);
+    for (size_t i = 0; i < c_count; ++i)
+    {
+        F_CHECK(consumed[i] == (i % 7u == 3u ? 0u : 1u));
+    }
+}
+
+F_TEST_CASE(DecodeImagesParallelExceptions)
+{
+    FThreadPool pool(4u);
+
+    // A throwing decode is rethrown once the rest finished, the others are still consumed
+    std::atomic<uint32_t> consumed{};
+    bool thrown = false;
+    try
+    {
+        DecodeImagesParallel(pool, 50u, 2u,
+            [](size_t index, FTextureData&) {
+                if (index == 20u) throw std::runtime_error("decode");
+                return true;
+            },
+            [&](size_t, FTextureData&) { consumed++; });
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    F_CHECK(thrown);
+    F_CHECK(consumed == 49u);
+
+    // A throwing consumer stops the remaining decodes instead of leaving them waiting for a slot
+    std::atomic<uint32_t> decoded{};
+    thrown = false;
+    try
+    {
+        DecodeImagesParallel(pool, 1000u, 2u,
+            [&](size_t, FTextureData&) {
+                decoded++;
+                return true;
+            },
+            [](size_t, FTextureData&) { throw std::runtime_error("consume"); });
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    F_CHECK(thrown);
+    F_CHECK(decoded < 1000u);
+}
@@ -0,0 +1,161 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+#include "DXMaterial/MeshOptimize.h"
+
+namespace
+{
+    struct FTestVertex
+    {
+        float position[3];
+        uint32_t id;
+    };
+
+    struct FTestMesh
+    {
+        std::vector<FTestVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // A (segments x rings) grid wrapped around a sphere, closed enough for outward facing clusters to exist
+    FTestMesh MakeSphere(uint32_t segments, uint32_t rings)
+    {
+        FTestMesh mesh;
+        for (uint32_t r = 0; r <= rings; ++r)
+        {
+            const float theta = 3.14159265f * static_cast<float>(r) / static_cast<float>(rings);
+            for (uint32_t s = 0; s <= segments; ++s)
+            {
+                const float phi = 6.2831853f * static_cast<float>(s) / static_cast<float>(segments);
+                const uint32_t id = static_cast<uint32_t>(mesh.vertices.size());
+                mesh.vertices.push_back({ { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) }, id });
+            }
+        }
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                const uint32_t a = r * (segments + 1u) + s;
+                const uint32_t b = a + segments + 1u;
+                mesh.indices.insert(mesh.indices.end(), { a, b, a + 1u, a + 1u, b, b + 1u });
+            }
+        }
+        return mesh;
+    }
+
+    void ShuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        for (size_t t = indices.size() / 3u - 1u; t > 0; --t)
+        {
+            const size_t other = std::uniform_int_distribution<size_t>(0, t)(rng);
+            std::swap_ranges(indices.begin() + static_cast<std::ptrdiff_t>(t * 3u), indices.begin() + static_cast<std::ptrdiff_t>(t * 3u + 3u),
+                indices.begin() + static_cast<std::ptrdiff_t>(other * 3u));
+        }
+    }
+
+    // The same triangles, corners in the same order, in any triangle order
+    bool SameTriangles(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+    {
+        if (a.size() != b.size()) return false;
+        std::vector<std::array<uint32_t, 3>> ta, tb;
+        for (size_t i = 0; i + 2u < a.size(); i += 3u)
+        {
+            ta.push_back({ a[i], a[i + 1u], a[i + 2u] });
+            tb.push_back({ b[i], b[i + 1u], b[i + 2u] });
+        }
+        std::sort(ta.begin(), ta.end());
+        std::sort(tb.begin(), tb.end());
+        return ta == tb;
+    }
+
+    float Acmr(const FTestMesh& mesh, const std::vector<uint32_t>& indices)
+    {
+        return AnalyzeVertexCache(indices.data(), indices.size(), mesh.vertices.size()).acmr;
+    }
+}
+
+F_TEST_CASE(VertexCacheStats)
+{
+    // A lone triangle misses every vertex, drawing it again hits all of them
+    const uint32_t twice[] = { 0u, 1u, 2u, 0u, 1u, 2u };
+    FVertexCacheStats stats = AnalyzeVertexCache(twice, 3u, 3u);
+    F_CHECK(stats.acmr == 3.f and stats.atvr == 1.f);
+    stats = AnalyzeVertexCache(twice, 6u, 3u);
+    F_CHECK(stats.acmr == 1.5f and stats.atvr == 1.f);
+
+    // Four vertices cycled through a cache of three miss every time
+    const uint32_t cycle[] = { 0u, 1u, 2u, 3u, 0u, 1u, 2u, 3u, 0u };
+    stats = AnalyzeVertexCache(cycle, 9u, 4u, 3u);
+    F_CHECK(stats.acmr == 3.f and stats.atvr == 9.f / 4.f);
+}
+
+F_TEST_CASE(VertexCacheOptimizeNeverWorse)
+{
+    const FTestMesh sphere = MakeSphere(96u, 48u);
+
+    // Shuffled is about as bad as it gets, row order is already decent: both only get better
+    std::vector<uint32_t> shuffled = sphere.indices;
+    ShuffleTriangles(shuffled, 3u);
+    const std::vector<uint32_t>* inputs[] = { &sphere.indices, &shuffled };
+    for (const std::vector<uint32_t>* input : inputs)
+    {
+        std::vector<uint32_t> optimized = *input;
+        OptimizeVertexCache(optimized.data(), optimized.size(), sphere.vertices.size());
+        const float before = Acmr(sphere, *input);
+        const float after = Acmr(sphere, optimized);
+        std::printf("    ACMR %.3f -> %.3f\n", before, after);
+        F_CHECK_LE(after, before);
+        F_CHECK_LE(after, 0.75f);
+        F_CHECK(SameTriangles(optimized, *input));
+
+        // Overdraw ordering gives up at most the threshold on top of the cache optimized order
+        std::vector<uint32_t> overdraw = optimized;
+        OptimizeOverdraw(overdraw.data(), overdraw.size(), sphere.vertices[0].position, sizeof(FTestVertex), sphere.vertices.size(), 1.05f);
+        F_CHECK_LE(Acmr(sphere, overdraw), after * 1.05f + 1e-4f);
+        F_CHECK(SameTriangles(overdraw, *input));
+    }
+
+    // Trailing indices of a partial triangle and empty lists are left alone
+    std::vector<uint32_t> partial = { 0u, 1u, 2u, 2u, 1u, 3u, 1u };
+    OptimizeVertexCache(partial.data(), partial.size(), 4u);
+    F_CHECK(partial.back() == 1u);
+    F_CHECK(SameTriangles({ partial.begin(), partial.end() - 1 }, { 0u, 1u, 2u, 2u, 1u, 3u }));
+    OptimizeVertexCache(nullptr, 0u, 0u);
+}
+
+F_TEST_CASE(VertexFetchCompacts)
+{
+    FTestMesh mesh = MakeSphere(32u, 16u);
+    // Triangles in random order, some dropped so their vertices end up unreferenced
+    ShuffleTriangles(mesh.indices, 7u);
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3u)
+    {
+        if (mesh.indices[i] % 7u != 0u) indices.insert(indices.end(), mesh.indices.begin() + static_cast<std::ptrdiff_t>(i), mesh.indices.begin() + static_cast<std::ptrdiff_t>(i + 3u));
+    }
+    std::vector<uint32_t> referenced = indices;
+    std::sort(referenced.begin(), referenced.end());
+    referenced.erase(std::unique(referenced.begin(), referenced.end()), referenced.end());
+
+    std::vector<FTestVertex> vertices = mesh.vertices;
+    std::vector<uint32_t> remapped = indices;
+    const size_t count = OptimizeVertexFetch(vertices.data(), sizeof(FTestVertex), vertices.size(), remapped.data(), remapped.size());
+    F_CHECK(count == referenced.size() and count < mesh.vertices.size());
+
+    // Same vertices behind every index, numbered in first use order
+    uint32_t next = 0;
+    bool firstUse = true;
+    bool sameVertex = true;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        firstUse = firstUse and remapped[i] <= next;
+        next = std::max(next, remapped[i] + 1u);
+        sameVertex = sameVertex and remapped[i] < count and vertices[remapped[i]].id == indices[i];
+    }
+    F_CHECK(firstUse and sameVertex);
+}
@@ -0,0 +1,147 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <random>
+
+#include "DXMaterial/MeshSplit.h"
+
+namespace
+{
+    // (columns x rows) quads, (columns + 1) * (rows + 1) vertices
+    std::vector<uint32_t> MakeGrid(uint32_t columns, uint32_t rows)
+    {
+        std::vector<uint32_t> indices;
+        for (uint32_t r = 0; r < rows; ++r)
+        {
+            for (uint32_t c = 0; c < columns; ++c)
+            {
+                const uint32_t a = r * (columns + 1u) + c;
+                const uint32_t b = a + columns + 1u;
+                indices.insert(indices.end(), { a, b, a + 1u, a + 1u, b, b + 1u });
+            }
+        }
+        return indices;
+    }
+
+    // Triangles in random order, so a range has to hold vertices from all over the mesh
+    void ShuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        for (size_t t = indices.size() / 3u - 1u; t > 0; --t)
+        {
+            const size_t other = std::uniform_int_distribution<size_t>(0, t)(rng);
+            std::swap_ranges(indices.begin() + static_cast<std::ptrdiff_t>(t * 3u), indices.begin() + static_cast<std::ptrdiff_t>(t * 3u + 3u),
+                indices.begin() + static_cast<std::ptrdiff_t>(other * 3u));
+        }
+    }
+
+    // Checks the ranges appended from 'firstRange' on and rebuilds the 32 bit source indices they draw
+    std::vector<uint32_t> Expand(const FIndexBuffer16& buffer, size_t firstRange, size_t& outMaxRangeVertices)
+    {
+        std::vector<uint32_t> expanded;
+        outMaxRangeVertices = 0;
+        for (size_t r = firstRange; r < buffer.ranges.size(); ++r)
+        {
+            const FDrawRange& range = buffer.ranges[r];
+            F_CHECK(range.indexCount % 3u == 0u);
+            F_CHECK(range.indexOffset + range.indexCount <= buffer.indices.size());
+            // Consecutive, nothing skipped in between
+            if (r > firstRange)
+            {
+                F_CHECK(range.indexOffset == buffer.ranges[r - 1].indexOffset + buffer.ranges[r - 1].indexCount);
+            }
+
+            std::vector<uint16_t> used(buffer.indices.begin() + range.indexOffset, buffer.indices.begin() + range.indexOffset + range.indexCount);
+            std::sort(used.begin(), used.end());
+            used.erase(std::unique(used.begin(), used.end()), used.end());
+            outMaxRangeVertices = std::max(outMaxRangeVertices, used.size());
+
+            for (uint32_t i = range.indexOffset; i < range.indexOffset + range.indexCount; ++i)
+            {
+                const size_t vertex = static_cast<size_t>(range.baseVertex) + buffer.indices[i];
+                if (buffer.vertexRemap.empty())
+                {
+                    expanded.push_back(static_cast<uint32_t>(vertex));
+                }
+                else
+                {
+                    F_CHECK(vertex < buffer.vertexRemap.size());
+                    expanded.push_back(buffer.vertexRemap[std::min(vertex, buffer.vertexRemap.size() - 1u)]);
+                }
+            }
+        }
+        return expanded;
+    }
+}
+
+F_TEST_CASE(IndexBuffer16KeepsSmallMeshes)
+{
+    // 256 x 255 quads is exactly 65536 vertices, the largest mesh that needs no split
+    const std::vector<uint32_t> indices = MakeGrid(255u, 255u);
+    FIndexBuffer16 buffer;
+    BuildIndexBuffer16(indices.data(), indices.size(), c_maxVertices16, buffer);
+
+    F_CHECK(buffer.ranges.size() == 1u and buffer.vertexRemap.empty());
+    F_CHECK(buffer.ranges[0].indexOffset == 0u and buffer.ranges[0].baseVertex == 0);
+    F_CHECK(*std::max_element(buffer.indices.begin(), buffer.indices.end()) == 0xFFFFu);
+    size_t maxRangeVertices;
+    F_CHECK(Expand(buffer, 0u, maxRangeVertices) == indices);
+    F_CHECK(maxRangeVertices == c_maxVertices16);
+}
+
+F_TEST_CASE(IndexBuffer16SplitsLargeMeshes)
+{
+    // 400 x 300 quads, 120701 vertices, in random triangle order
+    std::vector<uint32_t> indices = MakeGrid(400u, 300u);
+    const size_t vertexCount = 401u * 301u;
+    ShuffleTriangles(indices, 5u);
+
+    FIndexBuffer16 buffer;
+    BuildIndexBuffer16(indices.data(), indices.size(), vertexCount, buffer);
+    F_CHECK(buffer.ranges.size() >= 2u);
+    F_CHECK(buffer.ranges[0].indexOffset == 0u and buffer.ranges[0].baseVertex == 0);
+
+    // Every range addresses at most 65536 vertices, so its indices fit 16 bits, and the triangles come
+    // back in their original order and winding
+    size_t maxRangeVertices;
+    F_CHECK(Expand(buffer, 0u, maxRangeVertices) == indices);
+    F_CHECK_LE(maxRangeVertices, c_maxVertices16);
+    F_CHECK(buffer.indices.size() == indices.size());
+
+    // A second list over the same vertices, like a LOD, appends its own ranges and duplicated vertices
+    std::vector<uint32_t> lod(indices.begin(), indices.begin() + static_cast<std::ptrdiff_t>(indices.size() / 2u / 3u * 3u));
+    const size_t firstLodRange = buffer.ranges.size();
+    const size_t remapBefore = buffer.vertexRemap.size();
+    BuildIndexBuffer16(lod.data(), lod.size(), vertexCount, buffer);
+    F_CHECK(buffer.ranges[firstLodRange].indexOffset == indices.size());
+    F_CHECK(static_cast<size_t>(buffer.ranges[firstLodRange].baseVertex) == remapBefore);
+    F_CHECK(Expand(buffer, firstLodRange, maxRangeVertices) == lod);
+    F_CHECK_LE(maxRangeVertices, c_maxVertices16);
+
+    // A trailing partial triangle is dropped
+    FIndexBuffer16 partial;
+    BuildIndexBuffer16(indices.data(), indices.size() - 1u, vertexCount, partial);
+    F_CHECK(partial.indices.size() == indices.size() - 3u);
+}
+
+F_TEST_CASE(IndexBuffer16RemapsVertexBytes)
+{
+    struct FTestVertex
+    {
+        uint32_t id;
+        float data[3];
+    };
+    std::vector<FTestVertex> vertices(70000u);
+    for (uint32_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i] = { i, { static_cast<float>(i), 0.5f, -static_cast<float>(i) } };
+    }
+
+    const std::vector<uint32_t> remap = { 69999u, 0u, 12345u, 0u, 65536u };
+    std::vector<FTestVertex> out(remap.size());
+    RemapVertexBytes(vertices.data(), sizeof(FTestVertex), remap, out.data());
+    for (size_t i = 0; i < remap.size(); ++i)
+    {
+        F_CHECK(out[i].id == remap[i] and out[i].data[0] == static_cast<float>(remap[i]) and out[i].data[2] == -static_cast<float>(remap[i]));
+    }
+}
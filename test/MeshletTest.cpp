@@ -0,0 +1,223 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "DXMaterial/Meshlet.h"
+
+namespace
+{
+    // Interleaved like the importer's vertices, positions first
+    struct FTestVertex
+    {
+        float position[3];
+        float other[11];
+    };
+
+    struct FTestMesh
+    {
+        std::vector<FTestVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // A (segments x rings) grid wrapped around a sphere, curved enough for the cones to matter
+    FTestMesh MakeSphere(uint32_t segments, uint32_t rings)
+    {
+        FTestMesh mesh;
+        for (uint32_t r = 0; r <= rings; ++r)
+        {
+            const float theta = 3.14159265f * static_cast<float>(r) / static_cast<float>(rings);
+            for (uint32_t s = 0; s <= segments; ++s)
+            {
+                const float phi = 6.2831853f * static_cast<float>(s) / static_cast<float>(segments);
+                FTestVertex v{};
+                v.position[0] = std::sin(theta) * std::cos(phi) * 2.f + 1.f;
+                v.position[1] = std::cos(theta) * 2.f;
+                v.position[2] = std::sin(theta) * std::sin(phi) * 2.f - 3.f;
+                mesh.vertices.push_back(v);
+            }
+        }
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                const uint32_t a = r * (segments + 1u) + s;
+                const uint32_t b = a + segments + 1u;
+                mesh.indices.insert(mesh.indices.end(), { a, b, a + 1u, a + 1u, b, b + 1u });
+            }
+        }
+        return mesh;
+    }
+
+    void Build(const FTestMesh& mesh, FMeshletData& out, size_t maxVertices = c_meshletMaxVertices, size_t maxTriangles = c_meshletMaxTriangles)
+    {
+        BuildMeshlets(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(FTestVertex), mesh.vertices.size(),
+            out, maxVertices, maxTriangles);
+    }
+
+    float Dot(const float a[3], const float b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    void CheckMeshlets(const FTestMesh& mesh, const FMeshletData& data, size_t maxVertices, size_t maxTriangles)
+    {
+        std::vector<uint32_t> rebuilt;
+        for (const FMeshlet& meshlet : data.meshlets)
+        {
+            F_CHECK(meshlet.vertexCount <= maxVertices);
+            F_CHECK(meshlet.triangleCount <= maxTriangles);
+            F_CHECK(meshlet.triangleCount > 0u);
+            F_CHECK(meshlet.vertexOffset + meshlet.vertexCount <= data.vertices.size());
+            F_CHECK(meshlet.triangleOffset + meshlet.triangleCount * 3u <= data.triangles.size());
+
+            // Local vertices are distinct mesh vertices
+            std::vector<uint32_t> local(data.vertices.begin() + meshlet.vertexOffset, data.vertices.begin() + meshlet.vertexOffset + meshlet.vertexCount);
+            std::sort(local.begin(), local.end());
+            F_CHECK(std::adjacent_find(local.begin(), local.end()) == local.end());
+
+            for (uint32_t i = 0; i < meshlet.triangleCount * 3u; ++i)
+            {
+                const uint8_t index = data.triangles[meshlet.triangleOffset + i];
+                F_CHECK(index < meshlet.vertexCount);
+                rebuilt.push_back(data.vertices[meshlet.vertexOffset + std::min<uint32_t>(index, meshlet.vertexCount - 1u)]);
+            }
+
+            // Every vertex inside the sphere
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            {
+                const float* p = mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position;
+                const float d[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+                F_CHECK_LE(std::sqrt(Dot(d, d)), meshlet.radius * 1.0001f + 1e-5f);
+            }
+
+            // A culling cone holds every triangle normal and its apex is behind every triangle plane
+            if (meshlet.coneCutoff < 1.f)
+            {
+                F_CHECK_LE(std::abs(Dot(meshlet.coneAxis, meshlet.coneAxis) - 1.f), 1e-4f);
+                const float minDot = std::sqrt(1.f - meshlet.coneCutoff * meshlet.coneCutoff);
+                for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+                {
+                    const float* p[3];
+                    for (uint32_t c = 0; c < 3u; ++c)
+                    {
+                        p[c] = mesh.vertices[data.vertices[meshlet.vertexOffset + data.triangles[meshlet.triangleOffset + t * 3u + c]]].position;
+                    }
+                    const float e0[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+                    const float e1[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+                    float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+                    // The normal of a sliver at the poles is rounding noise
+                    const float length = std::sqrt(Dot(n, n));
+                    if (length <= 1e-6f)
+                    {
+                        continue;
+                    }
+                    for (float& x : n) x /= length;
+                    F_CHECK(Dot(n, meshlet.coneAxis) >= minDot - 1e-4f);
+
+                    const float toApex[3] = { meshlet.coneApex[0] - p[0][0], meshlet.coneApex[1] - p[0][1], meshlet.coneApex[2] - p[0][2] };
+                    F_CHECK_LE(Dot(toApex, n), 1e-4f);
+                }
+            }
+        }
+
+        // In index order, so every triangle shows up exactly once and where it was
+        F_CHECK(rebuilt == mesh.indices);
+    }
+}
+
+F_TEST_CASE(MeshletLimitsCoverageAndBounds)
+{
+    const FTestMesh mesh = MakeSphere(96u, 48u);
+    FMeshletData data;
+
+    Build(mesh, data);
+    F_CHECK(not data.meshlets.empty());
+    CheckMeshlets(mesh, data, c_meshletMaxVertices, c_meshletMaxTriangles);
+
+    // Tight custom limits, the vertex limit is hit before the triangle limit and the other way around
+    Build(mesh, data, 16u, 124u);
+    CheckMeshlets(mesh, data, 16u, 124u);
+    Build(mesh, data, 255u, 8u);
+    CheckMeshlets(mesh, data, 255u, 8u);
+
+    // Out of range limits are clamped: at least one triangle, no more than 256 vertices for the 8 bit indices
+    Build(mesh, data, 1u, 0u);
+    CheckMeshlets(mesh, data, 3u, 1u);
+    F_CHECK(data.meshlets.size() * 3u == mesh.indices.size());
+}
+
+F_TEST_CASE(MeshletDegenerateInput)
+{
+    FTestMesh mesh = MakeSphere(8u, 4u);
+    // Repeated corners and a zero area triangle still get a cluster slot each
+    mesh.indices.insert(mesh.indices.end(), { 0u, 0u, 0u, 5u, 5u, 6u, 7u, 8u, 7u });
+    FMeshletData data;
+    Build(mesh, data);
+    CheckMeshlets(mesh, data, c_meshletMaxVertices, c_meshletMaxTriangles);
+
+    // A flat patch has one normal, its cone is as tight as it gets
+    FTestMesh flat;
+    for (uint32_t i = 0; i < 4u; ++i)
+    {
+        FTestVertex v{};
+        v.position[0] = static_cast<float>(i & 1u);
+        v.position[1] = static_cast<float>(i >> 1u);
+        flat.vertices.push_back(v);
+    }
+    flat.indices = { 0u, 2u, 1u, 1u, 2u, 3u };
+    Build(flat, data);
+    F_CHECK(data.meshlets.size() == 1u);
+    F_CHECK_LE(data.meshlets[0].coneCutoff, 1e-3f);
+    CheckMeshlets(flat, data, c_meshletMaxVertices, c_meshletMaxTriangles);
+
+    Build({ flat.vertices, {} }, data);
+    F_CHECK(data.meshlets.empty() and data.vertices.empty() and data.triangles.empty());
+}
+
+F_TEST_CASE(MeshletDeterministic)
+{
+    FTestMesh mesh = MakeSphere(64u, 32u);
+    // Shuffled triangles, nothing about the order may leak into run to run differences
+    std::mt19937 rng(5u);
+    for (size_t t = mesh.indices.size() / 3u - 1u; t > 0; --t)
+    {
+        const size_t other = std::uniform_int_distribution<size_t>(0, t)(rng);
+        std::swap_ranges(mesh.indices.begin() + static_cast<std::ptrdiff_t>(t * 3u), mesh.indices.begin() + static_cast<std::ptrdiff_t>(t * 3u + 3u),
+            mesh.indices.begin() + static_cast<std::ptrdiff_t>(other * 3u));
+    }
+
+    FMeshletData first, second;
+    Build(mesh, first);
+    // The second one reuses a buffer holding other output
+    Build(MakeSphere(8u, 4u), second);
+    Build(mesh, second);
+
+    F_CHECK(first.vertices == second.vertices);
+    F_CHECK(first.triangles == second.triangles);
+    F_CHECK(first.meshlets.size() == second.meshlets.size());
+    F_CHECK(first.meshlets.size() == second.meshlets.size() and
+        std::memcmp(first.meshlets.data(), second.meshlets.data(), first.meshlets.size() * sizeof(FMeshlet)) == 0);
+    CheckMeshlets(mesh, first, c_meshletMaxVertices, c_meshletMaxTriangles);
+}
+
+F_TEST_CASE(MeshletThroughput)
+{
+    const FTestMesh mesh = MakeSphere(1024u, 512u);
+    FMeshletData data;
+
+    const auto start = std::chrono::steady_clock::now();
+    constexpr int c_iterations = 4;
+    for (int i = 0; i < c_iterations; ++i)
+    {
+        Build(mesh, data);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double triangles = static_cast<double>(mesh.indices.size() / 3u) * c_iterations;
+    std::printf("    %zu meshlets, %.1f M triangles/s\n", data.meshlets.size(), triangles / seconds / 1e6);
+    F_CHECK(not data.meshlets.empty());
+}
@@ -0,0 +1,240 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "DXMaterial/Mipmap.h"
+
+namespace
+{
+    FImage MakeImage(uint32_t width, uint32_t height, uint32_t rowPitch = 0)
+    {
+        FImage image;
+        image.width = width;
+        image.height = height;
+        image.rowPitch = rowPitch ? rowPitch : width * 4u;
+        image.texels.resize(static_cast<size_t>(image.rowPitch) * height);
+        return image;
+    }
+
+    uint8_t* Texel(FImage& image, uint32_t x, uint32_t y)
+    {
+        return image.texels.data() + static_cast<size_t>(y) * image.rowPitch + x * 4u;
+    }
+
+    const uint8_t* Texel(const FImage& image, uint32_t x, uint32_t y)
+    {
+        return image.texels.data() + static_cast<size_t>(y) * image.rowPitch + x * 4u;
+    }
+
+    std::vector<FImage> Generate(const FImage& source, FMipFilter filter, bool srgb, uint32_t maxLevels = 0, uint32_t alignment = 256u)
+    {
+        FMipOptions options;
+        options.filter = filter;
+        options.srgb = srgb;
+        options.maxLevels = maxLevels;
+        options.rowPitchAlignment = alignment;
+        std::vector<FImage> levels;
+        GenerateMips(FImage(source), options, levels);
+        return levels;
+    }
+
+    // Straight from the definitions in double precision, one texel at a time: no tables, no ring, no SIMD
+    double ReferenceWeight(FMipFilter filter, double t)
+    {
+        t = std::fabs(t);
+        if (filter == FMipFilter::FMipFilter_BOX)
+        {
+            return t <= 0.5 ? 1.0 : 0.0;
+        }
+        if (t >= 3.0)
+        {
+            return 0.0;
+        }
+        const double pi = 3.14159265358979323846;
+        const double sinc = t < 1e-5 ? 1.0 : std::sin(pi * t) / (pi * t);
+        const double ratio = t / 3.0;
+        return sinc * std::cyl_bessel_i(0.0, 4.0 * std::sqrt(1.0 - ratio * ratio)) / std::cyl_bessel_i(0.0, 4.0);
+    }
+
+    struct FReferenceTap
+    {
+        uint32_t index;
+        double weight;
+    };
+
+    std::vector<FReferenceTap> ReferenceTaps(FMipFilter filter, uint32_t srcSize, uint32_t dstSize, uint32_t d)
+    {
+        // The sample positions are computed like GenerateMips does, so box edges that land exactly on a
+        // texel boundary are decided the same way
+        const float scale = static_cast<float>(srcSize) / static_cast<float>(dstSize);
+        const float center = (static_cast<float>(d) + 0.5f) * scale;
+        const int64_t radius = static_cast<int64_t>(std::ceil((filter == FMipFilter::FMipFilter_BOX ? 0.5f : 3.f) * scale)) + 1;
+
+        std::vector<FReferenceTap> taps;
+        double sum = 0.0;
+        for (int64_t s = static_cast<int64_t>(center) - radius; s <= static_cast<int64_t>(center) + radius; ++s)
+        {
+            const double weight = ReferenceWeight(filter, (static_cast<float>(s) + 0.5f - center) / scale);
+            if (weight == 0.0) continue;
+            taps.push_back({ static_cast<uint32_t>(std::clamp<int64_t>(s, 0, static_cast<int64_t>(srcSize) - 1)), weight });
+            sum += weight;
+        }
+        for (FReferenceTap& tap : taps)
+        {
+            tap.weight /= sum;
+        }
+        return taps;
+    }
+
+    double SrgbToLinear(double c)
+    {
+        return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+    }
+
+    double LinearToSrgb(double l)
+    {
+        return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+    }
+
+    // Largest difference of any channel between 'dst' and the reference downsample of 'src'
+    uint32_t CompareWithReference(const FImage& src, const FImage& dst, FMipFilter filter, bool srgb)
+    {
+        uint32_t maxError = 0;
+        for (uint32_t dy = 0; dy < dst.height; ++dy)
+        {
+            const std::vector<FReferenceTap> tapsY = ReferenceTaps(filter, src.height, dst.height, dy);
+            for (uint32_t dx = 0; dx < dst.width; ++dx)
+            {
+                const std::vector<FReferenceTap> tapsX = ReferenceTaps(filter, src.width, dst.width, dx);
+                double sum[4]{};
+                for (const FReferenceTap& ty : tapsY)
+                {
+                    for (const FReferenceTap& tx : tapsX)
+                    {
+                        const uint8_t* texel = Texel(src, tx.index, ty.index);
+                        for (uint32_t c = 0; c < 4u; ++c)
+                        {
+                            const double value = texel[c] / 255.0;
+                            sum[c] += tx.weight * ty.weight * (srgb and c < 3u ? SrgbToLinear(value) : value);
+                        }
+                    }
+                }
+                for (uint32_t c = 0; c < 4u; ++c)
+                {
+                    const double linear = std::clamp(sum[c], 0.0, 1.0);
+                    const double expected = std::round((srgb and c < 3u ? LinearToSrgb(linear) : linear) * 255.0);
+                    maxError = std::max(maxError, static_cast<uint32_t>(std::fabs(Texel(dst, dx, dy)[c] - expected)));
+                }
+            }
+        }
+        return maxError;
+    }
+}
+
+F_TEST_CASE(MipSrgbAveragesInLinearSpace)
+{
+    // A 2x2 checker of black and white, the alpha checker runs the other way
+    FImage checker = MakeImage(2u, 2u);
+    for (uint32_t i = 0; i < 4u; ++i)
+    {
+        const uint8_t on = ((i ^ (i >> 1u)) & 1u) ? 255u : 0u;
+        uint8_t* texel = Texel(checker, i & 1u, i >> 1u);
+        texel[0] = texel[1] = texel[2] = on;
+        texel[3] = static_cast<uint8_t>(255u - on);
+    }
+
+    for (FMipFilter filter : { FMipFilter::FMipFilter_BOX, FMipFilter::FMipFilter_KAISER })
+    {
+        // Half the light is 0.5 linear, 188 once sRGB encoded, not the 128 of averaging the encoded bytes
+        const std::vector<FImage> srgb = Generate(checker, filter, true);
+        F_CHECK(srgb.size() == 2u);
+        const uint8_t* texel = Texel(srgb[1], 0u, 0u);
+        F_CHECK(texel[0] == 188u and texel[1] == 188u and texel[2] == 188u);
+        // Coverage, never gamma corrected
+        F_CHECK(texel[3] == 128u);
+
+        const std::vector<FImage> unorm = Generate(checker, filter, false);
+        texel = Texel(unorm[1], 0u, 0u);
+        F_CHECK(texel[0] == 128u and texel[1] == 128u and texel[2] == 128u and texel[3] == 128u);
+    }
+}
+
+F_TEST_CASE(MipChainLevelSizes)
+{
+    // Odd and non power of two sizes, each level halves rounding down and stops at 1x1
+    const uint32_t sizes[][3] = { { 1u, 1u, 1u }, { 2u, 1u, 2u }, { 5u, 3u, 3u }, { 1u, 37u, 6u }, { 300u, 7u, 9u }, { 640u, 480u, 10u }, { 1024u, 1024u, 11u } };
+    for (const auto& size : sizes)
+    {
+        F_CHECK(MipLevelCount(size[0], size[1]) == size[2]);
+
+        FImage source = MakeImage(size[0], size[1]);
+        std::fill(source.texels.begin(), source.texels.end(), uint8_t{ 77u });
+        for (FMipFilter filter : { FMipFilter::FMipFilter_BOX, FMipFilter::FMipFilter_KAISER })
+        {
+            const std::vector<FImage> levels = Generate(source, filter, true);
+            F_CHECK(levels.size() == size[2]);
+            for (size_t level = 1; level < levels.size(); ++level)
+            {
+                const FImage& image = levels[level];
+                F_CHECK(image.width == std::max(levels[level - 1].width / 2u, 1u));
+                F_CHECK(image.height == std::max(levels[level - 1].height / 2u, 1u));
+                F_CHECK(image.rowPitch % 256u == 0u and image.rowPitch >= image.width * 4u and image.rowPitch < image.width * 4u + 256u);
+                F_CHECK(image.texels.size() == static_cast<size_t>(image.rowPitch) * image.height);
+
+                // Normalized weights keep a constant image constant, clamped edges included
+                bool constant = true;
+                for (uint32_t y = 0; y < image.height; ++y)
+                {
+                    for (uint32_t x = 0; x < image.width * 4u; ++x)
+                    {
+                        constant = constant and image.texels[static_cast<size_t>(y) * image.rowPitch + x] == 77u;
+                    }
+                }
+                F_CHECK(constant);
+            }
+            F_CHECK(levels.back().width == 1u and levels.back().height == 1u);
+        }
+    }
+
+    FImage source = MakeImage(300u, 7u, 1536u);
+    F_CHECK(Generate(source, FMipFilter::FMipFilter_BOX, false, 3u).size() == 3u);
+    F_CHECK(Generate(source, FMipFilter::FMipFilter_BOX, false, 100u).size() == 9u);
+    const std::vector<FImage> packed = Generate(source, FMipFilter::FMipFilter_BOX, false, 0u, 4u);
+    F_CHECK(packed[1].rowPitch == 600u and packed[2].rowPitch == 300u);
+    // Level 0 is the source as it came in
+    F_CHECK(packed[0].rowPitch == 1536u);
+
+    F_CHECK(Generate(MakeImage(0u, 4u), FMipFilter::FMipFilter_BOX, false).empty());
+}
+
+F_TEST_CASE(MipFilterMatchesScalarReference)
+{
+    // Random texels stress every lane of the SIMD row filter, the sizes land on partial SIMD tails and uneven taps
+    std::mt19937 rng(19u);
+    const uint32_t sizes[][2] = { { 37u, 23u }, { 64u, 64u }, { 7u, 130u }, { 3u, 1u } };
+    for (const auto& size : sizes)
+    {
+        FImage source = MakeImage(size[0], size[1], (size[0] * 4u + 255u) / 256u * 256u);
+        for (uint8_t& value : source.texels)
+        {
+            value = static_cast<uint8_t>(rng());
+        }
+
+        for (FMipFilter filter : { FMipFilter::FMipFilter_BOX, FMipFilter::FMipFilter_KAISER })
+        {
+            for (bool srgb : { false, true })
+            {
+                // Each level against the reference filtered from the level above it
+                const std::vector<FImage> levels = Generate(source, filter, srgb);
+                uint32_t maxError = 0;
+                for (size_t level = 1; level < levels.size(); ++level)
+                {
+                    maxError = std::max(maxError, CompareWithReference(levels[level - 1], levels[level], filter, srgb));
+                }
+                F_CHECK_LE(maxError, 1u);
+            }
+        }
+    }
+}
@@ -0,0 +1,246 @@
+#include "Test.h"
+
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <random>
+
+#include "DXMaterial/OffsetAllocator.h"
+
+namespace
+{
+    // Live allocations by offset, checks nothing handed out overlaps and the books balance
+    struct FShadow
+    {
+        std::map<uint32_t, uint32_t> live;
+        uint32_t usedStorage{};
+
+        bool Add(const FOffsetAllocator& allocator, FOffsetAllocation allocation, uint32_t size)
+        {
+            if (not allocation.IsValid() or allocator.GetAllocationSize(allocation) != size or allocation.offset + size > allocator.GetSize())
+            {
+                return false;
+            }
+            const auto next = live.lower_bound(allocation.offset);
+            if (next != live.end() and next->first < allocation.offset + size)
+            {
+                return false;
+            }
+            if (next != live.begin() and std::prev(next)->first + std::prev(next)->second > allocation.offset)
+            {
+                return false;
+            }
+            live.emplace(allocation.offset, size);
+            usedStorage += size;
+            return true;
+        }
+
+        void Remove(uint32_t offset)
+        {
+            usedStorage -= live.at(offset);
+            live.erase(offset);
+        }
+    };
+}
+
+F_TEST_CASE(OffsetAllocatorMergesNeighbours)
+{
+    FOffsetAllocator allocator(1024u, 64u);
+    const FOffsetAllocation a = allocator.Allocate(100u);
+    const FOffsetAllocation b = allocator.Allocate(200u);
+    const FOffsetAllocation c = allocator.Allocate(300u);
+    F_CHECK(a.offset == 0u and b.offset == 100u and c.offset == 300u);
+    F_CHECK(allocator.GetAllocationSize(b) == 200u);
+    F_CHECK(allocator.GetFreeStorage() == 424u);
+
+    FOffsetAllocatorReport report = allocator.GetReport();
+    F_CHECK(report.usedBlocks == 3u and report.freeBlocks == 1u and report.largestFree == 424u);
+
+    // b has used blocks on both sides, nothing to merge
+    allocator.Free(b);
+    report = allocator.GetReport();
+    F_CHECK(report.usedBlocks == 2u and report.freeBlocks == 2u and report.totalFree == 624u);
+
+    // a merges with the free block after it
+    allocator.Free(a);
+    report = allocator.GetReport();
+    F_CHECK(report.usedBlocks == 1u and report.freeBlocks == 2u and report.largestFree == 424u);
+    // Its class comes before the 424 block's, so it is picked first
+    const FOffsetAllocation ab = allocator.Allocate(256u);
+    F_CHECK(ab.offset == 0u);
+    allocator.Free(ab);
+
+    // c merges with the blocks on both sides into the whole range again
+    allocator.Free(c);
+    report = allocator.GetReport();
+    F_CHECK(report.usedBlocks == 0u and report.freeBlocks == 1u and report.largestFree == 1024u and report.totalFree == 1024u);
+
+    const FOffsetAllocation all = allocator.Allocate(1024u);
+    F_CHECK(all.offset == 0u);
+    allocator.Free(all);
+
+    // Invalid allocations are ignored
+    allocator.Free({});
+    F_CHECK(allocator.GetFreeStorage() == 1024u);
+    F_CHECK(allocator.GetAllocationSize({}) == 0u);
+}
+
+F_TEST_CASE(OffsetAllocatorBinRoundUp)
+{
+    // Free blocks of 248 (class 240) and 256 (class 256) with used blocks in between, nothing merges
+    FOffsetAllocator allocator(248u + 1u + 256u + 1u, 64u);
+    const FOffsetAllocation small = allocator.Allocate(248u);
+    const FOffsetAllocation gap0 = allocator.Allocate(1u);
+    const FOffsetAllocation large = allocator.Allocate(256u);
+    const FOffsetAllocation gap1 = allocator.Allocate(1u);
+    F_CHECK(small.IsValid() and gap0.IsValid() and large.IsValid() and gap1.IsValid());
+    F_CHECK(allocator.GetFreeStorage() == 0u);
+    allocator.Free(small);
+    allocator.Free(large);
+
+    // 241 has mantissa 7 plus a remainder, the carry moves it into the next exponent's first class:
+    // the 248 block would fit but only the 256 class guarantees a fit without checking sizes
+    const FOffsetAllocation carried = allocator.Allocate(241u);
+    F_CHECK(carried.offset == large.offset);
+    // 240 is a class boundary and rounds to itself
+    const FOffsetAllocation exact = allocator.Allocate(240u);
+    F_CHECK(exact.offset == small.offset);
+    allocator.Free(carried);
+    allocator.Free(exact);
+
+    // Below 8 every size is its own class
+    FOffsetAllocator tiny(7u + 1u + 6u + 1u, 64u);
+    const FOffsetAllocation seven = tiny.Allocate(7u);
+    const FOffsetAllocation tinyGap0 = tiny.Allocate(1u);
+    const FOffsetAllocation six = tiny.Allocate(6u);
+    const FOffsetAllocation tinyGap1 = tiny.Allocate(1u);
+    F_CHECK(seven.IsValid() and tinyGap0.IsValid() and six.IsValid() and tinyGap1.IsValid());
+    tiny.Free(seven);
+    tiny.Free(six);
+    F_CHECK(tiny.Allocate(6u).offset == six.offset);
+    F_CHECK(tiny.Allocate(7u).offset == seven.offset);
+
+    // Any block found is large enough, whatever class the request started from
+    for (uint32_t size = 1; size < 70000u; size += 1u + size / 64u)
+    {
+        FOffsetAllocator single(size * 2u, 4u);
+        const FOffsetAllocation allocation = single.Allocate(size);
+        F_CHECK(allocation.IsValid() and allocation.offset == 0u and single.GetFreeStorage() == size);
+    }
+}
+
+F_TEST_CASE(OffsetAllocatorExhaustsPool)
+{
+    FOffsetAllocator allocator(1024u, 64u);
+    F_CHECK(not allocator.Allocate(0u).IsValid());
+    F_CHECK(not allocator.Allocate(1025u).IsValid());
+
+    std::vector<FOffsetAllocation> allocations;
+    for (uint32_t i = 0; i < 16u; ++i)
+    {
+        allocations.push_back(allocator.Allocate(64u));
+        F_CHECK(allocations.back().offset == i * 64u);
+    }
+    F_CHECK(allocator.GetFreeStorage() == 0u);
+    F_CHECK(not allocator.Allocate(1u).IsValid());
+
+    allocator.Free(allocations[5]);
+    F_CHECK(not allocator.Allocate(65u).IsValid());
+    F_CHECK(allocator.Allocate(64u).offset == 5u * 64u);
+    F_CHECK(allocator.GetReport().freeBlocks == 0u);
+}
+
+F_TEST_CASE(OffsetAllocatorRunsOutOfNodes)
+{
+    // 4 nodes: the first split takes the only spare after the initial free block, and so on
+    FOffsetAllocator allocator(30u + 64u, 4u);
+    FOffsetAllocation small[3];
+    for (uint32_t i = 0; i < 3u; ++i)
+    {
+        small[i] = allocator.Allocate(10u);
+        F_CHECK(small[i].offset == i * 10u);
+    }
+
+    // The 64 left would have to be split, no node to hold the remainder
+    F_CHECK(not allocator.Allocate(10u).IsValid());
+    F_CHECK(allocator.GetFreeStorage() == 64u);
+
+    // An exact fit takes over the free block's node
+    const FOffsetAllocation last = allocator.Allocate(64u);
+    F_CHECK(last.offset == 30u);
+    FOffsetAllocatorReport report = allocator.GetReport();
+    F_CHECK(report.usedBlocks == 4u and report.freeBlocks == 0u);
+
+    // Freeing without a merge keeps every node taken, a merge hands one back
+    allocator.Free(last);
+    F_CHECK(not allocator.Allocate(5u).IsValid());
+    allocator.Free(small[2]);
+    F_CHECK(allocator.Allocate(5u).offset == 20u);
+    report = allocator.GetReport();
+    F_CHECK(report.usedBlocks == 3u and report.freeBlocks == 1u and report.totalFree == 69u);
+
+    // Nothing to hand out at all
+    FOffsetAllocator empty;
+    F_CHECK(not empty.Allocate(1u).IsValid());
+}
+
+F_TEST_CASE(OffsetAllocatorFragmentation)
+{
+    constexpr uint32_t c_size = 64u * 1024u * 1024u;
+    FOffsetAllocator allocator(c_size, 64u * 1024u);
+    FShadow shadow;
+    std::vector<FOffsetAllocation> allocations;
+
+    std::mt19937 rng(13u);
+    // Mostly small blocks with a long tail, like mesh buffers
+    std::exponential_distribution<float> sizes(1.f / 4096.f);
+
+    size_t operations{}, failures{};
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 400000; ++i)
+    {
+        const bool allocate = allocations.empty() or (rng() % 100u) < (allocations.size() < 8000u ? 60u : 45u);
+        if (allocate)
+        {
+            const uint32_t size = 1u + static_cast<uint32_t>(sizes(rng));
+            const FOffsetAllocation allocation = allocator.Allocate(size);
+            if (not allocation.IsValid())
+            {
+                ++failures;
+                continue;
+            }
+            F_CHECK(shadow.Add(allocator, allocation, size));
+            allocations.push_back(allocation);
+        }
+        else
+        {
+            const size_t index = rng() % allocations.size();
+            shadow.Remove(allocations[index].offset);
+            allocator.Free(allocations[index]);
+            allocations[index] = allocations.back();
+            allocations.pop_back();
+        }
+        ++operations;
+
+        if (i % 10000 == 0)
+        {
+            const FOffsetAllocatorReport report = allocator.GetReport();
+            F_CHECK(report.totalFree + shadow.usedStorage == c_size);
+            F_CHECK(report.usedBlocks == allocations.size());
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const FOffsetAllocatorReport report = allocator.GetReport();
+    std::printf("    %zu live, %u free blocks, largest free %u of %u, %zu failed, %.1f M ops/s\n",
+        allocations.size(), report.freeBlocks, report.largestFree, report.totalFree, failures, static_cast<double>(operations) / seconds / 1e6);
+    F_CHECK(failures == 0u);
+
+    // Everything merges back into one block
+    for (const FOffsetAllocation& allocation : allocations)
+    {
+        allocator.Free(allocation);
+    }
+    const FOffsetAllocatorReport drained = allocator.GetReport();
+    F_CHECK(drained.freeBlocks == 1u and drained.usedBlocks == 0u and drained.largestFree == c_size);
+}
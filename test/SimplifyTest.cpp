@@ -0,0 +1,200 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "DXMaterial/Simplify.h"
+
+namespace
+{
+    struct FTestMesh
+    {
+        std::vector<FVertexF32> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    FVertexF32 MakeVertex(const float position[3], const float normal[3], float u, float v)
+    {
+        FVertexF32 vertex{};
+        std::copy_n(position, 3, vertex.position);
+        std::copy_n(normal, 3, vertex.normal);
+        vertex.tangent[0] = 1.f;
+        vertex.bitangent[1] = 1.f;
+        vertex.texCoord[0] = u;
+        vertex.texCoord[1] = v;
+        return vertex;
+    }
+
+    // UV mapped sphere of the given radius, the seam and the poles are duplicated vertices with their own UVs
+    FTestMesh MakeSphere(uint32_t segments, uint32_t rings, float radius)
+    {
+        FTestMesh mesh;
+        for (uint32_t r = 0; r <= rings; ++r)
+        {
+            const float theta = 3.14159265f * static_cast<float>(r) / static_cast<float>(rings);
+            for (uint32_t s = 0; s <= segments; ++s)
+            {
+                const float phi = 6.2831853f * static_cast<float>(s) / static_cast<float>(segments);
+                const float normal[3] = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+                const float position[3] = { normal[0] * radius, normal[1] * radius, normal[2] * radius };
+                mesh.vertices.push_back(MakeVertex(position, normal, static_cast<float>(s) / static_cast<float>(segments), static_cast<float>(r) / static_cast<float>(rings)));
+            }
+        }
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                const uint32_t a = r * (segments + 1u) + s;
+                const uint32_t b = a + segments + 1u;
+                mesh.indices.insert(mesh.indices.end(), { a, a + 1u, b, a + 1u, b + 1u, b });
+            }
+        }
+        return mesh;
+    }
+
+    // Flat (columns x rows) patch in the xz plane with an open border all around
+    FTestMesh MakePlane(uint32_t columns, uint32_t rows)
+    {
+        FTestMesh mesh;
+        const float up[3] = { 0.f, 1.f, 0.f };
+        for (uint32_t r = 0; r <= rows; ++r)
+        {
+            for (uint32_t c = 0; c <= columns; ++c)
+            {
+                const float position[3] = { static_cast<float>(c), 0.f, static_cast<float>(r) };
+                mesh.vertices.push_back(MakeVertex(position, up, static_cast<float>(c) / static_cast<float>(columns), static_cast<float>(r) / static_cast<float>(rows)));
+            }
+        }
+        for (uint32_t r = 0; r < rows; ++r)
+        {
+            for (uint32_t c = 0; c < columns; ++c)
+            {
+                const uint32_t a = r * (columns + 1u) + c;
+                const uint32_t b = a + columns + 1u;
+                mesh.indices.insert(mesh.indices.end(), { a, b, a + 1u, a + 1u, b, b + 1u });
+            }
+        }
+        return mesh;
+    }
+
+    // Valid indices, no triangle repeating a vertex
+    bool WellFormed(const uint32_t* indices, size_t count, size_t vertexCount)
+    {
+        for (size_t i = 0; i + 2u < count; i += 3u)
+        {
+            const uint32_t a = indices[i], b = indices[i + 1u], c = indices[i + 2u];
+            if (a >= vertexCount or b >= vertexCount or c >= vertexCount or a == b or b == c or a == c)
+            {
+                return false;
+            }
+        }
+        return count % 3u == 0u;
+    }
+
+    size_t Simplify(const FTestMesh& mesh, size_t target, const FSimplifyOptions& options, std::vector<uint32_t>& out, float& error)
+    {
+        out.assign(mesh.indices.size(), 0u);
+        const size_t count = SimplifyMesh(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(), target, options, out.data(), &error);
+        out.resize(count);
+        return count;
+    }
+}
+
+F_TEST_CASE(SimplifySphereErrorBounded)
+{
+    constexpr float c_radius = 2.f;
+    const FTestMesh sphere = MakeSphere(64u, 32u, c_radius);
+    const float extent = 2.f * c_radius;
+    const FSimplifyOptions options;
+
+    float previousError = 0.f;
+    for (size_t divisor : { 2u, 4u, 8u })
+    {
+        const size_t target = sphere.indices.size() / divisor / 3u * 3u;
+        std::vector<uint32_t> simplified;
+        float error = -1.f;
+        const size_t count = Simplify(sphere, target, options, simplified, error);
+        std::printf("    %zu -> %zu triangles (target %zu), error %.5f\n", sphere.indices.size() / 3u, count / 3u, target / 3u, error);
+
+        F_CHECK(count < sphere.indices.size());
+        F_CHECK(WellFormed(simplified.data(), count, sphere.vertices.size()));
+        // Within the limit, which is relative to the mesh extent, and growing with the reduction
+        F_CHECK(error >= previousError);
+        F_CHECK_LE(error, options.maxError * extent * 1.0001f);
+        previousError = error;
+
+        // Every vertex stays on the sphere, a collapse only ever moves to an existing vertex: the only error is
+        // how far the chords of the coarser triangles cut inside, which the reported error has to cover
+        float maxInside = 0.f;
+        for (size_t i = 0; i + 2u < count; i += 3u)
+        {
+            float centroid[3]{};
+            for (size_t corner = 0; corner < 3u; ++corner)
+            {
+                for (int axis = 0; axis < 3; ++axis) centroid[axis] += sphere.vertices[simplified[i + corner]].position[axis] / 3.f;
+            }
+            maxInside = std::max(maxInside, c_radius - std::sqrt(centroid[0] * centroid[0] + centroid[1] * centroid[1] + centroid[2] * centroid[2]));
+        }
+        F_CHECK_LE(maxInside, error * 2.f + extent * 1e-4f);
+    }
+
+    // Nothing may collapse when no error is allowed at all on a curved surface
+    FSimplifyOptions exact = options;
+    exact.maxError = 0.f;
+    std::vector<uint32_t> simplified;
+    float error = -1.f;
+    F_CHECK(Simplify(sphere, sphere.indices.size() / 2u, exact, simplified, error) == sphere.indices.size());
+    F_CHECK(error == 0.f);
+}
+
+F_TEST_CASE(SimplifyPlaneKeepsBorder)
+{
+    const FTestMesh plane = MakePlane(24u, 16u);
+    std::vector<uint32_t> simplified;
+    float error = -1.f;
+    FSimplifyOptions options;
+    // UVs are linear across the patch, their penalty would stop collapses long before the geometry does
+    options.texCoordWeight = 0.f;
+    const size_t count = Simplify(plane, 3u * 50u, options, simplified, error);
+    std::printf("    %zu -> %zu triangles, error %g\n", plane.indices.size() / 3u, count / 3u, error);
+
+    // A flat interior collapses for free
+    F_CHECK(count <= plane.indices.size() / 2u);
+    F_CHECK(WellFormed(simplified.data(), count, plane.vertices.size()));
+    F_CHECK_LE(error, 1e-4f);
+
+    // Border vertices are never collapsed away, the outline keeps every one of them
+    std::vector<uint8_t> referenced(plane.vertices.size());
+    for (uint32_t index : simplified) referenced[index] = 1u;
+    bool border = true;
+    for (size_t v = 0; v < plane.vertices.size(); ++v)
+    {
+        const float x = plane.vertices[v].position[0];
+        const float z = plane.vertices[v].position[2];
+        if (x == 0.f or x == 24.f or z == 0.f or z == 16.f) border = border and referenced[v];
+    }
+    F_CHECK(border);
+}
+
+F_TEST_CASE(SimplifyLodChain)
+{
+    const FTestMesh sphere = MakeSphere(64u, 32u, 1.f);
+    std::vector<uint32_t> indices = sphere.indices;
+    FLodChainSettings settings;
+    std::vector<FMeshLod> lods;
+    BuildLodChain(indices, sphere.vertices.data(), sphere.vertices.size(), settings, lods);
+
+    F_CHECK(lods.size() >= 2u and lods.size() <= settings.maxLods);
+    F_CHECK(lods[0].indexOffset == 0u and lods[0].indexCount == sphere.indices.size() and lods[0].error == 0.f);
+    F_CHECK(std::equal(sphere.indices.begin(), sphere.indices.end(), indices.begin()));
+    for (size_t level = 1; level < lods.size(); ++level)
+    {
+        const FMeshLod& lod = lods[level];
+        F_CHECK(lod.indexOffset == lods[level - 1].indexOffset + lods[level - 1].indexCount);
+        F_CHECK(lod.indexOffset + lod.indexCount <= indices.size());
+        F_CHECK(lod.indexCount < lods[level - 1].indexCount and lod.error >= lods[level - 1].error);
+        F_CHECK_LE(lod.error, settings.simplify.maxError * 2.f * 1.0001f);
+        F_CHECK(WellFormed(indices.data() + lod.indexOffset, lod.indexCount, sphere.vertices.size()));
+    }
+    F_CHECK(lods.back().indexOffset + lods.back().indexCount == indices.size());
+}
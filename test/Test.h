@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Minimal self registering test cases, main.cpp runs every one of them (or the ones whose name contains argv[1])
+// and exits non zero when a check failed. Checks report and keep going, a test stops only when it returns.
+struct FTestCase
+{
+    const char* name;
+    void (*run)();
+};
+
+std::vector<FTestCase>& GetTestCases();
+void ReportFailure(const char* file, int line, const char* expression);
+
+struct FTestRegistrar
+{
+    FTestRegistrar(const char* name, void (*run)()) { GetTestCases().push_back({ name, run }); }
+};
+
+#define F_TEST_CASE(name) \
+    static void name(); \
+    static const FTestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define F_CHECK(expression) \
+    do { if (not (expression)) ReportFailure(__FILE__, __LINE__, #expression); } while (0)
+
+// Prints both sides, for error bounds
+#define F_CHECK_LE(value, bound) \
+    do { \
+        const double f_value = static_cast<double>(value); \
+        const double f_bound = static_cast<double>(bound); \
+        if (not (f_value <= f_bound)) { \
+            std::printf("    %s = %g, expected <= %g\n", #value, f_value, f_bound); \
+            ReportFailure(__FILE__, __LINE__, #value " <= " #bound); \
+        } \
+    } while (0)
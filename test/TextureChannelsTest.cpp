@@ -0,0 +1,226 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "DXMaterial/TextureChannels.h"
+
+namespace
+{
+    // Rows padded to 'rowPitch', the padding holds junk that must never be looked at
+    FImage MakeImage(uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t seed, bool grayscale, bool opaque)
+    {
+        std::mt19937 rng(seed);
+        FImage image;
+        image.width = width;
+        image.height = height;
+        image.rowPitch = rowPitch;
+        image.texels.resize(static_cast<size_t>(rowPitch) * height);
+        for (uint8_t& value : image.texels)
+        {
+            value = static_cast<uint8_t>(rng());
+        }
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint8_t* texel = image.texels.data() + static_cast<size_t>(y) * rowPitch + x * 4u;
+                if (grayscale) texel[1] = texel[2] = texel[0];
+                if (opaque) texel[3] = 255u;
+            }
+        }
+        return image;
+    }
+
+    uint8_t* Texel(FImage& image, uint32_t x, uint32_t y)
+    {
+        return image.texels.data() + static_cast<size_t>(y) * image.rowPitch + x * 4u;
+    }
+
+    FTextureData MakeTexture(bool grayscale, bool opaque)
+    {
+        FTextureData texture;
+        texture.format = FPixelFormat::FPixelFormat_RGBA8;
+        texture.levels.push_back(MakeImage(13u, 5u, 64u, 1u, grayscale, opaque));
+        texture.levels.push_back(MakeImage(6u, 2u, 256u, 2u, grayscale, opaque));
+        texture.levels.push_back(MakeImage(1u, 1u, 4u, 3u, grayscale, opaque));
+        return texture;
+    }
+
+    // What the SRV component mapping of 'swizzle' hands to the shader for texel x of a packed row
+    void Sample(const uint8_t* row, uint32_t x, FChannelSwizzle swizzle, uint8_t out[4])
+    {
+        switch (swizzle)
+        {
+            case FChannelSwizzle::FChannelSwizzle_RRR1:
+                out[0] = out[1] = out[2] = row[x];
+                out[3] = 255u;
+                break;
+            case FChannelSwizzle::FChannelSwizzle_RRRG:
+                out[0] = out[1] = out[2] = row[2u * x];
+                out[3] = row[2u * x + 1u];
+                break;
+            default:
+                std::copy_n(row + 4u * x, 4u, out);
+                break;
+        }
+    }
+}
+
+F_TEST_CASE(ChannelsDetectGrayscaleAndOpaque)
+{
+    FImage image = MakeImage(19u, 7u, 128u, 5u, true, true);
+    FChannelUsage usage = AnalyzeChannels(image);
+    F_CHECK(usage.grayscale and usage.opaque);
+
+    // One texel with green off by one is enough to be color
+    Texel(image, 18u, 6u)[1] ^= 1u;
+    usage = AnalyzeChannels(image);
+    F_CHECK(not usage.grayscale and usage.opaque);
+    Texel(image, 18u, 6u)[1] ^= 1u;
+
+    Texel(image, 0u, 3u)[3] = 254u;
+    usage = AnalyzeChannels(image);
+    F_CHECK(usage.grayscale and not usage.opaque);
+
+    // Random texels are neither, the padding past the last texel of a row is not part of the image
+    F_CHECK(not AnalyzeChannels(MakeImage(19u, 7u, 128u, 6u, false, false)).grayscale);
+    F_CHECK(not AnalyzeChannels(MakeImage(19u, 7u, 128u, 6u, false, false)).opaque);
+    F_CHECK(AnalyzeChannels(MakeImage(1u, 40u, 256u, 7u, true, true)).grayscale);
+}
+
+F_TEST_CASE(ChannelsConstantSpread)
+{
+    FImage image = MakeImage(16u, 9u, 256u, 8u, false, false);
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            uint8_t* texel = Texel(image, x, y);
+            texel[0] = 10u;
+            texel[1] = 128u;
+            texel[2] = 250u;
+            texel[3] = 255u;
+        }
+    }
+    FChannelUsage usage = AnalyzeChannels(image);
+    const uint8_t constant[4] = { 10u, 128u, 250u, 255u };
+    for (uint32_t c = 0; c < 4u; ++c)
+    {
+        F_CHECK(usage.minValue[c] == constant[c] and usage.maxValue[c] == constant[c]);
+    }
+
+    // A spread in one channel leaves the others constant, wherever the outliers are
+    Texel(image, 15u, 8u)[1] = 131u;
+    Texel(image, 0u, 0u)[1] = 126u;
+    Texel(image, 7u, 4u)[3] = 0u;
+    usage = AnalyzeChannels(image);
+    F_CHECK(usage.minValue[0] == 10u and usage.maxValue[0] == 10u);
+    F_CHECK(usage.minValue[1] == 126u and usage.maxValue[1] == 131u);
+    F_CHECK(usage.minValue[2] == 250u and usage.maxValue[2] == 250u);
+    F_CHECK(usage.minValue[3] == 0u and usage.maxValue[3] == 255u);
+    F_CHECK(not usage.opaque);
+}
+
+F_TEST_CASE(ChannelsPackLayouts)
+{
+    const FTextureData source = MakeTexture(false, false);
+    const uint32_t layouts[][3] = { { 1u, 0u, 0u }, { 1u, 1u, 0u }, { 2u, 0u, 3u }, { 2u, 2u, 1u } };
+    for (const auto& layout : layouts)
+    {
+        const uint32_t count = layout[0];
+        const uint32_t channels[2] = { layout[1], layout[2] };
+        FTextureData packed;
+        PackChannels(source, channels, count, 256u, packed);
+
+        F_CHECK(packed.format == (count == 1u ? FPixelFormat::FPixelFormat_R8 : FPixelFormat::FPixelFormat_RG8));
+        F_CHECK(packed.levels.size() == source.levels.size());
+        for (size_t level = 0; level < packed.levels.size() and level < source.levels.size(); ++level)
+        {
+            const FImage& src = source.levels[level];
+            const FImage& dst = packed.levels[level];
+            F_CHECK(dst.width == src.width and dst.height == src.height);
+            F_CHECK(dst.rowPitch == 256u and dst.texels.size() == 256u * static_cast<size_t>(dst.height));
+
+            bool matches = true;
+            for (uint32_t y = 0; y < src.height; ++y)
+            {
+                const uint8_t* srcRow = src.texels.data() + static_cast<size_t>(y) * src.rowPitch;
+                const uint8_t* dstRow = dst.texels.data() + static_cast<size_t>(y) * dst.rowPitch;
+                for (uint32_t x = 0; x < src.width; ++x)
+                {
+                    for (uint32_t c = 0; c < count; ++c)
+                    {
+                        matches = matches and dstRow[x * count + c] == srcRow[4u * x + channels[c]];
+                    }
+                }
+                // Padding is cleared, not copied from the source
+                for (uint32_t i = src.width * count; i < dst.rowPitch; ++i)
+                {
+                    matches = matches and dstRow[i] == 0u;
+                }
+            }
+            F_CHECK(matches);
+        }
+    }
+
+    // A pitch alignment that does not round up at all
+    const uint32_t red[2] = { 0u, 0u };
+    FTextureData tight;
+    PackChannels(source, red, 1u, 1u, tight);
+    F_CHECK(tight.levels[0].rowPitch == 13u and tight.levels[1].rowPitch == 6u and tight.levels[2].rowPitch == 1u);
+
+    // Only RGBA8 to one or two channels
+    bool thrown = false;
+    try { PackChannels(source, red, 3u, 256u, tight); } catch (const std::invalid_argument&) { thrown = true; }
+    F_CHECK(thrown);
+    thrown = false;
+    try { PackChannels(source, red, 0u, 256u, tight); } catch (const std::invalid_argument&) { thrown = true; }
+    F_CHECK(thrown);
+    thrown = false;
+    try { PackChannels(tight, red, 1u, 256u, tight); } catch (const std::invalid_argument&) { thrown = true; }
+    F_CHECK(thrown);
+}
+
+F_TEST_CASE(ChannelsSwizzleRestoresGrayscale)
+{
+    // Grayscale opaque goes to R8 read as RRR1, grayscale with alpha to RG8 read as RRRG: what the shader
+    // samples is exactly the RGBA source
+    for (bool opaque : { true, false })
+    {
+        const FTextureData source = MakeTexture(true, opaque);
+        const uint32_t channels[2] = { 0u, 3u };
+        const uint32_t count = opaque ? 1u : 2u;
+        const FChannelSwizzle swizzle = opaque ? FChannelSwizzle::FChannelSwizzle_RRR1 : FChannelSwizzle::FChannelSwizzle_RRRG;
+
+        FTextureData packed;
+        PackChannels(source, channels, count, 256u, packed);
+        bool matches = true;
+        for (size_t level = 0; level < source.levels.size(); ++level)
+        {
+            const FImage& src = source.levels[level];
+            const FImage& dst = packed.levels[level];
+            for (uint32_t y = 0; y < src.height; ++y)
+            {
+                for (uint32_t x = 0; x < src.width; ++x)
+                {
+                    uint8_t sampled[4];
+                    Sample(dst.texels.data() + static_cast<size_t>(y) * dst.rowPitch, x, swizzle, sampled);
+                    matches = matches and std::equal(sampled, sampled + 4, src.texels.data() + static_cast<size_t>(y) * src.rowPitch + x * 4u);
+                }
+            }
+        }
+        F_CHECK(matches);
+    }
+
+    // A single channel taken from green, the roughness of a packed map, is handed to every channel by RRR1
+    const FTextureData source = MakeTexture(false, true);
+    const uint32_t green[2] = { 1u, 0u };
+    FTextureData packed;
+    PackChannels(source, green, 1u, 256u, packed);
+    uint8_t sampled[4];
+    Sample(packed.levels[0].texels.data(), 12u, FChannelSwizzle::FChannelSwizzle_RRR1, sampled);
+    const uint8_t* texel = source.levels[0].texels.data() + 12u * 4u;
+    F_CHECK(sampled[0] == texel[1] and sampled[1] == texel[1] and sampled[2] == texel[1] and sampled[3] == 255u);
+}
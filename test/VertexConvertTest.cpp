@@ -0,0 +1,158 @@
+#include "Test.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "DXMaterial/VertexConvert.h"
+
+namespace
+{
+    // Assimp style arrays, three floats per element for every attribute
+    struct FTestStreams
+    {
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> tangents;
+        std::vector<float> bitangents;
+        std::vector<float> texCoords;
+    };
+
+    // Random frames, about half of them left handed. The normal is the frame's cross product, bent a bit,
+    // so the handedness never hangs on the rounding of a determinant close to zero.
+    FTestStreams MakeStreams(size_t count, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> value(-1.f, 1.f);
+        FTestStreams s;
+        for (size_t i = 0; i < count; ++i)
+        {
+            float t[3], b[3];
+            for (float& x : t) x = value(rng);
+            for (float& x : b) x = value(rng);
+            const float c[3] = { t[1] * b[2] - t[2] * b[1], t[2] * b[0] - t[0] * b[2], t[0] * b[1] - t[1] * b[0] };
+            const float length = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+            const float sign = (rng() & 1u) ? -1.f : 1.f;
+            for (int k = 0; k < 3; ++k)
+            {
+                s.positions.push_back(value(rng) * 100.f);
+                s.normals.push_back(length > 1e-3f ? sign * c[k] / length + value(rng) * 0.1f : 0.f);
+                s.tangents.push_back(t[k]);
+                s.bitangents.push_back(b[k]);
+                // Only the first two are used, the third must not leak into the output
+                s.texCoords.push_back(k == 2 ? 1234.f : value(rng) * 4.f);
+            }
+        }
+        return s;
+    }
+
+    FVertexStreams View(const FTestStreams& s, size_t count, bool normals, bool tangents, bool texCoords)
+    {
+        FVertexStreams streams;
+        streams.positions = s.positions.data();
+        streams.normals = normals ? s.normals.data() : nullptr;
+        streams.tangents = tangents ? s.tangents.data() : nullptr;
+        streams.bitangents = tangents ? s.bitangents.data() : nullptr;
+        streams.texCoords = texCoords ? s.texCoords.data() : nullptr;
+        streams.count = count;
+        return streams;
+    }
+
+    // One guard vertex past the end catches stores that run over
+    std::vector<FVertexF32> Convert(const FVertexStreams& streams, FVertexKernel kernel)
+    {
+        std::vector<FVertexF32> out(streams.count + 1u);
+        std::memset(out.data(), 0xCD, out.size() * sizeof(FVertexF32));
+        ConvertVertices(streams, out.data(), kernel);
+        return out;
+    }
+
+    bool SameBytes(const std::vector<FVertexF32>& a, const std::vector<FVertexF32>& b)
+    {
+        return a.size() == b.size() and std::memcmp(a.data(), b.data(), a.size() * sizeof(FVertexF32)) == 0;
+    }
+}
+
+F_TEST_CASE(VertexConvertFallbacks)
+{
+    const FTestStreams s = MakeStreams(3u, 1u);
+
+    // Nothing but positions: zero normal, the default frame, zero UVs
+    std::vector<FVertexF32> out = Convert(View(s, 3u, false, false, false), FVertexKernel::Scalar);
+    for (size_t i = 0; i < 3u; ++i)
+    {
+        const FVertexF32& v = out[i];
+        F_CHECK(std::memcmp(v.position, &s.positions[i * 3u], sizeof(v.position)) == 0);
+        F_CHECK(v.normal[0] == 0.f and v.normal[1] == 0.f and v.normal[2] == 0.f);
+        F_CHECK(v.tangent[0] == 1.f and v.tangent[1] == 0.f and v.tangent[2] == 0.f);
+        F_CHECK(v.bitangent[0] == 0.f and v.bitangent[1] == 1.f and v.bitangent[2] == 0.f);
+        F_CHECK(v.texCoord[0] == 0.f and v.texCoord[1] == 0.f);
+    }
+
+    // Everything present: the bitangent is flipped exactly where the frame is left handed
+    out = Convert(View(s, 3u, true, true, true), FVertexKernel::Scalar);
+    for (size_t i = 0; i < 3u; ++i)
+    {
+        const float* n = &s.normals[i * 3u];
+        const float* t = &s.tangents[i * 3u];
+        const float* b = &s.bitangents[i * 3u];
+        const float det = n[0] * (t[1] * b[2] - t[2] * b[1]) + n[1] * (t[2] * b[0] - t[0] * b[2]) + n[2] * (t[0] * b[1] - t[1] * b[0]);
+        const float sign = det < 0.f ? -1.f : 1.f;
+        F_CHECK(out[i].bitangent[0] == b[0] * sign and out[i].bitangent[1] == b[1] * sign and out[i].bitangent[2] == b[2] * sign);
+        F_CHECK(out[i].texCoord[0] == s.texCoords[i * 3u] and out[i].texCoord[1] == s.texCoords[i * 3u + 1u]);
+    }
+
+    // A tangent without a bitangent is no frame, the default one still flips against the normal
+    FVertexStreams half = View(s, 3u, true, true, true);
+    half.bitangents = nullptr;
+    out = Convert(half, FVertexKernel::Scalar);
+    for (size_t i = 0; i < 3u; ++i)
+    {
+        F_CHECK(out[i].tangent[0] == 1.f and out[i].tangent[1] == 0.f and out[i].tangent[2] == 0.f);
+        F_CHECK(out[i].bitangent[1] == (s.normals[i * 3u + 2u] < 0.f ? -1.f : 1.f));
+    }
+
+    // Nothing to convert writes nothing
+    FVertexF32 untouched{};
+    ConvertVertices(View(s, 0u, true, true, true), &untouched, FVertexKernel::Scalar);
+    FVertexStreams noPositions = View(s, 3u, true, true, true);
+    noPositions.positions = nullptr;
+    ConvertVertices(noPositions, &untouched, GetBestVertexKernel());
+    F_CHECK(untouched.position[0] == 0.f);
+}
+
+F_TEST_CASE(VertexConvertKernelsMatchScalar)
+{
+    // Counts around the 4 and 8 wide steps, where the SIMD loops hand over to the scalar tail
+    std::vector<size_t> counts;
+    for (size_t count = 1; count <= 40u; ++count) counts.push_back(count);
+    counts.insert(counts.end(), { 1000u, 1001u, 1003u, 1007u });
+
+    const FTestStreams s = MakeStreams(1007u, 2u);
+    const FVertexKernel kernels[] = { FVertexKernel::SSE2, FVertexKernel::AVX2 };
+    std::printf("    best kernel: %s\n", VertexKernelToString(GetBestVertexKernel()));
+
+    size_t mismatches = 0;
+    for (uint32_t variant = 0; variant < 8u; ++variant)
+    {
+        const bool normals = (variant & 1u) != 0;
+        const bool tangents = (variant & 2u) != 0;
+        const bool texCoords = (variant & 4u) != 0;
+        for (size_t count : counts)
+        {
+            const FVertexStreams streams = View(s, count, normals, tangents, texCoords);
+            const std::vector<FVertexF32> reference = Convert(streams, FVertexKernel::Scalar);
+            for (FVertexKernel kernel : kernels)
+            {
+                if (not SameBytes(Convert(streams, kernel), reference))
+                {
+                    std::printf("    %s differs: normals %d, tangents %d, uvs %d, %zu vertices\n",
+                        VertexKernelToString(kernel), normals, tangents, texCoords, count);
+                    ++mismatches;
+                }
+            }
+            if (not SameBytes(Convert(streams, GetBestVertexKernel()), reference)) ++mismatches;
+        }
+    }
+    F_CHECK(mismatches == 0u);
+}
@@ -0,0 +1,239 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+#include "DXMaterial/VertexPacking.h"
+
+namespace
+{
+    // 16 bit octahedral directions land within ~0.0074 degrees, the fold included
+    constexpr float c_maxOctAngle = .01f;
+    // MeasurePackingError works in float, acos of a dot product that close to 1 resolves ~0.028 degrees only
+    constexpr float c_maxMeasuredAngle = .05f;
+
+    void Normalize(float v[3])
+    {
+        const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        for (int i = 0; i < 3; ++i) v[i] /= length;
+    }
+
+    void Cross(const float a[3], const float b[3], float out[3])
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    // Orthonormal frame around 'normal', the bitangent flipped for left handed ones
+    FVertexF32 MakeVertex(const float normal[3], bool leftHanded)
+    {
+        FVertexF32 v{};
+        for (int i = 0; i < 3; ++i) v.normal[i] = normal[i];
+        Normalize(v.normal);
+
+        const float up[3] = { 0.f, 1.f, 0.f };
+        const float side[3] = { 1.f, 0.f, 0.f };
+        Cross(std::abs(v.normal[1]) < .9f ? up : side, v.normal, v.tangent);
+        Normalize(v.tangent);
+        Cross(v.normal, v.tangent, v.bitangent);
+        if (leftHanded)
+        {
+            for (float& b : v.bitangent) b = -b;
+        }
+        return v;
+    }
+
+    // In double, float acos cannot resolve the small angles measured here
+    double AngleDegrees(const float a[3], const float b[3])
+    {
+        double cross[3], dot{};
+        for (int i = 0; i < 3; ++i)
+        {
+            cross[i] = static_cast<double>(a[(i + 1) % 3]) * b[(i + 2) % 3] - static_cast<double>(a[(i + 2) % 3]) * b[(i + 1) % 3];
+            dot += static_cast<double>(a[i]) * b[i];
+        }
+        return std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 57.29577951308232;
+    }
+
+    // Unit directions hitting every special spot of the octahedral map
+    std::vector<std::array<float, 3>> EdgeDirections()
+    {
+        const float h = std::sqrt(.5f);
+        return {
+            { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f },                                      // poles, -Z is every corner of the square
+            { 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f }, // corners of the z = 0 diamond
+            { h, h, 0.f }, { -h, h, 0.f }, { h, -h, 0.f }, { -h, -h, 0.f },              // the z = 0 seam between both halves
+            { .6f, 0.f, -.8f }, { -.6f, 0.f, -.8f }, { 0.f, .6f, -.8f }, { 0.f, -.6f, -.8f }, // fold lines of the lower half
+            { 1e-4f, -1e-4f, -1.f }, { -1e-4f, 1e-4f, 1.f },                             // next to the poles
+        };
+    }
+}
+
+F_TEST_CASE(PositionQuantizationRoundTrip)
+{
+    std::mt19937 rng(42u);
+    std::uniform_real_distribution<float> x(-3.f, 5.f), y(100.f, 100.5f);
+
+    std::vector<FVertexF32> vertices(4096);
+    for (FVertexF32& v : vertices)
+    {
+        const float n[3] = { 0.f, 0.f, 1.f };
+        v = MakeVertex(n, false);
+        v.position[0] = x(rng);
+        v.position[1] = y(rng);
+        v.position[2] = -7.25f; // zero extent axis
+    }
+
+    const FPositionQuantization quantization = ComputePositionQuantization(vertices.data(), vertices.size());
+    F_CHECK(quantization.scale[2] == 1.f);
+    F_CHECK(quantization.offset[2] == -7.25f);
+
+    std::vector<FPackedVertex> packed(vertices.size());
+    PackVertices(vertices.data(), vertices.size(), quantization, packed.data());
+
+    // Half a quantization step per axis, plus float rounding of the offset add
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        FVertexF32 decoded;
+        UnpackVertex(packed[i], quantization, decoded);
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            const float step = quantization.scale[axis] / 65535.f;
+            F_CHECK_LE(std::abs(decoded.position[axis] - vertices[i].position[axis]), .5f * step + 1e-5f * std::abs(vertices[i].position[axis]));
+        }
+        F_CHECK(packed[i].position[2] == 0u);
+        F_CHECK(decoded.position[2] == -7.25f);
+    }
+}
+
+F_TEST_CASE(PositionQuantizationDegenerateMesh)
+{
+    // A single point: every axis has zero extent and decodes exactly
+    FVertexF32 v{};
+    v.position[0] = 1.5f;
+    v.position[1] = -2.f;
+    v.position[2] = 1e6f;
+    v.normal[2] = 1.f;
+    v.tangent[0] = 1.f;
+    v.bitangent[1] = 1.f;
+
+    const FPositionQuantization quantization = ComputePositionQuantization(&v, 1u);
+    FPackedVertex packed;
+    PackVertices(&v, 1u, quantization, &packed);
+    const FPackingError error = MeasurePackingError(&v, &packed, 1u, quantization);
+    F_CHECK(error.maxPositionError == 0.f);
+}
+
+F_TEST_CASE(OctahedralNormalsRoundTrip)
+{
+    std::mt19937 rng(7u);
+    std::normal_distribution<float> gauss;
+
+    double worst{};
+    for (int i = 0; i < 100000; ++i)
+    {
+        float n[3] = { gauss(rng), gauss(rng), gauss(rng) };
+        Normalize(n);
+
+        int16_t encoded[2];
+        float decoded[3];
+        OctEncode(n, encoded);
+        OctDecode(encoded, decoded);
+        worst = std::max(worst, AngleDegrees(n, decoded));
+        F_CHECK_LE(std::abs(decoded[0] * decoded[0] + decoded[1] * decoded[1] + decoded[2] * decoded[2] - 1.f), 1e-5f);
+    }
+    F_CHECK_LE(worst, c_maxOctAngle);
+
+    for (const std::array<float, 3>& direction : EdgeDirections())
+    {
+        float n[3] = { direction[0], direction[1], direction[2] };
+        Normalize(n);
+
+        int16_t encoded[2];
+        float decoded[3];
+        OctEncode(n, encoded);
+        OctDecode(encoded, decoded);
+        F_CHECK_LE(AngleDegrees(n, decoded), c_maxOctAngle);
+    }
+
+    // Zero length stays finite, it decodes to +Z
+    const float zero[3] = {};
+    int16_t encoded[2];
+    float decoded[3];
+    OctEncode(zero, encoded);
+    OctDecode(encoded, decoded);
+    F_CHECK(decoded[2] == 1.f);
+}
+
+F_TEST_CASE(PackedFramesAndBitangentSign)
+{
+    std::mt19937 rng(3u);
+    std::normal_distribution<float> gauss;
+
+    std::vector<FVertexF32> vertices;
+    for (const std::array<float, 3>& direction : EdgeDirections())
+    {
+        vertices.push_back(MakeVertex(direction.data(), false));
+        vertices.push_back(MakeVertex(direction.data(), true));
+    }
+    for (int i = 0; i < 20000; ++i)
+    {
+        const float n[3] = { gauss(rng), gauss(rng), gauss(rng) };
+        vertices.push_back(MakeVertex(n, (i & 1) != 0));
+    }
+
+    const FPositionQuantization quantization = ComputePositionQuantization(vertices.data(), vertices.size());
+    std::vector<FPackedVertex> packed(vertices.size());
+    PackVertices(vertices.data(), vertices.size(), quantization, packed.data());
+
+    const FPackingError error = MeasurePackingError(vertices.data(), packed.data(), packed.size(), quantization);
+    F_CHECK_LE(error.maxNormalAngle, c_maxMeasuredAngle);
+    F_CHECK_LE(error.maxTangentAngle, c_maxMeasuredAngle);
+    F_CHECK_LE(error.maxPositionError, 0.f); // every vertex sits at the origin
+    F_CHECK(error.bitangentSignErrors == 0u);
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const bool leftHanded = i < 2u * EdgeDirections().size() ? (i & 1u) != 0 : ((i - 2u * EdgeDirections().size()) & 1u) != 0;
+        F_CHECK(packed[i].position[3] == (leftHanded ? 65535u : 0u));
+
+        // The rebuilt bitangent points the way the original did
+        FVertexF32 decoded;
+        UnpackVertex(packed[i], quantization, decoded);
+        F_CHECK_LE(AngleDegrees(decoded.bitangent, vertices[i].bitangent), 2.f * c_maxOctAngle);
+    }
+}
+
+F_TEST_CASE(TexCoordHalfRoundTrip)
+{
+    // Exactly representable values survive as they are
+    for (float value : { 0.f, -0.f, .5f, 1.f, -1.f, 2.f, 1024.f, 65504.f, 0.099975586f, 6.1035156e-5f, 5.9604645e-8f })
+    {
+        F_CHECK(HalfToFloat(FloatToHalf(value)) == value);
+    }
+    F_CHECK(std::signbit(HalfToFloat(FloatToHalf(-0.f))));
+
+    // Out of range
+    F_CHECK(std::isinf(HalfToFloat(FloatToHalf(1e6f))));
+    F_CHECK(std::isinf(HalfToFloat(FloatToHalf(-1e6f))) and HalfToFloat(FloatToHalf(-1e6f)) < 0.f);
+    F_CHECK(std::isnan(HalfToFloat(FloatToHalf(std::nanf("")))));
+    F_CHECK(HalfToFloat(FloatToHalf(1e-9f)) == 0.f);
+
+    // Round to nearest: half a unit in the last place, relative 2^-11 for normals, absolute 2^-25 for denormals
+    std::mt19937 rng(11u);
+    std::uniform_real_distribution<float> uv(-4.f, 4.f);
+    std::uniform_real_distribution<float> tiny(-1e-4f, 1e-4f);
+    for (int i = 0; i < 100000; ++i)
+    {
+        const float value = (i & 3) == 0 ? tiny(rng) : uv(rng);
+        const float decoded = HalfToFloat(FloatToHalf(value));
+        F_CHECK_LE(std::abs(decoded - value), std::fmax(std::abs(value) * 0x1p-11f, 0x1p-25f));
+    }
+
+    // Ties go to even
+    F_CHECK(FloatToHalf(1.f + 0x1p-11f) == FloatToHalf(1.f));
+    F_CHECK(FloatToHalf(1.f + 3.f * 0x1p-11f) == FloatToHalf(1.f + 0x1p-9f));
+}
@@ -0,0 +1,29 @@
+mox_setup_test()
+uuid("5b1f3e0a-6c2d-4f7e-9a4b-2d8e61c0f3a7")
+
+-- stb_image and stb_image_write come from vcpkg
+mox_use_vcpkg()
+
+warnings "Default"
+
+-- DXMaterial is an executable, the tests compile its platform independent sources in directly
+files {
+    "%{wks.location}/src/DXMaterial/VertexConvert.cpp",
+    "%{wks.location}/src/DXMaterial/VertexPacking.cpp",
+    "%{wks.location}/src/DXMaterial/MeshSplit.cpp",
+    "%{wks.location}/src/DXMaterial/MeshOptimize.cpp",
+    "%{wks.location}/src/DXMaterial/Simplify.cpp",
+    "%{wks.location}/src/DXMaterial/FrustumCull.cpp",
+    "%{wks.location}/src/DXMaterial/Meshlet.cpp",
+    "%{wks.location}/src/DXMaterial/OffsetAllocator.cpp",
+    "%{wks.location}/src/DXMaterial/ThreadPool.cpp",
+    "%{wks.location}/src/DXMaterial/ImageDecoder.cpp",
+    "%{wks.location}/src/DXMaterial/StbImageDecoder.cpp",
+    "%{wks.location}/src/DXMaterial/Mipmap.cpp",
+    "%{wks.location}/src/DXMaterial/BlockCompress.cpp",
+    "%{wks.location}/src/DXMaterial/TextureChannels.cpp",
+}
+
+filter "system:linux"
+    links { "pthread" }
+filter {}
@@ -0,0 +1,50 @@
+#include "Test.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    int g_failures{};
+}
+
+std::vector<FTestCase>& GetTestCases()
+{
+    static std::vector<FTestCase> cases;
+    return cases;
+}
+
+void ReportFailure(const char* file, int line, const char* expression)
+{
+    std::printf("    %s:%d: check failed: %s\n", file, line, expression);
+    g_failures++;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    int failedCases{};
+    int ranCases{};
+    for (const FTestCase& test : GetTestCases())
+    {
+        if (filter and not std::strstr(test.name, filter))
+        {
+            continue;
+        }
+
+        std::printf("[ RUN  ] %s\n", test.name);
+        const int failuresBefore = g_failures;
+        const auto start = std::chrono::steady_clock::now();
+        test.run();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        const bool passed = g_failures == failuresBefore;
+        std::printf("[ %s ] %s (%.1f ms)\n", passed ? " OK " : "FAIL", test.name, ms);
+        failedCases += passed ? 0 : 1;
+        ranCases++;
+    }
+
+    std::printf("%d of %d test cases passed\n", ranCases - failedCases, ranCases);
+    return failedCases == 0 ? 0 : 1;
+}